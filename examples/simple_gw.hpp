@@ -7,6 +7,7 @@
 #define __EXAMPLES_SIMPLE_GW_HPP_
 
 #include <DeviceHive/gateway.hpp>
+#include <DeviceHive/outbox.hpp>
 #include <DeviceHive/restful.hpp>
 #include <DeviceHive/websocket.hpp>
 #include "basic_app.hpp"
@@ -75,8 +76,12 @@ public:
 
         String serialPortName = "";
         UInt32 serialBaudrate = 9600;
+        bool serialLowLatency = false;
         String socketAddress = "";
 
+        String outboxFileName = "simple_gw.outbox";
+        size_t outboxCapacity = 16*1024*1024;
+
         // custom device properties
         for (int i = 1; i < argc; ++i) // skip executable name
         {
@@ -93,7 +98,10 @@ public:
                 std::cout << "\t--no-ws-ping-pong disable websocket ping/pong messages\n";
                 std::cout << "\t--serial <serial device>\n";
                 std::cout << "\t--baudrate <serial baudrate>\n";
+                std::cout << "\t--low-latency enable serial port low-latency mode (Linux only)\n";
                 std::cout << "\t--socket <socket address and port>\n";
+                std::cout << "\t--outbox <outbox file name>\n";
+                std::cout << "\t--outbox-capacity <outbox capacity, bytes>\n";
 
                 exit(1);
             }
@@ -117,18 +125,29 @@ public:
                 serialPortName = argv[++i];
             else if (boost::algorithm::iequals(argv[i], "--baudrate") && i+1 < argc)
                 serialBaudrate = boost::lexical_cast<UInt32>(argv[++i]);
+            else if (boost::algorithm::iequals(argv[i], "--low-latency"))
+                serialLowLatency = true;
             else if (boost::algorithm::iequals(argv[i], "--socket") && i+1 < argc)
                 socketAddress = argv[++i];
+            else if (boost::algorithm::iequals(argv[i], "--outbox") && i+1 < argc)
+                outboxFileName = argv[++i];
+            else if (boost::algorithm::iequals(argv[i], "--outbox-capacity") && i+1 < argc)
+                outboxCapacity = boost::lexical_cast<size_t>(argv[++i]);
         }
 
         if (!serialPortName.empty())
-            pthis->m_stream = gateway::StreamDevice::Serial::create(pthis->m_ios, serialPortName, serialBaudrate);
+        {
+            gateway::StreamDevice::Serial::SharedPtr serial = gateway::StreamDevice::Serial::create(pthis->m_ios, serialPortName, serialBaudrate);
+            serial->setLowLatency(serialLowLatency);
+            pthis->m_stream = serial;
+        }
         else if (!socketAddress.empty())
             pthis->m_stream = gateway::StreamDevice::Socket::create(pthis->m_ios, socketAddress);
         else
             throw std::runtime_error("no stream device provided");
 
         pthis->m_gw_api = GatewayAPI::create(*pthis->m_stream);
+        pthis->m_outbox = devicehive::Outbox::create(outboxFileName, outboxCapacity);
         pthis->m_network = devicehive::Network::create(networkName, networkKey, networkDesc);
 
         if (1) // create service
@@ -145,6 +164,7 @@ public:
                 devicehive::WebsocketService::SharedPtr service = devicehive::WebsocketService::create(
                     http::Client::create(pthis->m_ios), baseUrl, pthis);
                 service->setPingPongEnabled(!pthis->m_disableWebsocketPingPong);
+                service->setAutoReconnect(true); // restore the session after connection loss
                 if (0 < web_timeout)
                     service->setTimeout(web_timeout*1000); // seconds -> milliseconds
 
@@ -233,6 +253,11 @@ private:
         if (!err)
         {
             HIVELOG_INFO(m_log, "got stream device OPEN");
+            if (gateway::StreamDevice::Serial::SharedPtr serial = boost::dynamic_pointer_cast<gateway::StreamDevice::Serial>(m_stream))
+            {
+                HIVELOG_INFO(m_log, "serial port settings: "
+                    << serial->getSettings().toString());
+            }
 
             asyncListenForGatewayFrames(true);
             sendGatewayRegistrationRequest();
@@ -304,6 +329,7 @@ private: // IDeviceServiceEvents
                 devicehive::WebsocketService::SharedPtr service = devicehive::WebsocketService::create(
                     rest->getHttpClient(), info.alternativeUrl, shared_from_this());
                 service->setPingPongEnabled(!m_disableWebsocketPingPong);
+                service->setAutoReconnect(true); // restore the session after connection loss
                 service->setTimeout(rest->getTimeout());
                 m_service = service;
 
@@ -333,7 +359,7 @@ private: // IDeviceServiceEvents
             m_deviceRegistered = true;
 
             m_service->asyncSubscribeForCommands(m_device, m_lastCommandTimestamp);
-            sendPendingNotifications();
+            sendOutboxNotifications();
         }
         else
             handleServiceError(err, "registering device");
@@ -371,21 +397,71 @@ private: // IDeviceServiceEvents
             handleServiceError(err, "polling command");
     }
 
+
+    /// @copydoc devicehive::IDeviceServiceEvents::onInsertNotification()
+    virtual void onInsertNotification(ErrorCode err, devicehive::DevicePtr device, devicehive::NotificationPtr notification)
+    {
+        if (!m_outboxInFlight || m_outboxInFlight != notification)
+            return; // not the current one
+        m_outboxInFlight.reset();
+
+        if (devicehive::isRejectedError(err))
+        {
+            // will be rejected again, so don't block the outbox
+            HIVELOG_ERROR(m_log, "notification \"" << notification->name
+                << "\" for device \"" << device->id << "\" is rejected by server, dropped");
+            err = boost::system::error_code();
+        }
+
+        if (!err)
+        {
+            m_outbox->pop(1);
+            sendOutboxNotifications();
+        }
+        else
+            handleServiceError(err, "inserting notification");
+    }
+
 private:
 
-    /// @brief Send all pending notifications.
-    void sendPendingNotifications()
+    /// @brief Send the oldest stored notification.
+    /**
+    All notifications are stored in the outbox first.
+    The notification is removed from the outbox only when
+    it is sent, so nothing is lost during outages.
+    Notifications are sent one by one, so the server
+    receives them in order.
+    */
+    void sendOutboxNotifications()
     {
-        const size_t N = m_pendingNotifications.size();
-        HIVELOG_INFO(m_log, "sending " << N
-            << " pending notifications");
+        if (!m_deviceRegistered || m_outboxInFlight)
+            return; // not ready or notification in progress
 
-        for (size_t i = 0; i < N; ++i)
+        std::vector<devicehive::Outbox::Entry> head;
+        while (m_outbox->peek(head, 1))
         {
-            m_service->asyncInsertNotification(m_device,
-                m_pendingNotifications[i]);
+            if (head[0].notification && head[0].deviceId == m_device->id)
+                break; // ready to send
+
+            // corrupted record or notification from previous session:
+            // the device key is not stored, so it cannot be sent
+            if (head[0].notification)
+            {
+                HIVELOG_WARN(m_log, "notification \"" << head[0].notification->name
+                    << "\" for unknown device \"" << head[0].deviceId << "\", dropped");
+            }
+            m_outbox->pop(1);
         }
-        m_pendingNotifications.clear();
+
+        if (head.empty())
+            return; // nothing to send
+
+        devicehive::Outbox::Entry const& entry = head[0];
+        HIVELOG_DEBUG(m_log, "sending 1 of " << m_outbox->size()
+            << " stored notifications");
+
+        m_outboxInFlight = entry.notification;
+        m_service->asyncInsertNotification(m_device, entry.notification);
     }
 
 private:
@@ -402,14 +478,36 @@ private:
             HIVELOG_ERROR(m_log, (hint ? hint : "something")
                 << " failed: [" << err << "] " << err.message());
 
-            m_service->cancelAll();
+            m_outboxInFlight.reset(); // will be sent again
+
+            if (devicehive::WebsocketService::SharedPtr ws = boost::dynamic_pointer_cast<devicehive::WebsocketService>(m_service))
+                if (ws->isReconnecting())
+            {
+                // the service restores the session itself, registration is kept
+                HIVELOG_DEBUG_STR(m_log, "the service reconnects itself...");
+                m_delayed->callLater(SERVER_RECONNECT_TIMEOUT,
+                    boost::bind(&This::resumeService, shared_from_this()));
+                return;
+            }
 
+            m_deviceRegistered = false;
+            m_service->cancelAll();
             HIVELOG_DEBUG_STR(m_log, "try to connect later...");
             m_delayed->callLater(SERVER_RECONNECT_TIMEOUT,
                 boost::bind(&devicehive::IDeviceService::asyncConnect, m_service));
         }
     }
 
+
+    /// @brief Resume the service usage after error.
+    void resumeService()
+    {
+        if (m_deviceRegistered)
+            sendOutboxNotifications();
+        else
+            m_service->asyncGetServerInfo(); // register the device again
+    }
+
 private:
 
     /// @brief Send gateway registration request.
@@ -562,7 +660,6 @@ private:
             m_device = devicehive::Device::create(id, name, key, deviceClass, m_network);
             m_device->status = "Online";
 
-            m_pendingNotifications.clear();
             m_deviceRegistered = false;
         }
 
@@ -639,15 +736,10 @@ private:
 
                     devicehive::NotificationPtr notification = devicehive::Notification::create(name, data["parameters"]);
 
-                    if (m_deviceRegistered)
-                    {
-                        m_service->asyncInsertNotification(m_device, notification);
-                    }
-                    else
-                    {
+                    if (!m_deviceRegistered)
                         HIVELOG_DEBUG_STR(m_log, "device is not registered, notification delayed");
-                        m_pendingNotifications.push_back(notification);
-                    }
+                    m_outbox->push(m_device, notification);
+                    sendOutboxNotifications();
                 }
                 else
                     HIVELOG_WARN(m_log, "unknown notification: " << intent << ", ignored");
@@ -679,7 +771,8 @@ private:
 
 private:
     // TODO: list of pending commands
-    std::vector<devicehive::NotificationPtr> m_pendingNotifications; ///< @brief The list of pending notification.
+    devicehive::OutboxPtr m_outbox; ///< @brief The persistent notification outbox.
+    devicehive::NotificationPtr m_outboxInFlight; ///< @brief The notification being sent.
 };
 
 
@@ -814,6 +907,7 @@ Application supports the following command line arguments:
 |            `--server <URL>`              | `<URL>` is the server URL
 |            `--serial <serial device>`    | `<serial device>` is the serial port name
 |          `--baudrate <serial baudrate>`  | `<serial baudrate>` is the serial port baudrate
+|                     `--low-latency`      | enable serial port low-latency mode (Linux only)
 
 For example, to start application run the following command:
 
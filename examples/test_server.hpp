@@ -0,0 +1,2023 @@
+/** @file
+@brief The local DeviceHive test server.
+@author Sergey Polichnoy <sergey.polichnoy@dataart.com>
+@see @ref page_test_server
+*/
+#ifndef __EXAMPLES_TEST_SERVER_HPP_
+#define __EXAMPLES_TEST_SERVER_HPP_
+
+#include <hive/defs.hpp>
+#include <hive/http.hpp>
+#include <hive/ws13.hpp>
+#include <hive/json.hpp>
+#include <hive/bin.hpp>
+#include <hive/misc.hpp>
+#include <hive/log.hpp>
+#include "basic_app.hpp"
+
+#if !defined(HIVE_PCH)
+#   include <boost/enable_shared_from_this.hpp>
+#   include <boost/algorithm/string.hpp>
+#   include <boost/lexical_cast.hpp>
+#   include <boost/random/mersenne_twister.hpp>
+#   include <boost/random/uniform_real_distribution.hpp>
+#   include <boost/shared_ptr.hpp>
+#   include <boost/function.hpp>
+#   include <boost/asio.hpp>
+#   include <boost/bind.hpp>
+#   include <algorithm>
+#   include <cstdlib>
+#   include <list>
+#   include <map>
+#   include <set>
+#endif // HIVE_PCH
+
+
+/// @brief The local DeviceHive test server.
+namespace test_server
+{
+    using namespace hive;
+
+
+/// @brief The local DeviceHive server.
+/**
+Implements the subset of DeviceHive protocol used by
+devicehive::RestfulService and devicehive::WebsocketService:
+    - "server info"
+    - "device save" and "device get"
+    - "command poll", "command subscribe", "command insert" and "command update"
+    - "notification insert"
+
+The server listens on loopback interface only. REST API and websocket
+share the same port, the websocket endpoint is "/device".
+
+All data are kept in memory. The server may inject latency,
+failure responses and connection drops, so it's suitable for offline
+throughput and reconnect tests. The server might be used in-process
+with the same IO service as the DeviceHive services.
+
+@see @ref page_test_server
+*/
+class Server:
+    public boost::enable_shared_from_this<Server>
+{
+    typedef Server This; ///< @brief The type alias.
+
+    /// @brief The websocket transceiver type.
+    typedef bin::Transceiver<boost::asio::ip::tcp::socket, ws13::Frame> TRX;
+
+protected:
+
+    /// @brief The main constructor.
+    /**
+    @param[in] ios The IO service.
+    @param[in] name The server name, used for logging.
+    */
+    Server(boost::asio::io_service &ios, String const& name)
+        : m_ios(ios)
+        , m_acceptor(ios)
+        , m_port(0)
+        , m_latencyMin_ms(0)
+        , m_latencyMax_ms(0)
+        , m_failureRate(0.0)
+        , m_dropRate(0.0)
+        , m_websocketEnabled(true)
+        , m_apiVersion("1.2.0")
+        , m_lastCommandId(0)
+        , m_lastNotificationId(0)
+        , m_lastConnectionId(0)
+        , m_lastTimestamp(boost::posix_time::microsec_clock::universal_time())
+        , m_rgen(misc::random_seed(this))
+        , m_log("/test_server/" + name)
+    {}
+
+public:
+
+    /// @brief The trivial destructor.
+    virtual ~Server()
+    {}
+
+public:
+
+    /// @brief The shared pointer type.
+    typedef boost::shared_ptr<Server> SharedPtr;
+
+
+    /// @brief The factory method.
+    /**
+    Binds to the loopback interface and starts accepting connections.
+
+    @param[in] ios The IO service.
+    @param[in] port The port number. Zero for any free port.
+    @param[in] name The server name, used for logging.
+    @return The new server instance.
+    @throws boost::system::system_error if port cannot be bound.
+    */
+    static SharedPtr create(boost::asio::io_service &ios, UInt16 port = 0, String const& name = "test")
+    {
+        SharedPtr pthis(new This(ios, name));
+
+        const boost::asio::ip::tcp::endpoint ep(boost::asio::ip::address_v4::loopback(), port);
+        pthis->m_acceptor.open(ep.protocol());
+        pthis->m_acceptor.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
+        pthis->m_acceptor.bind(ep);
+        pthis->m_acceptor.listen();
+        pthis->m_port = pthis->m_acceptor.local_endpoint().port();
+
+        HIVELOG_INFO(pthis->m_log, "listening on " << pthis->getBaseUrl());
+        pthis->asyncAccept();
+        return pthis;
+    }
+
+
+    /// @brief Stop the server.
+    /**
+    Stops accepting connections and closes all active connections.
+    */
+    void stop()
+    {
+        boost::system::error_code err;
+        m_acceptor.close(err);
+        dropAllConnections();
+    }
+
+public:
+
+    /// @brief Get the server port.
+    /**
+    @return The port number.
+    */
+    UInt16 getPort() const
+    {
+        return m_port;
+    }
+
+
+    /// @brief Get the REST base URL.
+    /**
+    @return The base URL to pass to devicehive::RestfulService.
+    */
+    String getBaseUrl() const
+    {
+        return "http://127.0.0.1:" + boost::lexical_cast<String>(m_port);
+    }
+
+
+    /// @brief Get the websocket base URL.
+    /**
+    @return The base URL to pass to devicehive::WebsocketService.
+    */
+    String getWebsocketUrl() const
+    {
+        return "ws://127.0.0.1:" + boost::lexical_cast<String>(m_port);
+    }
+
+/// @name Fault injection
+/// @{
+public:
+
+    /// @brief Set the response latency.
+    /**
+    Each request or websocket action is delayed by a random value
+    in [min_ms, max_ms] range before processing.
+
+    @param[in] min_ms The minimum latency, milliseconds.
+    @param[in] max_ms The maximum latency, milliseconds.
+    */
+    void setLatency(size_t min_ms, size_t max_ms)
+    {
+        m_latencyMin_ms = min_ms;
+        m_latencyMax_ms = std::max(min_ms, max_ms);
+    }
+
+
+    /// @brief Set the failure rate.
+    /**
+    The failed requests are answered with "503 Service Unavailable"
+    status, the failed websocket actions with "error" status.
+
+    @param[in] rate The failure probability in [0.0, 1.0] range.
+    */
+    void setFailureRate(double rate)
+    {
+        m_failureRate = rate;
+    }
+
+
+    /// @brief Set the connection drop rate.
+    /**
+    The connection is closed without any response.
+
+    @param[in] rate The drop probability in [0.0, 1.0] range.
+    */
+    void setDropRate(double rate)
+    {
+        m_dropRate = rate;
+    }
+
+
+    /// @brief Enable/disable websocket endpoint.
+    /**
+    If websocket is disabled "server info" reports no websocket URL
+    and all websocket handshakes are rejected.
+
+    @param[in] enabled The "enabled" flag.
+    */
+    void setWebsocketEnabled(bool enabled)
+    {
+        m_websocketEnabled = enabled;
+    }
+
+
+    /// @brief Drop all active connections.
+    /**
+    Simulates the server restart. Pending polls are dropped too.
+    */
+    void dropAllConnections()
+    {
+        std::vector<ConnectionPtr> connections(m_connections.begin(), m_connections.end());
+        HIVELOG_INFO(m_log, "dropping " << connections.size() << " connections");
+        for (size_t i = 0; i < connections.size(); ++i)
+            closeConnection(connections[i]);
+    }
+/// @}
+
+/// @name Statistics
+/// @{
+public:
+
+    /// @brief The server statistics.
+    struct Stats
+    {
+        size_t connections;     ///< @brief The number of accepted connections.
+        size_t requests;        ///< @brief The number of HTTP requests.
+        size_t actions;         ///< @brief The number of websocket actions.
+        size_t failures;        ///< @brief The number of injected failures.
+        size_t drops;           ///< @brief The number of injected connection drops.
+        size_t devicesSaved;    ///< @brief The number of "device save" requests.
+        size_t commandsInserted;  ///< @brief The number of inserted commands.
+        size_t commandsDelivered; ///< @brief The number of commands delivered to devices.
+        size_t commandsUpdated;   ///< @brief The number of command updates.
+        size_t notificationsInserted; ///< @brief The number of inserted notifications.
+
+        /// @brief The default constructor.
+        Stats()
+            : connections(0), requests(0), actions(0)
+            , failures(0), drops(0), devicesSaved(0)
+            , commandsInserted(0), commandsDelivered(0)
+            , commandsUpdated(0), notificationsInserted(0)
+        {}
+    };
+
+
+    /// @brief Get the statistics.
+    /**
+    @return The statistics.
+    */
+    Stats const& getStats() const
+    {
+        return m_stats;
+    }
+
+
+    /// @brief Reset the statistics.
+    void resetStats()
+    {
+        m_stats = Stats();
+    }
+
+
+    /// @brief Format the statistics.
+    /**
+    @return The one-line statistics report.
+    */
+    String formatStats() const
+    {
+        OStringStream oss;
+        oss << "connections:" << m_stats.connections
+            << " requests:" << m_stats.requests
+            << " actions:" << m_stats.actions
+            << " failures:" << m_stats.failures
+            << " drops:" << m_stats.drops
+            << " devices:" << m_devices.size()
+            << " commands:" << m_stats.commandsInserted
+            << "/" << m_stats.commandsDelivered
+            << "/" << m_stats.commandsUpdated
+            << " notifications:" << m_stats.notificationsInserted;
+        return oss.str();
+    }
+/// @}
+
+/// @name Data access
+/// @{
+public:
+
+    /// @brief The "notification inserted" callback type.
+    typedef boost::function2<void, String, json::Value const&> NotificationCallback;
+
+    /// @brief The "command updated" callback type.
+    typedef boost::function2<void, String, json::Value const&> CommandUpdateCallback;
+
+
+    /// @brief Set the "notification inserted" callback.
+    /**
+    @param[in] callback The callback functor, called with device identifier and notification.
+    */
+    void setNotificationCallback(NotificationCallback callback)
+    {
+        m_notificationCallback = callback;
+    }
+
+
+    /// @brief Set the "command updated" callback.
+    /**
+    @param[in] callback The callback functor, called with device identifier and updated command.
+    */
+    void setCommandUpdateCallback(CommandUpdateCallback callback)
+    {
+        m_commandUpdateCallback = callback;
+    }
+
+
+    /// @brief Get identifiers of all registered devices.
+    /**
+    @return The list of device identifiers.
+    */
+    std::vector<String> getDeviceIds() const
+    {
+        std::vector<String> ids;
+        ids.reserve(m_devices.size());
+
+        std::map<String, DeviceInfo>::const_iterator i = m_devices.begin();
+        for (; i != m_devices.end(); ++i)
+            ids.push_back(i->first);
+        return ids;
+    }
+
+
+    /// @brief Insert a new command.
+    /**
+    The command is delivered to the pending polls and websocket subscribers.
+
+    @param[in] deviceId The device identifier.
+    @param[in] name The command name.
+    @param[in] params The command parameters.
+    @return The command identifier or zero if device is unknown.
+    */
+    UInt64 insertCommand(String const& deviceId, String const& name, json::Value const& params = json::Value())
+    {
+        json::Value jcommand;
+        jcommand["command"] = name;
+        jcommand["parameters"] = params;
+        return insertJsonCommand(deviceId, jcommand);
+    }
+
+
+    /// @brief Insert a new command.
+    /**
+    @param[in] deviceId The device identifier.
+    @param[in] jcommand The command, "command" field is required.
+    @return The command identifier or zero if device is unknown.
+    */
+    UInt64 insertJsonCommand(String const& deviceId, json::Value const& jcommand)
+    {
+        std::map<String, DeviceInfo>::iterator found = m_devices.find(deviceId);
+        if (found == m_devices.end())
+            return 0; // unknown device
+
+        json::Value jcmd;
+        jcmd["id"] = ++m_lastCommandId;
+        jcmd["timestamp"] = newTimestamp();
+        jcmd["command"] = jcommand["command"].asString();
+        jcmd["parameters"] = jcommand["parameters"];
+        if (jcommand.hasMemeber("lifetime"))
+            jcmd["lifetime"] = jcommand["lifetime"];
+        if (jcommand.hasMemeber("flags"))
+            jcmd["flags"] = jcommand["flags"];
+        found->second.commands.push_back(jcmd);
+        m_stats.commandsInserted += 1;
+
+        HIVELOG_DEBUG(m_log, "command inserted for \"" << deviceId << "\": " << json::toStr(jcmd));
+        notifySubscribers(deviceId, jcmd);
+        wakeUpPolls(deviceId);
+        return m_lastCommandId;
+    }
+/// @}
+
+private:
+
+    /// @brief The registered device.
+    struct DeviceInfo
+    {
+        String key;                         ///< @brief The device key.
+        json::Value jdevice;                ///< @brief The device properties.
+        std::vector<json::Value> commands;  ///< @brief The commands, ordered by timestamp.
+    };
+
+
+    /// @brief The client connection.
+    struct Connection
+    {
+        size_t id;                              ///< @brief The connection identifier.
+        boost::asio::ip::tcp::socket socket;    ///< @brief The socket.
+        boost::asio::streambuf rx_buf;          ///< @brief The HTTP receive buffer.
+        bool closed;                            ///< @brief The "closed" flag.
+
+        TRX::SharedPtr trx;                 ///< @brief The websocket transceiver. NULL in HTTP mode.
+        ws13::MessagePtr wsMessage;         ///< @brief The websocket message being assembled.
+        std::set<String> subscriptions;     ///< @brief The subscribed devices.
+
+        /// @brief The main constructor.
+        /**
+        @param[in] ios The IO service.
+        @param[in] id_ The connection identifier.
+        */
+        Connection(boost::asio::io_service &ios, size_t id_)
+            : id(id_), socket(ios), closed(false)
+        {}
+    };
+
+    /// @brief The connection shared pointer type.
+    typedef boost::shared_ptr<Connection> ConnectionPtr;
+
+
+    /// @brief The parsed HTTP request.
+    struct Request
+    {
+        http::RequestPtr http;              ///< @brief The HTTP method, URL and headers.
+        std::vector<String> path;           ///< @brief The path segments.
+        std::map<String, String> query;     ///< @brief The query parameters.
+        bool keepAlive;                     ///< @brief The "keep-alive" flag.
+    };
+
+    /// @brief The parsed HTTP request shared pointer type.
+    typedef boost::shared_ptr<Request> RequestPtr;
+
+
+    /// @brief The pending long poll.
+    struct Poll
+    {
+        ConnectionPtr conn;                 ///< @brief The corresponding connection.
+        RequestPtr request;                 ///< @brief The poll request.
+        std::vector<String> deviceIds;      ///< @brief The devices to poll commands for.
+        String timestamp;                   ///< @brief The last known timestamp.
+        String names;                       ///< @brief The command names filter.
+        bool multiple;                      ///< @brief The multi-device poll flag.
+        boost::shared_ptr<boost::asio::deadline_timer> timer; ///< @brief The wait timer.
+    };
+
+    /// @brief The pending long poll shared pointer type.
+    typedef boost::shared_ptr<Poll> PollPtr;
+
+/// @name Connections
+/// @{
+private:
+
+    /// @brief Start accepting new connection.
+    void asyncAccept()
+    {
+        ConnectionPtr conn(new Connection(m_ios, ++m_lastConnectionId));
+        m_acceptor.async_accept(conn->socket,
+            boost::bind(&This::onAccepted, shared_from_this(),
+                conn, boost::asio::placeholders::error));
+    }
+
+
+    /// @brief The new connection accepted.
+    /**
+    @param[in] conn The new connection.
+    @param[in] err The error code.
+    */
+    void onAccepted(ConnectionPtr conn, boost::system::error_code err)
+    {
+        if (!err)
+        {
+            HIVELOG_DEBUG(m_log, "connection #" << conn->id << " accepted");
+            m_connections.insert(conn);
+            m_stats.connections += 1;
+
+            asyncReadRequest(conn);
+            asyncAccept();
+        }
+        else if (err != boost::asio::error::operation_aborted)
+        {
+            HIVELOG_ERROR(m_log, "accept error: [" << err << "] " << err.message());
+            asyncAccept();
+        }
+    }
+
+
+    /// @brief Close the connection.
+    /**
+    Also cancels all pending polls of this connection.
+
+    @param[in] conn The connection to close.
+    */
+    void closeConnection(ConnectionPtr conn)
+    {
+        if (conn->closed)
+            return;
+
+        HIVELOG_DEBUG(m_log, "connection #" << conn->id << " closed");
+        conn->closed = true;
+        boost::system::error_code err;
+        conn->socket.close(err);
+        if (conn->trx)
+            conn->trx->recv(TRX::RecvFrameCallback()); // release shared pointer
+        m_connections.erase(conn);
+
+        std::list<PollPtr>::iterator i = m_polls.begin();
+        while (i != m_polls.end())
+        {
+            if ((*i)->conn == conn)
+            {
+                (*i)->timer->cancel(err);
+                i = m_polls.erase(i);
+            }
+            else
+                ++i;
+        }
+    }
+
+
+    /// @brief Apply the fault injection.
+    /**
+    Closes the connection if it should be dropped.
+
+    @param[in] conn The connection.
+    @param[out] failed The "should fail" flag.
+    @return `false` if connection is dropped.
+    */
+    bool injectFaults(ConnectionPtr conn, bool &failed)
+    {
+        if (0.0 < m_dropRate && random() < m_dropRate)
+        {
+            HIVELOG_DEBUG(m_log, "connection #" << conn->id << " dropped (injected)");
+            m_stats.drops += 1;
+            closeConnection(conn);
+            return false;
+        }
+
+        failed = (0.0 < m_failureRate && random() < m_failureRate);
+        if (failed)
+            m_stats.failures += 1;
+        return true;
+    }
+
+
+    /// @brief Call the handler after random latency.
+    /**
+    @param[in] handler The handler to call.
+    */
+    void callWithLatency(boost::function0<void> handler)
+    {
+        const size_t latency = m_latencyMin_ms + size_t(random()*(m_latencyMax_ms - m_latencyMin_ms));
+        if (0 < latency)
+        {
+            boost::shared_ptr<boost::asio::deadline_timer> timer(new boost::asio::deadline_timer(m_ios));
+            timer->expires_from_now(boost::posix_time::milliseconds(latency));
+            timer->async_wait(boost::bind(&This::onLatencyTimer,
+                shared_from_this(), timer, handler,
+                boost::asio::placeholders::error));
+        }
+        else
+            handler();
+    }
+
+
+    /// @brief The latency timer expired.
+    /**
+    @param[in] timer The timer.
+    @param[in] handler The handler to call.
+    @param[in] err The error code.
+    */
+    void onLatencyTimer(boost::shared_ptr<boost::asio::deadline_timer>, boost::function0<void> handler, boost::system::error_code err)
+    {
+        if (!err)
+            handler();
+    }
+/// @}
+
+/// @name HTTP
+/// @{
+private:
+
+    /// @brief Start reading the next HTTP request.
+    /**
+    @param[in] conn The connection.
+    */
+    void asyncReadRequest(ConnectionPtr conn)
+    {
+        boost::asio::async_read_until(conn->socket, conn->rx_buf, "\r\n\r\n",
+            boost::bind(&This::onRequestHeadersRead, shared_from_this(), conn,
+                boost::asio::placeholders::error,
+                boost::asio::placeholders::bytes_transferred));
+    }
+
+
+    /// @brief The HTTP request headers read.
+    /**
+    @param[in] conn The connection.
+    @param[in] err The error code.
+    @param[in] len The length of headers including final empty line.
+    */
+    void onRequestHeadersRead(ConnectionPtr conn, boost::system::error_code err, size_t len)
+    {
+        if (conn->closed)
+            return;
+
+        if (!err)
+        {
+            const boost::asio::streambuf::const_buffers_type bufs = conn->rx_buf.data();
+            const String head(boost::asio::buffers_begin(bufs),
+                boost::asio::buffers_begin(bufs) + len);
+            conn->rx_buf.consume(len);
+
+            RequestPtr req = parseRequest(head);
+            if (!req)
+            {
+                HIVELOG_WARN(m_log, "connection #" << conn->id << " bad request");
+                closeConnection(conn);
+                return;
+            }
+
+            const String len_s = req->http->getHeader(http::header::Content_Length);
+            UInt64 content_len = 0;
+            if (!len_s.empty() && !parseUInt(len_s, content_len))
+            {
+                HIVELOG_WARN(m_log, "connection #" << conn->id
+                    << " bad content length: \"" << len_s << "\"");
+                req->keepAlive = false; // the request boundary is unknown
+                sendResponse(conn, req, createError(http::status::BAD_REQUEST,
+                    "Bad Request", "invalid Content-Length"));
+                return;
+            }
+
+            if (conn->rx_buf.size() < content_len)
+            {
+                boost::asio::async_read(conn->socket, conn->rx_buf,
+                    boost::asio::transfer_at_least(content_len - conn->rx_buf.size()),
+                    boost::bind(&This::onRequestContentRead, shared_from_this(),
+                        conn, req, content_len, boost::asio::placeholders::error));
+            }
+            else
+                onRequestContentRead(conn, req, content_len, boost::system::error_code());
+        }
+        else
+        {
+            if (err != boost::asio::error::eof)
+                HIVELOG_DEBUG(m_log, "connection #" << conn->id << " read error: ["
+                    << err << "] " << err.message());
+            closeConnection(conn);
+        }
+    }
+
+
+    /// @brief The HTTP request content read.
+    /**
+    @param[in] conn The connection.
+    @param[in] req The request.
+    @param[in] content_len The content length.
+    @param[in] err The error code.
+    */
+    void onRequestContentRead(ConnectionPtr conn, RequestPtr req, size_t content_len, boost::system::error_code err)
+    {
+        if (conn->closed)
+            return;
+
+        if (!err)
+        {
+            if (content_len)
+            {
+                const boost::asio::streambuf::const_buffers_type bufs = conn->rx_buf.data();
+                req->http->setContent(String(boost::asio::buffers_begin(bufs),
+                    boost::asio::buffers_begin(bufs) + content_len));
+                conn->rx_buf.consume(content_len);
+            }
+
+            HIVELOG_DEBUG(m_log, "connection #" << conn->id << " got "
+                << req->http->getMethod() << " " << req->http->getUrl().toStr(http::Url::PATH|http::Url::QUERY));
+            m_stats.requests += 1;
+
+            bool failed = false;
+            if (injectFaults(conn, failed))
+            {
+                callWithLatency(boost::bind(&This::handleRequest,
+                    shared_from_this(), conn, req, failed));
+            }
+        }
+        else
+        {
+            HIVELOG_DEBUG(m_log, "connection #" << conn->id << " read error: ["
+                << err << "] " << err.message());
+            closeConnection(conn);
+        }
+    }
+
+
+    /// @brief Parse the HTTP request line and headers.
+    /**
+    @param[in] head The request line and headers.
+    @return The parsed request or NULL in case of error.
+    */
+    static RequestPtr parseRequest(String const& head)
+    {
+        std::vector<String> lines;
+        boost::split(lines, head, boost::is_any_of("\n"));
+
+        std::vector<String> first;
+        boost::split(first, boost::trim_copy(lines[0]), boost::is_any_of(" "), boost::token_compress_on);
+        if (first.size() != 3 || first[1].empty() || first[1][0] != '/')
+            return RequestPtr();
+
+        RequestPtr req(new Request());
+        try
+        {
+            req->http = http::Request::create(first[0], http::Url("http://127.0.0.1" + first[1]));
+        }
+        catch (std::exception const&)
+        {
+            return RequestPtr();
+        }
+
+        int major = 1, minor = 1;
+        if (boost::starts_with(first[2], "HTTP/"))
+        {
+            IStringStream iss(first[2].substr(5));
+            iss >> major;
+            if (iss.peek() == '.')
+                iss.ignore(1);
+            iss >> minor;
+        }
+        req->http->setVersion(major, minor);
+
+        for (size_t i = 1; i < lines.size(); ++i)
+        {
+            const String line = boost::trim_copy(lines[i]);
+            const size_t colon = line.find(':');
+            if (colon != String::npos)
+            {
+                req->http->addHeader(boost::trim_copy(line.substr(0, colon)),
+                    boost::trim_copy(line.substr(colon+1)));
+            }
+        }
+
+        { // path segments
+            std::vector<String> path;
+            boost::split(path, req->http->getUrl().getPath(), boost::is_any_of("/"));
+            for (size_t i = 0; i < path.size(); ++i)
+                if (!path[i].empty())
+                    req->path.push_back(path[i]);
+        }
+
+        { // query parameters
+            std::vector<String> query;
+            boost::split(query, req->http->getUrl().getQuery(), boost::is_any_of("&"));
+            for (size_t i = 0; i < query.size(); ++i)
+            {
+                const size_t eq = query[i].find('=');
+                if (eq != String::npos)
+                    req->query[query[i].substr(0, eq)] = query[i].substr(eq+1);
+                else if (!query[i].empty())
+                    req->query[query[i]] = String();
+            }
+        }
+
+        const String conn_h = req->http->getHeader(http::header::Connection);
+        if (major == 1 && minor == 0)
+            req->keepAlive = boost::iequals(conn_h, "keep-alive");
+        else
+            req->keepAlive = !boost::iequals(conn_h, "close");
+
+        return req;
+    }
+
+
+    /// @brief Handle the HTTP request.
+    /**
+    @param[in] conn The connection.
+    @param[in] req The request.
+    @param[in] failed The "injected failure" flag.
+    */
+    void handleRequest(ConnectionPtr conn, RequestPtr req, bool failed)
+    {
+        if (conn->closed)
+            return;
+
+        if (failed)
+        {
+            sendResponse(conn, req, createError(http::status::SERVICE_UNAVAILABLE,
+                "Service Unavailable", "injected failure"));
+            return;
+        }
+
+        String const& method = req->http->getMethod();
+        std::vector<String> const& path = req->path;
+
+        try
+        {
+            if (method == "GET" && path.size() == 1 && path[0] == "info")
+                sendResponse(conn, req, handleServerInfo());
+            else if (method == "GET" && path.size() == 1 && path[0] == "device"
+                && boost::iequals(req->http->getHeader(http::header::Upgrade), ws13::NAME))
+                handleUpgrade(conn, req);
+            else if (method == "GET" && path.size() == 3 && path[0] == "device"
+                && path[1] == "command" && path[2] == "poll")
+                handlePoll(conn, req, true);
+            else if (path.size() == 2 && path[0] == "device")
+            {
+                if (method == "PUT")
+                    sendResponse(conn, req, handleDeviceSave(path[1], req));
+                else if (method == "GET")
+                    sendResponse(conn, req, handleDeviceGet(path[1], req));
+                else
+                    sendResponse(conn, req, createError(http::status::METHOD_NOT_ALLOWED, "Method Not Allowed"));
+            }
+            else if (method == "GET" && path.size() == 4 && path[0] == "device"
+                && path[2] == "command" && path[3] == "poll")
+                handlePoll(conn, req, false);
+            else if (method == "POST" && path.size() == 3 && path[0] == "device" && path[2] == "command")
+                sendResponse(conn, req, handleCommandInsert(path[1], req));
+            else if (method == "PUT" && path.size() == 4 && path[0] == "device" && path[2] == "command")
+                sendResponse(conn, req, handleCommandUpdate(path[1], path[3], req));
+            else if (method == "POST" && path.size() == 3 && path[0] == "device" && path[2] == "notification")
+                sendResponse(conn, req, handleNotificationInsert(path[1], req));
+            else
+                sendResponse(conn, req, createError(http::status::NOT_FOUND, "Not Found"));
+        }
+        catch (std::exception const& ex)
+        {
+            HIVELOG_WARN(m_log, "connection #" << conn->id << " bad request: " << ex.what());
+            sendResponse(conn, req, createError(http::status::BAD_REQUEST, "Bad Request", ex.what()));
+        }
+    }
+
+
+    /// @brief Create the JSON response.
+    /**
+    @param[in] status The status code.
+    @param[in] phrase The status phrase.
+    @param[in] jcontent The JSON content. `null` for empty content.
+    @return The new response.
+    */
+    static http::ResponsePtr createResponse(int status, String const& phrase, json::Value const& jcontent = json::Value())
+    {
+        http::ResponsePtr res = http::Response::create(status, phrase);
+        res->setVersion(1, 1);
+        if (!jcontent.isNull())
+        {
+            res->addHeader(http::header::Content_Type, "application/json");
+            res->setContent(json::toStr(jcontent));
+        }
+        else if (status != http::status::SWITCHING_PROTOCOLS)
+            res->addHeader(http::header::Content_Length, "0"); // client expects at least one header
+        return res;
+    }
+
+
+    /// @brief Create the error response.
+    /**
+    @param[in] status The status code.
+    @param[in] phrase The status phrase.
+    @param[in] message The error message.
+    @return The new response.
+    */
+    static http::ResponsePtr createError(int status, String const& phrase, String const& message = String())
+    {
+        json::Value jerr;
+        jerr["error"] = status;
+        jerr["message"] = message.empty() ? phrase : message;
+        return createResponse(status, phrase, jerr);
+    }
+
+
+    /// @brief Send the HTTP response.
+    /**
+    @param[in] conn The connection.
+    @param[in] req The corresponding request.
+    @param[in] res The response to send.
+    */
+    void sendResponse(ConnectionPtr conn, RequestPtr req, http::ResponsePtr res)
+    {
+        if (conn->closed)
+            return;
+
+        if (!req->keepAlive)
+            res->addHeader(http::header::Connection, "close");
+
+        OStringStream oss;
+        oss << *res;
+        boost::shared_ptr<String> buf(new String(oss.str()));
+
+        HIVELOG_DEBUG(m_log, "connection #" << conn->id << " response: "
+            << res->getStatusCode() << " " << res->getStatusPhrase());
+        boost::asio::async_write(conn->socket, boost::asio::buffer(*buf),
+            boost::bind(&This::onResponseSent, shared_from_this(),
+                conn, req, buf, boost::asio::placeholders::error));
+    }
+
+
+    /// @brief The HTTP response sent.
+    /**
+    @param[in] conn The connection.
+    @param[in] req The corresponding request.
+    @param[in] buf The sent data.
+    @param[in] err The error code.
+    */
+    void onResponseSent(ConnectionPtr conn, RequestPtr req, boost::shared_ptr<String> buf, boost::system::error_code err)
+    {
+        HIVE_UNUSED(buf);
+
+        if (!err && req->keepAlive)
+            asyncReadRequest(conn);
+        else
+            closeConnection(conn);
+    }
+/// @}
+
+/// @name REST API
+/// @{
+private:
+
+    /// @brief Get the server info.
+    /**
+    @return The response.
+    */
+    http::ResponsePtr handleServerInfo()
+    {
+        json::Value jinfo;
+        jinfo["apiVersion"] = m_apiVersion;
+        jinfo["serverTimestamp"] = newTimestamp();
+        if (m_websocketEnabled)
+            jinfo["webSocketServerUrl"] = getWebsocketUrl();
+        return createResponse(http::status::OK, "OK", jinfo);
+    }
+
+
+    /// @brief Find the device and check its key.
+    /**
+    @param[in] deviceId The device identifier.
+    @param[in] deviceKey The device key.
+    @param[out] status The HTTP status code in case of error.
+    @return The device found or NULL.
+    */
+    DeviceInfo* authenticate(String const& deviceId, String const& deviceKey, int &status)
+    {
+        std::map<String, DeviceInfo>::iterator found = m_devices.find(deviceId);
+        if (found == m_devices.end())
+        {
+            status = http::status::NOT_FOUND;
+            return 0;
+        }
+
+        if (!found->second.key.empty() && found->second.key != deviceKey)
+        {
+            status = http::status::UNAUTHORIZED;
+            return 0;
+        }
+
+        status = http::status::OK;
+        return &found->second;
+    }
+
+
+    /// @brief Create the error response for the authentication status.
+    /**
+    @param[in] status The authentication status.
+    @return The error response.
+    */
+    static http::ResponsePtr createAuthError(int status)
+    {
+        if (status == http::status::UNAUTHORIZED)
+            return createError(status, "Unauthorized");
+        return createError(http::status::NOT_FOUND, "Not Found", "device not found");
+    }
+
+
+    /// @brief Save (register or update) the device.
+    /**
+    @param[in] deviceId The device identifier.
+    @param[in] req The request.
+    @return The response.
+    */
+    http::ResponsePtr handleDeviceSave(String const& deviceId, RequestPtr req)
+    {
+        const json::Value jdevice = json::fromStr(req->http->getContent());
+        if (!saveDevice(deviceId, req->http->getHeader("Auth-DeviceKey"), jdevice))
+            return createError(http::status::UNAUTHORIZED, "Unauthorized");
+        return createResponse(http::status::NO_CONTENT, "No Content");
+    }
+
+
+    /// @brief Get the device.
+    /**
+    @param[in] deviceId The device identifier.
+    @param[in] req The request.
+    @return The response.
+    */
+    http::ResponsePtr handleDeviceGet(String const& deviceId, RequestPtr req)
+    {
+        int status = 0;
+        if (DeviceInfo *dev = authenticate(deviceId, req->http->getHeader("Auth-DeviceKey"), status))
+            return createResponse(http::status::OK, "OK", formatDevice(deviceId, *dev));
+        return createAuthError(status);
+    }
+
+
+    /// @brief Insert the command.
+    /**
+    @param[in] deviceId The device identifier.
+    @param[in] req The request.
+    @return The response.
+    */
+    http::ResponsePtr handleCommandInsert(String const& deviceId, RequestPtr req)
+    {
+        const json::Value jcommand = json::fromStr(req->http->getContent());
+        if (const UInt64 id = insertJsonCommand(deviceId, jcommand))
+        {
+            json::Value jres;
+            jres["id"] = id;
+            jres["timestamp"] = m_devices[deviceId].commands.back()["timestamp"];
+            return createResponse(http::status::CREATED, "Created", jres);
+        }
+
+        return createError(http::status::NOT_FOUND, "Not Found", "device not found");
+    }
+
+
+    /// @brief Update the command.
+    /**
+    @param[in] deviceId The device identifier.
+    @param[in] commandId The command identifier.
+    @param[in] req The request.
+    @return The response.
+    */
+    http::ResponsePtr handleCommandUpdate(String const& deviceId, String const& commandId, RequestPtr req)
+    {
+        int status = 0;
+        if (DeviceInfo *dev = authenticate(deviceId, req->http->getHeader("Auth-DeviceKey"), status))
+        {
+            const json::Value jupdate = json::fromStr(req->http->getContent());
+            UInt64 id = 0;
+            if (!parseUInt(commandId, id))
+                return createError(http::status::BAD_REQUEST, "Bad Request", "invalid command identifier");
+
+            if (updateCommand(deviceId, *dev, id, jupdate))
+                return createResponse(http::status::NO_CONTENT, "No Content");
+            return createError(http::status::NOT_FOUND, "Not Found", "command not found");
+        }
+
+        return createAuthError(status);
+    }
+
+
+    /// @brief Insert the notification.
+    /**
+    @param[in] deviceId The device identifier.
+    @param[in] req The request.
+    @return The response.
+    */
+    http::ResponsePtr handleNotificationInsert(String const& deviceId, RequestPtr req)
+    {
+        int status = 0;
+        if (authenticate(deviceId, req->http->getHeader("Auth-DeviceKey"), status))
+        {
+            const json::Value jnotification = json::fromStr(req->http->getContent());
+            return createResponse(http::status::CREATED, "Created",
+                insertNotification(deviceId, jnotification));
+        }
+
+        return createAuthError(status);
+    }
+
+
+    /// @brief Handle the command poll.
+    /**
+    Responds immediately if there are commands,
+    otherwise waits for new commands up to "waitTimeout" seconds.
+
+    @param[in] conn The connection.
+    @param[in] req The request.
+    @param[in] multiple The multi-device poll flag.
+    */
+    void handlePoll(ConnectionPtr conn, RequestPtr req, bool multiple)
+    {
+        PollPtr poll(new Poll());
+        poll->conn = conn;
+        poll->request = req;
+        poll->multiple = multiple;
+        poll->names = req->query["names"];
+        poll->timestamp = req->query["timestamp"];
+        if (poll->timestamp.empty())
+            poll->timestamp = newTimestamp(); // new commands only
+
+        const String deviceKey = req->http->getHeader("Auth-DeviceKey");
+        if (multiple)
+        {
+            boost::split(poll->deviceIds, req->query["deviceGuids"], boost::is_any_of(","));
+            if (poll->deviceIds.empty() || poll->deviceIds[0].empty())
+            {
+                sendResponse(conn, req, createError(http::status::BAD_REQUEST, "Bad Request", "no devices"));
+                return;
+            }
+        }
+        else
+            poll->deviceIds.push_back(req->path[1]);
+
+        int status = 0;
+        if (!authenticate(poll->deviceIds[0], deviceKey, status))
+        {
+            sendResponse(conn, req, createAuthError(status));
+            return;
+        }
+
+        if (!completePoll(poll, false))
+        {
+            const String wait_s = req->query["waitTimeout"];
+            UInt64 wait_sec = 30;
+            if (!wait_s.empty() && !parseUInt(wait_s, wait_sec))
+            {
+                sendResponse(conn, req, createError(http::status::BAD_REQUEST,
+                    "Bad Request", "invalid waitTimeout"));
+                return;
+            }
+            wait_sec = std::min(wait_sec, UInt64(60));
+
+            poll->timer.reset(new boost::asio::deadline_timer(m_ios));
+            poll->timer->expires_from_now(boost::posix_time::seconds(long(wait_sec)));
+            poll->timer->async_wait(boost::bind(&This::onPollTimeout,
+                shared_from_this(), poll, boost::asio::placeholders::error));
+            m_polls.push_back(poll);
+        }
+    }
+
+
+    /// @brief Complete the poll if there are commands.
+    /**
+    @param[in] poll The poll.
+    @param[in] force Send the empty response if there are no commands.
+    @return `true` if the response is sent.
+    */
+    bool completePoll(PollPtr poll, bool force)
+    {
+        json::Value jres(json::Value::TYPE_ARRAY);
+        for (size_t i = 0; i < poll->deviceIds.size(); ++i)
+        {
+            std::map<String, DeviceInfo>::iterator found = m_devices.find(poll->deviceIds[i]);
+            if (found == m_devices.end())
+                continue;
+
+            std::vector<json::Value> const& commands = found->second.commands;
+            std::vector<json::Value>::const_iterator c = std::upper_bound(
+                commands.begin(), commands.end(), poll->timestamp, TimestampLess());
+            for (; c != commands.end(); ++c)
+            {
+                if (!matchName(poll->names, (*c)["command"].asString()))
+                    continue;
+
+                if (poll->multiple)
+                {
+                    json::Value jitem;
+                    jitem["deviceGuid"] = poll->deviceIds[i];
+                    jitem["command"] = *c;
+                    jres.append(jitem);
+                }
+                else
+                    jres.append(*c);
+            }
+        }
+
+        if (jres.empty() && !force)
+            return false;
+
+        m_stats.commandsDelivered += jres.size();
+        sendResponse(poll->conn, poll->request,
+            createResponse(http::status::OK, "OK", jres));
+        return true;
+    }
+
+
+    /// @brief The poll wait timeout expired.
+    /**
+    @param[in] poll The poll.
+    @param[in] err The error code.
+    */
+    void onPollTimeout(PollPtr poll, boost::system::error_code err)
+    {
+        if (!err)
+        {
+            m_polls.remove(poll);
+            completePoll(poll, true);
+        }
+    }
+
+
+    /// @brief Complete all pending polls for the device.
+    /**
+    @param[in] deviceId The device identifier.
+    */
+    void wakeUpPolls(String const& deviceId)
+    {
+        std::list<PollPtr>::iterator i = m_polls.begin();
+        while (i != m_polls.end())
+        {
+            PollPtr poll = *i;
+            if (std::find(poll->deviceIds.begin(), poll->deviceIds.end(), deviceId) != poll->deviceIds.end()
+                && completePoll(poll, false))
+            {
+                boost::system::error_code err;
+                poll->timer->cancel(err);
+                i = m_polls.erase(i);
+            }
+            else
+                ++i;
+        }
+    }
+/// @}
+
+/// @name Websocket API
+/// @{
+private:
+
+    /// @brief Handle the websocket handshake.
+    /**
+    @param[in] conn The connection.
+    @param[in] req The handshake request.
+    */
+    void handleUpgrade(ConnectionPtr conn, RequestPtr req)
+    {
+        const String key = req->http->getHeader(ws13::header::Key);
+        if (!m_websocketEnabled || key.empty())
+        {
+            sendResponse(conn, req, createError(http::status::BAD_REQUEST,
+                "Bad Request", "websocket is not available"));
+            return;
+        }
+
+        http::ResponsePtr res = createResponse(http::status::SWITCHING_PROTOCOLS, "Switching Protocols");
+        res->addHeader(http::header::Upgrade, ws13::NAME);
+        res->addHeader(http::header::Connection, "Upgrade");
+        res->addHeader(ws13::header::Accept, ws13::WebSocket::buildAcceptKey(key));
+
+        OStringStream oss;
+        oss << *res;
+        boost::shared_ptr<String> buf(new String(oss.str()));
+        boost::asio::async_write(conn->socket, boost::asio::buffer(*buf),
+            boost::bind(&This::onUpgraded, shared_from_this(),
+                conn, buf, boost::asio::placeholders::error));
+    }
+
+
+    /// @brief The websocket handshake response sent.
+    /**
+    @param[in] conn The connection.
+    @param[in] buf The sent data.
+    @param[in] err The error code.
+    */
+    void onUpgraded(ConnectionPtr conn, boost::shared_ptr<String> buf, boost::system::error_code err)
+    {
+        HIVE_UNUSED(buf);
+
+        if (!err && !conn->closed)
+        {
+            HIVELOG_DEBUG(m_log, "connection #" << conn->id << " switched to websocket");
+            conn->trx = TRX::create(m_log.getName() + "/ws", conn->socket);
+            conn->trx->recv(boost::bind(&This::onFrameReceived,
+                shared_from_this(), conn, _1, _2));
+        }
+        else
+            closeConnection(conn);
+    }
+
+
+    /// @brief The websocket frame received.
+    /**
+    @param[in] conn The connection.
+    @param[in] err The error code.
+    @param[in] frame The received frame.
+    */
+    void onFrameReceived(ConnectionPtr conn, boost::system::error_code err, ws13::FramePtr frame)
+    {
+        if (err || conn->closed)
+        {
+            closeConnection(conn);
+            return;
+        }
+
+        switch (frame->getOpcode())
+        {
+            case ws13::Frame::FRAME_TEXT:
+            {
+                ws13::Frame::Text info;
+                frame->getPayload(info);
+                conn->wsMessage = ws13::Message::create(info.text, true);
+            } break;
+
+            case ws13::Frame::FRAME_CONTINUE:
+            {
+                ws13::Frame::Continue info;
+                frame->getPayload(info);
+                if (conn->wsMessage)
+                    conn->wsMessage->appendData(info.data);
+            } break;
+
+            case ws13::Frame::FRAME_PING:
+            {
+                ws13::Frame::Ping ping;
+                frame->getPayload(ping);
+                conn->trx->send(ws13::Frame::create(ws13::Frame::Pong(ping.data), false),
+                    boost::bind(&This::onFrameSent, shared_from_this(), conn, _1, _2));
+            } return;
+
+            case ws13::Frame::FRAME_CLOSE:
+                closeConnection(conn);
+                return;
+
+            default:
+                return; // ignored
+        }
+
+        if (conn->wsMessage && frame->getFIN() == 1)
+        {
+            const String text = conn->wsMessage->getData();
+            conn->wsMessage.reset();
+            m_stats.actions += 1;
+
+            try
+            {
+                const json::Value jaction = json::fromStr(text);
+
+                bool failed = false;
+                if (injectFaults(conn, failed))
+                {
+                    callWithLatency(boost::bind(&This::handleAction,
+                        shared_from_this(), conn, jaction, failed));
+                }
+            }
+            catch (std::exception const& ex)
+            {
+                HIVELOG_WARN(m_log, "connection #" << conn->id << " bad action: " << ex.what());
+            }
+        }
+    }
+
+
+    /// @brief Send the websocket action.
+    /**
+    @param[in] conn The connection.
+    @param[in] jaction The action to send.
+    */
+    void sendAction(ConnectionPtr conn, json::Value const& jaction)
+    {
+        if (conn->closed || !conn->trx)
+            return;
+
+        conn->trx->send(ws13::Frame::create(ws13::Frame::Text(json::toStr(jaction)), false),
+            boost::bind(&This::onFrameSent, shared_from_this(), conn, _1, _2));
+    }
+
+
+    /// @brief The websocket frame sent.
+    /**
+    @param[in] conn The connection.
+    @param[in] err The error code.
+    @param[in] frame The sent frame.
+    */
+    void onFrameSent(ConnectionPtr conn, boost::system::error_code err, ws13::FramePtr frame)
+    {
+        HIVE_UNUSED(frame);
+
+        if (err)
+            closeConnection(conn);
+    }
+
+
+    /// @brief Handle the websocket action.
+    /**
+    @param[in] conn The connection.
+    @param[in] jaction The action received.
+    @param[in] failed The "injected failure" flag.
+    */
+    void handleAction(ConnectionPtr conn, json::Value const& jaction, bool failed)
+    {
+        if (conn->closed)
+            return;
+
+        const String action = jaction["action"].asString();
+        const String deviceId = jaction["deviceId"].asString();
+        const String deviceKey = jaction["deviceKey"].asString();
+
+        json::Value jres;
+        jres["action"] = action;
+        jres["requestId"] = jaction["requestId"];
+        jres["status"] = "success";
+
+        int status = http::status::OK;
+        try
+        {
+            if (failed)
+                status = http::status::SERVICE_UNAVAILABLE;
+            else if (action == "server/info")
+            {
+                jres["info"]["apiVersion"] = m_apiVersion;
+                jres["info"]["serverTimestamp"] = newTimestamp();
+                jres["info"]["restServerUrl"] = getBaseUrl();
+            }
+            else if (action == "device/save")
+            {
+                if (!saveDevice(deviceId, deviceKey, jaction["device"]))
+                    status = http::status::UNAUTHORIZED;
+            }
+            else if (action == "device/get")
+            {
+                if (DeviceInfo *dev = authenticate(deviceId, deviceKey, status))
+                    jres["device"] = formatDevice(deviceId, *dev);
+            }
+            else if (action == "command/subscribe")
+            {
+                if (DeviceInfo *dev = authenticate(deviceId, deviceKey, status))
+                {
+                    conn->subscriptions.insert(deviceId);
+                    sendAction(conn, jres);
+
+                    // send missed commands
+                    const String timestamp = jaction["timestamp"].asString();
+                    if (!timestamp.empty())
+                    {
+                        std::vector<json::Value>::const_iterator c = std::upper_bound(
+                            dev->commands.begin(), dev->commands.end(), timestamp, TimestampLess());
+                        for (; c != dev->commands.end(); ++c)
+                            sendCommand(conn, deviceId, *c);
+                    }
+                    return; // response is already sent
+                }
+            }
+            else if (action == "command/unsubscribe")
+            {
+                if (authenticate(deviceId, deviceKey, status))
+                    conn->subscriptions.erase(deviceId);
+            }
+            else if (action == "command/update")
+            {
+                if (DeviceInfo *dev = authenticate(deviceId, deviceKey, status))
+                {
+                    if (!updateCommand(deviceId, *dev, jaction["commandId"].asUInt(), jaction["command"]))
+                        status = http::status::NOT_FOUND;
+                }
+            }
+            else if (action == "command/insert")
+            {
+                if (const UInt64 id = insertJsonCommand(deviceId, jaction["command"]))
+                {
+                    jres["command"]["id"] = id;
+                    jres["command"]["timestamp"] = m_devices[deviceId].commands.back()["timestamp"];
+                }
+                else
+                    status = http::status::NOT_FOUND;
+            }
+            else if (action == "notification/insert")
+            {
+                if (authenticate(deviceId, deviceKey, status))
+                    jres["notification"] = insertNotification(deviceId, jaction["notification"]);
+            }
+            else
+                status = http::status::BAD_REQUEST;
+        }
+        catch (std::exception const& ex)
+        {
+            HIVELOG_WARN(m_log, "connection #" << conn->id << " bad \""
+                << action << "\" action: " << ex.what());
+            status = http::status::BAD_REQUEST;
+        }
+
+        if (status != http::status::OK)
+        {
+            jres["status"] = "error";
+            jres["code"] = status;
+            jres["error"] = failed ? "injected failure" : "request failed";
+        }
+
+        sendAction(conn, jres);
+    }
+
+
+    /// @brief Send the command to the subscriber.
+    /**
+    @param[in] conn The connection.
+    @param[in] deviceId The device identifier.
+    @param[in] jcommand The command.
+    */
+    void sendCommand(ConnectionPtr conn, String const& deviceId, json::Value const& jcommand)
+    {
+        json::Value jaction;
+        jaction["action"] = "command/insert";
+        jaction["deviceGuid"] = deviceId;
+        jaction["command"] = jcommand;
+
+        m_stats.commandsDelivered += 1;
+        sendAction(conn, jaction);
+    }
+
+
+    /// @brief Send the new command to all subscribers.
+    /**
+    @param[in] deviceId The device identifier.
+    @param[in] jcommand The command.
+    */
+    void notifySubscribers(String const& deviceId, json::Value const& jcommand)
+    {
+        std::set<ConnectionPtr>::const_iterator i = m_connections.begin();
+        for (; i != m_connections.end(); ++i)
+        {
+            if ((*i)->subscriptions.count(deviceId))
+                sendCommand(*i, deviceId, jcommand);
+        }
+    }
+/// @}
+
+/// @name Storage
+/// @{
+private:
+
+    /// @brief Register or update the device.
+    /**
+    The provided properties are merged with existing ones.
+
+    @param[in] deviceId The device identifier.
+    @param[in] deviceKey The device key.
+    @param[in] jdevice The device properties.
+    @return `false` if device key doesn't match.
+    */
+    bool saveDevice(String const& deviceId, String const& deviceKey, json::Value const& jdevice)
+    {
+        if (deviceId.empty())
+            throw std::runtime_error("no device identifier");
+
+        DeviceInfo &dev = m_devices[deviceId];
+        const String key = !deviceKey.empty() ? deviceKey : jdevice["key"].asString();
+        if (!dev.key.empty() && dev.key != key)
+            return false;
+        if (dev.key.empty())
+            dev.key = key;
+
+        json::Value::MemberIterator i = jdevice.membersBegin();
+        for (; i != jdevice.membersEnd(); ++i)
+        {
+            if (i->first != "key")
+                dev.jdevice[i->first] = i->second;
+        }
+
+        m_stats.devicesSaved += 1;
+        return true;
+    }
+
+
+    /// @brief Format the device.
+    /**
+    @param[in] deviceId The device identifier.
+    @param[in] dev The device.
+    @return The device JSON value without key.
+    */
+    static json::Value formatDevice(String const& deviceId, DeviceInfo const& dev)
+    {
+        json::Value jdevice = dev.jdevice;
+        jdevice["id"] = deviceId;
+        return jdevice;
+    }
+
+
+    /// @brief Update the command.
+    /**
+    @param[in] deviceId The device identifier.
+    @param[in,out] dev The device.
+    @param[in] commandId The command identifier.
+    @param[in] jupdate The "status", "result" and "flags" fields to update.
+    @return `false` if command not found.
+    */
+    bool updateCommand(String const& deviceId, DeviceInfo &dev, UInt64 commandId, json::Value const& jupdate)
+    {
+        for (size_t i = dev.commands.size(); 0 < i; --i) // recent commands are updated first
+        {
+            json::Value &jcmd = dev.commands[i-1];
+            if (jcmd["id"].asUInt() == commandId)
+            {
+                if (jupdate.hasMemeber("status"))
+                    jcmd["status"] = jupdate["status"];
+                if (jupdate.hasMemeber("result"))
+                    jcmd["result"] = jupdate["result"];
+                if (jupdate.hasMemeber("flags"))
+                    jcmd["flags"] = jupdate["flags"];
+
+                m_stats.commandsUpdated += 1;
+                if (m_commandUpdateCallback)
+                    m_commandUpdateCallback(deviceId, jcmd);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+
+    /// @brief Insert the notification.
+    /**
+    @param[in] deviceId The device identifier.
+    @param[in] jnotification The notification.
+    @return The inserted notification with identifier and timestamp.
+    */
+    json::Value insertNotification(String const& deviceId, json::Value const& jnotification)
+    {
+        json::Value jres;
+        jres["id"] = ++m_lastNotificationId;
+        jres["timestamp"] = newTimestamp();
+        jres["notification"] = jnotification["notification"];
+        jres["parameters"] = jnotification["parameters"];
+
+        m_stats.notificationsInserted += 1;
+        if (m_notificationCallback)
+            m_notificationCallback(deviceId, jres);
+        return jres;
+    }
+
+
+    /// @brief Generate the new unique timestamp.
+    /**
+    The timestamps are strictly increasing, so they can be
+    compared as strings.
+
+    @return The new timestamp.
+    */
+    String newTimestamp()
+    {
+        boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+        if (now <= m_lastTimestamp)
+            now = m_lastTimestamp + boost::posix_time::microseconds(1);
+        m_lastTimestamp = now;
+
+        const boost::posix_time::time_duration t = now.time_of_day();
+        OStringStream oss;
+        oss << boost::gregorian::to_iso_extended_string(now.date()) << "T"
+            << std::setfill('0') << std::setw(2) << t.hours() << ":"
+            << std::setw(2) << t.minutes() << ":"
+            << std::setw(2) << t.seconds() << "."
+            << std::setw(6) << (t.total_microseconds() % 1000000);
+        return oss.str();
+    }
+
+
+    /// @brief Compare the timestamp with the command timestamp.
+    struct TimestampLess
+    {
+        /// @brief Compare the timestamp with the command.
+        bool operator()(String const& timestamp, json::Value const& jcommand) const
+        {
+            return timestamp < jcommand["timestamp"].asString();
+        }
+
+        /// @brief Compare the command with the timestamp.
+        bool operator()(json::Value const& jcommand, String const& timestamp) const
+        {
+            return jcommand["timestamp"].asString() < timestamp;
+        }
+    };
+
+
+    /// @brief Check the command name against the filter.
+    /**
+    @param[in] names The comma separated list of names. Empty for any.
+    @param[in] name The command name to check.
+    @return `true` if the name matches.
+    */
+    static bool matchName(String const& names, String const& name)
+    {
+        if (names.empty())
+            return true;
+
+        std::vector<String> list;
+        boost::split(list, names, boost::is_any_of(","));
+        return std::find(list.begin(), list.end(), name) != list.end();
+    }
+
+
+    /// @brief Get the random value.
+    /**
+    @return The random value in [0.0, 1.0) range.
+    */
+    double random()
+    {
+        boost::random::uniform_real_distribution<double> dist(0.0, 1.0);
+        return dist(m_rgen);
+    }
+
+
+    /// @brief Parse the decimal unsigned integer.
+    /**
+    Unlike boost::lexical_cast doesn't throw
+    and doesn't accept signs and spaces.
+
+    @param[in] str The string to parse.
+    @param[out] val The parsed value.
+    @return `true` if the string is a valid number.
+    */
+    static bool parseUInt(String const& str, UInt64 &val)
+    {
+        if (str.empty() || 19 < str.size())
+            return false; // no overflow with 19 digits
+
+        val = 0;
+        for (size_t i = 0; i < str.size(); ++i)
+        {
+            if (str[i] < '0' || '9' < str[i])
+                return false;
+            val = val*10 + (str[i] - '0');
+        }
+
+        return true;
+    }
+/// @}
+
+private:
+    boost::asio::io_service &m_ios; ///< @brief The IO service.
+    boost::asio::ip::tcp::acceptor m_acceptor; ///< @brief The acceptor.
+    UInt16 m_port; ///< @brief The bound port number.
+
+    size_t m_latencyMin_ms; ///< @brief The minimum latency, milliseconds.
+    size_t m_latencyMax_ms; ///< @brief The maximum latency, milliseconds.
+    double m_failureRate; ///< @brief The failure probability.
+    double m_dropRate; ///< @brief The connection drop probability.
+    bool m_websocketEnabled; ///< @brief The websocket "enabled" flag.
+    String m_apiVersion; ///< @brief The reported API version.
+
+    std::map<String, DeviceInfo> m_devices; ///< @brief The registered devices.
+    std::set<ConnectionPtr> m_connections; ///< @brief The active connections.
+    std::list<PollPtr> m_polls; ///< @brief The pending long polls.
+
+    UInt64 m_lastCommandId; ///< @brief The last command identifier.
+    UInt64 m_lastNotificationId; ///< @brief The last notification identifier.
+    size_t m_lastConnectionId; ///< @brief The last connection identifier.
+    boost::posix_time::ptime m_lastTimestamp; ///< @brief The last generated timestamp.
+    boost::random::mt19937 m_rgen; ///< @brief The random generator for latency and faults.
+
+    NotificationCallback m_notificationCallback; ///< @brief The "notification inserted" callback.
+    CommandUpdateCallback m_commandUpdateCallback; ///< @brief The "command updated" callback.
+
+    Stats m_stats; ///< @brief The statistics.
+    hive::log::Logger m_log; ///< @brief The logger.
+};
+
+
+/// @brief The test server application.
+/**
+Runs the Server standalone. May periodically insert commands
+to all registered devices and drop all connections.
+
+@see @ref page_test_server
+*/
+class Application:
+    public basic_app::Application
+{
+    typedef basic_app::Application Base; ///< @brief The base type.
+    typedef Application This; ///< @brief The type alias.
+
+protected:
+
+    /// @brief The default constructor.
+    Application()
+        : m_port(8080)
+        , m_commandInterval_ms(0)
+        , m_dropInterval_ms(0)
+        , m_statsInterval_ms(10000)
+    {}
+
+public:
+
+    /// @brief The shared pointer type.
+    typedef boost::shared_ptr<Application> SharedPtr;
+
+
+    /// @brief The factory method.
+    /**
+    @param[in] argc The number of command line arguments.
+    @param[in] argv The command line arguments.
+    @return The new application instance.
+    */
+    static SharedPtr create(int argc, const char* argv[])
+    {
+        SharedPtr pthis(new This());
+
+        size_t latencyMin = 0;
+        size_t latencyMax = 0;
+        double failureRate = 0.0;
+        double dropRate = 0.0;
+        bool disableWebsockets = false;
+
+        for (int i = 1; i < argc; ++i) // skip executable name
+        {
+            if (boost::algorithm::iequals(argv[i], "--help"))
+            {
+                std::cout << argv[0] << " [options]";
+                std::cout << "\t--port <port number>\n";
+                std::cout << "\t--latency <min latency, milliseconds>\n";
+                std::cout << "\t--latency-max <max latency, milliseconds>\n";
+                std::cout << "\t--failure-rate <failure probability, 0..1>\n";
+                std::cout << "\t--drop-rate <connection drop probability, 0..1>\n";
+                std::cout << "\t--no-ws disable websocket endpoint\n";
+                std::cout << "\t--command-interval <insert command to all devices each X milliseconds>\n";
+                std::cout << "\t--drop-interval <drop all connections each X milliseconds>\n";
+                std::cout << "\t--stats-interval <report statistics each X milliseconds>\n";
+
+                exit(1);
+            }
+            else if (boost::algorithm::iequals(argv[i], "--port") && i+1 < argc)
+                pthis->m_port = boost::lexical_cast<UInt16>(argv[++i]);
+            else if (boost::algorithm::iequals(argv[i], "--latency") && i+1 < argc)
+                latencyMin = boost::lexical_cast<size_t>(argv[++i]);
+            else if (boost::algorithm::iequals(argv[i], "--latency-max") && i+1 < argc)
+                latencyMax = boost::lexical_cast<size_t>(argv[++i]);
+            else if (boost::algorithm::iequals(argv[i], "--failure-rate") && i+1 < argc)
+                failureRate = boost::lexical_cast<double>(argv[++i]);
+            else if (boost::algorithm::iequals(argv[i], "--drop-rate") && i+1 < argc)
+                dropRate = boost::lexical_cast<double>(argv[++i]);
+            else if (boost::algorithm::iequals(argv[i], "--no-ws"))
+                disableWebsockets = true;
+            else if (boost::algorithm::iequals(argv[i], "--command-interval") && i+1 < argc)
+                pthis->m_commandInterval_ms = boost::lexical_cast<long>(argv[++i]);
+            else if (boost::algorithm::iequals(argv[i], "--drop-interval") && i+1 < argc)
+                pthis->m_dropInterval_ms = boost::lexical_cast<long>(argv[++i]);
+            else if (boost::algorithm::iequals(argv[i], "--stats-interval") && i+1 < argc)
+                pthis->m_statsInterval_ms = boost::lexical_cast<long>(argv[++i]);
+        }
+
+        pthis->m_server = Server::create(pthis->m_ios, pthis->m_port);
+        pthis->m_server->setLatency(latencyMin, latencyMax);
+        pthis->m_server->setFailureRate(failureRate);
+        pthis->m_server->setDropRate(dropRate);
+        pthis->m_server->setWebsocketEnabled(!disableWebsockets);
+
+        return pthis;
+    }
+
+
+    /// @brief Get the shared pointer.
+    /**
+    @return The shared pointer to this instance.
+    */
+    SharedPtr shared_from_this()
+    {
+        return boost::dynamic_pointer_cast<This>(Base::shared_from_this());
+    }
+
+protected:
+
+    /// @brief Start the application.
+    /**
+    Starts periodic tasks.
+    */
+    virtual void start()
+    {
+        HIVELOG_TRACE_BLOCK(m_log, "start()");
+
+        Base::start();
+        HIVELOG_INFO(m_log, "server is running at " << m_server->getBaseUrl());
+
+        if (0 < m_commandInterval_ms)
+            m_delayed->callLater(m_commandInterval_ms,
+                boost::bind(&This::onInsertCommands, shared_from_this()));
+        if (0 < m_dropInterval_ms)
+            m_delayed->callLater(m_dropInterval_ms,
+                boost::bind(&This::onDropConnections, shared_from_this()));
+        if (0 < m_statsInterval_ms)
+            m_delayed->callLater(m_statsInterval_ms,
+                boost::bind(&This::onReportStats, shared_from_this()));
+    }
+
+
+    /// @brief Stop the application.
+    /**
+    Stops the server.
+    */
+    virtual void stop()
+    {
+        HIVELOG_TRACE_BLOCK(m_log, "stop()");
+
+        m_server->stop();
+        HIVELOG_INFO(m_log, m_server->formatStats());
+        Base::stop();
+    }
+
+private:
+
+    /// @brief Insert "ping" command to all registered devices.
+    void onInsertCommands()
+    {
+        const std::vector<String> ids = m_server->getDeviceIds();
+        for (size_t i = 0; i < ids.size(); ++i)
+            m_server->insertCommand(ids[i], "ping");
+
+        m_delayed->callLater(m_commandInterval_ms,
+            boost::bind(&This::onInsertCommands, shared_from_this()));
+    }
+
+
+    /// @brief Drop all connections.
+    void onDropConnections()
+    {
+        m_server->dropAllConnections();
+
+        m_delayed->callLater(m_dropInterval_ms,
+            boost::bind(&This::onDropConnections, shared_from_this()));
+    }
+
+
+    /// @brief Report the statistics.
+    void onReportStats()
+    {
+        HIVELOG_INFO(m_log, m_server->formatStats());
+
+        m_delayed->callLater(m_statsInterval_ms,
+            boost::bind(&This::onReportStats, shared_from_this()));
+    }
+
+private:
+    Server::SharedPtr m_server; ///< @brief The test server.
+    UInt16 m_port; ///< @brief The port number.
+    long m_commandInterval_ms; ///< @brief The command insert interval, milliseconds.
+    long m_dropInterval_ms; ///< @brief The connection drop interval, milliseconds.
+    long m_statsInterval_ms; ///< @brief The statistics report interval, milliseconds.
+};
+
+
+/// @brief The test server application entry point.
+/**
+Creates the Application instance and calls its Application::run() method.
+
+@param[in] argc The number of command line arguments.
+@param[in] argv The command line arguments.
+*/
+inline void main(int argc, const char* argv[])
+{
+    { // configure logging
+        using namespace hive::log;
+
+        Target::SharedPtr log_console = Logger::root().getTarget();
+        Logger::root().setLevel(LEVEL_INFO);
+        log_console->setFormat(Format::create("%N: %M\n"));
+    }
+
+    Application::create(argc, argv)->run();
+}
+
+} // test_server namespace
+
+
+///////////////////////////////////////////////////////////////////////////////
+/** @page page_test_server Local test server
+
+This example is a local stand-in for the DeviceHive server. It implements
+the subset of DeviceHive protocol used by devicehive::RestfulService
+and devicehive::WebsocketService:
+
+|              | REST                                 | Websocket action      |
+|--------------|--------------------------------------|-----------------------|
+| server info  | GET /info                            | server/info           |
+| device save  | PUT /device/{id}                     | device/save           |
+| device get   | GET /device/{id}                     | device/get            |
+| command poll | GET /device/{id}/command/poll        | command/subscribe     |
+|              | GET /device/command/poll?deviceGuids | command/unsubscribe   |
+| command insert | POST /device/{id}/command          | command/insert        |
+| command update | PUT /device/{id}/command/{cid}     | command/update        |
+| notification insert | POST /device/{id}/notification | notification/insert |
+
+The websocket endpoint is "ws://127.0.0.1:port/device". All data are kept
+in memory.
+
+The server can inject faults:
+    - random latency for each request or websocket action
+    - "503 Service Unavailable" responses with the given probability
+    - connection drops with the given probability
+    - periodic drop of all connections
+
+So it's possible to run throughput and reconnect tests offline:
+
+~~~{.sh}
+./test_server --port 8080 --latency 10 --latency-max 50 --drop-interval 30000 --command-interval 1000 &
+./zigbee_gw --server http://127.0.0.1:8080
+~~~
+
+The test_server::Server class might also be used in-process.
+It shares the IO service with the DeviceHive services:
+
+~~~{.cpp}
+boost::asio::io_service ios;
+test_server::Server::SharedPtr server = test_server::Server::create(ios);
+server->setFailureRate(0.1);
+
+http::Client::SharedPtr http = http::Client::create(ios);
+devicehive::IDeviceService::SharedPtr service = devicehive::RestfulService::create(
+    http, server->getBaseUrl(), callbacks);
+...
+ios.run();
+~~~
+*/
+
+#endif // __EXAMPLES_TEST_SERVER_HPP_
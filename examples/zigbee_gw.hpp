@@ -7,6 +7,8 @@
 #define __EXAMPLES_ZIGBEE_GW_HPP_
 
 #include <DeviceHive/gateway.hpp>
+#include <DeviceHive/hybrid.hpp>
+#include <DeviceHive/outbox.hpp>
 #include <DeviceHive/restful.hpp>
 #include <DeviceHive/websocket.hpp>
 #include <DeviceHive/xbee.hpp>
@@ -24,7 +26,212 @@ enum Timeouts
     SERIAL_RECONNECT_TIMEOUT    = 10000, ///< @brief Try to open serial port each X milliseconds.
     SERVER_RECONNECT_TIMEOUT    = 10000, ///< @brief Try to open server connection each X milliseconds.
     RETRY_TIMEOUT               = 5000,  ///< @brief Common retry timeout, milliseconds.
-    DEVICE_OFFLINE_TIMEOUT      = 0
+    DEVICE_OFFLINE_TIMEOUT      = 0,
+    OUTBOX_WINDOW_SIZE          = 256,   ///< @brief The maximum number of stored notifications examined at once.
+    OUTBOX_STALL_TIMEOUT        = 600000, ///< @brief Drop notifications of absent devices blocking the outbox for X milliseconds.
+    RSSI_QUERY_INTERVAL         = 10000  ///< @brief Query the node's RSSI at most each X milliseconds.
+};
+
+
+/// @brief The ZigBee nodes index.
+/**
+Keeps the nodes by MAC address and provides fast lookup
+by network address, by cloud device and by device identifier.
+All secondary keys should be changed via index methods.
+
+The node type should have `address64`, `address16` and `device` fields.
+*/
+template<typename NodeT>
+class NodeIndex
+{
+public:
+
+    /// @brief The node shared pointer type.
+    typedef boost::shared_ptr<NodeT> NodePtr;
+
+    /// @brief The nodes by MAC address.
+    typedef std::map<UInt64, NodePtr> Map;
+
+    /// @brief The constant iterator type.
+    typedef typename Map::const_iterator Iterator;
+
+    /// @brief The unknown network address.
+    enum { UNKNOWN_ADDRESS16 = 0xFFFE };
+
+public:
+
+    /// @brief Get or create the node.
+    /**
+    @param[in] address64 The node MAC address.
+    @return The existing or new node.
+    */
+    NodePtr get(UInt64 address64)
+    {
+        NodePtr &node = m_by64[address64];
+        if (!node)
+        {
+            node.reset(new NodeT());
+            node->address64 = address64;
+        }
+
+        return node;
+    }
+
+
+    /// @brief Find the node by MAC address.
+    /**
+    @param[in] address64 The node MAC address.
+    @return The node or NULL.
+    */
+    NodePtr find(UInt64 address64) const
+    {
+        typename Map::const_iterator i = m_by64.find(address64);
+        return (i != m_by64.end()) ? i->second : NodePtr();
+    }
+
+
+    /// @brief Find the node by network address.
+    /**
+    @param[in] address16 The node network address.
+    @return The node or NULL.
+    */
+    NodePtr find16(UInt16 address16) const
+    {
+        typename std::map<UInt16, NodePtr>::const_iterator i = m_by16.find(address16);
+        return (i != m_by16.end()) ? i->second : NodePtr();
+    }
+
+
+    /// @brief Find the node by cloud device.
+    /**
+    @param[in] device The cloud device.
+    @return The node or NULL.
+    */
+    NodePtr find(devicehive::DevicePtr device) const
+    {
+        typename DeviceMap::const_iterator i = m_byDevice.find(device.get());
+        return (i != m_byDevice.end()) ? i->second : NodePtr();
+    }
+
+
+    /// @brief Find the node by device identifier.
+    /**
+    @param[in] deviceId The device identifier.
+    @return The node or NULL.
+    */
+    NodePtr find(String const& deviceId) const
+    {
+        typename IdMap::const_iterator i = m_byId.find(deviceId);
+        return (i != m_byId.end()) ? i->second : NodePtr();
+    }
+
+public:
+
+    /// @brief Update the node network address.
+    /**
+    The network address may be changed once node rejoins the network.
+    The previous owner of the address loses it.
+
+    @param[in] node The node.
+    @param[in] address16 The new network address.
+    */
+    void setAddress16(NodePtr node, UInt16 address16)
+    {
+        if (UNKNOWN_ADDRESS16 == address16)
+        {
+            resetAddress16(node);
+            return;
+        }
+
+        if (node->address16 == address16 && find16(address16) == node)
+            return; // not changed
+
+        typename std::map<UInt16, NodePtr>::iterator i = m_by16.find(node->address16);
+        if (i != m_by16.end() && i->second == node)
+            m_by16.erase(i);
+
+        NodePtr &owner = m_by16[address16];
+        if (owner && owner != node) // address is reused
+            owner->address16 = UNKNOWN_ADDRESS16;
+        owner = node;
+        node->address16 = address16;
+    }
+
+
+    /// @brief Forget the node network address.
+    /**
+    The address is stale, for example node has left the network.
+
+    @param[in] node The node.
+    */
+    void resetAddress16(NodePtr node)
+    {
+        typename std::map<UInt16, NodePtr>::iterator i = m_by16.find(node->address16);
+        if (i != m_by16.end() && i->second == node)
+            m_by16.erase(i);
+        node->address16 = UNKNOWN_ADDRESS16;
+    }
+
+
+    /// @brief Update the node cloud device.
+    /**
+    The device identifier shared by several nodes
+    refers to the node whose device was set last.
+
+    @param[in] node The node.
+    @param[in] device The new cloud device. May be NULL.
+    */
+    void setDevice(NodePtr node, devicehive::DevicePtr device)
+    {
+        if (node->device)
+        {
+            typename DeviceMap::iterator d = m_byDevice.find(node->device.get());
+            if (d != m_byDevice.end() && d->second == node)
+                m_byDevice.erase(d);
+
+            typename IdMap::iterator i = m_byId.find(node->device->id);
+            if (i != m_byId.end() && i->second == node)
+                m_byId.erase(i);
+        }
+
+        node->device = device;
+        if (device)
+        {
+            m_byDevice[device.get()] = node;
+            m_byId[device->id] = node;
+        }
+    }
+
+public:
+
+    /// @brief Get the begin of nodes.
+    Iterator begin() const
+    {
+        return m_by64.begin();
+    }
+
+
+    /// @brief Get the end of nodes.
+    Iterator end() const
+    {
+        return m_by64.end();
+    }
+
+
+    /// @brief Get the number of nodes.
+    size_t size() const
+    {
+        return m_by64.size();
+    }
+
+private:
+    typedef boost::unordered_map<devicehive::Device const*, NodePtr> DeviceMap; ///< @brief The nodes by device type.
+    typedef boost::unordered_map<String, NodePtr> IdMap; ///< @brief The nodes by device identifier type.
+
+    Map m_by64; ///< @brief The nodes by MAC address.
+    std::map<UInt16, NodePtr> m_by16; ///< @brief The nodes by network address.
+    DeviceMap m_byDevice; ///< @brief The nodes by cloud device.
+    IdMap m_byId; ///< @brief The nodes by device identifier.
 };
 
 
@@ -45,8 +252,12 @@ protected:
     Application()
         : m_disableWebsockets(false)
         , m_disableWebsocketPingPong(false)
+        , m_serviceConnected(false)
+        , m_registrationScheduled(false)
+        , m_outboxDropped(0)
         , m_serial(m_ios)
-        , m_xbeeFrameId(1)
+        , m_serialGeneration(0)
+        , m_xbeeStream(m_serial, false)
     {}
 
 public:
@@ -70,11 +281,16 @@ public:
         String networkDesc = "C++ device test network";
 
         String baseUrl = "http://ecloud.dataart.com/ecapi8";
+        std::vector<String> baseUrls; // the server pool
         size_t web_timeout = 0; // zero - don't change
         String http_version;
 
         String serialPortName = "";
         UInt32 serialBaudrate = 9600;
+        bool xbeeEscaped = false;
+
+        String outboxFileName = "zigbee_gw.outbox";
+        size_t outboxCapacity = 16*1024*1024;
 
         // custom device properties
         for (int i = 1; i < argc; ++i) // skip executable name
@@ -85,13 +301,16 @@ public:
                 std::cout << "\t--networkName <network name>\n";
                 std::cout << "\t--networkKey <network authentication key>\n";
                 std::cout << "\t--networkDesc <network description>\n";
-                std::cout << "\t--server <server URL>\n";
+                std::cout << "\t--server <server URL>, repeat to use the server pool\n";
                 std::cout << "\t--web-timeout <timeout, seconds>\n";
                 std::cout << "\t--http-version <major.minor HTTP version>\n";
                 std::cout << "\t--no-ws disable automatic websocket service switching\n";
                 std::cout << "\t--no-ws-ping-pong disable websocket ping/pong messages\n";
                 std::cout << "\t--serial <serial device name>\n";
                 std::cout << "\t--baudrate <serial baudrate>\n";
+                std::cout << "\t--xbee-escaped use XBee API mode 2 (escaped)\n";
+                std::cout << "\t--outbox <outbox file name>\n";
+                std::cout << "\t--outbox-capacity <outbox capacity, bytes>\n";
 
                 exit(1);
             }
@@ -102,7 +321,7 @@ public:
             else if (boost::algorithm::iequals(argv[i], "--networkDesc") && i+1 < argc)
                 networkDesc = argv[++i];
             else if (boost::algorithm::iequals(argv[i], "--server") && i+1 < argc)
-                baseUrl = argv[++i];
+                baseUrls.push_back(baseUrl = argv[++i]);
             else if (boost::algorithm::iequals(argv[i], "--web-timeout") && i+1 < argc)
                 web_timeout = boost::lexical_cast<UInt32>(argv[++i]);
             else if (boost::algorithm::iequals(argv[i], "--http-version") && i+1 < argc)
@@ -115,6 +334,12 @@ public:
                 serialPortName = argv[++i];
             else if (boost::algorithm::iequals(argv[i], "--baudrate") && i+1 < argc)
                 serialBaudrate = boost::lexical_cast<UInt32>(argv[++i]);
+            else if (boost::iequals(argv[i], "--xbee-escaped"))
+                xbeeEscaped = true;
+            else if (boost::algorithm::iequals(argv[i], "--outbox") && i+1 < argc)
+                outboxFileName = argv[++i];
+            else if (boost::algorithm::iequals(argv[i], "--outbox-capacity") && i+1 < argc)
+                outboxCapacity = boost::lexical_cast<size_t>(argv[++i]);
         }
 
         if (serialPortName.empty())
@@ -122,10 +347,25 @@ public:
 
         pthis->m_serialPortName = serialPortName;
         pthis->m_serialBaudrate = serialBaudrate;
-        pthis->m_xbee = XBeeAPI::create(pthis->m_serial);
+        pthis->m_xbeeStream.setEscaped(xbeeEscaped);
+        pthis->m_xbee = XBeeAPI::create(pthis->m_xbeeStream);
+        pthis->m_reassembler = Reassembler::create();
+        pthis->m_outbox = devicehive::Outbox::create(outboxFileName, outboxCapacity);
         pthis->m_network = devicehive::Network::create(networkName, networkKey, networkDesc);
 
-        if (1) // create service
+        if (1 < baseUrls.size()) // create hybrid service
+        {
+            HIVELOG_INFO(pthis->m_log, "Hybrid service is used, "
+                << baseUrls.size() << " servers");
+            devicehive::HybridService::SharedPtr service = devicehive::HybridService::create(
+                http::Client::create(pthis->m_ios), baseUrls, pthis);
+            service->setWebsocketEnabled(!pthis->m_disableWebsockets);
+            if (0 < web_timeout)
+                service->setTimeout(web_timeout*1000); // seconds -> milliseconds
+
+            pthis->m_service = service;
+        }
+        else // create service
         {
             http::Url url(baseUrl);
 
@@ -139,6 +379,7 @@ public:
                 devicehive::WebsocketService::SharedPtr service = devicehive::WebsocketService::create(
                     http::Client::create(pthis->m_ios), baseUrl, pthis);
                 service->setPingPongEnabled(!pthis->m_disableWebsocketPingPong);
+                service->setAutoReconnect(true); // restore the session after connection loss
                 if (0 < web_timeout)
                     service->setTimeout(web_timeout*1000); // seconds -> milliseconds
 
@@ -149,6 +390,7 @@ public:
                 HIVELOG_INFO_STR(pthis->m_log, "RESTful service is used");
                 devicehive::RestfulService::SharedPtr service = devicehive::RestfulService::create(
                     http::Client::create(pthis->m_ios), baseUrl, pthis);
+                service->setMultiDevicePolling(true); // one long-poll for all ZigBee devices
                 if (0 < web_timeout)
                     service->setTimeout(web_timeout*1000); // seconds -> milliseconds
                 if (!http_version.empty())
@@ -215,25 +457,35 @@ private:
 
     /// @brief The ZigBee device.
     /**
+    The network address is learned from the received packets
+    and the transmit status frames. Link statistics are collected
+    from the same sources, see also XBeeAPI::getTxStats().
     */
     class ZDevice
     {
     public:
         UInt64 address64; ///< @brief The MAC address.
         UInt16 address16; ///< @brief The network address.
-        boost::asio::streambuf m_rx_buf; ///< @brief The RX stream buffer.
+
+        int rssi; ///< @brief The last hop RSSI, dBm. Zero if unknown.
+        size_t rxPackets; ///< @brief The number of received packets.
+        boost::posix_time::ptime lastSeen; ///< @brief The last packet received time.
+        boost::posix_time::ptime rssiQueried; ///< @brief The last RSSI query time.
 
         devicehive::DevicePtr device; ///< @brief The corresponding device.
         bool deviceRegistered;    ///< @brief The "registered" flag.
+        bool deviceRegistering;   ///< @brief The registration is in progress.
         String m_lastCommandTimestamp; ///< @brief The timestamp of the last received command.
-        std::vector<devicehive::NotificationPtr> delayedNotifications; ///< @brief The list of delayed notification.
         gateway::Engine gw; ///< @brief The gateway engine.
 
         /// @brief The default constructor.
         ZDevice()
             : address64(XBEE_BROADCAST64)
             , address16(XBEE_BROADCAST16)
+            , rssi(0)
+            , rxPackets(0)
             , deviceRegistered(false)
+            , deviceRegistering(false)
         {}
     };
 
@@ -242,8 +494,8 @@ private:
 
 private:
 
-    /// @brief The list of ZigBee devices.
-    std::map<UInt64, ZDeviceSPtr> m_devices;
+    /// @brief The ZigBee devices index.
+    NodeIndex<ZDevice> m_devices;
 
     /// @brief Get or create new ZigBee device.
     /**
@@ -252,15 +504,7 @@ private:
     */
     ZDeviceSPtr getZDevice(UInt64 address)
     {
-        if (ZDeviceSPtr zdev = m_devices[address])
-            return zdev;
-        else
-        {
-            zdev.reset(new ZDevice());
-            m_devices[address] = zdev;
-            zdev->address64 = address;
-            return zdev;
-        }
+        return m_devices.get(address);
     }
 
 
@@ -271,15 +515,18 @@ private:
     */
     ZDeviceSPtr findZDevice(devicehive::DevicePtr device) const
     {
-        typedef std::map<UInt64, ZDeviceSPtr>::const_iterator Iterator;
-        for (Iterator i = m_devices.begin(); i != m_devices.end(); ++i)
-        {
-            ZDeviceSPtr zdev = i->second;
-            if (zdev->device == device)
-                return zdev;
-        }
+        return m_devices.find(device);
+    }
 
-        return ZDeviceSPtr(); // not found
+
+    /// @brief Find ZigBee device by identifier.
+    /**
+    @param[in] deviceId The device identifier to find.
+    @return The ZigBee device or NULL.
+    */
+    ZDeviceSPtr findZDevice(String const& deviceId) const
+    {
+        return m_devices.find(deviceId);
     }
 
 private:
@@ -297,7 +544,9 @@ private:
                 "got serial device \"" << m_serialPortName
                 << "\" at baudrate: " << m_serialBaudrate);
 
+            m_xbeeStream.setEscaped(m_xbeeStream.isEscaped()); // reset state
             asyncListenForXBeeFrames(true);
+            queryXBeeInfo();
             sendGatewayRegistrationRequest();
         }
         else
@@ -358,6 +607,8 @@ private:
     {
         HIVELOG_WARN(m_log, "serial device reset");
         m_serial.close();
+        m_serialGeneration += 1; // ignore errors of the old requests
+        m_xbee->cancelTx(); // reported as aborted
 
         if (tryToReopen && !terminated())
         {
@@ -399,6 +650,7 @@ private: // IDeviceServiceEvents
                 devicehive::WebsocketService::SharedPtr service = devicehive::WebsocketService::create(
                     rest->getHttpClient(), info.alternativeUrl, shared_from_this());
                 service->setPingPongEnabled(!m_disableWebsocketPingPong);
+                service->setAutoReconnect(true); // restore the session after connection loss
                 service->setTimeout(rest->getTimeout());
                 m_service = service;
 
@@ -406,6 +658,10 @@ private: // IDeviceServiceEvents
                 m_delayed->callLater(boost::bind(&devicehive::IDeviceService::asyncConnect, m_service));
                 return;
             }
+
+            m_serviceConnected = true;
+            registerDevices();
+            sendOutboxNotifications();
         }
         else
             handleServiceError(err, "getting server info");
@@ -415,12 +671,16 @@ private: // IDeviceServiceEvents
     /// @copydoc devicehive::IDeviceServiceEvents::onRegisterDevice()
     virtual void onRegisterDevice(boost::system::error_code err, devicehive::DevicePtr device)
     {
+        ZDeviceSPtr zdev = findZDevice(device);
+        if (zdev)
+            zdev->deviceRegistering = false;
+
         if (!err)
         {
-            if (ZDeviceSPtr zdev = findZDevice(device))
+            if (zdev)
             {
                 zdev->deviceRegistered = true;
-                sendDelayedNotifications(zdev);
+                sendOutboxNotifications();
                 m_service->asyncSubscribeForCommands(device,
                     zdev->m_lastCommandTimestamp);
             }
@@ -461,27 +721,180 @@ private: // IDeviceServiceEvents
             else
                 HIVELOG_ERROR(m_log, "unknown device");
         }
+        else
             handleServiceError(err, "polling command");
     }
 
+
+    /// @copydoc devicehive::IDeviceServiceEvents::onInsertNotification()
+    virtual void onInsertNotification(ErrorCode err, devicehive::DevicePtr device, devicehive::NotificationPtr notification)
+    {
+        OutboxSlot *slot = findOutboxSlot(notification);
+        if (!slot || OUTBOX_SENDING != slot->state)
+            return; // not from the current window
+
+        if (devicehive::isRejectedError(err))
+        {
+            // will be rejected again, so don't block the outbox
+            HIVELOG_ERROR(m_log, "notification \"" << notification->name
+                << "\" for device \"" << device->id << "\" is rejected by server, dropped");
+            err = boost::system::error_code();
+        }
+
+        if (!err)
+        {
+            slot->state = OUTBOX_SENT;
+            sendOutboxNotifications();
+        }
+        else
+            handleServiceError(err, "inserting notification");
+    }
+
 private:
 
-    /// @brief Send all delayed notifications.
+    /// @brief The outbox record state.
+    enum OutboxState
+    {
+        OUTBOX_WAITING, ///< @brief The record is waiting to be sent.
+        OUTBOX_SENDING, ///< @brief The record is being sent.
+        OUTBOX_SENT     ///< @brief The record is sent, but not removed yet.
+    };
+
+    /// @brief The outbox window slot.
+    struct OutboxSlot
+    {
+        devicehive::Outbox::Entry entry; ///< @brief The stored record.
+        OutboxState state;               ///< @brief The record state.
+    };
+
+
+    /// @brief Send the stored notifications.
     /**
-    @param[in] zdev The ZigBee device.
+    All notifications are stored in the outbox first. The oldest records
+    are kept in the window and removed from the outbox only when all
+    the previous records are sent, so nothing is lost during outages.
+
+    Each device has at most one notification in flight, so the server
+    receives notifications of each device in order. Notifications of the
+    devices which are not registered yet stay in place and don't block
+    the other devices within the window.
+
+    The device key is not stored in the outbox, so notifications are sent
+    only when the device is known again. If notifications of unknown devices
+    (from previous sessions) block the whole window for #OUTBOX_STALL_TIMEOUT,
+    they are dropped.
     */
-    void sendDelayedNotifications(ZDeviceSPtr zdev)
+    void sendOutboxNotifications()
     {
-        const size_t N = zdev->delayedNotifications.size();
-        HIVELOG_INFO(m_log, "sending " << N
-            << " delayed notifications");
+        if (!m_serviceConnected)
+            return; // not ready
+
+        if (m_outboxDropped != m_outbox->getDroppedCount())
+        {
+            // the oldest records are dropped due to capacity
+            m_outboxDropped = m_outbox->getDroppedCount();
+            m_outboxWindow.clear();
+        }
+
+        for (;;) // update the window
+        {
+            size_t sent = 0;
+            while (sent < m_outboxWindow.size() && OUTBOX_SENT == m_outboxWindow[sent].state)
+                sent += 1;
+            if (sent)
+            {
+                m_outboxWindow.erase(m_outboxWindow.begin(), m_outboxWindow.begin() + sent);
+                m_outbox->pop(sent);
+            }
+
+            const size_t wanted = std::min(m_outbox->size(), size_t(OUTBOX_WINDOW_SIZE));
+            if (wanted <= m_outboxWindow.size())
+                break;
+
+            std::vector<devicehive::Outbox::Entry> entries;
+            if (!m_outbox->peek(entries, wanted - m_outboxWindow.size(), m_outboxWindow.size()))
+                break;
+
+            for (size_t i = 0; i < entries.size(); ++i)
+            {
+                OutboxSlot slot;
+                slot.entry = entries[i];
+                slot.state = entries[i].notification ? OUTBOX_WAITING
+                    : OUTBOX_SENT; // corrupted, just remove
+                m_outboxWindow.push_back(slot);
+            }
+        }
+
+        size_t count = 0;
+        size_t inFlight = 0;
+        std::set<String> busy; // devices with previous records in the window
+        for (size_t i = 0; i < m_outboxWindow.size(); ++i)
+        {
+            OutboxSlot &slot = m_outboxWindow[i];
+            if (OUTBOX_SENT == slot.state)
+                continue;
+            if (!busy.insert(slot.entry.deviceId).second)
+                continue; // wait for the previous one
+            if (OUTBOX_SENDING == slot.state)
+            {
+                inFlight += 1;
+                continue;
+            }
+
+            ZDeviceSPtr zdev = findZDevice(slot.entry.deviceId);
+            if (!zdev || !zdev->deviceRegistered)
+                continue; // wait for registration
+
+            slot.state = OUTBOX_SENDING;
+            m_service->asyncInsertNotification(zdev->device, slot.entry.notification);
+            count += 1;
+        }
 
-        for (size_t i = 0; i < N; ++i)
+        if (count)
         {
-            m_service->asyncInsertNotification(zdev->device,
-                zdev->delayedNotifications[i]);
+            HIVELOG_DEBUG(m_log, "sending " << count << " of "
+                << m_outbox->size() << " stored notifications");
+        }
+
+        using namespace boost::posix_time;
+        if (count || inFlight || m_outboxWindow.size() < size_t(OUTBOX_WINDOW_SIZE))
+            m_outboxStalled = ptime(); // not blocked
+        else if (m_outboxStalled.is_not_a_date_time())
+            m_outboxStalled = microsec_clock::universal_time();
+        else if (m_outboxStalled + milliseconds(long(OUTBOX_STALL_TIMEOUT)) <= microsec_clock::universal_time())
+        {
+            size_t dropped = 0;
+            for (size_t i = 0; i < m_outboxWindow.size(); ++i)
+            {
+                OutboxSlot &slot = m_outboxWindow[i];
+                if (OUTBOX_WAITING == slot.state && !findZDevice(slot.entry.deviceId))
+                {
+                    slot.state = OUTBOX_SENT; // just remove
+                    dropped += 1;
+                }
+            }
+
+            m_outboxStalled = ptime();
+            if (dropped)
+            {
+                HIVELOG_WARN(m_log, dropped << " stored notifications of unknown devices dropped");
+                sendOutboxNotifications();
+            }
         }
-        zdev->delayedNotifications.clear();
+    }
+
+
+    /// @brief Find the outbox window slot.
+    /**
+    @param[in] notification The notification to find.
+    @return The slot or NULL.
+    */
+    OutboxSlot* findOutboxSlot(devicehive::NotificationPtr notification)
+    {
+        for (size_t i = 0; i < m_outboxWindow.size(); ++i)
+            if (m_outboxWindow[i].entry.notification == notification)
+                return &m_outboxWindow[i];
+        return 0;
     }
 
 private:
@@ -498,7 +911,32 @@ private:
             HIVELOG_ERROR(m_log, (hint ? hint : "something")
                 << " failed: [" << err << "] " << err.message());
 
+            for (size_t i = 0; i < m_outboxWindow.size(); ++i)
+                if (OUTBOX_SENDING == m_outboxWindow[i].state)
+                    m_outboxWindow[i].state = OUTBOX_WAITING; // will be sent again
+
+            if (boost::dynamic_pointer_cast<devicehive::HybridService>(m_service))
+            {
+                // the service switches servers itself, just try later
+                resetRegistrations(); // will be registered again
+                m_delayed->callLater(SERVER_RECONNECT_TIMEOUT,
+                    boost::bind(&This::resumeService, shared_from_this()));
+                return;
+            }
+
+            if (devicehive::WebsocketService::SharedPtr ws = boost::dynamic_pointer_cast<devicehive::WebsocketService>(m_service))
+                if (ws->isReconnecting())
+            {
+                // the service restores the session itself, registrations are kept
+                HIVELOG_DEBUG_STR(m_log, "the service reconnects itself...");
+                m_delayed->callLater(SERVER_RECONNECT_TIMEOUT,
+                    boost::bind(&This::resumeService, shared_from_this()));
+                return;
+            }
+
+            m_serviceConnected = false;
             m_service->cancelAll();
+            resetRegistrations(); // will be registered again
 
             HIVELOG_DEBUG_STR(m_log, "try to connect later...");
             m_delayed->callLater(SERVER_RECONNECT_TIMEOUT,
@@ -506,6 +944,66 @@ private:
         }
     }
 
+    /// @brief Resume the service usage after error.
+    void resumeService()
+    {
+        registerDevices();
+        sendOutboxNotifications();
+    }
+
+private:
+
+    /// @brief Schedule registration of new devices.
+    /**
+    Registration responses usually come in a burst,
+    so all new devices are registered together.
+    */
+    void scheduleRegistration()
+    {
+        if (!m_registrationScheduled)
+        {
+            m_registrationScheduled = true;
+            m_delayed->callLater(boost::bind(&This::registerDevices,
+                shared_from_this()));
+        }
+    }
+
+
+    /// @brief Register all not registered devices.
+    void registerDevices()
+    {
+        m_registrationScheduled = false;
+        if (!m_serviceConnected)
+            return; // will be registered once connected
+
+        std::vector<devicehive::DevicePtr> devices;
+        typedef NodeIndex<ZDevice>::Iterator Iterator;
+        for (Iterator i = m_devices.begin(); i != m_devices.end(); ++i)
+        {
+            ZDeviceSPtr zdev = i->second;
+            if (zdev->device && !zdev->deviceRegistered && !zdev->deviceRegistering)
+            {
+                zdev->deviceRegistering = true;
+                devices.push_back(zdev->device);
+            }
+        }
+
+        if (!devices.empty())
+        {
+            HIVELOG_INFO(m_log, "registering " << devices.size() << " devices");
+            m_service->asyncRegisterDevices(devices);
+        }
+    }
+
+
+    /// @brief Forget all registrations in progress.
+    void resetRegistrations()
+    {
+        typedef NodeIndex<ZDevice>::Iterator Iterator;
+        for (Iterator i = m_devices.begin(); i != m_devices.end(); ++i)
+            i->second->deviceRegistering = false;
+    }
+
 private:
 
     /// @brief Send gateway registration request.
@@ -582,79 +1080,204 @@ private:
     {
         if (frame && !frame->empty())
         {
-            const size_t len = frame->size();
-            if (XBEE_FRAGMENTATION < len) // do fragmentation
-            {
-                std::vector<UInt8>::const_iterator data = frame->getContent().begin();
-                const size_t N = len/XBEE_FRAGMENTATION - 1; // number of "full" frames
+            // (!) fragments refer to the frame content
+            std::vector<xbee::Frame::ZBTransmitRequest> fragments;
+            xbee::Fragmentation::slice(frame, XBEE_FRAGMENTATION, da64, da16, fragments);
+            for (size_t i = 0; i < fragments.size(); ++i)
+                sendXBeeFrame(fragments[i]);
+        }
+    }
 
-                for (size_t i = 0 ; i < N; ++i)
-                {
-                    xbee::Frame::ZBTransmitRequest payload(String(data, data + XBEE_FRAGMENTATION), m_xbeeFrameId++, da64, da16);
-                    sendXBeeFrame(payload);
-                    data += XBEE_FRAGMENTATION;
-                }
+private:
 
-                // send the rest of frames
-                const size_t rest = (len - N*XBEE_FRAGMENTATION);
-                const size_t len1 = rest/2;
-                const size_t len2 = rest - len1;
+    /// @brief Send the XBee transmit request.
+    /**
+    The request is scheduled by XBee API which assigns the frame identifier.
 
-                xbee::Frame::ZBTransmitRequest payload1(String(data, data + len1), m_xbeeFrameId++, da64, da16);
-                data += len1;
+    @param[in] payload The XBee transmit request.
+    */
+    void sendXBeeFrame(xbee::Frame::ZBTransmitRequest const& payload)
+    {
+        HIVELOG_DEBUG(m_log, "schedule transmit request: "
+            << xbee::Debug::dump(payload));
 
-                xbee::Frame::ZBTransmitRequest payload2(String(data, data + len2), m_xbeeFrameId++, da64, da16);
-                data += len2;
+        m_xbee->transmit(payload,
+            boost::bind(&This::onXBeeTransmitStatus,
+                shared_from_this(), m_serialGeneration,
+                payload.dstAddr64, _1));
+    }
 
-                sendXBeeFrame(payload1);
-                sendXBeeFrame(payload2);
-            }
-            else // just one frame
-            {
-                const std::vector<UInt8> &data = frame->getContent();
-                xbee::Frame::ZBTransmitRequest payload(String(data.begin(), data.end()), m_xbeeFrameId++, da64, da16);
-                sendXBeeFrame(payload);
-            }
+
+    /// @brief The "transmit" callback.
+    /**
+    The serial device is reset once: write errors of the requests
+    sent before the last reset are ignored.
+
+    @param[in] generation The serial device generation.
+    @param[in] da64 The destination MAC address.
+    @param[in] status The delivery status.
+    */
+    void onXBeeTransmitStatus(size_t generation, UInt64 da64, int status)
+    {
+        if (XBeeAPI::TX_STATUS_ABORTED == status)
+        {
+            HIVELOG_DEBUG(m_log, "frame to " << dump::hex(da64) << " is cancelled");
+            return;
+        }
+
+        if (ZDeviceSPtr zdev = m_devices.find(da64))
+            updateTxLink(zdev, status);
+
+        if (xbee::Frame::ZBTransmitStatus::DELIVERY_SUCCESS == status)
+        {
+            HIVELOG_DEBUG(m_log, "frame delivered to " << dumpLink(da64));
+        }
+        else if (XBeeAPI::TX_STATUS_IO_ERROR == status)
+        {
+            HIVELOG_ERROR(m_log, "failed to send frame to "
+                << dump::hex(da64));
+            if (generation == m_serialGeneration)
+                resetSerial(true);
+        }
+        else
+        {
+            HIVELOG_WARN(m_log, "frame is not delivered to "
+                << dumpLink(da64) << ", status " << dump::hex(UInt8(status)));
         }
     }
 
 private:
 
-    /// @brief Send the custom XBee frame.
+    /// @brief Update the node after transmit status.
     /**
-    @param[in] payload The custom XBee message payload.
+    The network address discovered by XBee is cached,
+    the stale one is forgotten.
+
+    @param[in] zdev The ZigBee device.
+    @param[in] status The delivery status.
     */
-    template<typename PayloadT>
-    void sendXBeeFrame(PayloadT const& payload)
+    void updateTxLink(ZDeviceSPtr zdev, int status)
     {
-        m_xbee->send(xbee::Frame::create(payload),
-            boost::bind(&This::onSendXBeeFrame,
-                shared_from_this(), _1, _2));
+        const XBeeAPI::TxStats stats = m_xbee->getTxStats(zdev->address64);
+        if (xbee::Frame::ZBTransmitStatus::DELIVERY_SUCCESS == status
+            && stats.address16 <= xbee::Frame::ZBTransmitRequest::MAX_ADDRESS16)
+        {
+            m_devices.setAddress16(zdev, stats.address16);
+        }
+        else if (xbee::Frame::ZBTransmitStatus::DELIVERY_ADDRESS_NOT_FOUND == status
+              || xbee::Frame::ZBTransmitStatus::DELIVERY_ROUTE_NOT_FOUND == status)
+        {
+            m_devices.resetAddress16(zdev);
+        }
     }
 
 
-    /// @brief The "send frame" callback.
+    /// @brief Update the node after received packet.
     /**
-    @param[in] err The error code.
-    @param[in] frame The frame sent.
+    The RSSI is queried via local "DB" command which reports
+    the last hop RSSI of the last received packet. The command
+    is pipelined right after the packet, so usually it's the
+    RSSI of this node.
+
+    @param[in] zdev The ZigBee device.
     */
-    void onSendXBeeFrame(boost::system::error_code err, xbee::Frame::SharedPtr frame)
+    void updateRxLink(ZDeviceSPtr zdev)
     {
-        if (!err && frame)
+        const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+        zdev->rxPackets += 1;
+        zdev->lastSeen = now;
+
+        if (zdev->rssiQueried.is_not_a_date_time()
+            || zdev->rssiQueried + boost::posix_time::milliseconds(long(RSSI_QUERY_INTERVAL)) <= now)
         {
-            HIVELOG_DEBUG(m_log, "frame successfully sent #"
-                << frame->getIntent() << ": ["
-                << m_xbee->hexdump(frame) << "], "
-                << frame->size() << " bytes:\n"
-                << xbee::Debug::dump(frame));
+            zdev->rssiQueried = now;
+            m_xbee->queryAT("DB", boost::bind(&This::onXBeeRssi,
+                shared_from_this(), zdev->address64, _1));
         }
-        else if (err == boost::asio::error::operation_aborted)
-            HIVELOG_DEBUG_STR(m_log, "TX operation cancelled");
-        else
+    }
+
+
+    /// @brief The RSSI is received.
+    /**
+    @param[in] address64 The node MAC address.
+    @param[in] response The "DB" command response.
+    */
+    void onXBeeRssi(UInt64 address64, xbee::Frame::ATCommandResponse const& response)
+    {
+        ZDeviceSPtr zdev = m_devices.find(address64);
+        if (zdev && xbee::Frame::ATCommandResponse::STATUS_OK == response.status
+            && 1 == response.result.size())
         {
-            HIVELOG_ERROR(m_log, "failed to send frame: ["
-                << err << "] " << err.message());
-            resetSerial(true);
+            zdev->rssi = -int(UInt8(response.result[0]));
+        }
+    }
+
+
+    /// @brief Dump the node link statistics.
+    /**
+    @param[in] address64 The node MAC address.
+    @return The dump information.
+    */
+    String dumpLink(UInt64 address64) const
+    {
+        OStringStream oss;
+        oss << dump::hex(address64);
+
+        if (ZDeviceSPtr zdev = m_devices.find(address64))
+        {
+            oss << "/" << dump::hex(zdev->address16)
+                << " rssi=" << zdev->rssi << "dBm"
+                << " rx=" << zdev->rxPackets;
+        }
+
+        const XBeeAPI::TxStats stats = m_xbee->getTxStats(address64);
+        oss << " delivered=" << stats.delivered
+            << " failed=" << stats.failed
+            << " retries=" << stats.retries << "/" << stats.macRetries
+            << " discoveries=" << stats.discoveries
+            << " latency=" << stats.getAvgLatency() << "/" << stats.maxLatency << "us";
+
+        return oss.str();
+    }
+
+private:
+
+    /// @brief Query the XBee module information.
+    /**
+    All AT commands are pipelined.
+    */
+    void queryXBeeInfo()
+    {
+        std::vector<String> commands;
+        commands.push_back("SH");
+        commands.push_back("SL");
+        commands.push_back("MY");
+        commands.push_back("AP");
+        m_xbee->queryATBatch(commands,
+            boost::bind(&This::onXBeeInfo,
+                shared_from_this(), _1));
+    }
+
+
+    /// @brief The XBee module information received.
+    /**
+    @param[in] responses The AT command responses.
+    */
+    void onXBeeInfo(std::vector<xbee::Frame::ATCommandResponse> const& responses)
+    {
+        for (size_t i = 0; i < responses.size(); ++i)
+        {
+            xbee::Frame::ATCommandResponse const& r = responses[i];
+            if (xbee::Frame::ATCommandResponse::STATUS_OK == r.status)
+            {
+                HIVELOG_INFO(m_log, "XBee " << r.command << ": "
+                    << dump::hex(r.result));
+            }
+            else
+            {
+                HIVELOG_WARN(m_log, "XBee " << r.command << " failed with status "
+                    << dump::hex(r.status));
+            }
         }
     }
 
@@ -721,25 +1344,27 @@ private:
         {
             case xbee::Frame::ZB_RECEIVE_PACKET:
             {
-                xbee::Frame::ZBReceivePacket payload;
-                if (frame->getPayload(payload))
+                xbee::Frame::ZBReceivePacketView payload; // (!) no data copy
+                if (frame->getView(payload))
                 {
-                    boost::shared_ptr<ZDevice> zdev = getZDevice(payload.srcAddr64);
-                    zdev->address16 = payload.srcAddr16;
-
-                    { // put the data to the stream buffer
-                        OStream os(&zdev->m_rx_buf);
-                        os.write(payload.data.data(), payload.data.size());
-                    }
-
-                    HIVELOG_DEBUG(m_log, "got [" << dump::hex(payload.data) << "] from "
-                        << dump::hex(payload.srcAddr64) << "/" << dump::hex(payload.srcAddr16));
-
-                    gateway::Frame::ParseResult result = gateway::Frame::RESULT_SUCCESS;
-                    if (gateway::Frame::SharedPtr frame = gateway::Frame::parseFrame(zdev->m_rx_buf, &result))
+                    const UInt64 sa64 = payload.getSrcAddr64();
+                    const UInt16 sa16 = payload.getSrcAddr16();
+                    boost::shared_ptr<ZDevice> zdev = getZDevice(sa64);
+                    m_devices.setAddress16(zdev, sa16);
+                    updateRxLink(zdev);
+
+                    HIVELOG_DEBUG(m_log, "got [" << dump::hex(payload.getData(),
+                        payload.getData() + payload.getDataSize()) << "] from "
+                        << dump::hex(sa64) << "/" << dump::hex(sa16));
+
+                    // handle all complete frames
+                    std::vector<gateway::Frame::SharedPtr> frames;
+                    m_reassembler->feed(sa64, payload.getData(),
+                        payload.getDataSize(), frames);
+                    for (size_t i = 0; i < frames.size(); ++i)
                     {
-                        handleGatewayMessage(frame->getIntent(),
-                            zdev->gw.frameToJson(frame), zdev);
+                        handleGatewayMessage(frames[i]->getIntent(),
+                            zdev->gw.frameToJson(frames[i]), zdev);
                     }
                 }
             } break;
@@ -766,11 +1391,11 @@ private:
             devicehive::Device::ClassPtr deviceClass = devicehive::Device::Class::create("", "", false, DEVICE_OFFLINE_TIMEOUT);
             devicehive::Serializer::fromJson(jdev["deviceClass"], deviceClass);
 
-            zdev->device = devicehive::Device::create(id, name, key, deviceClass, m_network);
+            m_devices.setDevice(zdev, devicehive::Device::create(id, name, key, deviceClass, m_network));
             zdev->device->status = "Online";
 
-            zdev->delayedNotifications.clear();
             zdev->deviceRegistered = false;
+            zdev->deviceRegistering = false;
         }
 
         { // update equipment
@@ -804,7 +1429,7 @@ private:
         {
             zdev->gw.handleRegisterResponse(data);
             createDevice(zdev, data);
-            m_service->asyncRegisterDevice(zdev->device);
+            scheduleRegistration();
         }
 
         else if (intent == gateway::INTENT_REGISTRATION2_RESPONSE)
@@ -812,7 +1437,7 @@ private:
             json::Value jdev = json::fromStr(data["json"].asString());
             zdev->gw.handleRegister2Response(jdev);
             createDevice(zdev, jdev);
-            m_service->asyncRegisterDevice(zdev->device);
+            scheduleRegistration();
         }
 
         else if (intent == gateway::INTENT_COMMAND_RESULT_RESPONSE)
@@ -843,15 +1468,10 @@ private:
 
                     devicehive::NotificationPtr notification = devicehive::Notification::create(name, data["parameters"]);
 
-                    if (zdev->deviceRegistered)
-                    {
-                        m_service->asyncInsertNotification(zdev->device, notification);
-                    }
-                    else
-                    {
+                    if (!zdev->deviceRegistered)
                         HIVELOG_DEBUG_STR(m_log, "device is not registered, notification delayed");
-                        zdev->delayedNotifications.push_back(notification);
-                    }
+                    m_outbox->push(zdev->device, notification);
+                    sendOutboxNotifications();
                 }
                 else
                     HIVELOG_WARN(m_log, "unknown notification: " << intent << ", ignored");
@@ -872,16 +1492,30 @@ private:
     devicehive::IDeviceServicePtr m_service; ///< @brief The cloud service.
     bool m_disableWebsockets;       ///< @brief No automatic websocket switch.
     bool m_disableWebsocketPingPong; ///< @brief Disable websocket PING/PONG messages.
+    bool m_serviceConnected; ///< @brief The server connection flag.
+    bool m_registrationScheduled; ///< @brief The devices registration is scheduled.
+
+private:
+    devicehive::OutboxPtr m_outbox; ///< @brief The persistent notification outbox.
+    std::deque<OutboxSlot> m_outboxWindow; ///< @brief The oldest records being sent, in outbox order.
+    size_t m_outboxDropped; ///< @brief The number of dropped records the window is valid for.
+    boost::posix_time::ptime m_outboxStalled; ///< @brief The window is blocked by unknown devices since this time.
 
 private:
     boost::asio::serial_port m_serial; ///< @brief The serial port device.
     String m_serialPortName; ///< @brief The serial port name.
     UInt32 m_serialBaudrate; ///< @brief The serial baudrate.
+    size_t m_serialGeneration; ///< @brief The serial device generation, incremented on each reset.
 
 private:
-    typedef xbee::API<boost::asio::serial_port> XBeeAPI; ///< @brief The XBee %API type.
+    typedef xbee::EscapedStream<boost::asio::serial_port> XBeeStream; ///< @brief The XBee stream type.
+    XBeeStream m_xbeeStream; ///< @brief The XBee stream, API mode 1 or 2.
+
+    typedef xbee::API<XBeeStream> XBeeAPI; ///< @brief The XBee %API type.
     XBeeAPI::SharedPtr m_xbee; ///< @brief The XBee %API.
-    size_t m_xbeeFrameId; ///< @brief The XBee TX frame identifier.
+
+    typedef xbee::Reassembler<gateway::Frame> Reassembler; ///< @brief The gateway frames reassembler type.
+    Reassembler::SharedPtr m_reassembler; ///< @brief The gateway frames reassembler.
 };
 
 
@@ -18,6 +18,11 @@
 
 #include <boost/uuid/uuid_io.hpp>
 
+#if defined(__linux__)
+#   include <sys/ioctl.h>
+#   include <linux/serial.h>
+#endif // __linux__
+
 
 /// @brief The DeviceHive gateway prototype (experimental).
 namespace gateway
@@ -705,12 +710,12 @@ public:
     {
         if (Layout::SharedPtr layout = m_layouts.find(intent))
         {
-            OStringStream payload;
-            bin::OStream bs(payload);
+            String payload;
+            bin::BufferOStream<String> bs(payload);
             Serializer::json2bin(data,
                 bs, layout);
 
-            return Frame::create(intent, payload.str());
+            return Frame::create(intent, payload);
         }
         //else HIVELOG_WARN(m_log, "unknown layout for intent #" << intent);
 
@@ -721,7 +726,8 @@ public:
     /// @brief Convert binary frame into JSON payload.
     /**
     @param[in] frame The frame to convert.
-    @return The JSON frame payload. May be empty for unknown intents.
+    @return The JSON frame payload. May be empty for unknown intents
+    or truncated payloads.
     */
     json::Value frameToJson(Frame::SharedPtr frame) const
     {
@@ -730,10 +736,11 @@ public:
             String payload;
             if (frame->getPayload(payload))
             {
-                IStringStream is(payload);
-                bin::IStream bs(is);
-
-                return Serializer::bin2json(bs, layout);
+                bin::SpanIStream bs(payload.data(), payload.size());
+                json::Value jval = Serializer::bin2json(bs, layout);
+                if (!bs.fail())
+                    return jval;
+                //else HIVELOG_WARN(m_log, "truncated frame payload, intent #" << frame->getIntent());
             }
             //else HIVELOG_WARN(m_log, "unable to get frame payload, intent #" << frame->getIntent());
         }
@@ -983,7 +990,8 @@ public:
         @param[in] layout The layout.
         @return The JSON value.
         */
-        static json::Value bin2json(bin::IStream &bs, Layout::SharedPtr layout)
+        template<typename IStreamT>
+        static json::Value bin2json(IStreamT &bs, Layout::SharedPtr layout)
         {
             json::Value jval;
 
@@ -1012,7 +1020,8 @@ public:
         @param[in] layoutElement The layout element.
         @return The JSON value.
         */
-        static json::Value bin2json(bin::IStream &bs, Layout::Element::SharedPtr layoutElement)
+        template<typename IStreamT>
+        static json::Value bin2json(IStreamT &bs, Layout::Element::SharedPtr layoutElement)
         {
             switch (layoutElement->dataType)
             {
@@ -1052,22 +1061,25 @@ public:
                 case DT_STRING:
                 case DT_BINARY:
                 {
-                    if (const UInt32 len = bs.getUInt16LE()) // read if non-empty
-                    {
-                        std::vector<UInt8> buf(len);
-                        bs.getBuffer(&buf[0], len);
-                        return json::Value(String(buf.begin(), buf.end()));
-                    }
-                    else
-                        return json::Value("");
+                    // read directly to the string, no temporary buffers,
+                    // truncated data is rejected before allocation
+                    String buf;
+                    bs.getBuffer(buf, bs.getUInt16LE());
+
+                    json::Value jval;
+                    jval.swapString(buf);
+                    return jval;
                 } break;
 
                 case DT_ARRAY:
                 {
                     json::Value jarr(json::Value::TYPE_ARRAY);
                     const UInt32 N = bs.getUInt16LE();
-                    for (size_t i = 0; i < N; ++i)
-                        jarr.append(bin2json(bs, layoutElement->sublayout));
+                    if (!intArray2json(bs, N, layoutElement->sublayout, jarr))
+                    {
+                        for (size_t i = 0; i < N; ++i)
+                            jarr.append(bin2json(bs, layoutElement->sublayout));
+                    }
                     return jarr;
                 } break;
 
@@ -1089,7 +1101,8 @@ public:
         @param[in,out] bs The binary output stream.
         @param[in] layout The layout.
         */
-        static void json2bin(json::Value const& jval, bin::OStream &bs, Layout::SharedPtr layout)
+        template<typename OStreamT>
+        static void json2bin(json::Value const& jval, OStreamT &bs, Layout::SharedPtr layout)
         {
             Layout::ElementIterator i = layout->elementsBegin();
             Layout::ElementIterator e = layout->elementsEnd();
@@ -1114,7 +1127,8 @@ public:
         @param[in,out] bs The binary output stream.
         @param[in] layoutElement The layout element.
         */
-        static void json2bin(json::Value const& jval, bin::OStream &bs, Layout::Element::SharedPtr layoutElement)
+        template<typename OStreamT>
+        static void json2bin(json::Value const& jval, OStreamT &bs, Layout::Element::SharedPtr layoutElement)
         {
             // TODO: more checks on data types!!!
             switch (layoutElement->dataType)
@@ -1171,8 +1185,11 @@ public:
 
                     const size_t N = jval.size();
                     bs.putUInt16LE(N);
-                    for (size_t i = 0; i < N; ++i)
-                        json2bin(jval[i], bs, layoutElement->sublayout);
+                    if (!json2intArray(jval, bs, layoutElement->sublayout))
+                    {
+                        for (size_t i = 0; i < N; ++i)
+                            json2bin(jval[i], bs, layoutElement->sublayout);
+                    }
                 } break;
 
                 case DT_OBJECT:
@@ -1184,6 +1201,128 @@ public:
                     assert(!"unknown data type");
             }
         }
+
+    private:
+
+        /// @brief Get the integer type of array element.
+        /**
+        @param[in] layout The array sublayout.
+        @return The integer data type or DT_NULL if array elements
+            are not plain integers.
+        */
+        static DataType getIntArrayType(Layout::SharedPtr layout)
+        {
+            Layout::ElementIterator i = layout->elementsBegin();
+            Layout::ElementIterator e = layout->elementsEnd();
+            if (i == e || (i+1) != e || !(*i)->name.empty())
+                return DT_NULL; // one unnamed element expected
+
+            switch ((*i)->dataType)
+            {
+                case DT_UINT8:  case DT_INT8:
+                case DT_UINT16: case DT_INT16:
+                case DT_UINT32: case DT_INT32:
+                case DT_UINT64: case DT_INT64:
+                    return (*i)->dataType;
+
+                default:
+                    return DT_NULL;
+            }
+        }
+
+
+        /// @brief Read the integer array as a whole.
+        /**
+        @param[in,out] bs The binary input stream.
+        @param[in] N The number of elements.
+        @param[in,out] jarr The JSON array to append to.
+        */
+        template<typename IntX, typename IStreamT>
+        static void intArray2jsonT(IStreamT &bs, size_t N, json::Value &jarr)
+        {
+            std::vector<IntX> buf(N);
+            bs.getArrayLE(&buf[0], N);
+            for (size_t i = 0; i < N; ++i)
+                jarr.append(json::Value(buf[i]));
+        }
+
+
+        /// @brief Read array of plain integers.
+        /**
+        All integers are read at once and converted by misc::le2h_array().
+
+        @param[in,out] bs The binary input stream.
+        @param[in] N The number of elements.
+        @param[in] layout The array sublayout.
+        @param[in,out] jarr The JSON array to append to.
+        @return `false` if array elements are not plain integers.
+        */
+        template<typename IStreamT>
+        static bool intArray2json(IStreamT &bs, size_t N, Layout::SharedPtr layout, json::Value &jarr)
+        {
+            if (0 == N)
+                return true; // nothing to read
+
+            switch (getIntArrayType(layout))
+            {
+                case DT_UINT8:  intArray2jsonT<UInt8>(bs, N, jarr); return true;
+                case DT_UINT16: intArray2jsonT<UInt16>(bs, N, jarr); return true;
+                case DT_UINT32: intArray2jsonT<UInt32>(bs, N, jarr); return true;
+                case DT_UINT64: intArray2jsonT<UInt64>(bs, N, jarr); return true;
+                case DT_INT8:   intArray2jsonT<Int8>(bs, N, jarr); return true;
+                case DT_INT16:  intArray2jsonT<Int16>(bs, N, jarr); return true;
+                case DT_INT32:  intArray2jsonT<Int32>(bs, N, jarr); return true;
+                case DT_INT64:  intArray2jsonT<Int64>(bs, N, jarr); return true;
+                default:        return false;
+            }
+        }
+
+
+        /// @brief Write the integer array as a whole.
+        /**
+        @param[in] jarr The JSON array.
+        @param[in,out] bs The binary output stream.
+        @param[in] as The JSON value converter.
+        */
+        template<typename IntX, typename OStreamT>
+        static void json2intArrayT(json::Value const& jarr, OStreamT &bs, IntX (json::Value::*as)() const)
+        {
+            const size_t N = jarr.size();
+            std::vector<IntX> buf(N);
+            for (size_t i = 0; i < N; ++i)
+                buf[i] = (jarr[i].*as)();
+            bs.putArrayLE(&buf[0], N);
+        }
+
+
+        /// @brief Write array of plain integers.
+        /**
+        All integers are converted by misc::h2le_array() and written at once.
+
+        @param[in] jarr The JSON array.
+        @param[in,out] bs The binary output stream.
+        @param[in] layout The array sublayout.
+        @return `false` if array elements are not plain integers.
+        */
+        template<typename OStreamT>
+        static bool json2intArray(json::Value const& jarr, OStreamT &bs, Layout::SharedPtr layout)
+        {
+            if (0 == jarr.size())
+                return true; // nothing to write
+
+            switch (getIntArrayType(layout))
+            {
+                case DT_UINT8:  json2intArrayT(jarr, bs, &json::Value::asUInt8); return true;
+                case DT_UINT16: json2intArrayT(jarr, bs, &json::Value::asUInt16); return true;
+                case DT_UINT32: json2intArrayT(jarr, bs, &json::Value::asUInt32); return true;
+                case DT_UINT64: json2intArrayT(jarr, bs, &json::Value::asUInt64); return true;
+                case DT_INT8:   json2intArrayT(jarr, bs, &json::Value::asInt8); return true;
+                case DT_INT16:  json2intArrayT(jarr, bs, &json::Value::asInt16); return true;
+                case DT_INT32:  json2intArrayT(jarr, bs, &json::Value::asInt32); return true;
+                case DT_INT64:  json2intArrayT(jarr, bs, &json::Value::asInt64); return true;
+                default:        return false;
+            }
+        }
     };
 
 private:
@@ -1409,6 +1548,20 @@ typedef StreamDevice::SharedPtr StreamDevicePtr;
 /// @brief The Serial stream device.
 /**
 Represents serial port. Main properties: port name and baudrate.
+
+The optional low-latency mode sets `ASYNC_LOW_LATENCY` flag once
+the port is opened, so USB-serial adapters disable their latency timer.
+This is the only setting applied and it's Linux only, on other platforms
+the low-latency mode does nothing. The driver queue sizes are not changed.
+
+The read timeouts (VMIN/VTIME or COMMTIMEOUTS) are not touched:
+boost.asio uses non-blocking reads on POSIX and overlapped reads
+on Windows, so asynchronous reads already complete as soon as
+any data is available.
+
+The flag is set on best effort basis (not all drivers support it),
+the achieved settings are available via getSettings() and may be
+reported by the application.
 */
 class StreamDevice::Serial:
     public StreamDevice
@@ -1430,6 +1583,7 @@ protected:
         : m_stream(ios)
         , m_portName(portName)
         , m_baudrate(baudrate)
+        , m_lowLatency(false)
     {}
 
 public:
@@ -1468,6 +1622,63 @@ public:
         return boost::dynamic_pointer_cast<This>(Base::shared_from_this());
     }
 
+public:
+
+    /// @brief The achieved serial port settings.
+    struct Settings
+    {
+        bool lowLatency;     ///< @brief The `ASYNC_LOW_LATENCY` flag is set.
+
+        /// @brief The default constructor.
+        Settings()
+            : lowLatency(false)
+        {}
+
+
+        /// @brief Get the settings as a string.
+        /**
+        @return The human-readable settings.
+        */
+        String toString() const
+        {
+            OStringStream oss;
+            oss << "low-latency:" << (lowLatency ? "yes" : "no");
+            return oss.str();
+        }
+    };
+
+
+    /// @brief Enable/disable the low-latency mode.
+    /**
+    Takes effect on the next open.
+
+    @param[in] enabled The low-latency mode flag.
+    */
+    void setLowLatency(bool enabled)
+    {
+        m_lowLatency = enabled;
+    }
+
+
+    /// @brief Is the low-latency mode enabled?
+    /**
+    @return `true` if the low-latency mode is requested.
+    */
+    bool isLowLatency() const
+    {
+        return m_lowLatency;
+    }
+
+
+    /// @brief Get the achieved settings.
+    /**
+    @return The settings read back after the last successful open.
+    */
+    Settings const& getSettings() const
+    {
+        return m_settings;
+    }
+
 public: // StreamDevice interface
 
     /// @copydoc StreamDevice::get_io_service()
@@ -1557,13 +1768,70 @@ protected:
         m_stream.set_option(boost::asio::serial_port::parity(), err);
         if (err) return err;
 
+        // low-latency mode
+        if (m_lowLatency)
+            tune(m_stream);
+
+        m_settings = query(m_stream);
         return err; // OK
     }
 
+public:
+
+    /// @brief Tune the serial port for the low latency.
+    /**
+    Sets `ASYNC_LOW_LATENCY` flag on Linux, does nothing on other platforms.
+    The driver may not support the flag, so errors are ignored,
+    use query() to check what is actually achieved.
+
+    @param[in] port The opened serial port.
+    */
+    static void tune(boost::asio::serial_port &port)
+    {
+#if defined(__linux__) && defined(ASYNC_LOW_LATENCY)
+        const int fd = port.native_handle();
+
+        serial_struct ss;
+        if (0 == ::ioctl(fd, TIOCGSERIAL, &ss))
+        {
+            ss.flags |= ASYNC_LOW_LATENCY;
+            ::ioctl(fd, TIOCSSERIAL, &ss); // (!) ignore error, not supported by all drivers
+        }
+#else
+        (void)port;
+#endif // __linux__
+    }
+
+
+    /// @brief Query the serial port settings.
+    /**
+    @param[in] port The opened serial port.
+    @return The achieved settings.
+    */
+    static Settings query(boost::asio::serial_port &port)
+    {
+        Settings res;
+
+#if defined(__linux__) && defined(ASYNC_LOW_LATENCY)
+        const int fd = port.native_handle();
+
+        serial_struct ss;
+        if (0 == ::ioctl(fd, TIOCGSERIAL, &ss))
+            res.lowLatency = (ss.flags & ASYNC_LOW_LATENCY) != 0;
+#else
+        (void)port;
+#endif // __linux__
+
+        return res;
+    }
+
 protected:
     boost::asio::serial_port m_stream; ///< @brief The serial port device.
     String m_portName; ///< @brief The serial port name.
     UInt32 m_baudrate; ///< @brief The serial baudrate.
+
+    bool m_lowLatency;   ///< @brief The low-latency mode flag.
+    Settings m_settings; ///< @brief The achieved settings.
 };
 
 
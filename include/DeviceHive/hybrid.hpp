@@ -0,0 +1,803 @@
+/** @file
+@brief The DeviceHive hybrid service.
+@author Sergey Polichnoy <sergey.polichnoy@dataart.com>
+*/
+#ifndef __DEVICEHIVE_HYBRID_HPP_
+#define __DEVICEHIVE_HYBRID_HPP_
+
+#include <DeviceHive/restful.hpp>
+#include <DeviceHive/websocket.hpp>
+
+#if !defined(HIVE_PCH)
+#   include <boost/enable_shared_from_this.hpp>
+#   include <boost/random/mersenne_twister.hpp>
+#   include <boost/random/uniform_int_distribution.hpp>
+#   include <boost/shared_ptr.hpp>
+#   include <boost/weak_ptr.hpp>
+#   include <vector>
+#endif // HIVE_PCH
+
+namespace devicehive
+{
+
+/// @brief The hybrid service.
+/**
+Uses both RESTful and Websocket services of a server pool:
+  - commands are received via websocket if server provides
+    one (see ServerInfo::alternativeUrl), or via REST long-polling otherwise;
+  - registrations, device data, command results and notifications are sent
+    via REST, pipelined over keep-alive connections.
+
+The initial server is chosen randomly, so many gateways are spread
+over the server pool.
+
+The current server is checked periodically by "server info" requests.
+Until the service is ready the failed "server info" request is retried
+with backoff delay (see RestfulServiceBase::getRetryBackoff()).
+If the server fails too many checks or requests in a row the service
+switches to the next server and restores all command subscriptions there
+since the last received command. The failover is not visible
+to the application: IDeviceServiceEvents::onConnected() is reported only once.
+If all servers of the pool fail before the service is ready,
+the connection error is reported via IDeviceServiceEvents::onConnected()
+and the service keeps trying the servers.
+Device registrations, both queued and cancelled in flight, are moved
+to the next server. Other failed requests are still reported to the application.
+*/
+class HybridService:
+    public IDeviceService,
+    public boost::enable_shared_from_this<HybridService>
+{
+    typedef HybridService This; ///< @brief The type alias.
+
+protected:
+
+    /// @brief The main constructor.
+    /**
+    @param[in] httpClient The HTTP client instance.
+    @param[in] baseUrls The REST URLs of the server pool.
+    @param[in] callbacks The events handler.
+    @param[in] name The custom name. Optional.
+    */
+    HybridService(http::ClientPtr httpClient,
+                  std::vector<String> const& baseUrls,
+                  boost::shared_ptr<IDeviceServiceEvents> callbacks,
+                  String const& name)
+        : m_http(httpClient)
+        , m_baseUrls(baseUrls)
+        , m_callbacks(callbacks)
+        , m_log("/devicehive/hybrid/" + name)
+        , m_name(name)
+        , m_timeout_ms(60000)
+        , m_websocketEnabled(true)
+        , m_current(0)
+        , m_generation(0)
+        , m_wsReady(false)
+        , m_ready(false)
+        , m_connected(false)
+        , m_serverInfoRequested(false)
+        , m_healthTimer(httpClient->getIoService())
+        , m_healthInterval_ms(30000)
+        , m_failureLimit(3)
+        , m_failures(0)
+        , m_failedServers(0)
+    {
+        assert(!baseUrls.empty() && "no server URL provided");
+
+        if (!baseUrls.empty())
+        {
+            boost::random::mt19937 rgen(hive::misc::random_seed(this));
+            boost::random::uniform_int_distribution<size_t> first(0, baseUrls.size()-1);
+            m_current = first(rgen);
+        }
+    }
+
+public:
+
+    /// @brief The trivial destructor.
+    virtual ~HybridService()
+    {}
+
+public:
+
+    ///@brief The error code type.
+    typedef boost::system::error_code ErrorCode;
+
+    /// @brief The shared pointer type.
+    typedef boost::shared_ptr<HybridService> SharedPtr;
+
+
+    /// @brief The factory method.
+    /**
+    @param[in] httpClient The HTTP client instance.
+    @param[in] baseUrls The REST URLs of the server pool.
+    @param[in] callbacks The events handler.
+    @param[in] name The custom name. Optional.
+    @return The new instance.
+    */
+    static SharedPtr create(http::ClientPtr httpClient, std::vector<String> const& baseUrls,
+        boost::shared_ptr<IDeviceServiceEvents> callbacks, String const& name = String())
+    {
+        return SharedPtr(new This(httpClient, baseUrls, callbacks, name));
+    }
+
+public:
+
+    /// @brief Set web request timeout.
+    /**
+    Should be called before connection.
+
+    @param[in] timeout_ms The web request timeout, milliseconds.
+    @return Self reference.
+    */
+    This& setTimeout(size_t timeout_ms)
+    {
+        m_timeout_ms = timeout_ms;
+        return *this;
+    }
+
+
+    /// @brief Enable/disable websocket transport.
+    /**
+    If disabled, commands are received via REST long-polling.
+    Should be called before connection.
+
+    @param[in] enabled The websocket enabled flag.
+    @return Self reference.
+    */
+    This& setWebsocketEnabled(bool enabled)
+    {
+        m_websocketEnabled = enabled;
+        return *this;
+    }
+
+
+    /// @brief Set health check parameters.
+    /**
+    @param[in] interval_ms The interval between "server info" checks, milliseconds.
+    @param[in] failureLimit The number of failures in a row to switch to the next server.
+    @return Self reference.
+    */
+    This& setHealthCheck(size_t interval_ms, size_t failureLimit)
+    {
+        m_healthInterval_ms = interval_ms;
+        m_failureLimit = failureLimit;
+        return *this;
+    }
+
+
+    /// @brief Get the current server URL.
+    /**
+    @return The REST URL of the current server.
+    */
+    String const& getCurrentUrl() const
+    {
+        return m_baseUrls[m_current];
+    }
+
+
+    /// @brief Is websocket used for commands?
+    /**
+    @return `true` if commands are received via websocket.
+    */
+    bool isWebsocketUsed() const
+    {
+        return m_wsReady;
+    }
+
+public: // IDeviceService
+
+    /// @copydoc IDeviceService::cancelAll()
+    virtual void cancelAll()
+    {
+        stopServer();
+        m_subscriptions.clear();
+        m_connected = false;
+        m_serverInfoRequested = false;
+        m_failedServers = 0;
+    }
+
+public:
+
+    /// @copydoc IDeviceService::asyncConnect()
+    virtual void asyncConnect()
+    {
+        startServer();
+    }
+
+
+    /// @copydoc IDeviceService::asyncGetServerInfo()
+    /**
+    The server information of the current server is reported
+    once the service is ready.
+    */
+    virtual void asyncGetServerInfo()
+    {
+        m_serverInfoRequested = true;
+        if (m_ready)
+            reportServerInfo();
+    }
+
+public:
+
+    /// @copydoc IDeviceService::asyncRegisterDevice()
+    virtual void asyncRegisterDevice(DevicePtr device)
+    {
+        m_rest->asyncRegisterDevice(device);
+    }
+
+
+    /// @copydoc IDeviceService::asyncRegisterDevices()
+    virtual void asyncRegisterDevices(std::vector<DevicePtr> const& devices)
+    {
+        m_rest->asyncRegisterDevices(devices);
+    }
+
+
+    /// @copydoc IDeviceService::asyncGetDeviceData()
+    virtual void asyncGetDeviceData(DevicePtr device)
+    {
+        m_rest->asyncGetDeviceData(device);
+    }
+
+
+    /// @copydoc IDeviceService::asyncUpdateDeviceData()
+    virtual void asyncUpdateDeviceData(DevicePtr device)
+    {
+        m_rest->asyncUpdateDeviceData(device);
+    }
+
+public:
+
+    /// @copydoc IDeviceService::asyncSubscribeForCommands()
+    virtual void asyncSubscribeForCommands(DevicePtr device, String const& timestamp)
+    {
+        m_subscriptions.insert(device).lastCommandTimestamp = timestamp;
+        if (m_ready)
+            getCommandService()->asyncSubscribeForCommands(device, timestamp);
+        // else will be subscribed once ready
+    }
+
+
+    /// @copydoc IDeviceService::asyncUnsubscribeFromCommands()
+    virtual void asyncUnsubscribeFromCommands(DevicePtr device)
+    {
+        if (m_subscriptions.erase(device) && m_ready)
+            getCommandService()->asyncUnsubscribeFromCommands(device);
+    }
+
+public:
+
+    /// @copydoc IDeviceService::asyncUpdateCommand()
+    virtual void asyncUpdateCommand(DevicePtr device, CommandPtr command)
+    {
+        m_rest->asyncUpdateCommand(device, command);
+    }
+
+public:
+
+    /// @copydoc IDeviceService::asyncInsertNotification()
+    virtual void asyncInsertNotification(DevicePtr device, NotificationPtr notification)
+    {
+        m_rest->asyncInsertNotification(device, notification);
+    }
+
+private:
+
+    /// @brief Get the service used for commands.
+    /**
+    @return The websocket service if ready, the RESTful service otherwise.
+    */
+    IDeviceServicePtr getCommandService() const
+    {
+        if (m_wsReady)
+            return m_ws;
+        return m_rest;
+    }
+
+
+    /// @brief Start using the current server.
+    /**
+    Creates new services and checks the server by "server info" request.
+    */
+    void startServer()
+    {
+        stopServer();
+        m_generation += 1;
+        m_failures = 0;
+
+        HIVELOG_INFO(m_log, "using server #" << m_current << ": " << getCurrentUrl());
+
+        m_restEvents.reset(new Events(shared_from_this(), m_generation, false));
+        m_rest = RestfulService::create(m_http, getCurrentUrl(), m_restEvents, m_name);
+        m_rest->setAutoReconnect(true); // restore failed polls
+        m_rest->setTimeout(m_timeout_ms);
+
+        m_rest->asyncGetServerInfo();
+        startHealthTimer();
+    }
+
+
+    /// @brief Stop using the current server.
+    void stopServer()
+    {
+        m_healthTimer.cancel();
+
+        if (m_ws)
+            m_ws->cancelAll();
+        if (m_rest)
+            m_rest->cancelAll();
+
+        // events from old services are ignored by generation
+        m_ws.reset();
+        m_wsEvents.reset();
+        m_wsReady = false;
+        m_ready = false;
+    }
+
+
+    /// @brief Switch to the next server.
+    /**
+    The queued registrations are moved to the new server.
+    The registrations cancelled in flight are moved by the old server events.
+    */
+    void failover()
+    {
+        std::vector<DevicePtr> registrations;
+        if (m_rest)
+            registrations = m_rest->takePendingRegistrations();
+        if (m_restEvents)
+            m_restEvents->setFailover();
+
+        m_current = (m_current + 1) % m_baseUrls.size();
+        HIVELOG_WARN(m_log, "switching to server #" << m_current << ": " << getCurrentUrl());
+        startServer();
+
+        if (!registrations.empty())
+        {
+            HIVELOG_INFO(m_log, "moving " << registrations.size()
+                << " queued registrations");
+            m_rest->asyncRegisterDevices(registrations);
+        }
+    }
+
+
+    /// @brief Register the device on the current server again.
+    /**
+    @param[in] device The device cancelled by failover.
+    */
+    void moveRegistration(DevicePtr device)
+    {
+        HIVELOG_DEBUG(m_log, "moving registration of \"" << device->id << "\"");
+        m_rest->asyncRegisterDevices(std::vector<DevicePtr>(1, device));
+    }
+
+
+    /// @brief Register the server failure.
+    /**
+    Switches to the next server if there are too many failures in a row.
+    Reports the connection error to the application if all servers
+    failed before the service is ready.
+
+    @param[in] err The error code.
+    @param[in] hint The failed operation.
+    */
+    void handleFailure(ErrorCode err, const char *hint)
+    {
+        m_failures += 1;
+        HIVELOG_WARN(m_log, hint << " failed: [" << err << "] " << err.message()
+            << ", failure #" << m_failures << " of " << m_failureLimit);
+
+        if (m_failures < m_failureLimit)
+            return;
+
+        if (!m_connected && m_baseUrls.size() <= ++m_failedServers)
+        {
+            // no failover target left, let application know
+            m_failedServers = 0;
+            HIVELOG_ERROR(m_log, "all " << m_baseUrls.size() << " servers failed");
+            if (boost::shared_ptr<IDeviceServiceEvents> cb = m_callbacks.lock())
+            {
+                m_http->getIoService().post(
+                    boost::bind(&IDeviceServiceEvents::onConnected,
+                        cb, err));
+            }
+            else
+                assert(!"callback is dead or not initialized");
+        }
+
+        if (1 < m_baseUrls.size())
+            failover();
+        else
+            m_failures = 0; // start new round on the same server
+    }
+
+
+    /// @brief The service is ready to receive commands.
+    /**
+    Restores command subscriptions and reports connection if not reported yet.
+    */
+    void setReady()
+    {
+        m_ready = true;
+        m_failures = 0;
+        m_failedServers = 0;
+
+        HIVELOG_INFO(m_log, "ready, commands are received via "
+            << (m_wsReady ? "websocket" : "REST"));
+
+        // restore subscriptions at once
+        IDeviceServicePtr service = getCommandService();
+        const std::vector<DevicePtr> devices = m_subscriptions.getDevices();
+        for (size_t i = 0; i < devices.size(); ++i)
+        {
+            service->asyncSubscribeForCommands(devices[i],
+                m_subscriptions.findData(devices[i])->lastCommandTimestamp);
+        }
+
+        if (boost::shared_ptr<IDeviceServiceEvents> cb = m_callbacks.lock())
+        {
+            if (!m_connected)
+            {
+                m_connected = true;
+                cb->onConnected(ErrorCode());
+            }
+        }
+        else
+            assert(!"callback is dead or not initialized");
+
+        if (m_serverInfoRequested)
+            reportServerInfo();
+    }
+
+
+    /// @brief Report the current server information.
+    void reportServerInfo()
+    {
+        m_serverInfoRequested = false;
+
+        ServerInfo info = m_serverInfo;
+        info.alternativeUrl.clear(); // already used
+
+        if (boost::shared_ptr<IDeviceServiceEvents> cb = m_callbacks.lock())
+        {
+            m_http->getIoService().post(
+                boost::bind(&IDeviceServiceEvents::onServerInfo,
+                    cb, ErrorCode(), info));
+        }
+        else
+            assert(!"callback is dead or not initialized");
+    }
+
+private: // health check
+
+    /// @brief Start the health check timer.
+    void startHealthTimer()
+    {
+        m_healthTimer.expires_from_now(boost::posix_time::milliseconds(m_healthInterval_ms));
+        m_healthTimer.async_wait(boost::bind(&This::onHealthTimer,
+            shared_from_this(), m_generation, boost::asio::placeholders::error));
+    }
+
+
+    /// @brief The health check timer handler.
+    /**
+    @param[in] generation The server generation.
+    @param[in] err The error code.
+    */
+    void onHealthTimer(size_t generation, ErrorCode err)
+    {
+        if (err || generation != m_generation)
+            return; // cancelled
+
+        if (m_ready || m_ws) // otherwise retried by onServerInfo()
+            m_rest->asyncGetServerInfo();
+        startHealthTimer();
+    }
+
+
+    /// @brief Retry the initial "server info" request.
+    /**
+    @param[in] generation The server generation.
+    */
+    void retryServerInfo(size_t generation)
+    {
+        if (generation == m_generation && !m_ready && !m_ws)
+            m_rest->asyncGetServerInfo();
+    }
+
+private: // events of the inner services
+
+    /// @brief The server info is received.
+    void onServerInfo(ErrorCode err, ServerInfo const& info)
+    {
+        if (err)
+        {
+            const size_t generation = m_generation;
+            handleFailure(err, "server info");
+
+            // retry with backoff until ready, unless switched to the next server
+            if (generation == m_generation && !m_ready && !m_ws)
+            {
+                m_rest->asyncRetry(boost::bind(&This::retryServerInfo,
+                    shared_from_this(), generation));
+            }
+            return;
+        }
+
+        m_failures = 0;
+        m_rest->getRetryBackoff().reset();
+        m_serverInfo = info;
+        if (m_ready || m_ws)
+            return; // just health check
+
+        if (m_websocketEnabled && !info.alternativeUrl.empty())
+        {
+            HIVELOG_INFO(m_log, "connecting to websocket: " << info.alternativeUrl);
+
+            m_wsEvents.reset(new Events(shared_from_this(), m_generation, true));
+            m_ws = WebsocketService::create(m_http, info.alternativeUrl, m_wsEvents, m_name);
+            m_ws->setAutoReconnect(true); // restore the session after connection loss
+            m_ws->setTimeout(m_timeout_ms);
+            m_ws->asyncConnect();
+        }
+        else
+            setReady();
+    }
+
+
+    /// @brief The websocket connection state is changed.
+    void onWebsocketConnected(ErrorCode err)
+    {
+        if (err)
+        {
+            // websocket reconnects itself
+            handleFailure(err, "websocket connection");
+            return;
+        }
+
+        if (!m_ready)
+        {
+            m_wsReady = true;
+            setReady();
+        }
+        // else subscriptions are restored by websocket service
+    }
+
+
+    /// @brief The command is received.
+    void onInsertCommand(ErrorCode err, DevicePtr device, CommandPtr command)
+    {
+        if (err)
+        {
+            handleFailure(err, "polling command");
+            return;
+        }
+
+        Subscription *s = m_subscriptions.findData(device);
+        if (!s)
+            return; // unsubscribed
+        s->lastCommandTimestamp = command->timestamp;
+
+        if (boost::shared_ptr<IDeviceServiceEvents> cb = m_callbacks.lock())
+            cb->onInsertCommand(err, device, command);
+    }
+
+
+    /// @brief The request is finished.
+    /**
+    Failures of the current server are counted.
+    Requests rejected by server are not failures of the server.
+
+    @param[in] generation The server generation.
+    @param[in] err The error code.
+    @param[in] hint The request name.
+    */
+    void onRequestDone(size_t generation, ErrorCode err, const char *hint)
+    {
+        if (generation != m_generation)
+            return; // old server
+        if (!err || isRefusedError(err))
+            m_failures = 0; // server is alive
+        else if (err != boost::asio::error::operation_aborted)
+            handleFailure(err, hint);
+    }
+
+private:
+
+    /// @brief The events of the inner services.
+    /**
+    Forwards request results to the application and
+    connection related events to the hybrid service.
+    */
+    class Events:
+        public IDeviceServiceEvents
+    {
+    public:
+
+        /// @brief The main constructor.
+        /**
+        @param[in] owner The hybrid service.
+        @param[in] generation The server generation.
+        @param[in] websocket The websocket service flag.
+        */
+        Events(HybridService::SharedPtr owner, size_t generation, bool websocket)
+            : m_owner(owner)
+            , m_generation(generation)
+            , m_websocket(websocket)
+            , m_failover(false)
+        {}
+
+    public:
+
+        /// @brief Mark the server as switched.
+        /**
+        Registrations cancelled after this call are moved to the new server.
+        */
+        void setFailover()
+        {
+            m_failover = true;
+        }
+
+    public:
+
+        /// @copydoc IDeviceServiceEvents::onConnected()
+        virtual void onConnected(ErrorCode err)
+        {
+            if (HybridService::SharedPtr owner = getOwner())
+                if (m_websocket)
+                    owner->onWebsocketConnected(err);
+            // RESTful "connection" is not used
+        }
+
+
+        /// @copydoc IDeviceServiceEvents::onServerInfo()
+        virtual void onServerInfo(ErrorCode err, ServerInfo info)
+        {
+            if (HybridService::SharedPtr owner = getOwner())
+                owner->onServerInfo(err, info);
+        }
+
+
+        /// @copydoc IDeviceServiceEvents::onRegisterDevice()
+        virtual void onRegisterDevice(ErrorCode err, DevicePtr device)
+        {
+            if (m_failover && err == boost::asio::error::operation_aborted)
+            {
+                if (HybridService::SharedPtr owner = m_owner.lock())
+                {
+                    owner->moveRegistration(device);
+                    return;
+                }
+            }
+
+            if (boost::shared_ptr<IDeviceServiceEvents> cb = done(err, "registering device"))
+                cb->onRegisterDevice(err, device);
+        }
+
+
+        /// @copydoc IDeviceServiceEvents::onGetDeviceData()
+        virtual void onGetDeviceData(ErrorCode err, DevicePtr device)
+        {
+            if (boost::shared_ptr<IDeviceServiceEvents> cb = done(err, "getting device data"))
+                cb->onGetDeviceData(err, device);
+        }
+
+
+        /// @copydoc IDeviceServiceEvents::onUpdateDeviceData()
+        virtual void onUpdateDeviceData(ErrorCode err, DevicePtr device)
+        {
+            if (boost::shared_ptr<IDeviceServiceEvents> cb = done(err, "updating device data"))
+                cb->onUpdateDeviceData(err, device);
+        }
+
+
+        /// @copydoc IDeviceServiceEvents::onInsertCommand()
+        virtual void onInsertCommand(ErrorCode err, DevicePtr device, CommandPtr command)
+        {
+            if (HybridService::SharedPtr owner = getOwner())
+                owner->onInsertCommand(err, device, command);
+        }
+
+
+        /// @copydoc IDeviceServiceEvents::onUpdateCommand()
+        virtual void onUpdateCommand(ErrorCode err, DevicePtr device, CommandPtr command)
+        {
+            if (boost::shared_ptr<IDeviceServiceEvents> cb = done(err, "updating command"))
+                cb->onUpdateCommand(err, device, command);
+        }
+
+
+        /// @copydoc IDeviceServiceEvents::onInsertNotification()
+        virtual void onInsertNotification(ErrorCode err, DevicePtr device, NotificationPtr notification)
+        {
+            if (boost::shared_ptr<IDeviceServiceEvents> cb = done(err, "inserting notification"))
+                cb->onInsertNotification(err, device, notification);
+        }
+
+    private:
+
+        /// @brief Get the owner if events are from the current server.
+        /**
+        @return The hybrid service or NULL.
+        */
+        HybridService::SharedPtr getOwner() const
+        {
+            HybridService::SharedPtr owner = m_owner.lock();
+            if (owner && owner->m_generation == m_generation)
+                return owner;
+            return HybridService::SharedPtr();
+        }
+
+
+        /// @brief Finish the request.
+        /**
+        Results of the requests are reported even from the old servers.
+
+        @param[in] err The error code.
+        @param[in] hint The request name.
+        @return The application events handler or NULL.
+        */
+        boost::shared_ptr<IDeviceServiceEvents> done(ErrorCode err, const char *hint) const
+        {
+            if (HybridService::SharedPtr owner = m_owner.lock())
+            {
+                owner->onRequestDone(m_generation, err, hint);
+                return owner->m_callbacks.lock();
+            }
+
+            return boost::shared_ptr<IDeviceServiceEvents>();
+        }
+
+    private:
+        boost::weak_ptr<HybridService> m_owner; ///< @brief The hybrid service.
+        size_t m_generation; ///< @brief The server generation.
+        bool m_websocket;    ///< @brief The websocket service flag.
+        bool m_failover;     ///< @brief The server is switched.
+    };
+
+private:
+    http::ClientPtr m_http; ///< @brief The HTTP client.
+    std::vector<String> m_baseUrls; ///< @brief The server pool.
+    boost::weak_ptr<IDeviceServiceEvents> m_callbacks; ///< @brief The application events.
+    hive::log::Logger m_log; ///< @brief The logger.
+    String m_name;           ///< @brief The custom name.
+    size_t m_timeout_ms;     ///< @brief The web request timeout, milliseconds.
+    bool m_websocketEnabled; ///< @brief The websocket enabled flag.
+
+private:
+    size_t m_current;    ///< @brief The current server index.
+    size_t m_generation; ///< @brief The server generation, incremented on each switch.
+    ServerInfo m_serverInfo; ///< @brief The current server information.
+
+    RestfulService::SharedPtr m_rest; ///< @brief The current RESTful service.
+    WebsocketService::SharedPtr m_ws; ///< @brief The current websocket service.
+    boost::shared_ptr<Events> m_restEvents; ///< @brief The RESTful service events.
+    boost::shared_ptr<Events> m_wsEvents;   ///< @brief The websocket service events.
+
+    bool m_wsReady;   ///< @brief Commands are received via websocket.
+    bool m_ready;     ///< @brief The current server is ready.
+    bool m_connected; ///< @brief The connection is reported to the application.
+    bool m_serverInfoRequested; ///< @brief The application waits for server info.
+
+private:
+    boost::asio::deadline_timer m_healthTimer; ///< @brief The health check timer.
+    size_t m_healthInterval_ms; ///< @brief The health check interval, milliseconds.
+    size_t m_failureLimit;      ///< @brief The maximum number of failures in a row.
+    size_t m_failures;          ///< @brief The current number of failures in a row.
+    size_t m_failedServers;     ///< @brief The number of servers failed in a row before ready.
+
+private:
+
+    /// @brief The command subscription.
+    struct Subscription
+    {
+        String lastCommandTimestamp; ///< @brief The timestamp of the last received command.
+    };
+
+    DeviceRegistry<Subscription> m_subscriptions; ///< @brief The subscribed devices.
+};
+
+} // devicehive namespace
+
+#endif // __DEVICEHIVE_HYBRID_HPP_
@@ -0,0 +1,614 @@
+/** @file
+@brief The DeviceHive persistent notification outbox.
+@author Sergey Polichnoy <sergey.polichnoy@dataart.com>
+*/
+#ifndef __DEVICEHIVE_OUTBOX_HPP_
+#define __DEVICEHIVE_OUTBOX_HPP_
+
+#include <DeviceHive/service.hpp>
+#include <hive/swab.hpp>
+
+#if !defined(HIVE_PCH)
+#   include <boost/shared_ptr.hpp>
+#   include <boost/crc.hpp>
+#   include <fstream>
+#   include <iomanip>
+#   include <deque>
+#   include <stdio.h>
+#endif // HIVE_PCH
+
+
+namespace devicehive
+{
+
+/// @brief The persistent notification outbox.
+/**
+This class is used to store notifications on disk while the server
+is not available. Stored notifications are replayed in order later.
+
+The outbox is an append-only log split into segment files:
+`<fileName>.00000001`, `<fileName>.00000002`, etc. Each record is
+written as `[length:UInt32LE][CRC32:UInt32LE][JSON payload]`, so a torn
+record after crash is detected and ignored. The read position is kept
+in the `<fileName>.cursor` file which is updated via temporary file
+and rename. Fully consumed segments are removed after the cursor is saved.
+
+Only the device identifier is stored with notification, the device key
+is never written to disk, so the application should find the device
+(and its key) by identifier on replay.
+
+Records are flushed to the operating system but not synced to the disk
+(there is no `fsync`), so stored notifications survive the application
+crash but may be lost on power failure.
+
+The outbox capacity is the maximum total size of all segments in bytes.
+If there is no more space, the oldest segment is dropped.
+
+The typical replay loop is:
+~~~{.cpp}
+std::vector<Outbox::Entry> head;
+outbox->peek(head, 1);
+// ... send the entry, then if it is sent:
+outbox->pop(1);
+~~~
+
+The records are removed from the head only, so the application
+that sends several records at once should keep the sent ones
+and pop them in order. The next records may be peeked using
+the number of already peeked records as `skip` argument.
+
+Delivery is "at least once": the record is sent again if it wasn't popped.
+*/
+class Outbox:
+    private NonCopyable
+{
+    typedef Outbox This; ///< @brief The type alias.
+
+    /// @brief Constants.
+    enum Const
+    {
+        HEADER_SIZE = 8,    ///< @brief The record header size in bytes.
+        MAX_SEQ_GAP = 16    ///< @brief The maximum number of missing segments to skip on open.
+    };
+
+protected:
+
+    /// @brief The main constructor.
+    /**
+    @param[in] fileName The base file name.
+    @param[in] capacity The maximum total size in bytes.
+    @param[in] segmentSize The maximum segment size in bytes.
+    */
+    Outbox(String const& fileName, size_t capacity, size_t segmentSize)
+        : m_fileName(fileName)
+        , m_capacity(capacity)
+        , m_segmentSize(std::min(segmentSize, capacity))
+        , m_readOffset(0)
+        , m_readCount(0)
+        , m_totalSize(0)
+        , m_size(0)
+        , m_dropped(0)
+        , m_droppedSincePeek(0)
+        , m_log("/devicehive/outbox")
+    {}
+
+public:
+
+    /// @brief The trivial destructor.
+    virtual ~Outbox()
+    {}
+
+public:
+
+    /// @brief The shared pointer type.
+    typedef boost::shared_ptr<Outbox> SharedPtr;
+
+
+    /// @brief The factory method.
+    /**
+    Opens existing outbox files or creates new ones.
+
+    @param[in] fileName The base file name.
+    @param[in] capacity The maximum total size in bytes.
+    @param[in] segmentSize The maximum segment size in bytes.
+    @return The new outbox instance.
+    */
+    static SharedPtr create(String const& fileName,
+        size_t capacity = 16*1024*1024,
+        size_t segmentSize = 1024*1024)
+    {
+        SharedPtr pthis(new This(fileName, capacity, segmentSize));
+        pthis->open();
+        return pthis;
+    }
+
+public:
+
+    /// @brief The outbox entry.
+    struct Entry
+    {
+        String deviceId;    ///< @brief The device identifier.
+        NotificationPtr notification; ///< @brief The notification. NULL for corrupted record.
+    };
+
+public:
+
+    /// @brief Append notification.
+    /**
+    @param[in] device The device.
+    @param[in] notification The notification.
+    @return `true` if notification is stored.
+    */
+    bool push(DevicePtr device, NotificationPtr notification)
+    {
+        Entry entry;
+        entry.deviceId = device->id;
+        entry.notification = notification;
+        return push(entry);
+    }
+
+
+    /// @brief Append entry.
+    /**
+    @param[in] entry The entry to append.
+    @return `true` if entry is stored.
+    */
+    bool push(Entry const& entry)
+    {
+        json::Value jrec;
+        jrec["deviceId"] = entry.deviceId;
+        jrec["notification"] = Serializer::toJson(entry.notification);
+        const String payload = json::toStr(jrec);
+
+        const size_t rec_size = HEADER_SIZE + payload.size();
+        if (m_capacity < rec_size)
+        {
+            HIVELOG_ERROR(m_log, "notification is too big (" << rec_size
+                << " bytes), ignored");
+            return false;
+        }
+
+        if (m_segments.back().size && m_segmentSize < m_segments.back().size + rec_size)
+            startNewSegment();
+        while (m_capacity < m_totalSize + rec_size && 1 < m_segments.size())
+            dropFrontSegment();
+
+        if (!m_writer.is_open())
+        {
+            HIVELOG_ERROR(m_log, "no segment to write, notification ignored");
+            return false;
+        }
+
+        boost::crc_32_type crc;
+        crc.process_bytes(payload.data(), payload.size());
+
+        UInt32 header[2];
+        header[0] = misc::h2le(UInt32(payload.size()));
+        header[1] = misc::h2le(UInt32(crc.checksum()));
+        m_writer.write(reinterpret_cast<const char*>(header), HEADER_SIZE);
+        m_writer.write(payload.data(), payload.size());
+        m_writer.flush();
+        if (!m_writer)
+        {
+            HIVELOG_ERROR(m_log, "failed to write segment #"
+                << m_segments.back().seq);
+            m_writer.close();
+            return false;
+        }
+
+        m_segments.back().size += rec_size;
+        m_segments.back().count += 1;
+        m_totalSize += rec_size;
+        m_size += 1;
+        return true;
+    }
+
+
+    /// @brief Get the oldest entries.
+    /**
+    Entries are not removed, use pop() to remove them when they are sent.
+    Corrupted records are reported with NULL notification and
+    should be popped as well, so each entry is one record.
+
+    @param[out] entries The oldest entries.
+    @param[in] maxCount The maximum number of records.
+    @param[in] skip The number of the oldest records to skip (already peeked).
+    @return The number of peeked records.
+    */
+    size_t peek(std::vector<Entry> &entries, size_t maxCount, size_t skip = 0)
+    {
+        entries.clear();
+        m_droppedSincePeek = 0;
+
+        size_t offset = m_readOffset;
+        for (size_t i = 0; i < m_segments.size() && entries.size() < maxCount; ++i)
+        {
+            std::ifstream file(buildFileName(m_segments[i].seq).c_str(), std::ios::binary);
+            file.seekg(offset);
+
+            String payload;
+            while (entries.size() < maxCount && readRecord(file, skip ? 0 : &payload))
+            {
+                if (skip)
+                {
+                    skip -= 1; // already peeked
+                    continue;
+                }
+
+                Entry entry;
+                try
+                {
+                    const json::Value jrec = json::fromStr(payload);
+
+                    NotificationPtr notification = Notification::create();
+                    Serializer::fromJson(jrec["notification"], notification);
+                    entry.deviceId = jrec["deviceId"].asString();
+                    entry.notification = notification;
+                }
+                catch (std::exception const& ex)
+                {
+                    HIVELOG_ERROR(m_log, "failed to parse record: " << ex.what());
+                }
+                entries.push_back(entry);
+            }
+
+            offset = 0;
+        }
+
+        return entries.size();
+    }
+
+
+    /// @brief Remove the oldest entries.
+    /**
+    Records dropped due to capacity after the last peek() are not removed twice.
+
+    @param[in] count The number of records to remove.
+    */
+    void pop(size_t count)
+    {
+        const size_t skip = std::min(count, m_droppedSincePeek);
+        m_droppedSincePeek -= skip;
+        count -= skip;
+
+        while (count)
+        {
+            std::ifstream file(buildFileName(m_segments.front().seq).c_str(), std::ios::binary);
+            file.seekg(m_readOffset);
+
+            while (count && readRecord(file, 0))
+            {
+                m_readOffset = size_t(file.tellg());
+                m_readCount += 1;
+                m_size -= 1;
+                count -= 1;
+            }
+
+            if (count && 1 < m_segments.size())
+                removeFrontSegment();
+            else
+                break;
+        }
+
+        if (!m_size && m_segments.back().size)
+            startNewSegment(); // to remove the current one
+        removeConsumedSegments();
+    }
+
+public:
+
+    /// @brief Get the number of stored records.
+    /**
+    @return The number of stored records.
+    */
+    size_t size() const
+    {
+        return m_size;
+    }
+
+
+    /// @brief Is outbox empty?
+    /**
+    @return `true` if there is no stored records.
+    */
+    bool empty() const
+    {
+        return 0 == m_size;
+    }
+
+
+    /// @brief Get the total size of all segments.
+    /**
+    @return The total size in bytes.
+    */
+    size_t getTotalSize() const
+    {
+        return m_totalSize;
+    }
+
+
+    /// @brief Get the capacity.
+    /**
+    @return The maximum total size in bytes.
+    */
+    size_t getCapacity() const
+    {
+        return m_capacity;
+    }
+
+
+    /// @brief Get the number of dropped records.
+    /**
+    @return The number of records dropped due to capacity.
+    */
+    size_t getDroppedCount() const
+    {
+        return m_dropped;
+    }
+
+private:
+
+    /// @brief Open the outbox.
+    /**
+    Loads the read position and scans all existing segments.
+    Missing segments are skipped, so existing ones are never overwritten.
+    New segment is always started to avoid writing after torn record.
+    */
+    void open()
+    {
+        UInt32 seq = 1;
+        UInt32 gap = 0;
+
+        if (1) // load cursor
+        {
+            std::ifstream file((m_fileName + ".cursor").c_str());
+            UInt32 s = 0;
+            size_t offset = 0;
+            if (file >> s >> offset)
+            {
+                seq = s;
+                m_readOffset = offset;
+            }
+        }
+
+        const UInt32 cursorSeq = seq;
+        for (; gap < MAX_SEQ_GAP; ++seq) // scan existing segments
+        {
+            std::ifstream file(buildFileName(seq).c_str(), std::ios::binary);
+            if (!file.is_open())
+            {
+                gap += 1;
+                continue;
+            }
+
+            if (gap)
+            {
+                HIVELOG_WARN(m_log, gap << " missing segments before #"
+                    << seq << " skipped");
+                gap = 0;
+            }
+
+            if (m_segments.empty() && seq != cursorSeq)
+                m_readOffset = 0; // read segment is lost
+
+            Segment s;
+            s.seq = seq;
+            s.size = 0;
+            s.count = 0;
+
+            while (readRecord(file, 0))
+            {
+                s.size = size_t(file.tellg());
+                s.count += 1;
+
+                if (m_segments.empty() && s.size <= m_readOffset)
+                    m_readCount += 1;
+            }
+
+            m_segments.push_back(s);
+            m_totalSize += s.size;
+            m_size += s.count;
+        }
+
+        if (m_segments.empty())
+            m_readOffset = 0;
+        m_size -= m_readCount;
+
+        startNewSegment(m_segments.empty()
+            ? cursorSeq : m_segments.back().seq + 1);
+        removeConsumedSegments();
+
+        HIVELOG_INFO(m_log, "\"" << m_fileName << "\" opened: "
+            << m_size << " records in " << m_segments.size()
+            << " segments, " << m_totalSize << " bytes");
+    }
+
+
+    /// @brief Start new segment to write.
+    /**
+    @param[in] seq The segment sequence number. Zero for the next one.
+    */
+    void startNewSegment(UInt32 seq = 0)
+    {
+        if (!seq)
+            seq = m_segments.back().seq + 1;
+
+        m_writer.close();
+        m_writer.clear();
+        m_writer.open(buildFileName(seq).c_str(),
+            std::ios::binary|std::ios::trunc);
+        if (!m_writer.is_open())
+        {
+            HIVELOG_ERROR(m_log, "failed to create segment #" << seq);
+        }
+
+        Segment s;
+        s.seq = seq;
+        s.size = 0;
+        s.count = 0;
+        m_segments.push_back(s);
+    }
+
+
+    /// @brief Remove the oldest (fully consumed) segment.
+    /**
+    The read position is saved before the segment file is removed,
+    so the cursor never points to the removed segment.
+    */
+    void removeFrontSegment()
+    {
+        const Segment s = m_segments.front();
+        m_totalSize -= s.size;
+        m_segments.pop_front();
+
+        m_readOffset = 0;
+        m_readCount = 0;
+
+        saveCursor();
+        ::remove(buildFileName(s.seq).c_str());
+    }
+
+
+    /// @brief Remove all fully consumed segments.
+    /**
+    The last segment is never removed. Also saves the read position.
+    */
+    void removeConsumedSegments()
+    {
+        while (1 < m_segments.size() && m_segments.front().count <= m_readCount)
+            removeFrontSegment();
+        saveCursor();
+    }
+
+
+    /// @brief Drop the oldest segment due to capacity.
+    void dropFrontSegment()
+    {
+        const size_t lost = m_segments.front().count - m_readCount;
+        HIVELOG_WARN(m_log, "outbox is full, " << lost
+            << " oldest records dropped");
+
+        m_dropped += lost;
+        m_droppedSincePeek += lost;
+        m_size -= lost;
+
+        removeFrontSegment();
+    }
+
+
+    /// @brief Save the read position.
+    /**
+    The temporary file is renamed to make this operation atomic.
+    */
+    void saveCursor() const
+    {
+        const String fileName = m_fileName + ".cursor";
+        const String tmpName = fileName + ".tmp";
+
+        if (1)
+        {
+            std::ofstream file(tmpName.c_str(), std::ios::trunc);
+            file << m_segments.front().seq << " " << m_readOffset << "\n";
+            file.flush();
+            if (!file)
+            {
+                HIVELOG_ERROR(m_log, "failed to save cursor");
+                return;
+            }
+        }
+
+        if (0 != ::rename(tmpName.c_str(), fileName.c_str()))
+        {
+            // some platforms cannot rename to existing file
+            ::remove(fileName.c_str());
+            ::rename(tmpName.c_str(), fileName.c_str());
+        }
+    }
+
+
+    /// @brief Read one record.
+    /**
+    The record length is checked before the payload is allocated,
+    the record longer than the capacity is treated as corrupted.
+
+    @param[in] file The input file stream.
+    @param[out] payload The record payload. May be NULL to skip payload.
+    @return `false` on end of file or corrupted record.
+    */
+    bool readRecord(std::istream &file, String *payload) const
+    {
+        UInt32 header[2];
+        if (!file.read(reinterpret_cast<char*>(header), HEADER_SIZE))
+            return false;
+
+        const UInt32 len = misc::le2h(header[0]);
+        if (m_capacity < HEADER_SIZE + size_t(len))
+            return false; // corrupted record
+
+        String buf(len, '\0');
+        if (len && !file.read(&buf[0], len))
+            return false; // torn record
+
+        boost::crc_32_type crc;
+        crc.process_bytes(buf.data(), buf.size());
+        if (crc.checksum() != misc::le2h(header[1]))
+            return false; // corrupted record
+
+        if (payload)
+            payload->swap(buf);
+        return true;
+    }
+
+
+    /// @brief Build the segment file name.
+    /**
+    @param[in] seq The segment sequence number.
+    @return The segment file name.
+    */
+    String buildFileName(UInt32 seq) const
+    {
+        OStringStream oss;
+        oss.fill('0');
+        oss << m_fileName << '.'
+            << std::setw(8)
+            << seq;
+        return oss.str();
+    }
+
+private:
+
+    /// @brief The segment.
+    struct Segment
+    {
+        UInt32 seq;     ///< @brief The sequence number.
+        size_t size;    ///< @brief The segment size in bytes.
+        size_t count;   ///< @brief The number of records.
+    };
+
+    String m_fileName;      ///< @brief The base file name.
+    size_t m_capacity;      ///< @brief The maximum total size in bytes.
+    size_t m_segmentSize;   ///< @brief The maximum segment size in bytes.
+
+    /// @brief The segments.
+    /**
+    The first one is read, the last one is written.
+    */
+    std::deque<Segment> m_segments;
+    std::ofstream m_writer; ///< @brief The last segment stream.
+
+    size_t m_readOffset;    ///< @brief The read position in the first segment.
+    size_t m_readCount;     ///< @brief The number of records read in the first segment.
+    size_t m_totalSize;     ///< @brief The total size of all segments in bytes.
+    size_t m_size;          ///< @brief The number of stored records.
+    size_t m_dropped;       ///< @brief The number of dropped records.
+    size_t m_droppedSincePeek; ///< @brief The number of records dropped since the last peek.
+
+    hive::log::Logger m_log; ///< @brief The logger.
+};
+
+/// @brief The outbox shared pointer type.
+typedef Outbox::SharedPtr OutboxPtr;
+
+} // devicehive namespace
+
+#endif // __DEVICEHIVE_OUTBOX_HPP_
@@ -44,6 +44,8 @@ protected:
         , m_log("/devicehive/rest/" + name)
         , m_baseUrl(baseUrl)
         , m_timeout_ms(60000)
+        , m_lazyParams(false)
+        , m_retryTimer(httpClient->getIoService())
     {}
 
 public:
@@ -100,6 +102,32 @@ public:
         return *this;
     }
 
+
+    /// @brief Enable lazy parsing of command parameters.
+    /**
+    If enabled, parameters of polled commands are kept as raw JSON text
+    and parsed on first access. Command handlers should use
+    Command::getParams() instead of Command::params.
+
+    @param[in] enabled The lazy parsing flag.
+    @return Self reference.
+    */
+    This& setLazyParams(bool enabled)
+    {
+        m_lazyParams = enabled;
+        return *this;
+    }
+
+
+    /// @brief Is lazy parsing of command parameters enabled?
+    /**
+    @return `true` if command parameters are parsed on first access.
+    */
+    bool isLazyParams() const
+    {
+        return m_lazyParams;
+    }
+
 public:
 
     /// @brief Get HTTP client.
@@ -135,9 +163,62 @@ public:
         // TODO: cancel only related requests: m_http_tasks
         m_http->cancelAll();
         m_http->clearKeepAliveConnections();
+        m_retryTimer.cancel();
+    }
+
+public:
+
+    /// @brief The "retry" callback type.
+    typedef boost::function0<void> RetryCallback;
+
+
+    /// @brief Get the retry backoff.
+    /**
+    @return The retry backoff reference.
+    */
+    Backoff& getRetryBackoff()
+    {
+        return m_backoff;
     }
 
 
+    /// @brief Call the functor after backoff delay.
+    /**
+    The delay grows with each attempt until getRetryBackoff().reset()
+    is called. Only one retry may be scheduled, the new one replaces
+    the previous. The callback is not called if retry is cancelled
+    by cancelAll().
+
+    @param[in] callback The callback functor.
+    */
+    void asyncRetry(RetryCallback callback)
+    {
+        const size_t delay_ms = m_backoff.next();
+        HIVELOG_INFO(m_log, "retry attempt #" << m_backoff.getAttempt()
+            << " in " << delay_ms << " ms");
+
+        m_retryTimer.expires_from_now(boost::posix_time::milliseconds(delay_ms));
+        m_retryTimer.async_wait(boost::bind(&This::onRetryTimer,
+            shared_from_this(), boost::asio::placeholders::error, callback));
+    }
+
+private:
+
+    /// @brief The retry timer handler.
+    /**
+    @param[in] err The error code.
+    @param[in] callback The callback functor.
+    */
+    void onRetryTimer(boost::system::error_code err, RetryCallback callback)
+    {
+        if (!err)
+            callback();
+        // else cancelled
+    }
+
+public:
+
+
 /// @name Server Info
 /// @{
 public:
@@ -480,11 +561,32 @@ private:
         std::vector<CommandPtr> commands;
 
         ErrorCode err = verifyTaskResponse(task, "poll commands");
-        if (!err)
+        if (!err && m_lazyParams)
         {
             try
             {
-                const json::Value jval = json::fromStr(task->response->getContent());
+                HIVELOG_DEBUG(m_log, "got \"poll commands\" response: " << task->response->getContent());
+                IStringStream iss(task->response->getContent());
+
+                json::Parser::parseBegin(iss, '[');
+                for (bool first = true; json::Parser::parseNextElement(iss, first); )
+                {
+                    CommandPtr command = Command::create();
+                    Serializer::parseLazy(iss, command);
+                    commands.push_back(command);
+                }
+            }
+            catch (std::exception const& ex)
+            {
+                HIVELOG_ERROR(m_log, "failed to parse \"poll commands\" response: " << ex.what());
+                err = boost::asio::error::fault; // TODO: useful error code
+            }
+        }
+        else if (!err)
+        {
+            try
+            {
+                json::Value jval = json::fromStr(task->response->getContent());
                 HIVELOG_DEBUG(m_log, "got \"poll commands\" response: " << json::toStrHH(jval));
                 if (jval.isArray())
                 {
@@ -494,7 +596,7 @@ private:
                     for (size_t i = 0; i < N; ++i)
                     {
                         CommandPtr command = Command::create();
-                        Serializer::fromJson(jval[i], command);
+                        Serializer::moveFromJson(jval[i], command); // response is dropped anyway
                         commands.push_back(command);
                     }
                 }
@@ -512,6 +614,209 @@ private:
             callback(err, device, commands);
     }
 
+public:
+
+    /// @brief The device and its command.
+    typedef std::pair<devicehive::DevicePtr, devicehive::CommandPtr> DeviceCommand;
+
+    /// @brief The "poll many commands" callback type.
+    typedef boost::function3<void, ErrorCode, std::vector<devicehive::DevicePtr>, std::vector<DeviceCommand> > PollManyCommandsCallback;
+
+
+    /// @brief Poll commands for several devices from the server.
+    /**
+    Uses the multi-device "device/command/poll?deviceGuids=..." endpoint,
+    so only one long-poll request is active for the whole device set.
+    The first device credentials are used for authentication,
+    if server refuses them the callback is called with
+    `boost::asio::error::access_denied` error code.
+
+    If server doesn't support this endpoint the callback is called with
+    `boost::asio::error::operation_not_supported` error code,
+    so the caller can fall back to per-device polling.
+
+    @param[in] devices The devices to poll commands for. Should not be empty.
+    @param[in] timestamp The timestamp of the last received command. Empty for server's "now".
+    @param[in] names The list of command names (coma separated).
+    @param[in] wait_sec Waiting timeout in seconds: [0,60]. -1 - default 30 seconds. 0 - to disable waiting.
+    @param[in] callback The callback functor.
+    @return Corresponding HTTP task.
+    */
+    http::Client::TaskPtr asyncPollCommands(std::vector<DevicePtr> const& devices, String const& timestamp,
+        String const& names, int wait_sec, PollManyCommandsCallback callback)
+    {
+        assert(!devices.empty() && "no devices to poll");
+
+        String guids;
+        for (size_t i = 0; i < devices.size(); ++i)
+        {
+            if (i) guids += ",";
+            guids += devices[i]->id;
+        }
+
+        http::Url::Builder urlb(m_baseUrl);
+        urlb.appendPath("device/command/poll");
+        urlb.appendQuery("deviceGuids=" + guids);
+        if (!timestamp.empty())
+            urlb.appendQuery("timestamp=" + timestamp);
+        if (!names.empty())
+            urlb.appendQuery("names="+names);
+        if (0 <= wait_sec)
+            urlb.appendQuery("waitTimeout="+boost::lexical_cast<String>(wait_sec));
+
+        http::RequestPtr req = http::Request::GET(urlb.build());
+        req->addHeader("Auth-DeviceID", devices.front()->id)
+            .addHeader("Auth-DeviceKey", devices.front()->key)
+            .setVersion(m_http_major, m_http_minor);
+
+        HIVELOG_DEBUG(m_log, "poll commands for " << devices.size() << " devices");
+        http::Client::TaskPtr task = m_http->send(req, m_timeout_ms);
+        if (task)
+        {
+            task->callWhenDone(boost::bind(&This::onPollManyCommands,
+                shared_from_this(), task, devices, callback));
+            m_http_tasks.insert(task); // watch
+        }
+        return task;
+    }
+
+private:
+
+    /// @brief The "poll many commands" completion handler.
+    /**
+    @param[in] task The HTTP task.
+    @param[in] devices The devices to poll commands for.
+    @param[in] callback The callback functor.
+    */
+    void onPollManyCommands(http::Client::TaskPtr task, std::vector<DevicePtr> devices, PollManyCommandsCallback callback)
+    {
+        m_http_tasks.erase(task); // done
+        std::vector<DeviceCommand> commands;
+
+        ErrorCode err;
+        if (!task->errorCode && task->response && isNotSupportedStatus(task->response->getStatusCode()))
+        {
+            HIVELOG_WARN(m_log, "multi-device \"poll commands\" is not supported, HTTP status: "
+                << task->response->getStatusCode() << " " << task->response->getStatusPhrase());
+            err = boost::asio::error::operation_not_supported;
+        }
+        else
+            err = verifyTaskResponse(task, "poll many commands");
+
+        std::map<String, DevicePtr> guids;
+        for (size_t i = 0; i < devices.size(); ++i)
+            guids[devices[i]->id] = devices[i];
+
+        if (!err && m_lazyParams)
+        {
+            try
+            {
+                HIVELOG_DEBUG(m_log, "got \"poll many commands\" response: " << task->response->getContent());
+                IStringStream iss(task->response->getContent());
+
+                json::Parser::parseBegin(iss, '[');
+                for (bool first = true; json::Parser::parseNextElement(iss, first); )
+                {
+                    String guid;
+                    CommandPtr command;
+
+                    json::Parser::parseBegin(iss, '{');
+                    String name;
+                    for (bool firstMember = true; json::Parser::parseNextMember(iss, firstMember, name); )
+                    {
+                        if (name == "command")
+                        {
+                            command = Command::create();
+                            Serializer::parseLazy(iss, command);
+                        }
+                        else
+                        {
+                            json::Value jval;
+                            json::Parser::parse(iss, jval);
+                            if (name == "deviceGuid")
+                                guid = jval.asString();
+                        }
+                    }
+
+                    std::map<String, DevicePtr>::const_iterator it = guids.find(guid);
+                    if (it != guids.end() && command)
+                        commands.push_back(DeviceCommand(it->second, command));
+                    else
+                        HIVELOG_WARN(m_log, "command for unknown device \"" << guid << "\" ignored");
+                }
+            }
+            catch (std::exception const& ex)
+            {
+                HIVELOG_ERROR(m_log, "failed to parse \"poll many commands\" response: " << ex.what());
+                err = boost::asio::error::fault; // TODO: useful error code
+            }
+        }
+        else if (!err)
+        {
+            try
+            {
+                json::Value jval = json::fromStr(task->response->getContent());
+                HIVELOG_DEBUG(m_log, "got \"poll many commands\" response: " << json::toStrHH(jval));
+                if (jval.isArray())
+                {
+                    const size_t N = jval.size();
+                    commands.reserve(N);
+
+                    for (size_t i = 0; i < N; ++i)
+                    {
+                        json::Value &jitem = jval[i];
+                        const String guid = jitem.get("deviceGuid", json::Value::null()).asString();
+
+                        std::map<String, DevicePtr>::const_iterator it = guids.find(guid);
+                        if (it != guids.end())
+                        {
+                            CommandPtr command = Command::create();
+                            Serializer::moveFromJson(jitem["command"], command); // response is dropped anyway
+                            commands.push_back(DeviceCommand(it->second, command));
+                        }
+                        else
+                            HIVELOG_WARN(m_log, "command for unknown device \"" << guid << "\" ignored");
+                    }
+                }
+                else
+                    throw std::runtime_error("response is not an array");
+            }
+            catch (std::exception const& ex)
+            {
+                HIVELOG_ERROR(m_log, "failed to parse \"poll many commands\" response: " << ex.what());
+                err = boost::asio::error::fault; // TODO: useful error code
+            }
+        }
+
+        if (callback)
+            callback(err, devices, commands);
+    }
+
+
+    /// @brief Check for "not supported" HTTP status.
+    /**
+    Old servers have no multi-device endpoints.
+
+    Authentication errors (401, 403) are not treated as "not supported",
+    they are reported to the caller as usual errors.
+
+    @param[in] status The HTTP status code.
+    @return `true` if status means the endpoint is not supported.
+    */
+    static bool isNotSupportedStatus(int status)
+    {
+        switch (status)
+        {
+            case http::status::NOT_FOUND:
+            case http::status::METHOD_NOT_ALLOWED:
+            case http::status::NOT_IMPLEMENTED:
+                return true;
+
+            default:
+                return false;
+        }
+    }
+
 public:
 
     /// @brief The "update command" callback type.
@@ -709,7 +1014,7 @@ private:
             HIVELOG_WARN(m_log, "failed to get \"" << hint
                 << "\": HTTP status: " << task->response->getStatusCode()
                 << " " << task->response->getStatusPhrase());
-            err = boost::asio::error::fault; // TODO: useful error code
+            err = getStatusError(task->response->getStatusCode());
         }
 
         return err;
@@ -726,6 +1031,10 @@ private:
     hive::log::Logger m_log;        ///< @brief The logger.
     http::Url m_baseUrl;            ///< @brief The base URL.
     size_t m_timeout_ms;            ///< @brief The HTTP request timeout, milliseconds.
+    bool m_lazyParams;              ///< @brief Parse command parameters on first access.
+
+    Backoff m_backoff; ///< @brief The retry backoff.
+    boost::asio::deadline_timer m_retryTimer; ///< @brief The retry timer.
 };
 
 
@@ -752,8 +1061,105 @@ protected:
                    String const& name)
         : Base(httpClient, baseUrl, name)
         , m_callbacks(callbacks)
+        , m_autoReconnect(false)
+        , m_retryPending(false)
+        , m_pollWait_sec(-1)
     {}
 
+public:
+
+    /// @brief Enable automatic poll restore.
+    /**
+    If enabled, the failed command polls are not reported
+    but restarted after backoff delay (see getRetryBackoff()).
+    All failed polls are restarted at once since the last
+    received command timestamp.
+
+    @param[in] enabled The automatic reconnect flag.
+    @return Self reference.
+    */
+    This& setAutoReconnect(bool enabled)
+    {
+        m_autoReconnect = enabled;
+        return *this;
+    }
+
+
+    /// @brief Is automatic poll restore enabled?
+    /**
+    @return `true` if automatic reconnect is enabled.
+    */
+    bool isAutoReconnect() const
+    {
+        return m_autoReconnect;
+    }
+
+
+    /// @brief Set the command poll waiting timeout.
+    /**
+    The server holds the poll request up to this timeout
+    if there are no commands. Should be less than the HTTP
+    request timeout, see setTimeout(), otherwise empty polls
+    are finished by the client with "timed out" error.
+
+    @param[in] wait_sec Waiting timeout in seconds: [0,60]. -1 - server's default (30 seconds).
+    @return Self reference.
+    */
+    This& setPollWaitTimeout(int wait_sec)
+    {
+        m_pollWait_sec = wait_sec;
+        return *this;
+    }
+
+
+    /// @brief Get the command poll waiting timeout.
+    /**
+    @return The waiting timeout in seconds. -1 for server's default.
+    */
+    int getPollWaitTimeout() const
+    {
+        return m_pollWait_sec;
+    }
+
+public:
+
+    /// @brief Enable/disable multi-device command polling.
+    /**
+    If enabled, all subscribed devices share one long-poll request
+    instead of a long-poll request per device. If server doesn't support
+    multi-device polling the service automatically falls back to
+    per-device polling.
+
+    Only the first device credentials (Auth-DeviceID and Auth-DeviceKey)
+    are sent for the whole device set. If server refuses them for
+    the other devices (401 or 403 HTTP status) the service also
+    falls back to per-device polling, each device is authenticated
+    with its own key.
+
+    Poll errors are reported to each subscribed device via
+    IDeviceServiceEvents::onInsertCommand().
+
+    Should be called before any subscription.
+
+    @param[in] enabled The multi-device polling flag.
+    @return Self reference.
+    */
+    This& setMultiDevicePolling(bool enabled)
+    {
+        m_multiPoll.enabled = enabled;
+        return *this;
+    }
+
+
+    /// @brief Is multi-device command polling used?
+    /**
+    @return `true` if multi-device polling is enabled and supported by server.
+    */
+    bool isMultiDevicePolling() const
+    {
+        return m_multiPoll.enabled && m_multiPoll.supported;
+    }
+
 public:
 
     /// @brief The shared pointer type.
@@ -791,6 +1197,11 @@ public: // IDeviceService
     {
         Base::cancelAll();
         m_devices.clear();
+
+        m_multiPoll.task.reset();
+        m_multiPoll.seq += 1; // ignore the cancelled one
+        m_retryPending = false;
+        m_registrations.clear();
     }
 
 public:
@@ -840,6 +1251,88 @@ public:
     }
 
 
+    /// @copydoc IDeviceService::asyncRegisterDevices()
+    virtual void asyncRegisterDevices(std::vector<DevicePtr> const& devices)
+    {
+        for (size_t i = 0; i < devices.size(); ++i)
+            m_registrations.push(devices[i]);
+        startRegistrations();
+    }
+
+
+    /// @brief Set the bulk registration limit.
+    /**
+    The HTTP client reuses keep-alive connections,
+    so the limit is also the maximum number of connections used.
+
+    @param[in] limit The maximum number of registrations in flight. Zero for unlimited.
+    @return Self reference.
+    */
+    This& setRegistrationLimit(size_t limit)
+    {
+        m_registrations.setLimit(limit);
+        return *this;
+    }
+
+
+    /// @brief Take not started bulk registrations.
+    /**
+    The taken devices are removed from the queue and not reported.
+    Used to move registrations to another service, see HybridService.
+
+    @return The queued devices.
+    */
+    std::vector<DevicePtr> takePendingRegistrations()
+    {
+        return m_registrations.takePending();
+    }
+
+private:
+
+    /// @brief Start queued registrations.
+    /**
+    Sends registrations until the in-flight limit is reached.
+    The callbacks are bound to each request, so registrations
+    cancelled by cancelAll() are still reported.
+    */
+    void startRegistrations()
+    {
+        boost::shared_ptr<IDeviceServiceEvents> cb = m_callbacks.lock();
+        if (!cb)
+        {
+            assert(!"callback is dead or not initialized");
+            return;
+        }
+
+        while (DevicePtr device = m_registrations.pop())
+        {
+            Base::asyncRegisterDevice(device,
+                boost::bind(&This::onRegistrationDone,
+                    shared_from_this(), m_registrations.getGeneration(),
+                    cb, _1, _2));
+        }
+    }
+
+
+    /// @brief The bulk registration is finished.
+    /**
+    @param[in] generation The registration queue generation.
+    @param[in] cb The events handler.
+    @param[in] err The error code.
+    @param[in] device The registered device.
+    */
+    void onRegistrationDone(size_t generation, boost::shared_ptr<IDeviceServiceEvents> cb,
+                            ErrorCode err, DevicePtr device)
+    {
+        m_registrations.done(generation);
+        startRegistrations();
+
+        cb->onRegisterDevice(err, device);
+    }
+
+public:
+
+
     /// @copydoc IDeviceService::asyncGetDeviceData()
     virtual void asyncGetDeviceData(DevicePtr device)
     {
@@ -872,14 +1365,26 @@ public:
     /// @copydoc IDeviceService::asyncSubscribeForCommands()
     virtual void asyncSubscribeForCommands(DevicePtr device, String const& timestamp)
     {
-        if (m_devices.find(device) == m_devices.end())
+        if (!m_devices.findData(device))
         {
-            DeviceData &dd = m_devices[device];
+            // another device object with the same identifier
+            if (DevicePtr prev = m_devices.find(device->id))
+                asyncUnsubscribeFromCommands(prev);
+
+            DeviceData &dd = m_devices.insert(device);
             dd.lastCommandTimestamp = timestamp;
-            const String names;
-            int wait_sec = -1; // default one
-            dd.pollTask = Base::asyncPollCommands(device, dd.lastCommandTimestamp, names, wait_sec,
-                boost::bind(&This::onPollCommands, shared_from_this(), _1, _2, _3));
+            if (isMultiDevicePolling())
+            {
+                // the new device shouldn't get commands from the shared
+                // window of the other devices, so start it from the newest one
+                if (timestamp.empty())
+                    dd.lastCommandTimestamp = m_multiPoll.newestTimestamp;
+                else if (m_multiPoll.newestTimestamp < timestamp)
+                    m_multiPoll.newestTimestamp = timestamp;
+                scheduleMultiPoll();
+            }
+            else
+                startPoll(device);
         }
         // else // already subscribed, do nothing (TODO: maybe update timestamp?)
     }
@@ -888,19 +1393,35 @@ public:
     /// @copydoc IDeviceService::asyncUnsubscribeFromCommands()
     virtual void asyncUnsubscribeFromCommands(DevicePtr device)
     {
-        std::map<DevicePtr, DeviceData>::iterator it = m_devices.find(device);
-        if (it != m_devices.end())
+        if (DeviceData *dd = m_devices.findData(device))
         {
-            DeviceData &dd = it->second;
-            if (dd.pollTask)
-                dd.pollTask->cancel();
-            m_devices.erase(it);
+            if (dd->pollTask)
+                dd->pollTask->cancel();
+            m_devices.erase(device);
+
+            if (isMultiDevicePolling())
+                scheduleMultiPoll();
         }
         // else // not subscribed, do nothing
     }
 
 private:
 
+    /// @brief Start per-device polling.
+    /**
+    @param[in] device The subscribed device.
+    */
+    void startPoll(DevicePtr device)
+    {
+        if (DeviceData *dd = m_devices.findData(device))
+        {
+            const String names;
+            dd->pollTask = Base::asyncPollCommands(device, dd->lastCommandTimestamp, names, m_pollWait_sec,
+                boost::bind(&This::onPollCommands, shared_from_this(), _1, _2, _3));
+        }
+        // else // not subscribed, do nothing
+    }
+
     /// @brief The "poll commands" callback.
     /**
     @param[in] err The error code.
@@ -913,27 +1434,205 @@ private:
         {
             if (!err)
             {
-                DeviceData &dd = m_devices[device];
-
                 for (size_t i = 0; i < commands.size(); ++i)
                 {
+                    DeviceData *dd = m_devices.findData(device);
+                    if (!dd)
+                        break; // unsubscribed
+
+                    dd->lastCommandTimestamp = commands[i]->timestamp;
                     cb->onInsertCommand(err, device, commands[i]);
-                    dd.lastCommandTimestamp = commands[i]->timestamp;
                 }
 
                 // start polling again
-                const String names;
-                int wait_sec = -1; // default one
-                dd.pollTask = Base::asyncPollCommands(device, dd.lastCommandTimestamp, names, wait_sec,
-                    boost::bind(&This::onPollCommands, shared_from_this(), _1, _2, _3));
+                getRetryBackoff().reset();
+                startPoll(device);
+            }
+            else if (DeviceData *dd = m_devices.findData(device)) // don't report unsubscribed
+            {
+                if (m_autoReconnect && err != boost::asio::error::operation_aborted)
+                {
+                    dd->pollTask.reset(); // restarted by scheduleRetry()
+                    scheduleRetry();
+                }
+                else
+                    cb->onInsertCommand(err, device, CommandPtr());
+            }
+        }
+        else
+            assert(!"callback is dead or not initialized");
+    }
+
+private:
+
+    /// @brief Schedule the multi-device poll restart.
+    /**
+    The device set is changed, so the current multi-device poll should be restarted.
+    The restart is deferred, so a burst of subscriptions leads to only one request.
+    */
+    void scheduleMultiPoll()
+    {
+        if (!m_multiPoll.restartPending)
+        {
+            m_multiPoll.restartPending = true;
+            getHttpClient()->getIoService().post(
+                boost::bind(&This::startMultiPoll,
+                    shared_from_this()));
+        }
+    }
+
+
+    /// @brief Start (or restart) the multi-device poll.
+    /**
+    Uses the oldest known timestamp for the whole device set.
+    Commands already received are filtered out by the device's timestamp.
+    The devices subscribed without timestamp use the newest known
+    timestamp, see asyncSubscribeForCommands().
+    */
+    void startMultiPoll()
+    {
+        m_multiPoll.restartPending = false;
+        m_multiPoll.seq += 1;
+
+        if (m_multiPoll.task)
+        {
+            m_multiPoll.task->cancel();
+            m_multiPoll.task.reset();
+        }
+
+        if (m_devices.empty() || !isMultiDevicePolling())
+            return; // nothing to poll
+
+        const std::vector<DevicePtr> devices = m_devices.getDevices();
+        String timestamp;
+
+        for (size_t i = 0; i < devices.size(); ++i)
+        {
+            String const& ts = m_devices.findData(devices[i])->lastCommandTimestamp;
+            if (!ts.empty() && (timestamp.empty() || ts < timestamp))
+                timestamp = ts;
+        }
+
+        const String names;
+        m_multiPoll.task = Base::asyncPollCommands(devices, timestamp, names, m_pollWait_sec,
+            boost::bind(&This::onPollManyCommands, shared_from_this(),
+                m_multiPoll.seq, _1, _2, _3));
+    }
+
+
+    /// @brief The "poll many commands" callback.
+    /**
+    @param[in] seq The multi-device poll sequence number.
+    @param[in] err The error code.
+    @param[in] devices The polled devices.
+    @param[in] commands The list of commands.
+    */
+    void onPollManyCommands(size_t seq, ErrorCode err, std::vector<DevicePtr> devices, std::vector<DeviceCommand> commands)
+    {
+        if (seq != m_multiPoll.seq)
+            return; // restarted or cancelled, ignore
+        m_multiPoll.task.reset();
+
+        if (boost::shared_ptr<IDeviceServiceEvents> cb = m_callbacks.lock())
+        {
+            if (!err)
+            {
+                // timestamps before this response, to skip duplicates
+                std::map<DevicePtr, String> since;
+
+                for (size_t i = 0; i < commands.size(); ++i)
+                {
+                    DevicePtr device = commands[i].first;
+                    CommandPtr command = commands[i].second;
+
+                    DeviceData *dd = m_devices.findData(device);
+                    if (!dd)
+                        continue; // unsubscribed
+
+                    if (since.find(device) == since.end())
+                        since[device] = dd->lastCommandTimestamp;
+                    String const& ts = since[device];
+                    if (!ts.empty() && command->timestamp <= ts)
+                        continue; // already received
+
+                    dd->lastCommandTimestamp = command->timestamp;
+                    if (m_multiPoll.newestTimestamp < command->timestamp)
+                        m_multiPoll.newestTimestamp = command->timestamp;
+                    cb->onInsertCommand(err, device, command);
+                }
+
+                // start polling again
+                getRetryBackoff().reset();
+                if (seq == m_multiPoll.seq && !m_multiPoll.restartPending)
+                    startMultiPoll();
+            }
+            else if (err == boost::asio::error::operation_not_supported
+                  || err == boost::asio::error::access_denied)
+            {
+                // fall back to per-device polling, each device uses own credentials
+                m_multiPoll.supported = false;
+
+                const std::vector<DevicePtr> all = m_devices.getDevices();
+                for (size_t i = 0; i < all.size(); ++i)
+                    startPoll(all[i]);
+            }
+            else if (m_autoReconnect && err != boost::asio::error::operation_aborted)
+            {
+                // restarted by scheduleRetry()
+                scheduleRetry();
             }
             else
-                cb->onInsertCommand(err, device, CommandPtr());
+            {
+                // report error for each polled device still subscribed
+                for (size_t i = 0; i < devices.size(); ++i)
+                {
+                    if (m_devices.findData(devices[i]))
+                        cb->onInsertCommand(err, devices[i], CommandPtr());
+                }
+            }
         }
         else
             assert(!"callback is dead or not initialized");
     }
 
+private:
+
+    /// @brief Schedule restart of the failed polls.
+    /**
+    All polls failed during backoff delay are restarted together.
+    */
+    void scheduleRetry()
+    {
+        if (!m_retryPending)
+        {
+            m_retryPending = true;
+            Base::asyncRetry(boost::bind(&This::restartFailedPolls,
+                shared_from_this()));
+        }
+    }
+
+
+    /// @brief Restart all failed polls.
+    void restartFailedPolls()
+    {
+        m_retryPending = false;
+
+        if (isMultiDevicePolling())
+        {
+            if (!m_multiPoll.task && !m_multiPoll.restartPending)
+                startMultiPoll();
+        }
+        else
+        {
+            const std::vector<DevicePtr> devices = m_devices.getDevices();
+            for (size_t i = 0; i < devices.size(); ++i)
+            {
+                if (!m_devices.findData(devices[i])->pollTask)
+                    startPoll(devices[i]);
+            }
+        }
+    }
+
 public:
 
     /// @copydoc IDeviceService::asyncUpdateCommand()
@@ -976,7 +1675,36 @@ private:
         String lastCommandTimestamp;
     };
 
-    std::map<DevicePtr, DeviceData> m_devices;
+    DeviceRegistry<DeviceData> m_devices; ///< @brief The subscribed devices.
+    RegistrationQueue m_registrations;    ///< @brief The bulk registrations.
+
+private:
+
+    /// @brief Multi-device polling related data.
+    struct MultiPoll
+    {
+        bool enabled;           ///< @brief Multi-device polling is enabled.
+        bool supported;         ///< @brief Server supports multi-device polling.
+        bool restartPending;    ///< @brief Restart is scheduled.
+        size_t seq;             ///< @brief The current poll sequence number.
+        http::Client::TaskPtr task; ///< @brief The current poll task.
+        String newestTimestamp; ///< @brief The newest known command timestamp.
+
+        /// @brief The default constructor.
+        MultiPoll()
+            : enabled(false)
+            , supported(true)
+            , restartPending(false)
+            , seq(0)
+        {}
+    };
+
+    MultiPoll m_multiPoll;
+
+private:
+    bool m_autoReconnect; ///< @brief The automatic reconnect flag.
+    bool m_retryPending;  ///< @brief The failed polls restart is scheduled.
+    int m_pollWait_sec;   ///< @brief The command poll waiting timeout, seconds.
 };
 
 } // devicehive namespace
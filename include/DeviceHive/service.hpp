@@ -7,16 +7,23 @@
 
 #include <hive/defs.hpp>
 #include <hive/json.hpp>
+#include <hive/misc.hpp>
 #include <hive/log.hpp>
 
 #if !defined(HIVE_PCH)
 #   include <boost/algorithm/string.hpp>
 #   include <boost/lexical_cast.hpp>
 #   include <boost/shared_ptr.hpp>
+#   include <boost/unordered_map.hpp>
+#   include <boost/random/mersenne_twister.hpp>
+#   include <boost/random/uniform_int_distribution.hpp>
 #   include <boost/asio.hpp>
 #   include <fstream>
 #   include <sstream>
 #   include <iomanip>
+#   include <algorithm>
+#   include <cstdlib>
+#   include <deque>
 #   include <set>
 #endif // HIVE_PCH
 
@@ -306,6 +313,13 @@ public:
     String status; ///< @brief Command status.
     json::Value result; ///< @brief Command result.
 
+    /// @brief The raw JSON text of parameters, if not parsed yet.
+    /**
+    Filled instead of #params if the command is parsed lazily,
+    see Serializer::parseLazy(). Use getParams() to access parameters.
+    */
+    String rawParams;
+
 protected:
 
     /// @brief The default constructor.
@@ -341,6 +355,26 @@ public:
         pthis->params = params;
         return pthis;
     }
+
+public:
+
+    /// @brief Get the command parameters.
+    /**
+    Parses the raw parameters on first access.
+
+    @return The command parameters.
+    @throw json::error::SyntaxError if raw parameters are invalid.
+    */
+    json::Value const& getParams()
+    {
+        if (!rawParams.empty())
+        {
+            params = json::fromStr(rawParams);
+            rawParams.clear();
+        }
+
+        return params;
+    }
 };
 
 /// @brief The command shared pointer type.
@@ -359,6 +393,13 @@ public:
     String name; ///< @brief The notification name.
     json::Value params; ///< @brief The notification parameters.
 
+    /// @brief The raw JSON text of parameters, if not parsed yet.
+    /**
+    Filled instead of #params if the notification is parsed lazily,
+    see Serializer::parseLazy(). Use getParams() to access parameters.
+    */
+    String rawParams;
+
 protected:
 
     /// @brief The default constructor.
@@ -392,6 +433,26 @@ public:
         pthis->params = params;
         return pthis;
     }
+
+public:
+
+    /// @brief Get the notification parameters.
+    /**
+    Parses the raw parameters on first access.
+
+    @return The notification parameters.
+    @throw json::error::SyntaxError if raw parameters are invalid.
+    */
+    json::Value const& getParams()
+    {
+        if (!rawParams.empty())
+        {
+            params = json::fromStr(rawParams);
+            rawParams.clear();
+        }
+
+        return params;
+    }
 };
 
 /// @brief The notification shared pointer type.
@@ -420,6 +481,7 @@ public:
             notification->timestamp = jval["timestamp"].asString();
             notification->name = jval["notification"].asString();
             notification->params = jval["parameters"];
+            notification->rawParams.clear();
         }
         catch (std::exception const& ex)
         {
@@ -431,6 +493,46 @@ public:
     }
 
 
+    /// @brief Update a notification from the JSON value without copying parameters.
+    /**
+    The same as fromJson() but the parameters are moved out
+    of the JSON value instead of deep copy. Useful for large
+    server responses which are dropped after parsing.
+
+    @param[in,out] jval The JSON value to convert. The parameters are removed.
+    @param[in,out] notification The notification to update.
+    @throws std::runtime_error
+    */
+    static void moveFromJson(json::Value &jval, NotificationPtr notification)
+    {
+        json::Value params;
+        if (jval.isObject())
+            params.swap(jval["parameters"]);
+
+        fromJson(jval, notification);
+        notification->params.swap(params);
+    }
+
+
+    /// @brief Parse a notification keeping parameters unparsed.
+    /**
+    The parameters are kept as raw text and parsed on first access,
+    see Notification::getParams().
+
+    @param[in,out] is The input stream.
+    @param[in,out] notification The notification to update.
+    @throws std::runtime_error
+    */
+    static void parseLazy(IStream &is, NotificationPtr notification)
+    {
+        String rawParams;
+        json::Value jval = parseLazyObject(is, rawParams);
+
+        fromJson(jval, notification);
+        notification->rawParams.swap(rawParams);
+    }
+
+
     /// @brief Convert a notification to the JSON value.
     /**
     @param[in] notification The notification to convert.
@@ -443,7 +545,7 @@ public:
         if (!notification->timestamp.empty())
             jval["timestamp"] = notification->timestamp;
         jval["notification"] = notification->name;
-        jval["parameters"] = notification->params;
+        jval["parameters"] = notification->getParams();
         return jval;
     }
 
@@ -462,6 +564,7 @@ public:
             command->timestamp = jval["timestamp"].asString();
             command->name = jval["command"].asString();
             command->params = jval["parameters"];
+            command->rawParams.clear();
             command->lifetime = jval["lifetime"].asInt32();
             command->flags = jval["flags"].asInt32();
             command->status = jval["status"].asString();
@@ -477,6 +580,51 @@ public:
     }
 
 
+    /// @brief Update a command from the JSON value without copying parameters.
+    /**
+    The same as fromJson() but the parameters and the result are moved out
+    of the JSON value instead of deep copy. Useful for large poll responses
+    which are dropped after parsing.
+
+    @param[in,out] jval The JSON value to convert. The parameters and the result are removed.
+    @param[in,out] command The command to update.
+    @throws std::runtime_error
+    */
+    static void moveFromJson(json::Value &jval, CommandPtr command)
+    {
+        json::Value params, result;
+        if (jval.isObject())
+        {
+            params.swap(jval["parameters"]);
+            result.swap(jval["result"]);
+        }
+
+        fromJson(jval, command);
+        command->params.swap(params);
+        command->result.swap(result);
+    }
+
+
+    /// @brief Parse a command keeping parameters unparsed.
+    /**
+    The parameters are kept as raw text and parsed on first access,
+    see Command::getParams(). Useful if command handlers check the
+    command name only or forward parameters as is.
+
+    @param[in,out] is The input stream.
+    @param[in,out] command The command to update.
+    @throws std::runtime_error
+    */
+    static void parseLazy(IStream &is, CommandPtr command)
+    {
+        String rawParams;
+        json::Value jval = parseLazyObject(is, rawParams);
+
+        fromJson(jval, command);
+        command->rawParams.swap(rawParams);
+    }
+
+
     /// @brief Convert the command to the JSON value.
     /**
     @param[in] command The command to convert.
@@ -488,7 +636,7 @@ public:
         //jval["id"] = cmd.id;
         jval["timestamp"] = command->timestamp;
         jval["command"] = command->name;
-        jval["parameters"] = command->params;
+        jval["parameters"] = command->getParams();
         jval["lifetime"] = command->lifetime;
         jval["flags"] = command->flags;
         jval["status"] = command->status;
@@ -729,6 +877,489 @@ public:
             jval["data"] = device->data;
         return jval;
     }
+
+private:
+
+    /// @brief Parse an object keeping "parameters" unparsed.
+    /**
+    @param[in,out] is The input stream.
+    @param[out] rawParams The raw text of "parameters" member.
+    @return The object without "parameters" member.
+    @throws std::runtime_error
+    */
+    static json::Value parseLazyObject(IStream &is, String &rawParams)
+    {
+        json::Value jval(json::Value::TYPE_OBJECT);
+
+        json::Parser::parseBegin(is, '{');
+        String name;
+        for (bool first = true; json::Parser::parseNextMember(is, first, name); )
+        {
+            if (name == "parameters")
+                json::Parser::parseRaw(is, rawParams);
+            else
+                json::Parser::parse(is, jval[name]);
+        }
+
+        if (rawParams == "null")
+            rawParams.clear(); // nothing to parse
+
+        return jval;
+    }
+};
+
+
+/// @brief Check for the permanent request rejection.
+/**
+The server rejects the request payload: "Bad Request",
+"Request Entity Too Large" or "Unprocessable Entity",
+so the same request will be rejected again.
+
+The other 4xx status codes (for example "Unauthorized", "Forbidden"
+or "Not Found") may be caused by temporary authentication problems
+or by not registered device, so such requests should be retried.
+
+@param[in] status The HTTP status code or the websocket error code.
+@return `true` if the request is rejected permanently.
+*/
+inline bool isRejectedStatus(int status)
+{
+    return 400 == status || 413 == status || 422 == status;
+}
+
+
+/// @brief Check for the "request rejected" error.
+/**
+The services report permanently rejected requests (see isRejectedStatus())
+with `boost::asio::error::invalid_argument` error code.
+Such requests should not be sent again.
+
+@param[in] err The error code.
+@return `true` if the request is rejected permanently.
+*/
+inline bool isRejectedError(boost::system::error_code err)
+{
+    return err == boost::asio::error::invalid_argument;
+}
+
+
+/// @brief Get the error code of the failed request.
+/**
+The permanently rejected requests are reported with `invalid_argument`
+(see isRejectedError()), the authentication errors (401, 403) with
+`access_denied` and the "Not Found" status with `not_found`.
+The other statuses are reported with `fault`.
+
+@param[in] status The HTTP status code or the websocket error code.
+@return The corresponding error code.
+*/
+inline boost::system::error_code getStatusError(int status)
+{
+    if (isRejectedStatus(status))
+        return boost::asio::error::invalid_argument;
+
+    switch (status)
+    {
+        case 401: case 403:
+            return boost::asio::error::access_denied;
+
+        case 404:
+            return boost::asio::error::not_found;
+
+        default:
+            return boost::asio::error::fault; // TODO: useful error code
+    }
+}
+
+
+/// @brief Check for the "request refused" error.
+/**
+The server is available but refuses the request (see getStatusError()),
+so such error doesn't mean the server is down.
+
+@param[in] err The error code.
+@return `true` if the request is refused by the server.
+*/
+inline bool isRefusedError(boost::system::error_code err)
+{
+    return isRejectedError(err)
+        || err == boost::asio::error::access_denied
+        || err == boost::asio::error::not_found;
+}
+
+
+/// @brief The reconnect backoff.
+/**
+Calculates jittered exponential delays between reconnect attempts.
+The base delay is doubled with each attempt up to the maximum delay.
+The actual delay is random in range [base/2, base], so many clients
+disconnected at the same time don't reconnect all together.
+Each instance has its own random generator seeded by misc::random_seed().
+
+Call reset() when connection is restored.
+*/
+class Backoff
+{
+public:
+
+    /// @brief The main constructor.
+    /**
+    @param[in] initial_ms The initial delay, milliseconds.
+    @param[in] max_ms The maximum delay, milliseconds.
+    */
+    explicit Backoff(size_t initial_ms = 1000, size_t max_ms = 60000)
+        : m_initial_ms(initial_ms)
+        , m_max_ms(max_ms)
+        , m_attempt(0)
+        , m_rgen(misc::random_seed(this))
+    {}
+
+public:
+
+    /// @brief Get the next delay.
+    /**
+    Also increments the attempt counter.
+
+    @return The delay before the next attempt, milliseconds.
+    */
+    size_t next()
+    {
+        size_t base = m_initial_ms;
+        for (size_t i = 0; i < m_attempt && base < m_max_ms; ++i)
+            base *= 2;
+        base = std::min(base, m_max_ms);
+
+        m_attempt += 1;
+        boost::random::uniform_int_distribution<size_t> jitter(base/2, base);
+        return jitter(m_rgen);
+    }
+
+
+    /// @brief Reset the attempt counter.
+    void reset()
+    {
+        m_attempt = 0;
+    }
+
+
+    /// @brief Get the number of attempts.
+    /**
+    @return The number of attempts since the last reset.
+    */
+    size_t getAttempt() const
+    {
+        return m_attempt;
+    }
+
+public:
+
+    /// @brief Set the delays.
+    /**
+    @param[in] initial_ms The initial delay, milliseconds.
+    @param[in] max_ms The maximum delay, milliseconds.
+    @return Self reference.
+    */
+    Backoff& setDelays(size_t initial_ms, size_t max_ms)
+    {
+        m_initial_ms = initial_ms;
+        m_max_ms = max_ms;
+        return *this;
+    }
+
+private:
+    size_t m_initial_ms; ///< @brief The initial delay, milliseconds.
+    size_t m_max_ms;     ///< @brief The maximum delay, milliseconds.
+    size_t m_attempt;    ///< @brief The current attempt.
+    boost::random::mt19937 m_rgen; ///< @brief The jitter generator.
+};
+
+
+/// @brief The device registry.
+/**
+Keeps devices and custom per-device data hashed by device identifier (GUID),
+so incoming commands are routed to devices without linear search.
+
+Only one device per identifier is kept: inserting another device object
+with the same identifier replaces the previous one (custom data is kept).
+
+Use getDevices() to iterate over a snapshot if the registry might be
+changed during iteration (for example, from user callbacks).
+*/
+template<typename DataT>
+class DeviceRegistry
+{
+public:
+
+    /// @brief The custom data type.
+    typedef DataT Data;
+
+public:
+
+    /// @brief Add device.
+    /**
+    @param[in] device The device to add.
+    @return The device data reference.
+    */
+    Data& insert(DevicePtr device)
+    {
+        Item &item = m_items[device->id];
+        item.device = device;
+        return item.data;
+    }
+
+
+    /// @brief Remove device.
+    /**
+    Does nothing if registry contains another device with the same identifier.
+
+    @param[in] device The device to remove.
+    @return `true` if device was removed.
+    */
+    bool erase(DevicePtr device)
+    {
+        typename Container::iterator it = m_items.find(device->id);
+        if (it != m_items.end() && it->second.device == device)
+        {
+            m_items.erase(it);
+            return true;
+        }
+
+        return false;
+    }
+
+
+    /// @brief Remove all devices.
+    void clear()
+    {
+        m_items.clear();
+    }
+
+public:
+
+    /// @brief Find device by identifier.
+    /**
+    @param[in] id The device identifier.
+    @return The device or NULL.
+    */
+    DevicePtr find(String const& id) const
+    {
+        typename Container::const_iterator it = m_items.find(id);
+        return (it != m_items.end()) ? it->second.device : DevicePtr();
+    }
+
+
+    /// @brief Find device data.
+    /**
+    @param[in] device The device.
+    @return The device data or NULL if device is not registered.
+    */
+    Data* findData(DevicePtr device)
+    {
+        typename Container::iterator it = m_items.find(device->id);
+        return (it != m_items.end() && it->second.device == device) ? &it->second.data : 0;
+    }
+
+
+    /// @brief Get all devices.
+    /**
+    @return The snapshot of all registered devices.
+    */
+    std::vector<DevicePtr> getDevices() const
+    {
+        std::vector<DevicePtr> devices;
+        devices.reserve(m_items.size());
+
+        typename Container::const_iterator i = m_items.begin();
+        typename Container::const_iterator const e = m_items.end();
+        for (; i != e; ++i)
+            devices.push_back(i->second.device);
+
+        return devices;
+    }
+
+public:
+
+    /// @brief Get the number of devices.
+    /**
+    @return The number of registered devices.
+    */
+    size_t size() const
+    {
+        return m_items.size();
+    }
+
+
+    /// @brief Is registry empty?
+    /**
+    @return `true` if there are no registered devices.
+    */
+    bool empty() const
+    {
+        return m_items.empty();
+    }
+
+private:
+
+    /// @brief The registry item.
+    struct Item
+    {
+        DevicePtr device;   ///< @brief The device.
+        Data data;          ///< @brief The custom data.
+    };
+
+    /// @brief The container type.
+    typedef boost::unordered_map<String, Item> Container;
+    Container m_items; ///< @brief The registry items.
+};
+
+
+/// @brief The device registration queue.
+/**
+Limits the number of device registrations in flight.
+Services use it to pipeline a bulk registration: the next device
+is taken from the queue as soon as any previous registration is finished.
+
+Each registration is started within the current generation, see getGeneration().
+The clear() method starts a new generation, so completions of
+the cancelled registrations don't affect the in-flight counter.
+*/
+class RegistrationQueue
+{
+public:
+
+    /// @brief The main constructor.
+    /**
+    @param[in] limit The maximum number of registrations in flight.
+    */
+    explicit RegistrationQueue(size_t limit = 16)
+        : m_limit(limit)
+        , m_inFlight(0)
+        , m_generation(0)
+    {}
+
+public:
+
+    /// @brief Add device to the queue.
+    /**
+    @param[in] device The device to register.
+    */
+    void push(DevicePtr device)
+    {
+        m_pending.push_back(device);
+    }
+
+
+    /// @brief Start the next registration.
+    /**
+    @return The next device to register or NULL if the queue is empty
+        or the in-flight limit is reached.
+    */
+    DevicePtr pop()
+    {
+        if (m_pending.empty() || (0 < m_limit && m_limit <= m_inFlight))
+            return DevicePtr();
+
+        DevicePtr device = m_pending.front();
+        m_pending.pop_front();
+        m_inFlight += 1;
+        return device;
+    }
+
+
+    /// @brief Finish the registration.
+    /**
+    Registrations started before the last clear() are ignored.
+
+    @param[in] generation The generation the registration was started within.
+    */
+    void done(size_t generation)
+    {
+        if (generation == m_generation && 0 < m_inFlight)
+            m_inFlight -= 1;
+    }
+
+
+    /// @brief Forget all registrations.
+    /**
+    Starts a new generation.
+    */
+    void clear()
+    {
+        m_pending.clear();
+        m_inFlight = 0;
+        m_generation += 1;
+    }
+
+
+    /// @brief Take all not started registrations.
+    /**
+    The registrations in flight are not affected.
+
+    @return The devices removed from the queue.
+    */
+    std::vector<DevicePtr> takePending()
+    {
+        std::vector<DevicePtr> devices(m_pending.begin(), m_pending.end());
+        m_pending.clear();
+        return devices;
+    }
+
+
+    /// @brief Get the current generation.
+    /**
+    @return The generation to pass to done().
+    */
+    size_t getGeneration() const
+    {
+        return m_generation;
+    }
+
+public:
+
+    /// @brief Get the in-flight limit.
+    /**
+    @return The maximum number of registrations in flight. Zero for unlimited.
+    */
+    size_t getLimit() const
+    {
+        return m_limit;
+    }
+
+
+    /// @brief Set the in-flight limit.
+    /**
+    @param[in] limit The maximum number of registrations in flight. Zero for unlimited.
+    */
+    void setLimit(size_t limit)
+    {
+        m_limit = limit;
+    }
+
+
+    /// @brief Get the number of registrations in flight.
+    /**
+    @return The number of started but not finished registrations.
+    */
+    size_t getInFlight() const
+    {
+        return m_inFlight;
+    }
+
+
+    /// @brief Get the number of queued registrations.
+    /**
+    @return The number of not started registrations.
+    */
+    size_t getPending() const
+    {
+        return m_pending.size();
+    }
+
+private:
+    std::deque<DevicePtr> m_pending; ///< @brief The devices to register.
+    size_t m_limit;     ///< @brief The maximum number of registrations in flight.
+    size_t m_inFlight;  ///< @brief The number of registrations in flight.
+    size_t m_generation; ///< @brief The current generation.
 };
 
 
@@ -891,6 +1522,16 @@ public:
     virtual void asyncRegisterDevice(DevicePtr device) = 0;
 
 
+    /// @brief Register the devices asynchronously.
+    /**
+    Registrations are pipelined with a limited number of requests
+    in flight. Each device is reported via IDeviceServiceEvents::onRegisterDevice().
+
+    @param[in] devices The devices to register.
+    */
+    virtual void asyncRegisterDevices(std::vector<DevicePtr> const& devices) = 0;
+
+
     /// @brief Get the device data asynchronously.
     /**
     @param[in] device The device to get data for.
@@ -9,6 +9,11 @@
 
 #include <hive/ws13.hpp>
 
+#if !defined(HIVE_PCH)
+#   include <boost/unordered_map.hpp>
+#   include <map>
+#endif // HIVE_PCH
+
 namespace devicehive
 {
 
@@ -36,6 +41,7 @@ protected:
         , m_log("/devicehive/websocket/" + name)
         , m_baseUrl(baseUrl)
         , m_timeout_ms(60000)
+        , m_reconnectTimer(m_ios)
         , m_pingPong(m_ios)
     {}
 
@@ -128,6 +134,7 @@ public:
     {
         // TODO: cancel only related requests
         m_http->cancelAll();
+        m_reconnectTimer.cancel();
 
         close();
     }
@@ -182,6 +189,55 @@ public:
         }
     }
 
+public:
+
+    /// @brief Get the reconnect backoff.
+    /**
+    @return The reconnect backoff reference.
+    */
+    Backoff& getReconnectBackoff()
+    {
+        return m_backoff;
+    }
+
+
+    /// @brief Make connection after backoff delay.
+    /**
+    Closes the current connection if any and starts the reconnect timer.
+    The delay grows with each attempt until getReconnectBackoff().reset()
+    is called.
+
+    The callback is not called if the reconnect is cancelled by cancelAll().
+
+    @param[in] callback The callback functor.
+    */
+    void asyncReconnect(ConnectedCallback callback)
+    {
+        close(true);
+
+        const size_t delay_ms = m_backoff.next();
+        HIVELOG_INFO(m_log, "reconnect attempt #" << m_backoff.getAttempt()
+            << " in " << delay_ms << " ms");
+
+        m_reconnectTimer.expires_from_now(boost::posix_time::milliseconds(delay_ms));
+        m_reconnectTimer.async_wait(boost::bind(&This::onReconnectTimer,
+            shared_from_this(), boost::asio::placeholders::error, callback));
+    }
+
+private:
+
+    /// @brief The reconnect timer handler.
+    /**
+    @param[in] err The error code.
+    @param[in] callback The callback functor.
+    */
+    void onReconnectTimer(ErrorCode err, ConnectedCallback callback)
+    {
+        if (!err)
+            asyncConnect(callback);
+        // else cancelled
+    }
+
 private:
 
     /// @brief The "connected" callback.
@@ -224,6 +280,9 @@ public:
 
     /// @brief Send an action.
     /**
+    If there is no connection (for example, reconnect is in progress)
+    the callback is called with `boost::asio::error::not_connected` error code.
+
     @param[in] jaction The JSON action.
     @param[in] callback The callback functor.
     */
@@ -237,7 +296,11 @@ public:
                 boost::bind(&This::onMessageSent, shared_from_this(), _1, _2, jaction, callback));
         }
         else
-            assert(!"no connection");
+        {
+            HIVELOG_WARN(m_log, "no connection, JSON action is not sent: " << json::toStrHH(jaction));
+            if (callback)
+                m_ios.post(boost::bind(callback, boost::asio::error::not_connected, jaction));
+        }
     }
 
 private:
@@ -447,6 +510,9 @@ private:
     http::Url m_baseUrl;            ///< @brief The base URL.
     size_t m_timeout_ms;            ///< @brief The HTTP request timeout, milliseconds.
 
+    Backoff m_backoff; ///< @brief The reconnect backoff.
+    boost::asio::deadline_timer m_reconnectTimer; ///< @brief The reconnect timer.
+
 private: // Ping/Pong
 
     /// @brief Ping/Pong related fields.
@@ -482,6 +548,7 @@ class WebsocketService:
 {
     typedef WebsocketServiceBase Base; ///< @brief The base class.
     typedef WebsocketService This; ///< @brief The type alias.
+    typedef boost::function1<void, ErrorCode> ActionCallback; ///< @brief The action callback type.
 
 protected:
 
@@ -499,7 +566,22 @@ protected:
         : Base(httpClient, baseUrl, name)
         , m_callbacks(callbacks)
         , m_requestId(0)
-    {}
+        , m_actionTimer(httpClient->getIoService())
+        , m_actionTimerStarted(false)
+        , m_actionsTimedOut(0)
+        , m_autoReconnect(false)
+        , m_reconnecting(false)
+        , m_connectReported(false)
+    {
+        m_handlers["server/info"] = &This::handleServerInfo;
+        m_handlers["device/save"] = &This::handleStatus; // "register device" or "update device data" response
+        m_handlers["device/get"] = &This::handleDeviceGet;
+        m_handlers["command/update"] = &This::handleStatus;
+        m_handlers["command/subscribe"] = &This::handleStatus;
+        m_handlers["command/unsubscribe"] = &This::handleStatus;
+        m_handlers["command/insert"] = &This::handleCommandInsert;
+        m_handlers["notification/insert"] = &This::handleStatus;
+    }
 
 public:
 
@@ -539,6 +621,78 @@ public: // IDeviceService
         Base::cancelAll();
         m_devices.clear();
         m_actions.clear();
+        m_deadlines.clear();
+        m_actionTimer.cancel();
+        m_actionTimerStarted = false;
+        m_reconnecting = false;
+        m_connectReported = false;
+        m_registrations.clear();
+    }
+
+public:
+
+    /// @brief Enable automatic reconnect.
+    /**
+    If enabled, the lost connection is restored after backoff delay
+    (see getReconnectBackoff()). All pending actions are finished with
+    the connection error. Once connected again, all subscribed devices are
+    re-subscribed in one burst since the last received command timestamp.
+
+    The reconnect is not visible to the application: once the connection
+    is reported via IDeviceServiceEvents::onConnected(), neither lost
+    connection nor restored session is reported again. The actions
+    requested while reconnect is in progress are finished with
+    `boost::asio::error::not_connected` error, see isReconnecting().
+    The initial connection errors are still reported.
+
+    @param[in] enabled The automatic reconnect flag.
+    @return Self reference.
+    */
+    This& setAutoReconnect(bool enabled)
+    {
+        m_autoReconnect = enabled;
+        return *this;
+    }
+
+
+    /// @brief Is automatic reconnect enabled?
+    /**
+    @return `true` if automatic reconnect is enabled.
+    */
+    bool isAutoReconnect() const
+    {
+        return m_autoReconnect;
+    }
+
+
+    /// @brief Is reconnect in progress?
+    /**
+    @return `true` if connection is lost and will be restored automatically.
+    */
+    bool isReconnecting() const
+    {
+        return m_reconnecting;
+    }
+
+public:
+
+    /// @brief Get the number of outstanding actions.
+    /**
+    @return The number of actions waiting for response.
+    */
+    size_t getOutstandingActionCount() const
+    {
+        return m_actions.size();
+    }
+
+
+    /// @brief Get the number of timed out actions.
+    /**
+    @return The total number of actions finished by timeout.
+    */
+    size_t getTimedOutActionCount() const
+    {
+        return m_actionsTimedOut;
     }
 
 public:
@@ -563,7 +717,8 @@ public:
             jaction["action"] = "server/info";
             jaction["requestId"] = reqId;
 
-            // no action tracking
+            // success is reported by handleServerInfo()
+            trackAction(reqId, boost::bind(&This::onServerInfoFailed, cb, _1));
 
             Base::asyncSendAction(jaction,
                 boost::bind(&This::onActionSent,
@@ -580,26 +735,40 @@ public:
     {
         if (boost::shared_ptr<IDeviceServiceEvents> cb = m_callbacks.lock())
         {
-            const UInt64 reqId = m_requestId++;
-
-            json::Value jaction;
-            jaction["action"] = "device/save";
-            jaction["requestId"] = reqId;
-            jaction["deviceId"] = device->id;
-            jaction["deviceKey"] = device->key;
-            jaction["device"] = Serializer::toJson(device);
-
-            m_actions[reqId] = boost::bind(&IDeviceServiceEvents::onRegisterDevice, cb, _1, device);
-
-            Base::asyncSendAction(jaction,
-                boost::bind(&This::onActionSent,
-                    shared_from_this(), _1, _2));
+            sendRegisterDevice(device,
+                boost::bind(&IDeviceServiceEvents::onRegisterDevice,
+                    cb, _1, device));
         }
         else
             assert(!"callback is dead or not initialized");
     }
 
 
+    /// @copydoc IDeviceService::asyncRegisterDevices()
+    /**
+    The queued registrations are kept while connection is lost
+    and continued once connected again.
+    */
+    virtual void asyncRegisterDevices(std::vector<DevicePtr> const& devices)
+    {
+        for (size_t i = 0; i < devices.size(); ++i)
+            m_registrations.push(devices[i]);
+        startRegistrations();
+    }
+
+
+    /// @brief Set the bulk registration limit.
+    /**
+    @param[in] limit The maximum number of registrations in flight. Zero for unlimited.
+    @return Self reference.
+    */
+    This& setRegistrationLimit(size_t limit)
+    {
+        m_registrations.setLimit(limit);
+        return *this;
+    }
+
+
     /// @copydoc IDeviceService::asyncGetDeviceData()
     virtual void asyncGetDeviceData(DevicePtr device)
     {
@@ -613,7 +782,7 @@ public:
             jaction["deviceId"] = device->id;
             jaction["deviceKey"] = device->key;
 
-            m_actions[reqId] = boost::bind(&IDeviceServiceEvents::onGetDeviceData, cb, _1, device);
+            trackAction(reqId, boost::bind(&IDeviceServiceEvents::onGetDeviceData, cb, _1, device));
             m_devices.insert(device); // to be able to update device data
 
             Base::asyncSendAction(jaction,
@@ -639,7 +808,7 @@ public:
             jaction["deviceKey"] = device->key;
             jaction["device"]["data"] = device->data;
 
-            m_actions[reqId] = boost::bind(&IDeviceServiceEvents::onUpdateDeviceData, cb, _1, device);
+            trackAction(reqId, boost::bind(&IDeviceServiceEvents::onUpdateDeviceData, cb, _1, device));
 
             Base::asyncSendAction(jaction,
                 boost::bind(&This::onActionSent,
@@ -657,23 +826,17 @@ public:
     {
         if (boost::shared_ptr<IDeviceServiceEvents> cb = m_callbacks.lock())
         {
-            const UInt64 reqId = m_requestId++;
-
-            json::Value jaction;
-            jaction["action"] = "command/subscribe";
-            jaction["requestId"] = reqId;
-            jaction["deviceId"] = device->id;
-            jaction["deviceKey"] = device->key;
-            if (!timestamp.empty())
-                jaction["timestamp"] = timestamp;
-
-            // no action tracking yet
-
-            Base::asyncSendAction(jaction,
-                boost::bind(&This::onActionSent,
-                    shared_from_this(), _1, _2));
+            DeviceData &data = m_devices.insert(device);
+            if (data.resumed)
+            {
+                // already re-subscribed after reconnect and not
+                // acknowledged yet, keep the last command timestamp
+                return;
+            }
 
-            m_devices.insert(device);
+            data.lastCommandTimestamp = timestamp;
+            data.subscribed = true;
+            sendSubscribe(device, timestamp);
         }
         else
             assert(!"callback is dead or not initialized");
@@ -725,7 +888,7 @@ public:
             jaction["command"]["result"] = command->result;
             jaction["command"]["flags"] = command->flags;
 
-            m_actions[reqId] = boost::bind(&IDeviceServiceEvents::onUpdateCommand, cb, _1, device, command);
+            trackAction(reqId, boost::bind(&IDeviceServiceEvents::onUpdateCommand, cb, _1, device, command));
 
             Base::asyncSendAction(jaction,
                 boost::bind(&This::onActionSent,
@@ -751,7 +914,7 @@ public:
             jaction["deviceKey"] = device->key;
             jaction["notification"] = Serializer::toJson(notification);
 
-            m_actions[reqId] = boost::bind(&IDeviceServiceEvents::onInsertNotification, cb, _1, device, notification);
+            trackAction(reqId, boost::bind(&IDeviceServiceEvents::onInsertNotification, cb, _1, device, notification));
 
             Base::asyncSendAction(jaction,
                 boost::bind(&This::onActionSent,
@@ -774,10 +937,30 @@ private:
             Base::listenForActions(
                 boost::bind(&This::onActionReceived,
                     shared_from_this(), _1, _2));
+
+            if (m_reconnecting)
+            {
+                m_reconnecting = false;
+                resubscribeAll();
+            }
+
+            startRegistrations();
+        }
+        else if (m_autoReconnect)
+        {
+            m_reconnecting = true;
+            Base::asyncReconnect(
+                boost::bind(&This::onConnected,
+                    shared_from_this(), _1));
         }
 
+        if (m_autoReconnect && m_connectReported)
+            return; // the session is restored silently
+
         if (boost::shared_ptr<IDeviceServiceEvents> cb = m_callbacks.lock())
         {
+            if (!err)
+                m_connectReported = true;
             cb->onConnected(err);
         }
         else
@@ -809,68 +992,31 @@ private:
     {
         if (!err)
         {
-            const String action = jaction["action"].asString();
+            const String action = boost::to_lower_copy(jaction["action"].asString());
 
-            if (boost::iequals(action, "server/info"))
-            {
-                if (!boost::iequals(jaction["status"].asString(), "success"))
-                    err = boost::asio::error::fault; // TODO: useful error code
-                else if (boost::shared_ptr<IDeviceServiceEvents> cb = m_callbacks.lock())
-                {
-                    const json::Value jinfo = jaction["info"];
-
-                    ServerInfo info;
-                    info.api_version = jinfo["apiVersion"].asString();
-                    info.timestamp = jinfo["serverTimestamp"].asString();
-                    info.alternativeUrl = jinfo["restServerUrl"].asString();
-
-                    cb->onServerInfo(err, info);
-                }
-            }
+            HandlerMap::const_iterator h = m_handlers.find(action);
+            if (h != m_handlers.end())
+                (this->*(h->second))(err, jaction);
+            // else unknown action, ignored
 
-            else if (boost::iequals(action, "device/save"))  // got "register device" or "update device data" response
-            {
-                if (!boost::iequals(jaction["status"].asString(), "success"))
-                    err = boost::asio::error::fault; // TODO: useful error code
-            }
-
-            else if (boost::iequals(action, "device/get"))  // got "get device data" response
-            {
-                if (!boost::iequals(jaction["status"].asString(), "success"))
-                    err = boost::asio::error::fault; // TODO: useful error code
-                else
-                {
-                    // update device's data
-                    json::Value const& jdev = jaction["device"];
-                    if (DevicePtr device = findDeviceById(jdev["id"].asString()))
-                        Serializer::fromJson(jdev, device);
-                }
-            }
-
-            else if (boost::iequals(action, "command/update")
-                  || boost::iequals(action, "command/subscribe")
-                  || boost::iequals(action, "command/unsubscribe"))
-            {
-                if (!boost::iequals(jaction["status"].asString(), "success"))
-                    err = boost::asio::error::fault; // TODO: useful error code
-            }
-
-            else if (boost::iequals(action, "command/insert"))
-            {
-                if (DevicePtr device = findDeviceById(jaction["deviceGuid"].asString()))
-                    if (boost::shared_ptr<IDeviceServiceEvents> cb = m_callbacks.lock())
-                {
-                    CommandPtr command = Command::create();
-                    Serializer::fromJson(jaction["command"], command);
-                    cb->onInsertCommand(err, device, command);
-                }
-            }
+            // the session is alive
+            getReconnectBackoff().reset();
         }
         else
         {
-            // report errors via 'onConnected' event!?
-            if (boost::shared_ptr<IDeviceServiceEvents> cb = m_callbacks.lock())
+            if (m_autoReconnect)
+            {
+                m_reconnecting = true;
+                Base::asyncReconnect(
+                    boost::bind(&This::onConnected,
+                        shared_from_this(), _1));
+
+                // no response is expected on the lost connection
+                failAllActions(err);
+            }
+            else if (boost::shared_ptr<IDeviceServiceEvents> cb = m_callbacks.lock())
             {
+                // report errors via 'onConnected' event!?
                 cb->onConnected(err);
             }
         }
@@ -892,39 +1038,377 @@ private:
         std::map<UInt64, ActionCallback>::iterator it = m_actions.find(reqId);
         if (it != m_actions.end())
         {
-            it->second(err); // callback
+            ActionCallback callback = it->second;
             m_actions.erase(it);
+            callback(err);
+        }
+    }
+
+private: // registration
+
+    /// @brief Send the "device/save" action.
+    /**
+    @param[in] device The device to register.
+    @param[in] callback The callback functor.
+    */
+    void sendRegisterDevice(DevicePtr device, ActionCallback callback)
+    {
+        const UInt64 reqId = m_requestId++;
+
+        json::Value jaction;
+        jaction["action"] = "device/save";
+        jaction["requestId"] = reqId;
+        jaction["deviceId"] = device->id;
+        jaction["deviceKey"] = device->key;
+        jaction["device"] = Serializer::toJson(device);
+
+        trackAction(reqId, callback);
+
+        Base::asyncSendAction(jaction,
+            boost::bind(&This::onActionSent,
+                shared_from_this(), _1, _2));
+    }
+
+
+    /// @brief Start queued registrations.
+    /**
+    Sends registrations until the in-flight limit is reached.
+    */
+    void startRegistrations()
+    {
+        if (!Base::isOpen())
+            return; // continued once connected
+
+        while (DevicePtr device = m_registrations.pop())
+        {
+            sendRegisterDevice(device,
+                boost::bind(&This::onRegistrationDone,
+                    shared_from_this(), m_registrations.getGeneration(), _1, device));
+        }
+    }
+
+
+    /// @brief The bulk registration is finished.
+    /**
+    @param[in] generation The registration queue generation.
+    @param[in] err The error code.
+    @param[in] device The registered device.
+    */
+    void onRegistrationDone(size_t generation, ErrorCode err, DevicePtr device)
+    {
+        m_registrations.done(generation);
+        startRegistrations();
+
+        if (boost::shared_ptr<IDeviceServiceEvents> cb = m_callbacks.lock())
+            cb->onRegisterDevice(err, device);
+    }
+
+private: // session resumption
+
+    /// @brief Send the "command/subscribe" action.
+    /**
+    @param[in] device The device.
+    @param[in] timestamp The timestamp of the last received command.
+    @return The request identifier.
+    */
+    UInt64 sendSubscribe(DevicePtr device, String const& timestamp)
+    {
+        const UInt64 reqId = m_requestId++;
+
+        json::Value jaction;
+        jaction["action"] = "command/subscribe";
+        jaction["requestId"] = reqId;
+        jaction["deviceId"] = device->id;
+        jaction["deviceKey"] = device->key;
+        if (!timestamp.empty())
+            jaction["timestamp"] = timestamp;
+
+        // no action tracking yet
+
+        Base::asyncSendAction(jaction,
+            boost::bind(&This::onActionSent,
+                shared_from_this(), _1, _2));
+        return reqId;
+    }
+
+
+    /// @brief Re-subscribe all subscribed devices.
+    /**
+    All "command/subscribe" actions are sent at once without waiting
+    for responses. The subscription continues from the last received command,
+    so no commands are lost while connection was broken.
+
+    Until the resumed subscription is acknowledged, explicit subscriptions
+    of the same device are ignored, see onResubscribed().
+    */
+    void resubscribeAll()
+    {
+        const std::vector<DevicePtr> devices = m_devices.getDevices();
+        for (size_t i = 0; i < devices.size(); ++i)
+        {
+            DeviceData *data = m_devices.findData(devices[i]);
+            if (data && data->subscribed)
+            {
+                const UInt64 reqId = sendSubscribe(devices[i], data->lastCommandTimestamp);
+                trackAction(reqId, boost::bind(&This::onResubscribed,
+                    shared_from_this(), devices[i], reqId, _1));
+                data->resumed = true;
+                data->resumeRequestId = reqId;
+            }
+        }
+    }
+
+
+    /// @brief The resumed subscription is finished.
+    /**
+    The next explicit subscription is not ignored anymore.
+
+    @param[in] device The device.
+    @param[in] reqId The resumed subscription request identifier.
+    @param[in] err The error code.
+    */
+    void onResubscribed(DevicePtr device, UInt64 reqId, ErrorCode err)
+    {
+        HIVE_UNUSED(err); // the next explicit subscription is sent anyway
+
+        DeviceData *data = m_devices.findData(device);
+        if (data && data->resumed && data->resumeRequestId == reqId)
+            data->resumed = false;
+    }
+
+
+    /// @brief Finish all pending actions.
+    /**
+    @param[in] err The error code.
+    */
+    void failAllActions(ErrorCode err)
+    {
+        std::map<UInt64, ActionCallback> actions;
+        actions.swap(m_actions);
+        m_deadlines.clear();
+        m_actionTimer.cancel();
+        m_actionTimerStarted = false;
+
+        // callbacks may start new actions
+        std::map<UInt64, ActionCallback>::iterator it = actions.begin();
+        for (; it != actions.end(); ++it)
+            it->second(err);
+    }
+
+private: // action handlers
+
+    /// @brief Check the action status.
+    /**
+    @param[in,out] err The error code.
+    @param[in] jaction The received action.
+    */
+    void handleStatus(ErrorCode &err, json::Value const& jaction)
+    {
+        if (!boost::iequals(jaction["status"].asString(), "success"))
+        {
+            json::Value const& jcode = jaction["code"];
+            if (jcode.isConvertibleToInteger())
+                err = getStatusError(int(jcode.asInt()));
+            else
+                err = boost::asio::error::fault; // TODO: useful error code
+        }
+    }
+
+
+    /// @brief Handle the "server/info" response.
+    /**
+    @param[in,out] err The error code.
+    @param[in] jaction The received action.
+    */
+    void handleServerInfo(ErrorCode &err, json::Value const& jaction)
+    {
+        handleStatus(err, jaction);
+        if (!err)
+        {
+            if (boost::shared_ptr<IDeviceServiceEvents> cb = m_callbacks.lock())
+            {
+                json::Value const& jinfo = jaction["info"];
+
+                ServerInfo info;
+                info.api_version = jinfo["apiVersion"].asString();
+                info.timestamp = jinfo["serverTimestamp"].asString();
+                info.alternativeUrl = jinfo["restServerUrl"].asString();
+
+                cb->onServerInfo(err, info);
+            }
         }
     }
 
 
-    /// @brief Find device by UUID.
+    /// @brief Handle the "device/get" response.
+    /**
+    @param[in,out] err The error code.
+    @param[in] jaction The received action.
+    */
+    void handleDeviceGet(ErrorCode &err, json::Value const& jaction)
+    {
+        handleStatus(err, jaction);
+        if (!err)
+        {
+            // update device's data
+            json::Value const& jdev = jaction["device"];
+            if (DevicePtr device = m_devices.find(jdev["id"].asString()))
+                Serializer::fromJson(jdev, device);
+        }
+    }
+
+
+    /// @brief Handle the "command/insert" action.
+    /**
+    @param[in,out] err The error code.
+    @param[in] jaction The received action.
+    */
+    void handleCommandInsert(ErrorCode &err, json::Value const& jaction)
+    {
+        if (DevicePtr device = m_devices.find(jaction["deviceGuid"].asString()))
+            if (boost::shared_ptr<IDeviceServiceEvents> cb = m_callbacks.lock())
+        {
+            CommandPtr command = Command::create();
+            Serializer::fromJson(jaction["command"], command);
+            m_devices.findData(device)->lastCommandTimestamp = command->timestamp;
+            cb->onInsertCommand(err, device, command);
+        }
+    }
+
+
+    /// @brief Report "server/info" error.
+    /**
+    Successful response is reported by handleServerInfo().
+
+    @param[in] cb The events handler.
+    @param[in] err The error code.
+    */
+    static void onServerInfoFailed(boost::shared_ptr<IDeviceServiceEvents> cb, ErrorCode err)
+    {
+        if (err)
+            cb->onServerInfo(err, ServerInfo());
+    }
+
+private: // action deadlines
+
+    /// @brief Start tracking the action.
     /**
-    @param[in] id The device identifer.
-    @return The device or NULL.
+    Each action keeps its own deadline, so the timeout may be changed
+    while actions are in flight. Deadlines are ordered by time
+    and only one timer is used for the earliest deadline.
+
+    @param[in] reqId The request identifier.
+    @param[in] callback The callback functor.
     */
-    DevicePtr findDeviceById(String const& id) const
+    void trackAction(UInt64 reqId, ActionCallback callback)
+    {
+        m_actions[reqId] = callback;
+
+        const boost::posix_time::ptime deadline = boost::asio::deadline_timer::traits_type::now()
+            + boost::posix_time::milliseconds(getTimeout());
+        const DeadlineMap::iterator it = m_deadlines.insert(std::make_pair(deadline, reqId));
+
+        // the timer is restarted for the new earliest deadline
+        if (!m_actionTimerStarted || it == m_deadlines.begin())
+            startActionTimer();
+    }
+
+
+    /// @brief Start the action timer for the earliest deadline.
+    void startActionTimer()
     {
-        std::set<DevicePtr>::const_iterator i = m_devices.begin();
-        std::set<DevicePtr>::const_iterator e = m_devices.end();
-        for (; i != e; ++i)
+        m_actionTimerStarted = true;
+        m_actionTimer.expires_at(m_deadlines.begin()->first);
+        m_actionTimer.async_wait(boost::bind(&This::onActionTimer,
+            shared_from_this(), boost::asio::placeholders::error));
+    }
+
+
+    /// @brief The action timer handler.
+    /**
+    Finishes all expired actions with `timed_out` error.
+
+    @param[in] err The error code.
+    */
+    void onActionTimer(ErrorCode err)
+    {
+        if (err == boost::asio::error::operation_aborted)
+            return; // cancelled or restarted
+        m_actionTimerStarted = false;
+
+        const boost::posix_time::ptime now = boost::asio::deadline_timer::traits_type::now();
+        while (!m_deadlines.empty() && m_deadlines.begin()->first <= now)
         {
-            DevicePtr device = *i;
-            if (device->id == id)
-                return device;
+            const UInt64 reqId = m_deadlines.begin()->second;
+            m_deadlines.erase(m_deadlines.begin());
+
+            std::map<UInt64, ActionCallback>::iterator it = m_actions.find(reqId);
+            if (it != m_actions.end()) // still waiting
+            {
+                m_actionsTimedOut += 1;
+
+                ActionCallback callback = it->second;
+                m_actions.erase(it);
+                callback(boost::asio::error::timed_out);
+            }
         }
 
-        return DevicePtr(); // not found
+        // skip already finished actions
+        while (!m_deadlines.empty() && m_actions.find(m_deadlines.begin()->second) == m_actions.end())
+            m_deadlines.erase(m_deadlines.begin());
+
+        if (!m_deadlines.empty() && !m_actionTimerStarted)
+            startActionTimer();
     }
 
+
 private:
     boost::weak_ptr<IDeviceServiceEvents> m_callbacks;
-    std::set<DevicePtr> m_devices;
 
 private:
-    typedef boost::function1<void, ErrorCode> ActionCallback;
+
+    /// @brief Device related data.
+    struct DeviceData
+    {
+        String lastCommandTimestamp; ///< @brief The timestamp of the last received command.
+        bool subscribed; ///< @brief The device is subscribed for commands.
+        bool resumed;    ///< @brief The subscription is restored after reconnect, not acknowledged yet.
+        UInt64 resumeRequestId; ///< @brief The resumed subscription request identifier.
+
+        /// @brief The default constructor.
+        DeviceData()
+            : subscribed(false)
+            , resumed(false)
+            , resumeRequestId(0)
+        {}
+    };
+
+    DeviceRegistry<DeviceData> m_devices; ///< @brief The known devices.
+    RegistrationQueue m_registrations;    ///< @brief The bulk registrations.
+
+private:
     std::map<UInt64, ActionCallback> m_actions;
     UInt64 m_requestId;
+
+    /// @brief The action deadlines type: request identifiers ordered by deadline.
+    typedef std::multimap<boost::posix_time::ptime, UInt64> DeadlineMap;
+    DeadlineMap m_deadlines; ///< @brief The action deadlines.
+    boost::asio::deadline_timer m_actionTimer; ///< @brief The action deadline timer.
+    bool m_actionTimerStarted; ///< @brief The action timer is started.
+    size_t m_actionsTimedOut; ///< @brief The number of timed out actions.
+
+private:
+    bool m_autoReconnect; ///< @brief The automatic reconnect flag.
+    bool m_reconnecting;  ///< @brief The reconnect is in progress.
+    bool m_connectReported; ///< @brief The connection is reported to the application.
+
+private:
+    /// @brief The action handler type.
+    typedef void (This::*ActionHandler)(ErrorCode&, json::Value const&);
+
+    /// @brief The action handlers by action name.
+    typedef boost::unordered_map<String, ActionHandler> HandlerMap;
+    HandlerMap m_handlers;
 };
 
 } // devicehive namespace
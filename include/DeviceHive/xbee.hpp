@@ -6,13 +6,18 @@
 #define __DEVICEHIVE_XBEE_HPP_
 
 #include <hive/bin.hpp>
+#include <hive/pool.hpp>
 
 #if !defined(HIVE_PCH)
 #   include <boost/enable_shared_from_this.hpp>
 #   include <boost/shared_ptr.hpp>
 #   include <boost/asio.hpp>
 #   include <boost/bind.hpp>
+#   include <algorithm>
+#   include <cstring>
 #   include <vector>
+#   include <deque>
+#   include <map>
 #endif // HIVE_PCH
 
 
@@ -41,6 +46,11 @@ There are a few payloads:
     - ZBTransmitRequest
     - ZBTransmitStatus
     - ZBReceivePacket
+
+The received payloads may also be accessed via views (see getView()):
+    - ATCommandResponseView
+    - ZBTransmitStatusView
+    - ZBReceivePacketView
 */
 class Frame:
     public bin::FrameContent
@@ -52,6 +62,9 @@ public:
     {
         SIGNATURE = 0x7E, ///< @brief The signature byte.
         ESCAPE    = 0x7D, ///< @brief The escape byte.
+        XON       = 0x11, ///< @brief The XON byte, escaped in API mode 2.
+        XOFF      = 0x13, ///< @brief The XOFF byte, escaped in API mode 2.
+        ESCAPE_XOR = 0x20, ///< @brief The escaped byte mask.
 
         SIGNATURE_LEN = 1, ///< @brief The signature field length in bytes.
         LENGTH_LEN    = 2, ///< @brief The length field length in bytes.
@@ -85,6 +98,13 @@ public: // common payloads
         class ZBTransmitStatus;
         class ZBReceivePacket;
 
+public: // payload views
+
+    class PayloadView;
+        class ATCommandResponseView;
+        class ZBTransmitStatusView;
+        class ZBReceivePacketView;
+
 protected:
 
     /// @brief The default constructor.
@@ -109,12 +129,13 @@ public:
     template<typename PayloadT>
     static SharedPtr create(PayloadT const& payload)
     {
-        OStringStream oss;
-        bin::OStream bs(oss);
-        payload.format(bs);
-
         SharedPtr pthis(new Frame());
-        pthis->init(oss.str());
+        pthis->m_content.reserve(HEADER_LEN + 64 + FOOTER_LEN);
+        pthis->m_content.resize(HEADER_LEN); // will be updated later
+
+        bin::BufferOStream<Content> bs(pthis->m_content);
+        payload.format(bs); // (!) directly to the frame content
+        pthis->finish();
         return pthis;
     }
 
@@ -123,6 +144,8 @@ public:
     /// @brief Parse the payload from the frame.
     /**
     The provided argument should support the `parse()` method.
+    The payload is parsed directly from the frame content,
+    truncated payloads are rejected.
 
     @param[out] payload The frame data payload to parse.
     @return `true` if data payload successfully parsed.
@@ -132,14 +155,33 @@ public:
     {
         if (HEADER_LEN+FOOTER_LEN <= m_content.size())
         {
-            const String pdata(
-                m_content.begin()+HEADER_LEN, // skip signature and length
-                m_content.end()-FOOTER_LEN);  // skip checksum
-            IStringStream iss(pdata);
-            bin::IStream bs(iss);
-            return payload.parse(bs);
+            bin::SpanIStream bs(&m_content[HEADER_LEN], // skip signature and length
+                m_content.size() - HEADER_LEN - FOOTER_LEN); // skip checksum
+            return payload.parse(bs) && !bs.fail();
+        }
+
+        return false; // empty
+    }
+
+
+    /// @brief Get the payload view.
+    /**
+    The view refers to the frame content, no data is copied.
+    The frame should be alive while the view is used.
+
+    @param[out] view The payload view to assign.
+    @return `true` if payload type and size are valid.
+    */
+    template<typename ViewT>
+    bool getView(ViewT & view) const
+    {
+        if (HEADER_LEN+FOOTER_LEN <= m_content.size())
+        {
+            return view.assign(&m_content[HEADER_LEN], // skip signature and length
+                m_content.size() - HEADER_LEN - FOOTER_LEN); // skip checksum
         }
 
+        view = ViewT();
         return false; // empty
     }
 
@@ -267,30 +309,22 @@ protected:
     }
 
 
-    /// @brief Initialize frame content from payload data.
+    /// @brief Finish the frame content.
     /**
-    @param[in] payload The frame payload data.
+    The payload should be already placed after the header.
+    Updates the header and appends the checksum.
     */
-    void init(String const& payload)
+    void finish()
     {
-        const size_t len = payload.size();
+        const size_t len = m_content.size() - HEADER_LEN;
         assert(len <= 64*1024 && "frame data payload too big");
 
-        m_content.reserve(HEADER_LEN+len+FOOTER_LEN);
-
-        // header (signature+length)
-        m_content.push_back(SIGNATURE);
-        m_content.push_back((len>>8)&0xFF); // length, MSB
-        m_content.push_back((len)&0xFF);    // length, LSB
-
-        // payload
-        m_content.insert(m_content.end(),
-            payload.begin(), payload.end());
-
-        // checksum
-        m_content.push_back(
-            checksum(payload.begin(),
-                payload.end()));
+        m_content[0] = SIGNATURE;
+        m_content[1] = UInt8((len>>8)&0xFF); // length, MSB
+        m_content[2] = UInt8((len)&0xFF);    // length, LSB
+        m_content.push_back(checksum(
+            m_content.begin() + HEADER_LEN,
+            m_content.end()));
     }
 };
 
@@ -312,7 +346,8 @@ public:
     /**
     @param[in,out] bs The output binary stream.
     */
-    void format(bin::OStream & bs) const
+    template<typename OStreamT>
+    void format(OStreamT & bs) const
     {
         HIVE_UNUSED(bs);
     }
@@ -323,7 +358,8 @@ public:
     @param[in,out] bs The input binary stream.
     @return `true` if successfully parsed.
     */
-    bool parse(bin::IStream & bs)
+    template<typename IStreamT>
+    bool parse(IStreamT & bs)
     {
         HIVE_UNUSED(bs);
         return true;
@@ -351,6 +387,22 @@ protected:
         }
         return data;
     }
+
+
+    /// @brief Get all remaining data.
+    /**
+    This method reads the data till the end of memory block.
+
+    @param[in,out] bs The input binary stream.
+    @return The parsed data.
+    */
+    static String getAll(bin::SpanIStream & bs)
+    {
+        String data(bs.getRemaining(), '\0');
+        if (!data.empty())
+            bs.getBuffer(&data[0], data.size());
+        return data;
+    }
 };
 
 
@@ -385,7 +437,8 @@ public:
     /**
     @param[in,out] bs The output binary stream.
     */
-    void format(bin::OStream & bs) const
+    template<typename OStreamT>
+    void format(OStreamT & bs) const
     {
         bs.putUInt8(Frame::ATCOMMAND_REQUEST);
         bs.putUInt8(frameId);
@@ -399,7 +452,8 @@ public:
     @param[in,out] bs The input binary stream.
     @return `true` if successfully parsed.
     */
-    bool parse(bin::IStream & bs)
+    template<typename IStreamT>
+    bool parse(IStreamT & bs)
     {
         if (bs.getUInt8() != Frame::ATCOMMAND_REQUEST)
             return false; // bad frame type
@@ -416,6 +470,18 @@ public:
 class Frame::ATCommandResponse:
     public Frame::Payload
 {
+public:
+
+    /// @brief The command status codes.
+    enum Status
+    {
+        STATUS_OK                = 0, ///< @brief OK.
+        STATUS_ERROR             = 1, ///< @brief Error.
+        STATUS_INVALID_COMMAND   = 2, ///< @brief Invalid command.
+        STATUS_INVALID_PARAMETER = 3, ///< @brief Invalid parameter.
+        STATUS_TX_FAILURE        = 4  ///< @brief Remote command transmission failed.
+    };
+
 public:
     UInt8 frameId; ///< @brief The frame identifier.
     String command; ///< @brief The AT command.
@@ -436,7 +502,8 @@ public:
     /**
     @param[in,out] bs The output binary stream.
     */
-    void format(bin::OStream & bs) const
+    template<typename OStreamT>
+    void format(OStreamT & bs) const
     {
         bs.putUInt8(Frame::ATCOMMAND_RESPONSE);
         bs.putUInt8(frameId);
@@ -453,7 +520,8 @@ public:
     @param[in,out] bs The input binary stream.
     @return `true` if successfully parsed.
     */
-    bool parse(bin::IStream & bs)
+    template<typename IStreamT>
+    bool parse(IStreamT & bs)
     {
         if (bs.getUInt8() != Frame::ATCOMMAND_RESPONSE)
             return false; // bad frame type
@@ -476,13 +544,32 @@ public:
 class Frame::ZBTransmitRequest:
     public Frame::Payload
 {
+public:
+
+    /// @brief The special addresses.
+    enum Address
+    {
+        BROADCAST_ADDRESS64 = 0xFFFF, ///< @brief The broadcast MAC address.
+        UNKNOWN_ADDRESS16   = 0xFFFE, ///< @brief The unknown network address, XBee discovers it.
+        MAX_ADDRESS16       = 0xFFF7  ///< @brief The maximum valid network address.
+    };
+
 public:
     UInt8 frameId; ///< @brief The frame identifier.
     UInt64 dstAddr64; ///< @brief The destination address (64 bits).
     UInt16 dstAddr16; ///< @brief The destination network address (16 bits).
     UInt8 bcastRadius; ///< @brief The broadcast radius.
     UInt8 options; ///< @brief The transmision options.
-    String data; ///< @brief The data to send.
+    String data; ///< @brief The data to send, if there is no source.
+
+    /// @brief The shared data source.
+    /**
+    If not NULL the slice of the source content is sent
+    instead of #data. The source is not copied.
+    */
+    boost::shared_ptr<bin::FrameContent const> source;
+    size_t sourceOffset; ///< @brief The slice offset in the source content.
+    size_t sourceLength; ///< @brief The slice length in bytes.
 
 public:
 
@@ -492,10 +579,37 @@ public:
           dstAddr64(0),
           dstAddr16(0),
           bcastRadius(0),
-          options(0)
+          options(0),
+          sourceOffset(0),
+          sourceLength(0)
     {}
 
 
+    /// @brief Construct the request from a slice of shared content.
+    /**
+    @param[in] source_ The shared data source.
+    @param[in] offset_ The slice offset in bytes.
+    @param[in] length_ The slice length in bytes.
+    @param[in] frameId_ The frame identifier.
+    @param[in] dstAddr64_ The destination address (64 bits).
+    @param[in] dstAddr16_ The destination network address (16 bits).
+    */
+    ZBTransmitRequest(boost::shared_ptr<bin::FrameContent const> source_,
+        size_t offset_, size_t length_, UInt8 frameId_,
+        UInt64 dstAddr64_, UInt16 dstAddr16_)
+        : frameId(frameId_),
+          dstAddr64(dstAddr64_),
+          dstAddr16(dstAddr16_),
+          bcastRadius(0),
+          options(0),
+          source(source_),
+          sourceOffset(offset_),
+          sourceLength(length_)
+    {
+        assert(source && offset_+length_ <= source->size() && "slice out of range");
+    }
+
+
     /// @brief The main constructor.
     /**
     @param[in] data_ The data to send.
@@ -513,16 +627,36 @@ public:
           dstAddr16(dstAddr16_),
           bcastRadius(bcastRadius_),
           options(options_),
-          data(data_)
+          data(data_),
+          sourceOffset(0),
+          sourceLength(0)
     {}
 
+public:
+
+    /// @brief Get the data to send.
+    /**
+    @return The copy of the source slice or #data.
+    */
+    String getData() const
+    {
+        if (source && 0 < sourceLength)
+        {
+            const UInt8 *p = &source->getContent()[sourceOffset];
+            return String(p, p + sourceLength);
+        }
+
+        return source ? String() : data;
+    }
+
 public:
 
     /// @brief Format the ZigBee Transmit Request payload.
     /**
     @param[in,out] bs The output binary stream.
     */
-    void format(bin::OStream & bs) const
+    template<typename OStreamT>
+    void format(OStreamT & bs) const
     {
         bs.putUInt8(Frame::ZB_TRANSMIT_REQUEST);
         bs.putUInt8(frameId);
@@ -530,8 +664,15 @@ public:
         bs.putUInt16BE(dstAddr16);
         bs.putUInt8(bcastRadius);
         bs.putUInt8(options);
-        bs.putBuffer(data.data(),
-            data.size());
+        if (source)
+        {
+            if (0 < sourceLength)
+                bs.putBuffer(&source->getContent()[sourceOffset],
+                    sourceLength);
+        }
+        else
+            bs.putBuffer(data.data(),
+                data.size());
     }
 
 
@@ -540,7 +681,8 @@ public:
     @param[in,out] bs The input binary stream.
     @return `true` if successfully parsed.
     */
-    bool parse(bin::IStream & bs)
+    template<typename IStreamT>
+    bool parse(IStreamT & bs)
     {
         if (bs.getUInt8() != Frame::ZB_TRANSMIT_REQUEST)
             return false;
@@ -551,6 +693,9 @@ public:
         bcastRadius = bs.getUInt8();
         options = bs.getUInt8();
         data = getAll(bs);
+        source.reset();
+        sourceOffset = 0;
+        sourceLength = 0;
 
         return true;
     }
@@ -561,6 +706,32 @@ public:
 class Frame::ZBTransmitStatus:
     public Frame::Payload
 {
+public:
+
+    /// @brief The delivery status codes.
+    enum Delivery
+    {
+        DELIVERY_SUCCESS             = 0x00, ///< @brief Success.
+        DELIVERY_MAC_ACK_FAILURE     = 0x01, ///< @brief MAC ACK failure.
+        DELIVERY_CCA_FAILURE         = 0x02, ///< @brief CCA failure.
+        DELIVERY_INVALID_ENDPOINT    = 0x15, ///< @brief Invalid destination endpoint.
+        DELIVERY_NETWORK_ACK_FAILURE = 0x21, ///< @brief Network ACK failure.
+        DELIVERY_NOT_JOINED          = 0x22, ///< @brief Not joined to network.
+        DELIVERY_SELF_ADDRESSED      = 0x23, ///< @brief Self-addressed.
+        DELIVERY_ADDRESS_NOT_FOUND   = 0x24, ///< @brief Address not found.
+        DELIVERY_ROUTE_NOT_FOUND     = 0x25, ///< @brief Route not found.
+        DELIVERY_RESOURCE_ERROR      = 0x32, ///< @brief Resource error, lack of free buffers.
+        DELIVERY_PAYLOAD_TOO_LARGE   = 0x74  ///< @brief Data payload too large.
+    };
+
+    /// @brief The discovery status flags.
+    enum Discovery
+    {
+        DISCOVERY_NONE    = 0x00, ///< @brief No discovery overhead.
+        DISCOVERY_ADDRESS = 0x01, ///< @brief Address discovery.
+        DISCOVERY_ROUTE   = 0x02  ///< @brief Route discovery.
+    };
+
 public:
     UInt8 frameId; ///< @brief The frame identifier.
     UInt16 dstAddr16; ///< @brief The destination network address (16 bits).
@@ -585,7 +756,8 @@ public:
     /**
     @param[in,out] bs The output binary stream.
     */
-    void format(bin::OStream & bs) const
+    template<typename OStreamT>
+    void format(OStreamT & bs) const
     {
         bs.putUInt8(Frame::ZB_TRANSMIT_STATUS);
         bs.putUInt8(frameId);
@@ -601,7 +773,8 @@ public:
     @param[in,out] bs The input binary stream.
     @return `true` if successfully parsed.
     */
-    bool parse(bin::IStream & bs)
+    template<typename IStreamT>
+    bool parse(IStreamT & bs)
     {
         if (bs.getUInt8() != Frame::ZB_TRANSMIT_STATUS)
             return false;
@@ -642,7 +815,8 @@ public:
     /**
     @param[in,out] bs The output binary stream.
     */
-    void format(bin::OStream & bs) const
+    template<typename OStreamT>
+    void format(OStreamT & bs) const
     {
         bs.putUInt8(Frame::ZB_RECEIVE_PACKET);
         bs.putUInt64BE(srcAddr64);
@@ -658,7 +832,8 @@ public:
     @param[in,out] bs The input binary stream.
     @return `true` if successfully parsed.
     */
-    bool parse(bin::IStream & bs)
+    template<typename IStreamT>
+    bool parse(IStreamT & bs)
     {
         if (bs.getUInt8() != Frame::ZB_RECEIVE_PACKET)
             return false;
@@ -675,202 +850,2107 @@ public:
 #endif // payloads
 
 
-/// @brief The XBee debug interface.
-class Debug
+#if 1 // payload views
+
+/// @brief The payload view.
+/**
+Refers to the payload memory block, all fields are read
+from fixed offsets. The payload type and minimum size are
+checked once when view is assigned.
+*/
+class Frame::PayloadView
 {
 public:
 
-    /// @brief Dump the AT command request to string.
+    /// @brief The default constructor.
     /**
-    @param[in] payload The payload to dump.
-    @return The dump information.
+    Constructs the empty (invalid) view.
     */
-    static String dump(Frame::ATCommandRequest const& payload)
-    {
-        OStringStream oss;
+    PayloadView()
+        : m_data(0)
+        , m_size(0)
+    {}
 
-        oss << "frameId=" << int(payload.frameId) << " "
-            "command=\"" << payload.command << "\"";
+public:
 
-        return oss.str();
+    /// @brief Check the view is valid.
+    /**
+    @return `true` if view is assigned.
+    */
+    bool isValid() const
+    {
+        return 0 != m_data;
     }
 
 
-    /// @brief Dump the AT command response to string.
+    /// @brief Get the payload size.
     /**
-    @param[in] payload The payload to dump.
-    @return The dump information.
+    @return The payload size in bytes, including frame type.
     */
-    static String dump(Frame::ATCommandResponse const& payload)
+    size_t getSize() const
     {
-        OStringStream oss;
+        return m_size;
+    }
 
-        oss << "frameId=" << int(payload.frameId)
-            << " command=\"" << payload.command << "\""
-            << " status=" << dump::hex(payload.status)
-            << " result=[" << dump::hex(payload.result) << "]";
+protected:
 
-        return oss.str();
+    /// @brief Assign the payload memory block.
+    /**
+    @param[in] data The payload data.
+    @param[in] len The payload length in bytes.
+    @param[in] type The expected frame type.
+    @param[in] minSize The minimum payload size in bytes.
+    @return `true` if payload type and size are valid.
+    */
+    bool reset(const UInt8 *data, size_t len, int type, size_t minSize)
+    {
+        if (minSize <= len && 0 < len && data[0] == type)
+        {
+            m_data = data;
+            m_size = len;
+            return true;
+        }
+
+        m_data = 0;
+        m_size = 0;
+        return false;
     }
 
 
-    /// @brief Dump the ZB transmit request to string.
+    /// @brief Get the 8-bits field.
     /**
-    @param[in] payload The payload to dump.
-    @return The dump information.
+    @param[in] offset The field offset.
+    @return The field value.
     */
-    static String dump(Frame::ZBTransmitRequest const& payload)
+    UInt8 getUInt8(size_t offset) const
     {
-        OStringStream oss;
+        return m_data[offset];
+    }
 
-        oss << "frameId=" << int(payload.frameId)
-            << " DA64=" << dump::hex(payload.dstAddr64)
-            << " DA16=" << dump::hex(payload.dstAddr16)
-            << " bcastRadius=" << int(payload.bcastRadius)
-            << " options=" << dump::hex(payload.options)
-            << " data=[" << dump::hex(payload.data)
-            << "] (ascii:\"" << dump::ascii(payload.data) << "\")";
 
-        return oss.str();
+    /// @brief Get the 16-bits big-endian field.
+    /**
+    @param[in] offset The field offset.
+    @return The field value.
+    */
+    UInt16 getUInt16BE(size_t offset) const
+    {
+        UInt16 val;
+        memcpy(&val, m_data + offset, sizeof(val));
+        return misc::be2h_16(val);
     }
 
 
-    /// @brief Dump the ZB transmit status to string.
+    /// @brief Get the 64-bits big-endian field.
     /**
-    @param[in] payload The payload to dump.
-    @return The dump information.
+    @param[in] offset The field offset.
+    @return The field value.
     */
-    static String dump(Frame::ZBTransmitStatus const& payload)
+    UInt64 getUInt64BE(size_t offset) const
     {
-        OStringStream oss;
+        UInt64 val;
+        memcpy(&val, m_data + offset, sizeof(val));
+        return misc::be2h_64(val);
+    }
 
-        oss << "frameId=" << int(payload.frameId)
-            << " DA16=" << dump::hex(payload.dstAddr16)
-            << " retryCount=" << int(payload.retryCount)
-            << " delivery=" << dump::hex(payload.deliveryStatus)
-            << " discovery=" << dump::hex(payload.discoveryStatus);
+protected:
+    const UInt8 *m_data; ///< @brief The payload data.
+    size_t m_size; ///< @brief The payload size in bytes.
+};
 
-        return oss.str();
-    }
 
+/// @brief The AT command response payload view.
+/**
+@see Frame::ATCommandResponse
+*/
+class Frame::ATCommandResponseView:
+    public Frame::PayloadView
+{
+    /// @brief The field offsets.
+    enum Offset
+    {
+        FRAME_ID = 1,
+        COMMAND  = 2,
+        STATUS   = 4,
+        RESULT   = 5
+    };
 
-    /// @brief Dump the ZB receive packet to string.
+public:
+
+    /// @brief Assign the payload memory block.
     /**
-    @param[in] payload The payload to dump.
-    @return The dump information.
+    @param[in] data The payload data.
+    @param[in] len The payload length in bytes.
+    @return `true` if payload type and size are valid.
     */
-    static String dump(Frame::ZBReceivePacket const& payload)
+    bool assign(const UInt8 *data, size_t len)
     {
-        OStringStream oss;
+        return reset(data, len, Frame::ATCOMMAND_RESPONSE, RESULT);
+    }
 
-        oss << "SA64=" << dump::hex(payload.srcAddr64)
-            << " SA16=" << dump::hex(payload.srcAddr16)
-            << " options=" << dump::hex(payload.options)
-            << " data=[" << dump::hex(payload.data)
-            << "] (ascii:\"" << dump::ascii(payload.data) << "\")";
+public:
 
-        return oss.str();
+    /// @brief Get the frame identifier.
+    UInt8 getFrameId() const
+    {
+        return getUInt8(FRAME_ID);
     }
 
-public:
 
-    /// @brief Dump the frame to string.
+    /// @brief Get the AT command.
     /**
-    @param[in] frame The frame to dump.
-    @return The dump information.
+    @return The two characters command (not null-terminated).
     */
-    static String dump(Frame::SharedPtr frame)
+    const char* getCommand() const
     {
-        OStringStream oss;
+        return reinterpret_cast<const char*>(m_data + COMMAND);
+    }
 
-        if (frame)
-        switch (frame->getIntent())
-        {
-            case Frame::ATCOMMAND_REQUEST:      tdump<Frame::ATCommandRequest>(oss, frame, "ATCOMMAND_REQUEST");    break;
-            case Frame::ATCOMMAND_RESPONSE:     tdump<Frame::ATCommandResponse>(oss, frame, "ATCOMMAND_RESPONSE");  break;
-            case Frame::ZB_TRANSMIT_REQUEST:    tdump<Frame::ZBTransmitRequest>(oss, frame, "ZB_TRANSMIT_REQUEST"); break;
-            case Frame::ZB_TRANSMIT_STATUS:     tdump<Frame::ZBTransmitStatus>(oss, frame, "ZB_TRANSMIT_STATUS");   break;
-            case Frame::ZB_RECEIVE_PACKET:      tdump<Frame::ZBReceivePacket>(oss, frame, "ZB_RECEIVE_PACKET");     break;
 
-            default:
-                oss << "unknown frame type: " << frame->getIntent();
-                break;
-        }
+    /// @brief Get the command status.
+    UInt8 getStatus() const
+    {
+        return getUInt8(STATUS);
+    }
 
-        return oss.str();
+
+    /// @brief Get the command result.
+    /**
+    @return The begin of result data.
+    */
+    const UInt8* getResult() const
+    {
+        return m_data + RESULT;
     }
 
-private:
 
-    /// @brief Dump the custom payload.
+    /// @brief Get the command result size.
     /**
-    @param[in,out] oss The output stream.
-    @param[in] frame The frame content.
-    @param[in] title The payload title.
+    @return The result size in bytes.
     */
-    template<typename PayloadT>
-    static void tdump(OStream &oss, Frame::SharedPtr frame, const char *title)
+    size_t getResultSize() const
     {
-        oss << title << ": ";
-        PayloadT payload;
-        if (frame->getPayload(payload))
-            oss << dump(payload);
-        else
-            oss << "bad format";
+        return m_size - RESULT;
     }
 };
 
 
-/// @brief The XBee interface.
+/// @brief The ZigBee Transmit Status payload view.
 /**
-Uses external stream object to communicate with XBee device.
-Application is responsible to open and setup serial device.
+@see Frame::ZBTransmitStatus
 */
-template<typename StreamT>
-class API:
-    public bin::Transceiver<StreamT, Frame>
+class Frame::ZBTransmitStatusView:
+    public Frame::PayloadView
 {
-    /// @brief The base type.
-    typedef bin::Transceiver<StreamT, Frame> Base;
-
-    /// @brief The type alias.
-    typedef API<StreamT> This;
+    /// @brief The field offsets.
+    enum Offset
+    {
+        FRAME_ID    = 1,
+        DST_ADDR16  = 2,
+        RETRY_COUNT = 4,
+        DELIVERY    = 5,
+        DISCOVERY   = 6,
+        SIZE        = 7
+    };
 
-private:
+public:
 
-    /// @brief The default constructor.
+    /// @brief Assign the payload memory block.
     /**
-    @param[in] stream The external stream.
+    @param[in] data The payload data.
+    @param[in] len The payload length in bytes.
+    @return `true` if payload type and size are valid.
     */
-    explicit API(StreamT &stream)
-        : Base("xbee/API", stream)
-    {}
+    bool assign(const UInt8 *data, size_t len)
+    {
+        return reset(data, len, Frame::ZB_TRANSMIT_STATUS, SIZE);
+    }
 
 public:
 
-    /// @brief The shared pointer type.
-    typedef boost::shared_ptr<This> SharedPtr;
+    /// @brief Get the frame identifier.
+    UInt8 getFrameId() const
+    {
+        return getUInt8(FRAME_ID);
+    }
 
 
-    /// @brief The factory method.
-    /**
-    @param[in] stream The external stream.
-    @return The new instance.
-    */
-    static SharedPtr create(StreamT &stream)
+    /// @brief Get the destination network address.
+    UInt16 getDstAddr16() const
     {
-        return SharedPtr(new This(stream));
+        return getUInt16BE(DST_ADDR16);
     }
 
 
-    /// @brief Get the shared pointer.
-    /**
-    @return The shared pointer to this instance.
-    */
-    SharedPtr shared_from_this()
+    /// @brief Get the number of retries.
+    UInt8 getRetryCount() const
+    {
+        return getUInt8(RETRY_COUNT);
+    }
+
+
+    /// @brief Get the delivery status.
+    UInt8 getDeliveryStatus() const
     {
-        return boost::dynamic_pointer_cast<This>(Base::shared_from_this());
+        return getUInt8(DELIVERY);
     }
+
+
+    /// @brief Get the discovery status.
+    UInt8 getDiscoveryStatus() const
+    {
+        return getUInt8(DISCOVERY);
+    }
+};
+
+
+/// @brief The ZigBee Receive Packet payload view.
+/**
+@see Frame::ZBReceivePacket
+*/
+class Frame::ZBReceivePacketView:
+    public Frame::PayloadView
+{
+    /// @brief The field offsets.
+    enum Offset
+    {
+        SRC_ADDR64 = 1,
+        SRC_ADDR16 = 9,
+        OPTIONS    = 11,
+        DATA       = 12
+    };
+
+public:
+
+    /// @brief Assign the payload memory block.
+    /**
+    @param[in] data The payload data.
+    @param[in] len The payload length in bytes.
+    @return `true` if payload type and size are valid.
+    */
+    bool assign(const UInt8 *data, size_t len)
+    {
+        return reset(data, len, Frame::ZB_RECEIVE_PACKET, DATA);
+    }
+
+public:
+
+    /// @brief Get the source address.
+    UInt64 getSrcAddr64() const
+    {
+        return getUInt64BE(SRC_ADDR64);
+    }
+
+
+    /// @brief Get the source network address.
+    UInt16 getSrcAddr16() const
+    {
+        return getUInt16BE(SRC_ADDR16);
+    }
+
+
+    /// @brief Get the receive options.
+    UInt8 getOptions() const
+    {
+        return getUInt8(OPTIONS);
+    }
+
+
+    /// @brief Get the received data.
+    /**
+    @return The begin of received data.
+    */
+    const UInt8* getData() const
+    {
+        return m_data + DATA;
+    }
+
+
+    /// @brief Get the received data size.
+    /**
+    @return The data size in bytes.
+    */
+    size_t getDataSize() const
+    {
+        return m_size - DATA;
+    }
+};
+
+#endif // payload views
+
+
+/// @brief The XBee debug interface.
+class Debug
+{
+public:
+
+    /// @brief Dump the AT command request to string.
+    /**
+    @param[in] payload The payload to dump.
+    @return The dump information.
+    */
+    static String dump(Frame::ATCommandRequest const& payload)
+    {
+        OStringStream oss;
+
+        oss << "frameId=" << int(payload.frameId) << " "
+            "command=\"" << payload.command << "\"";
+
+        return oss.str();
+    }
+
+
+    /// @brief Dump the AT command response to string.
+    /**
+    @param[in] payload The payload to dump.
+    @return The dump information.
+    */
+    static String dump(Frame::ATCommandResponse const& payload)
+    {
+        OStringStream oss;
+
+        oss << "frameId=" << int(payload.frameId)
+            << " command=\"" << payload.command << "\""
+            << " status=" << dump::hex(payload.status)
+            << " result=[" << dump::hex(payload.result) << "]";
+
+        return oss.str();
+    }
+
+
+    /// @brief Dump the ZB transmit request to string.
+    /**
+    @param[in] payload The payload to dump.
+    @return The dump information.
+    */
+    static String dump(Frame::ZBTransmitRequest const& payload)
+    {
+        OStringStream oss;
+
+        oss << "frameId=" << int(payload.frameId)
+            << " DA64=" << dump::hex(payload.dstAddr64)
+            << " DA16=" << dump::hex(payload.dstAddr16)
+            << " bcastRadius=" << int(payload.bcastRadius)
+            << " options=" << dump::hex(payload.options);
+
+        const String data = payload.getData();
+        oss << " data=[" << dump::hex(data)
+            << "] (ascii:\"" << dump::ascii(data) << "\")";
+
+        return oss.str();
+    }
+
+
+    /// @brief Dump the ZB transmit status to string.
+    /**
+    @param[in] payload The payload to dump.
+    @return The dump information.
+    */
+    static String dump(Frame::ZBTransmitStatus const& payload)
+    {
+        OStringStream oss;
+
+        oss << "frameId=" << int(payload.frameId)
+            << " DA16=" << dump::hex(payload.dstAddr16)
+            << " retryCount=" << int(payload.retryCount)
+            << " delivery=" << dump::hex(payload.deliveryStatus)
+            << " discovery=" << dump::hex(payload.discoveryStatus);
+
+        return oss.str();
+    }
+
+
+    /// @brief Dump the ZB receive packet to string.
+    /**
+    @param[in] payload The payload to dump.
+    @return The dump information.
+    */
+    static String dump(Frame::ZBReceivePacket const& payload)
+    {
+        OStringStream oss;
+
+        oss << "SA64=" << dump::hex(payload.srcAddr64)
+            << " SA16=" << dump::hex(payload.srcAddr16)
+            << " options=" << dump::hex(payload.options)
+            << " data=[" << dump::hex(payload.data)
+            << "] (ascii:\"" << dump::ascii(payload.data) << "\")";
+
+        return oss.str();
+    }
+
+public:
+
+    /// @brief Dump the frame to string.
+    /**
+    @param[in] frame The frame to dump.
+    @return The dump information.
+    */
+    static String dump(Frame::SharedPtr frame)
+    {
+        OStringStream oss;
+
+        if (frame)
+        switch (frame->getIntent())
+        {
+            case Frame::ATCOMMAND_REQUEST:      tdump<Frame::ATCommandRequest>(oss, frame, "ATCOMMAND_REQUEST");    break;
+            case Frame::ATCOMMAND_RESPONSE:     tdump<Frame::ATCommandResponse>(oss, frame, "ATCOMMAND_RESPONSE");  break;
+            case Frame::ZB_TRANSMIT_REQUEST:    tdump<Frame::ZBTransmitRequest>(oss, frame, "ZB_TRANSMIT_REQUEST"); break;
+            case Frame::ZB_TRANSMIT_STATUS:     tdump<Frame::ZBTransmitStatus>(oss, frame, "ZB_TRANSMIT_STATUS");   break;
+            case Frame::ZB_RECEIVE_PACKET:      tdump<Frame::ZBReceivePacket>(oss, frame, "ZB_RECEIVE_PACKET");     break;
+
+            default:
+                oss << "unknown frame type: " << frame->getIntent();
+                break;
+        }
+
+        return oss.str();
+    }
+
+private:
+
+    /// @brief Dump the custom payload.
+    /**
+    @param[in,out] oss The output stream.
+    @param[in] frame The frame content.
+    @param[in] title The payload title.
+    */
+    template<typename PayloadT>
+    static void tdump(OStream &oss, Frame::SharedPtr frame, const char *title)
+    {
+        oss << title << ": ";
+        PayloadT payload;
+        if (frame->getPayload(payload))
+            oss << dump(payload);
+        else
+            oss << "bad format";
+    }
+};
+
+
+/// @brief The gateway-over-XBee fragmentation.
+/**
+The big frame is split into fragments which fit the XBee payload.
+Fragments refer to the source frame content, no data is copied
+until the XBee frame is formatted.
+
+All fragments except the last two are full. The rest is split
+into two halves, so the last fragment is never too small.
+*/
+class Fragmentation
+{
+public:
+
+    /// @brief Get the fragment sizes.
+    /**
+    @param[in] len The total data length in bytes.
+    @param[in] maxLen The maximum fragment length in bytes.
+    @param[out] sizes The fragment sizes.
+    */
+    static void split(size_t len, size_t maxLen, std::vector<size_t> &sizes)
+    {
+        sizes.clear();
+        if (len <= maxLen)
+        {
+            if (0 < len)
+                sizes.push_back(len);
+            return;
+        }
+
+        const size_t N = len/maxLen - 1; // number of "full" fragments
+        sizes.assign(N, maxLen);
+
+        const size_t rest = len - N*maxLen;
+        sizes.push_back(rest/2);
+        sizes.push_back(rest - rest/2);
+    }
+
+
+    /// @brief Slice the frame into transmit requests.
+    /**
+    The frame identifiers are zero, the transmit scheduler assigns them.
+
+    @param[in] frame The frame to slice.
+    @param[in] maxLen The maximum fragment length in bytes.
+    @param[in] da64 The destination address (64 bits).
+    @param[in] da16 The destination network address (16 bits).
+    @param[out] requests The transmit requests.
+    */
+    static void slice(boost::shared_ptr<bin::FrameContent const> frame, size_t maxLen,
+        UInt64 da64, UInt16 da16, std::vector<Frame::ZBTransmitRequest> &requests)
+    {
+        requests.clear();
+        if (!frame) return;
+
+        std::vector<size_t> sizes;
+        split(frame->size(), maxLen, sizes);
+        requests.reserve(sizes.size());
+
+        size_t offset = 0;
+        for (size_t i = 0; i < sizes.size(); ++i)
+        {
+            requests.push_back(Frame::ZBTransmitRequest(frame,
+                offset, sizes[i], 0, da64, da16));
+            offset += sizes[i];
+        }
+    }
+};
+
+
+/// @brief The gateway-over-XBee reassembly.
+/**
+Accumulates the received fragments per source and parses all
+complete frames at once. The frame type should provide static
+`parseFrame(boost::asio::streambuf&, ParseResult*)` method.
+
+The partial data is dropped if the next fragment doesn't come
+in time or the per-source or total memory limit is exceeded.
+The buffers are borrowed from the buffer pool while there is
+an incomplete frame only.
+*/
+template<typename FrameT>
+class Reassembler:
+    private NonCopyable
+{
+    /// @brief The type alias.
+    typedef Reassembler<FrameT> This;
+
+public:
+
+    /// @brief The defaults.
+    enum Defaults
+    {
+        DEFAULT_MAX_SOURCE_BYTES = 16*1024,  ///< @brief The per-source memory limit.
+        DEFAULT_MAX_TOTAL_BYTES  = 256*1024, ///< @brief The total memory limit.
+        DEFAULT_TIMEOUT          = 5000      ///< @brief The reassembly timeout, milliseconds.
+    };
+
+    /// @brief The frame shared pointer type.
+    typedef typename FrameT::SharedPtr FrameSPtr;
+
+    /// @brief The shared pointer type.
+    typedef boost::shared_ptr<This> SharedPtr;
+
+protected:
+
+    /// @brief The main constructor.
+    /**
+    @param[in] maxSourceBytes The per-source memory limit.
+    @param[in] maxTotalBytes The total memory limit.
+    @param[in] timeout_ms The reassembly timeout, milliseconds.
+    */
+    Reassembler(size_t maxSourceBytes, size_t maxTotalBytes, long timeout_ms)
+        : m_pool(BufferPool::getDefault())
+        , m_maxSourceBytes(maxSourceBytes)
+        , m_maxTotalBytes(maxTotalBytes)
+        , m_timeout(boost::posix_time::milliseconds(timeout_ms))
+        , m_pending(0)
+        , m_timeouts(0)
+        , m_overflows(0)
+        , m_dropped(0)
+    {}
+
+public:
+
+    /// @brief The factory method.
+    /**
+    @param[in] maxSourceBytes The per-source memory limit.
+    @param[in] maxTotalBytes The total memory limit.
+    @param[in] timeout_ms The reassembly timeout, milliseconds.
+    @return The new reassembler.
+    */
+    static SharedPtr create(size_t maxSourceBytes = DEFAULT_MAX_SOURCE_BYTES,
+        size_t maxTotalBytes = DEFAULT_MAX_TOTAL_BYTES, long timeout_ms = DEFAULT_TIMEOUT)
+    {
+        return SharedPtr(new This(maxSourceBytes, maxTotalBytes, timeout_ms));
+    }
+
+public:
+
+    /// @brief Put the received fragment.
+    /**
+    @param[in] src The source address.
+    @param[in] data The fragment data.
+    @param[in] len The fragment length in bytes.
+    @param[out] frames The complete frames are appended to this list.
+    @return The number of complete frames.
+    */
+    size_t feed(UInt64 src, const void *data, size_t len, std::vector<FrameSPtr> &frames)
+    {
+        const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+        if (m_lastSweep.is_not_a_date_time() || m_lastSweep + m_timeout <= now)
+        {
+            expire(now);
+            m_lastSweep = now;
+        }
+
+        Source &s = m_sources[src];
+        if (s.buf && s.last + m_timeout <= now)
+            drop(s, m_timeouts);
+
+        const size_t old = s.buf ? s.buf->size() : 0;
+        if (m_maxSourceBytes < old + len || m_maxTotalBytes < m_pending + len)
+        {
+            drop(s, m_overflows); // the new data may start a new frame
+            if (m_maxSourceBytes < len || m_maxTotalBytes < m_pending + len)
+            {
+                m_dropped += len;
+                m_sources.erase(src);
+                return 0;
+            }
+        }
+
+        if (!s.buf) // borrow from the pool
+            s.buf = m_pool->acquire(len);
+        s.buf->commit(boost::asio::buffer_copy(s.buf->prepare(len),
+            boost::asio::buffer(data, len)));
+        s.last = now;
+        m_pending += len;
+
+        size_t count = 0;
+        while (0 < s.buf->size()) // drain all complete frames
+        {
+            const size_t before = s.buf->size();
+            typename FrameT::ParseResult result = FrameT::RESULT_SUCCESS;
+            FrameSPtr frame = FrameT::parseFrame(*s.buf, &result);
+            m_pending -= before - s.buf->size(); // parsed or skipped
+
+            if (frame)
+            {
+                frames.push_back(frame);
+                count += 1;
+            }
+            else if (result == FrameT::RESULT_INCOMPLETE)
+                break;
+        }
+
+        if (0 == s.buf->size()) // return idle buffer
+            m_sources.erase(src);
+        return count;
+    }
+
+
+    /// @brief Drop the stale partial data.
+    /**
+    Called by feed() from time to time.
+    @param[in] now The current time.
+    */
+    void expire(boost::posix_time::ptime now)
+    {
+        typename std::map<UInt64, Source>::iterator i = m_sources.begin();
+        while (i != m_sources.end())
+        {
+            if (i->second.last + m_timeout <= now)
+            {
+                drop(i->second, m_timeouts);
+                m_sources.erase(i++);
+            }
+            else
+                ++i;
+        }
+    }
+
+
+    /// @brief Drop all partial data.
+    void clear()
+    {
+        m_sources.clear();
+        m_pending = 0;
+    }
+
+/// @name Counters
+/// @{
+public:
+
+    /// @brief Get the pending bytes.
+    /**
+    @return The total size of incomplete frames.
+    */
+    size_t getPendingBytes() const
+    {
+        return m_pending;
+    }
+
+
+    /// @brief Get the number of reassembly timeouts.
+    /**
+    @return The number of dropped stale partial frames.
+    */
+    size_t getTimeoutCount() const
+    {
+        return m_timeouts;
+    }
+
+
+    /// @brief Get the number of memory limit violations.
+    /**
+    @return The number of partial frames dropped due to memory limits.
+    */
+    size_t getOverflowCount() const
+    {
+        return m_overflows;
+    }
+
+
+    /// @brief Get the number of dropped bytes.
+    /**
+    @return The total number of dropped bytes.
+    */
+    size_t getDroppedBytes() const
+    {
+        return m_dropped;
+    }
+/// @}
+
+private:
+
+    /// @brief The source state.
+    struct Source
+    {
+        BufferPool::StreamBufPtr buf; ///< @brief The partial data.
+        boost::posix_time::ptime last; ///< @brief The last fragment time.
+    };
+
+
+    /// @brief Drop the partial data.
+    /**
+    @param[in,out] s The source.
+    @param[in,out] counter The counter to increment.
+    */
+    void drop(Source &s, size_t &counter)
+    {
+        if (s.buf)
+        {
+            const size_t n = s.buf->size();
+            if (0 < n)
+            {
+                m_pending -= n;
+                m_dropped += n;
+                counter += 1;
+            }
+            s.buf.reset();
+        }
+    }
+
+private:
+    BufferPool::SharedPtr m_pool; ///< @brief The buffer pool.
+    std::map<UInt64, Source> m_sources; ///< @brief The sources with partial data.
+    size_t m_maxSourceBytes; ///< @brief The per-source memory limit.
+    size_t m_maxTotalBytes; ///< @brief The total memory limit.
+    boost::posix_time::time_duration m_timeout; ///< @brief The reassembly timeout.
+    boost::posix_time::ptime m_lastSweep; ///< @brief The last expire() time.
+    size_t m_pending; ///< @brief The total size of partial data.
+    size_t m_timeouts; ///< @brief The number of timeouts.
+    size_t m_overflows; ///< @brief The number of memory limit violations.
+    size_t m_dropped; ///< @brief The number of dropped bytes.
+};
+
+
+/// @brief The XBee %API mode 2 stream adapter.
+/**
+In API mode 2 all frame bytes except the start delimiter are escaped:
+0x7E, 0x7D, 0x11 and 0x13 are sent as 0x7D followed by the byte XOR 0x20.
+
+This adapter escapes the outgoing frames and unescapes the incoming
+data, so the Frame parser works on the unescaped data in both modes.
+The outgoing frames are tracked by their length field, so the data
+byte 0x7E is never confused with the start delimiter. If the escaping
+is disabled, all operations are passed to the underlying stream as is.
+
+The adapter supports one read and one write operation at a time,
+just like bin::Transceiver does.
+*/
+template<typename StreamT>
+class EscapedStream:
+    private NonCopyable
+{
+    /// @brief The type alias.
+    typedef EscapedStream<StreamT> This;
+
+public:
+
+    /// @brief The IO service type.
+    typedef boost::asio::io_service IOService;
+
+public:
+
+    /// @brief The main constructor.
+    /**
+    @param[in] stream The underlying stream.
+    @param[in] escaped The API mode 2 flag.
+    */
+    explicit EscapedStream(StreamT &stream, bool escaped = true)
+        : m_stream(stream)
+        , m_escaped(escaped)
+        , m_tx_pos(0)
+        , m_tx_len(0)
+        , m_rx_escape(false)
+    {}
+
+public:
+
+    /// @brief Enable/disable the escaping.
+    /**
+    Should be changed while there is no active operation.
+    @param[in] escaped The API mode 2 flag.
+    */
+    void setEscaped(bool escaped)
+    {
+        m_escaped = escaped;
+        m_tx_pos = 0;
+        m_tx_len = 0;
+        m_rx_escape = false;
+    }
+
+
+    /// @brief Is the escaping enabled?
+    /**
+    @return `true` for API mode 2.
+    */
+    bool isEscaped() const
+    {
+        return m_escaped;
+    }
+
+
+    /// @brief Get the underlying stream.
+    /**
+    @return The underlying stream reference.
+    */
+    StreamT& next_layer()
+    {
+        return m_stream;
+    }
+
+
+    /// @brief Get the IO service.
+    /**
+    @return The IO service reference.
+    */
+    IOService& get_io_service()
+    {
+        return m_stream.get_io_service();
+    }
+
+#if BOOST_VERSION >= 106600
+    /// @brief The executor type.
+    typedef typename StreamT::executor_type executor_type;
+
+    /// @brief Get the executor.
+    /**
+    @return The underlying stream executor.
+    */
+    executor_type get_executor()
+    {
+        return m_stream.get_executor();
+    }
+#endif // BOOST_VERSION
+
+
+    /// @brief Cancel all asynchronous operations.
+    void cancel()
+    {
+        m_stream.cancel();
+    }
+
+public:
+
+    /// @brief Start asynchronous write operation.
+    /**
+    The escaped data is written completely, the handler
+    gets the number of unescaped bytes.
+
+    @param[in] bufs The buffers to write.
+    @param[in] handler The completion handler.
+    */
+    template<typename ConstBufferSequence, typename Handler>
+    void async_write_some(ConstBufferSequence const& bufs, Handler handler)
+    {
+        if (!m_escaped)
+        {
+            m_stream.async_write_some(bufs, handler);
+            return;
+        }
+
+        const size_t len = boost::asio::buffer_size(bufs);
+        m_tx_raw.resize(len);
+        if (len) boost::asio::buffer_copy(boost::asio::buffer(m_tx_raw), bufs);
+
+        m_tx_buf.clear();
+        if (len) escape(&m_tx_raw[0], len);
+
+        boost::asio::async_write(m_stream, boost::asio::buffer(m_tx_buf),
+            boost::bind(&This::template onWrite<Handler>, this,
+                boost::asio::placeholders::error, len, handler));
+    }
+
+
+    /// @brief Start asynchronous read operation.
+    /**
+    The handler gets the number of unescaped bytes,
+    which may be zero if only escape byte is received.
+
+    @param[in] bufs The buffers to read to.
+    @param[in] handler The completion handler.
+    */
+    template<typename MutableBufferSequence, typename Handler>
+    void async_read_some(MutableBufferSequence const& bufs, Handler handler)
+    {
+        if (!m_escaped)
+        {
+            m_stream.async_read_some(bufs, handler);
+            return;
+        }
+
+        m_rx_buf.resize(std::max(size_t(1), boost::asio::buffer_size(bufs)));
+        m_stream.async_read_some(boost::asio::buffer(m_rx_buf),
+            boost::bind(&This::template onRead<MutableBufferSequence, Handler>, this,
+                boost::asio::placeholders::error,
+                boost::asio::placeholders::bytes_transferred,
+                bufs, handler));
+    }
+
+public:
+
+    /// @brief Unescape the data.
+    /**
+    The output may be the same as input.
+
+    @param[in] in The escaped data.
+    @param[in] len The escaped data length.
+    @param[out] out The unescaped data, at least @a len bytes.
+    @param[in,out] pending The escape byte is pending flag.
+    @return The unescaped data length.
+    */
+    static size_t unescape(UInt8 const* in, size_t len, UInt8 *out, bool &pending)
+    {
+        UInt8 const* const end = in + len;
+        UInt8 *const first = out;
+
+        if (pending && in != end)
+        {
+            *out++ = UInt8(*in++ ^ Frame::ESCAPE_XOR);
+            pending = false;
+        }
+
+        while (in != end)
+        {
+            UInt8 const* esc = static_cast<UInt8 const*>(::memchr(in, Frame::ESCAPE, end - in));
+            UInt8 const* run_end = esc ? esc : end;
+
+            const size_t n = run_end - in; // copy unescaped run
+            if (out != in) ::memmove(out, in, n);
+            out += n;
+            in = run_end;
+
+            if (esc)
+            {
+                if (++in == end)
+                {
+                    pending = true;
+                    break;
+                }
+
+                *out++ = UInt8(*in++ ^ Frame::ESCAPE_XOR);
+            }
+        }
+
+        return out - first;
+    }
+
+private:
+
+    /// @brief Check if byte should be escaped.
+    static bool isSpecial(UInt8 b)
+    {
+        return b == Frame::SIGNATURE || b == Frame::ESCAPE
+            || b == Frame::XON || b == Frame::XOFF;
+    }
+
+
+    /// @brief Escape the outgoing data.
+    /**
+    The frame boundaries are tracked by the length field.
+
+    @param[in] data The unescaped data.
+    @param[in] len The data length.
+    */
+    void escape(UInt8 const* data, size_t len)
+    {
+        const size_t base = m_tx_buf.size();
+        m_tx_buf.resize(base + 2*len); // worst case
+        UInt8 *out = &m_tx_buf[0] + base;
+
+        for (size_t i = 0; i < len; ++i)
+        {
+            const UInt8 b = data[i];
+            if (0 == m_tx_pos) // start delimiter, never escaped
+                *out++ = b;
+            else
+            {
+                if (1 == m_tx_pos)
+                    m_tx_len = size_t(b) << 8;
+                else if (2 == m_tx_pos)
+                    m_tx_len = Frame::HEADER_LEN + (m_tx_len|b) + Frame::FOOTER_LEN;
+
+                if (isSpecial(b))
+                {
+                    *out++ = Frame::ESCAPE;
+                    *out++ = UInt8(b ^ Frame::ESCAPE_XOR);
+                }
+                else
+                    *out++ = b;
+            }
+
+            if (++m_tx_pos == m_tx_len) // end of frame
+            {
+                m_tx_pos = 0;
+                m_tx_len = 0;
+            }
+        }
+
+        m_tx_buf.resize(out - &m_tx_buf[0]);
+    }
+
+
+    /// @brief The write operation completed.
+    /**
+    @param[in] err The error code.
+    @param[in] len The number of unescaped bytes.
+    @param[in] handler The completion handler.
+    */
+    template<typename Handler>
+    void onWrite(boost::system::error_code err, size_t len, Handler handler)
+    {
+        handler(err, err ? 0 : len);
+    }
+
+
+    /// @brief The read operation completed.
+    /**
+    @param[in] err The error code.
+    @param[in] len The number of escaped bytes.
+    @param[in] bufs The output buffers.
+    @param[in] handler The completion handler.
+    */
+    template<typename MutableBufferSequence, typename Handler>
+    void onRead(boost::system::error_code err, size_t len,
+        MutableBufferSequence bufs, Handler handler)
+    {
+        size_t n = 0;
+        if (len)
+        {
+            n = unescape(&m_rx_buf[0], len, &m_rx_buf[0], m_rx_escape);
+            boost::asio::buffer_copy(bufs, boost::asio::buffer(m_rx_buf, n));
+        }
+
+        handler(err, n);
+    }
+
+private:
+    StreamT &m_stream; ///< @brief The underlying stream.
+    bool m_escaped; ///< @brief The API mode 2 flag.
+
+    std::vector<UInt8> m_tx_raw; ///< @brief The unescaped TX data.
+    std::vector<UInt8> m_tx_buf; ///< @brief The escaped TX data.
+    size_t m_tx_pos; ///< @brief The position in the current TX frame.
+    size_t m_tx_len; ///< @brief The current TX frame length, zero if unknown yet.
+
+    std::vector<UInt8> m_rx_buf; ///< @brief The escaped RX data.
+    bool m_rx_escape; ///< @brief The escape byte is pending.
+};
+
+
+/// @brief The XBee interface.
+/**
+Uses external stream object to communicate with XBee device.
+Application is responsible to open and setup serial device.
+
+The ZigBee Transmit Requests may be sent via transmit scheduler.
+The scheduler assigns frame identifiers and matches them with
+the ZigBee Transmit Status frames. The number of frames waiting for
+the status is limited per destination and globally, so the module's
+buffers are never overrun. Failed deliveries are retried if the
+status code means a temporary problem (see isRetryable()).
+The delivery latency is measured per destination (see getTxStats()).
+If the stream is reset all pending requests should be cancelled
+by cancelTx().
+
+The network addresses reported by the transmit status are cached per
+destination. Queued requests with unknown network address use the
+cached one, so the address discovery is done once per destination.
+If the cached address is stale (the address or route is not found)
+it's forgotten and the request is retried with the address discovery.
+
+The local AT commands may be pipelined (see queryAT() and queryATBatch()).
+Several commands are sent without waiting for the previous responses,
+the responses are matched by the frame identifiers. The same frame
+identifier space is shared with the transmit scheduler.
+
+If the module works in API mode 2 the stream should be
+wrapped with EscapedStream adapter.
+*/
+template<typename StreamT>
+class API:
+    public bin::Transceiver<StreamT, Frame>
+{
+    /// @brief The base type.
+    typedef bin::Transceiver<StreamT, Frame> Base;
+
+    /// @brief The type alias.
+    typedef API<StreamT> This;
+
+public:
+
+    /// @brief The frame shared pointer type.
+    typedef typename Base::FrameSPtr FrameSPtr;
+
+    /// @brief The local transmit status codes.
+    /**
+    Extends the Frame::ZBTransmitStatus::Delivery codes.
+    */
+    enum TxStatus
+    {
+        TX_STATUS_ABORTED  = 0xFD, ///< @brief The request is cancelled by cancelTx().
+        TX_STATUS_IO_ERROR = 0xFE, ///< @brief The frame cannot be written to the stream.
+        TX_STATUS_TIMEOUT  = 0xFF  ///< @brief No transmit status received in time.
+    };
+
+    /// @brief The transmit scheduler defaults.
+    enum TxDefaults
+    {
+        DEFAULT_TX_PER_DESTINATION = 1,     ///< @brief In-flight frames per destination, keeps the order.
+        DEFAULT_TX_GLOBAL          = 4,     ///< @brief In-flight frames in total.
+        DEFAULT_TX_RETRIES         = 2,     ///< @brief The maximum number of retries.
+        DEFAULT_TX_STATUS_TIMEOUT  = 10000, ///< @brief The transmit status timeout, milliseconds.
+        DEFAULT_AT_WINDOW          = 8      ///< @brief In-flight AT commands.
+    };
+
+private:
+
+    /// @brief The default constructor.
+    /**
+    @param[in] stream The external stream.
+    */
+    explicit API(StreamT &stream)
+        : Base("xbee/API", stream)
+        , m_tx_timer(stream.get_io_service())
+        , m_tx_timer_active(false)
+        , m_tx_per_dst(DEFAULT_TX_PER_DESTINATION)
+        , m_tx_global(DEFAULT_TX_GLOBAL)
+        , m_tx_retries(DEFAULT_TX_RETRIES)
+        , m_tx_status_timeout(boost::posix_time::milliseconds(long(DEFAULT_TX_STATUS_TIMEOUT)))
+        , m_tx_last_dst(0)
+        , m_tx_next_id(1)
+        , m_at_window(DEFAULT_AT_WINDOW)
+    {}
+
+public:
+
+    /// @brief The shared pointer type.
+    typedef boost::shared_ptr<This> SharedPtr;
+
+
+    /// @brief The factory method.
+    /**
+    @param[in] stream The external stream.
+    @return The new instance.
+    */
+    static SharedPtr create(StreamT &stream)
+    {
+        return SharedPtr(new This(stream));
+    }
+
+
+    /// @brief Get the shared pointer.
+    /**
+    @return The shared pointer to this instance.
+    */
+    SharedPtr shared_from_this()
+    {
+        return boost::static_pointer_cast<This>(Base::shared_from_this());
+    }
+
+public:
+
+    /// @brief Start listening for the RX frames.
+    /**
+    The ZigBee Transmit Status frames are processed by the transmit
+    scheduler first and then reported to the @a callback as well.
+
+    @param[in] callback The callback functor.
+    */
+    void recv(typename Base::RecvFrameCallback callback)
+    {
+        m_rx_callback = callback;
+        updateRx();
+    }
+
+/// @name Transmit scheduler
+/// @{
+public:
+
+    /// @brief The "transmit" callback type.
+    /**
+    The argument is the delivery status:
+    one of Frame::ZBTransmitStatus::Delivery or TxStatus codes.
+    */
+    typedef boost::function1<void, int> TransmitCallback;
+
+
+    /// @brief The per-destination transmit statistics.
+    struct TxStats
+    {
+        size_t delivered;   ///< @brief The number of delivered frames.
+        size_t failed;      ///< @brief The number of failed frames.
+        size_t retries;     ///< @brief The number of retries.
+        size_t macRetries;  ///< @brief The number of retransmissions reported by XBee.
+        size_t discoveries; ///< @brief The number of address discoveries.
+        UInt16 address16;   ///< @brief The last reported network address.
+        Int64 lastLatency;  ///< @brief The last delivery latency, microseconds.
+        Int64 maxLatency;   ///< @brief The maximum delivery latency, microseconds.
+        Int64 sumLatency;   ///< @brief The total delivery latency, microseconds.
+
+        /// @brief The default constructor.
+        TxStats()
+            : delivered(0)
+            , failed(0)
+            , retries(0)
+            , macRetries(0)
+            , discoveries(0)
+            , address16(Frame::ZBTransmitRequest::UNKNOWN_ADDRESS16)
+            , lastLatency(0)
+            , maxLatency(0)
+            , sumLatency(0)
+        {}
+
+        /// @brief Get the average delivery latency.
+        /**
+        @return The average latency of delivered frames, microseconds.
+        */
+        Int64 getAvgLatency() const
+        {
+            return delivered ? sumLatency/Int64(delivered) : 0;
+        }
+    };
+
+
+    /// @brief Set the in-flight limits.
+    /**
+    @param[in] perDestination The maximum number of frames waiting
+        for status per destination. `1` keeps the frames order.
+    @param[in] global The maximum number of frames waiting for status.
+    */
+    void setTxWindow(size_t perDestination, size_t global)
+    {
+        m_tx_per_dst = std::max(size_t(1), perDestination);
+        m_tx_global = std::min(size_t(255), std::max(size_t(1), global));
+        pumpTx();
+    }
+
+
+    /// @brief Set the retry policy.
+    /**
+    @param[in] retries The maximum number of retries per frame.
+    @param[in] statusTimeout_ms The transmit status timeout, milliseconds.
+    */
+    void setTxRetries(size_t retries, long statusTimeout_ms = DEFAULT_TX_STATUS_TIMEOUT)
+    {
+        m_tx_retries = retries;
+        m_tx_status_timeout = boost::posix_time::milliseconds(statusTimeout_ms);
+    }
+
+
+    /// @brief Schedule the ZigBee Transmit Request.
+    /**
+    The frame identifier is assigned by the scheduler.
+
+    @param[in] payload The transmit request.
+    @param[in] callback The callback functor. May be NULL.
+    */
+    void transmit(Frame::ZBTransmitRequest const& payload, TransmitCallback callback = TransmitCallback())
+    {
+        TxItemSPtr item(new TxItem(payload, callback));
+        Destination &dst = m_tx_dsts[payload.dstAddr64];
+        if (Frame::ZBTransmitRequest::UNKNOWN_ADDRESS16 == item->payload.dstAddr16)
+            item->payload.dstAddr16 = dst.stats.address16; // cached, if any
+        dst.queue.push_back(item);
+        updateRx();
+        pumpTx();
+    }
+
+
+    /// @brief Cancel all transmit requests and AT commands.
+    /**
+    All queued and in-flight requests are completed with #TX_STATUS_ABORTED
+    status, the transmit statuses received later are ignored.
+    The frames waiting in the transceiver's TX queue are dropped.
+    Should be called when the stream is closed or reset,
+    so the old requests aren't written to the reopened stream.
+    */
+    void cancelTx()
+    {
+        Base::dropTxQueue();
+
+        std::vector<TxItemSPtr> items;
+        typename std::map<UInt8, TxItemSPtr>::const_iterator i = m_tx_inflight.begin();
+        for (; i != m_tx_inflight.end(); ++i)
+            items.push_back(i->second);
+        m_tx_inflight.clear();
+
+        typename DstMap::iterator d = m_tx_dsts.begin();
+        for (; d != m_tx_dsts.end(); ++d)
+        {
+            items.insert(items.end(), d->second.queue.begin(), d->second.queue.end());
+            d->second.queue.clear();
+            d->second.inFlight = 0;
+        }
+
+        std::vector<ATItemSPtr> commands;
+        typename std::map<UInt8, ATItemSPtr>::const_iterator j = m_at_inflight.begin();
+        for (; j != m_at_inflight.end(); ++j)
+            commands.push_back(j->second);
+        m_at_inflight.clear();
+        commands.insert(commands.end(), m_at_queue.begin(), m_at_queue.end());
+        m_at_queue.clear();
+
+        if (!items.empty() || !commands.empty())
+        {
+            HIVELOG_WARN(Base::m_log, "cancel " << items.size() << " transmit requests and "
+                << commands.size() << " AT commands");
+        }
+
+        for (size_t k = 0; k < items.size(); ++k)
+            complete(items[k], TX_STATUS_ABORTED);
+        for (size_t k = 0; k < commands.size(); ++k)
+        {
+            Frame::ATCommandResponse response;
+            response.command = commands[k]->command.substr(0, 2);
+            response.status = UInt8(TX_STATUS_ABORTED);
+            reportAT(commands[k], response);
+        }
+
+        updateRx();
+    }
+
+
+    /// @brief Get the number of frames waiting for status.
+    /**
+    @return The number of in-flight frames.
+    */
+    size_t getTxInFlight() const
+    {
+        return m_tx_inflight.size();
+    }
+
+
+    /// @brief Get the number of queued frames.
+    /**
+    @return The number of frames waiting to be sent.
+    */
+    size_t getTxQueued() const
+    {
+        size_t n = 0;
+        typename DstMap::const_iterator i = m_tx_dsts.begin();
+        for (; i != m_tx_dsts.end(); ++i)
+            n += i->second.queue.size();
+        return n;
+    }
+
+
+    /// @brief Get the per-destination statistics.
+    /**
+    @param[in] addr64 The destination address.
+    @return The transmit statistics.
+    */
+    TxStats getTxStats(UInt64 addr64) const
+    {
+        typename DstMap::const_iterator i = m_tx_dsts.find(addr64);
+        return (i != m_tx_dsts.end()) ? i->second.stats : TxStats();
+    }
+
+
+    /// @brief Check if the delivery status is temporary.
+    /**
+    The #TX_STATUS_TIMEOUT is not retried: the frame may be already
+    delivered and only the status is lost, so the retry might
+    duplicate the frame (for example, a fragment of a larger message).
+
+    @param[in] status The delivery status.
+    @return `true` if delivery may be retried.
+    */
+    static bool isRetryable(int status)
+    {
+        switch (status)
+        {
+            case Frame::ZBTransmitStatus::DELIVERY_MAC_ACK_FAILURE:
+            case Frame::ZBTransmitStatus::DELIVERY_CCA_FAILURE:
+            case Frame::ZBTransmitStatus::DELIVERY_NETWORK_ACK_FAILURE:
+            case Frame::ZBTransmitStatus::DELIVERY_NOT_JOINED:
+            case Frame::ZBTransmitStatus::DELIVERY_ROUTE_NOT_FOUND:
+            case Frame::ZBTransmitStatus::DELIVERY_RESOURCE_ERROR:
+                return true;
+        }
+
+        return false;
+    }
+/// @}
+
+/// @name AT command pipeline
+/// @{
+public:
+
+    /// @brief The AT command callback type.
+    /**
+    If no response is received the status is one of TxStatus codes.
+    */
+    typedef boost::function1<void, Frame::ATCommandResponse const&> ATCallback;
+
+
+    /// @brief The AT command batch callback type.
+    /**
+    The responses are in the same order as the commands.
+    */
+    typedef boost::function1<void, std::vector<Frame::ATCommandResponse> const&> ATBatchCallback;
+
+
+    /// @brief Set the AT commands in-flight limit.
+    /**
+    @param[in] window The maximum number of commands waiting for response.
+    */
+    void setATWindow(size_t window)
+    {
+        m_at_window = std::min(size_t(255), std::max(size_t(1), window));
+        pumpAT();
+    }
+
+
+    /// @brief Send the local AT command.
+    /**
+    The frame identifier is assigned by the pipeline.
+
+    @param[in] command The AT command and parameters, for example "MY".
+    @param[in] callback The callback functor. May be NULL.
+    */
+    void queryAT(String const& command, ATCallback callback = ATCallback())
+    {
+        ATItemSPtr item(new ATItem(command));
+        item->callback = callback;
+        m_at_queue.push_back(item);
+        updateRx();
+        pumpAT();
+    }
+
+
+    /// @brief Send the batch of local AT commands.
+    /**
+    All commands are pipelined, the @a callback is called
+    once all responses are received.
+
+    @param[in] commands The AT commands and parameters.
+    @param[in] callback The callback functor. May be NULL.
+    */
+    void queryATBatch(std::vector<String> const& commands, ATBatchCallback callback = ATBatchCallback())
+    {
+        ATBatchSPtr batch(new ATBatch(commands.size(), callback));
+        for (size_t i = 0; i < commands.size(); ++i)
+        {
+            ATItemSPtr item(new ATItem(commands[i]));
+            item->batch = batch;
+            item->index = i;
+            m_at_queue.push_back(item);
+        }
+
+        if (commands.empty())
+            completeAT(batch);
+
+        updateRx();
+        pumpAT();
+    }
+
+
+    /// @brief Get the number of AT commands waiting for response.
+    /**
+    @return The number of in-flight AT commands.
+    */
+    size_t getATInFlight() const
+    {
+        return m_at_inflight.size();
+    }
+/// @}
+
+private:
+
+    /// @brief The scheduled transmit request.
+    struct TxItem
+    {
+        Frame::ZBTransmitRequest payload; ///< @brief The request, frameId is assigned on send.
+        TransmitCallback callback; ///< @brief The callback.
+        size_t attempts; ///< @brief The number of attempts made.
+        boost::posix_time::ptime start; ///< @brief The first attempt time.
+        boost::posix_time::ptime sent; ///< @brief The last attempt time.
+
+        /// @brief The main constructor.
+        TxItem(Frame::ZBTransmitRequest const& payload_, TransmitCallback callback_)
+            : payload(payload_)
+            , callback(callback_)
+            , attempts(0)
+        {}
+    };
+
+    /// @brief The transmit request shared pointer type.
+    typedef boost::shared_ptr<TxItem> TxItemSPtr;
+
+    /// @brief The destination state.
+    struct Destination
+    {
+        std::deque<TxItemSPtr> queue; ///< @brief The queued requests.
+        size_t inFlight; ///< @brief The number of in-flight requests.
+        TxStats stats; ///< @brief The statistics.
+
+        /// @brief The default constructor.
+        Destination()
+            : inFlight(0)
+        {}
+    };
+
+    /// @brief The destinations by MAC address.
+    typedef std::map<UInt64, Destination> DstMap;
+
+    /// @brief The AT command batch.
+    struct ATBatch
+    {
+        std::vector<Frame::ATCommandResponse> responses; ///< @brief The responses.
+        size_t pending; ///< @brief The number of commands without response.
+        ATBatchCallback callback; ///< @brief The callback.
+
+        /// @brief The main constructor.
+        ATBatch(size_t size, ATBatchCallback callback_)
+            : responses(size)
+            , pending(size)
+            , callback(callback_)
+        {}
+    };
+
+    /// @brief The AT command batch shared pointer type.
+    typedef boost::shared_ptr<ATBatch> ATBatchSPtr;
+
+    /// @brief The scheduled AT command.
+    struct ATItem
+    {
+        String command; ///< @brief The AT command and parameters.
+        ATCallback callback; ///< @brief The callback, if not in batch.
+        ATBatchSPtr batch; ///< @brief The batch, if any.
+        size_t index; ///< @brief The index in the batch.
+        boost::posix_time::ptime sent; ///< @brief The send time.
+
+        /// @brief The main constructor.
+        explicit ATItem(String const& command_)
+            : command(command_)
+            , index(0)
+        {}
+    };
+
+    /// @brief The AT command shared pointer type.
+    typedef boost::shared_ptr<ATItem> ATItemSPtr;
+
+private:
+
+    /// @brief Start/stop the RX.
+    /**
+    The RX is active while there is a subscriber or the in-flight frames.
+    */
+    void updateRx()
+    {
+        if (m_rx_callback || !m_tx_inflight.empty() || 0 < getTxQueued()
+            || !m_at_inflight.empty() || !m_at_queue.empty())
+            Base::recv(boost::bind(&This::onRecvFrame, shared_from_this(), _1, _2));
+        else
+            Base::recv(typename Base::RecvFrameCallback());
+    }
+
+
+    /// @brief The RX frame callback.
+    /**
+    @param[in] err The error code.
+    @param[in] frame The received frame.
+    */
+    void onRecvFrame(boost::system::error_code err, FrameSPtr frame)
+    {
+        if (!err && frame && frame->getIntent() == Frame::ZB_TRANSMIT_STATUS)
+        {
+            Frame::ZBTransmitStatusView view;
+            if (frame->getView(view))
+            {
+                onTransmitStatus(view.getFrameId(), view.getDeliveryStatus(),
+                    view.getDstAddr16(), view.getRetryCount(), view.getDiscoveryStatus());
+            }
+        }
+        else if (!err && frame && frame->getIntent() == Frame::ATCOMMAND_RESPONSE)
+        {
+            Frame::ATCommandResponseView view;
+            Frame::ATCommandResponse payload;
+            if (frame->getView(view) && m_at_inflight.count(view.getFrameId())
+                && frame->getPayload(payload)) // copy only own responses
+            {
+                onATResponse(payload.frameId, payload);
+            }
+        }
+
+        if (m_rx_callback)
+            m_rx_callback(err, frame);
+    }
+
+private:
+
+    /// @brief Send queued requests while the limits allow.
+    /**
+    The destinations are served in round-robin order
+    starting after the last served one.
+    */
+    void pumpTx()
+    {
+        size_t idle = 0; // destinations visited without progress
+        while (m_tx_inflight.size() < m_tx_global && hasFrameId()
+            && !m_tx_dsts.empty() && idle < m_tx_dsts.size())
+        {
+            typename DstMap::iterator i = m_tx_dsts.upper_bound(m_tx_last_dst);
+            if (i == m_tx_dsts.end())
+                i = m_tx_dsts.begin();
+            m_tx_last_dst = i->first;
+
+            Destination &dst = i->second;
+            if (!dst.queue.empty() && dst.inFlight < m_tx_per_dst)
+            {
+                TxItemSPtr item = dst.queue.front();
+                dst.queue.pop_front();
+                sendItem(dst, item);
+                idle = 0;
+            }
+            else
+                idle += 1;
+        }
+    }
+
+
+    /// @brief Send the request.
+    /**
+    @param[in] dst The destination.
+    @param[in] item The request to send.
+    */
+    void sendItem(Destination &dst, TxItemSPtr item)
+    {
+        const UInt8 id = allocFrameId();
+        const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+        if (0 == item->attempts)
+            item->start = now;
+        item->attempts += 1;
+        item->sent = now;
+        item->payload.frameId = id;
+
+        dst.inFlight += 1;
+        m_tx_inflight[id] = item;
+
+        Base::send(Frame::create(item->payload),
+            boost::bind(&This::onSendFrame, shared_from_this(), id, item, _1, _2));
+        armTimer();
+    }
+
+
+    /// @brief The frame is written to the stream.
+    /**
+    @param[in] id The frame identifier.
+    @param[in] item The request sent.
+    @param[in] err The error code.
+    @param[in] frame The frame sent.
+    */
+    void onSendFrame(UInt8 id, TxItemSPtr item, boost::system::error_code err, FrameSPtr frame)
+    {
+        HIVE_UNUSED(frame);
+
+        typename std::map<UInt8, TxItemSPtr>::const_iterator f = m_tx_inflight.find(id);
+        if (f == m_tx_inflight.end() || f->second != item)
+            return; // cancelled, the identifier might be reused
+
+        if (err) // no status will be received
+        {
+            HIVELOG_ERROR(Base::m_log, "cannot send frame #" << int(id) << ": ["
+                << err << "] " << err.message());
+            onTransmitStatus(id, TX_STATUS_IO_ERROR);
+        }
+    }
+
+
+    /// @brief Handle the transmit status.
+    /**
+    @param[in] id The frame identifier.
+    @param[in] status The delivery status.
+    @param[in] addr16 The reported network address.
+    @param[in] macRetries The reported number of retransmissions.
+    @param[in] discovery The reported discovery status.
+    */
+    void onTransmitStatus(UInt8 id, int status,
+        UInt16 addr16 = Frame::ZBTransmitRequest::UNKNOWN_ADDRESS16,
+        UInt8 macRetries = 0, UInt8 discovery = 0)
+    {
+        typename std::map<UInt8, TxItemSPtr>::iterator f = m_tx_inflight.find(id);
+        if (f == m_tx_inflight.end())
+        {
+            HIVELOG_DEBUG(Base::m_log, "unexpected transmit status, frame #" << int(id));
+            return;
+        }
+
+        TxItemSPtr item = f->second;
+        m_tx_inflight.erase(f);
+
+        Destination &dst = m_tx_dsts[item->payload.dstAddr64];
+        dst.inFlight -= 1;
+        dst.stats.macRetries += macRetries;
+        if (discovery & Frame::ZBTransmitStatus::DISCOVERY_ADDRESS)
+            dst.stats.discoveries += 1;
+
+        bool stale = false; // cached network address is not valid anymore
+        if (Frame::ZBTransmitStatus::DELIVERY_SUCCESS == status)
+            learnAddress16(dst, item->payload.dstAddr64, addr16);
+        else if (Frame::ZBTransmitStatus::DELIVERY_ADDRESS_NOT_FOUND == status
+              || Frame::ZBTransmitStatus::DELIVERY_ROUTE_NOT_FOUND == status)
+        {
+            stale = Frame::ZBTransmitRequest::UNKNOWN_ADDRESS16 != item->payload.dstAddr16;
+            forgetAddress16(dst, item->payload.dstAddr16);
+            item->payload.dstAddr16 = Frame::ZBTransmitRequest::UNKNOWN_ADDRESS16;
+        }
+
+        if (Frame::ZBTransmitStatus::DELIVERY_SUCCESS == status)
+        {
+            const Int64 latency = (boost::posix_time::microsec_clock::universal_time()
+                - item->start).total_microseconds();
+            dst.stats.delivered += 1;
+            dst.stats.lastLatency = latency;
+            dst.stats.maxLatency = std::max(dst.stats.maxLatency, latency);
+            dst.stats.sumLatency += latency;
+            complete(item, status);
+        }
+        else if ((isRetryable(status) || stale) && item->attempts <= m_tx_retries)
+        {
+            HIVELOG_WARN(Base::m_log, "frame #" << int(id) << " to "
+                << dump::hex(item->payload.dstAddr64) << " failed with status "
+                << dump::hex(UInt8(status)) << ", retry #" << item->attempts);
+            dst.stats.retries += 1;
+            dst.queue.push_front(item); // keep the order
+        }
+        else
+        {
+            HIVELOG_WARN(Base::m_log, "frame #" << int(id) << " to "
+                << dump::hex(item->payload.dstAddr64) << " failed with status "
+                << dump::hex(UInt8(status)));
+            dst.stats.failed += 1;
+            complete(item, status);
+        }
+
+        pumpTx();
+        pumpAT(); // frame identifier might be released
+        if (isIdle())
+            updateRx(); // stop RX if nobody is listening
+    }
+
+
+    /// @brief Cache the reported network address.
+    /**
+    Queued requests with unknown network address get the reported one.
+
+    @param[in] dst The destination.
+    @param[in] addr64 The destination address.
+    @param[in] addr16 The reported network address.
+    */
+    void learnAddress16(Destination &dst, UInt64 addr64, UInt16 addr16)
+    {
+        if (Frame::ZBTransmitRequest::BROADCAST_ADDRESS64 == addr64
+            || Frame::ZBTransmitRequest::MAX_ADDRESS16 < addr16)
+                return; // not a unicast address
+
+        dst.stats.address16 = addr16;
+        for (size_t i = 0; i < dst.queue.size(); ++i)
+        {
+            Frame::ZBTransmitRequest &payload = dst.queue[i]->payload;
+            if (Frame::ZBTransmitRequest::UNKNOWN_ADDRESS16 == payload.dstAddr16)
+                payload.dstAddr16 = addr16;
+        }
+    }
+
+
+    /// @brief Forget the stale network address.
+    /**
+    Queued requests with stale network address will use the address discovery.
+
+    @param[in] dst The destination.
+    @param[in] addr16 The stale network address.
+    */
+    void forgetAddress16(Destination &dst, UInt16 addr16)
+    {
+        if (Frame::ZBTransmitRequest::UNKNOWN_ADDRESS16 == addr16)
+            return; // nothing to forget
+
+        if (dst.stats.address16 == addr16)
+            dst.stats.address16 = Frame::ZBTransmitRequest::UNKNOWN_ADDRESS16;
+        for (size_t i = 0; i < dst.queue.size(); ++i)
+        {
+            Frame::ZBTransmitRequest &payload = dst.queue[i]->payload;
+            if (addr16 == payload.dstAddr16)
+                payload.dstAddr16 = Frame::ZBTransmitRequest::UNKNOWN_ADDRESS16;
+        }
+    }
+
+
+    /// @brief Report the request result.
+    /**
+    @param[in] item The request.
+    @param[in] status The delivery status.
+    */
+    void complete(TxItemSPtr item, int status)
+    {
+        if (item->callback)
+        {
+            Base::m_stream.get_io_service().post(
+                boost::bind(item->callback, status));
+        }
+    }
+
+
+    /// @brief Is there nothing to send or wait for?
+    bool isIdle() const
+    {
+        return m_tx_inflight.empty() && 0 == getTxQueued()
+            && m_at_inflight.empty() && m_at_queue.empty();
+    }
+
+private:
+
+    /// @brief Send queued AT commands while the limit allows.
+    void pumpAT()
+    {
+        while (m_at_inflight.size() < m_at_window
+            && !m_at_queue.empty() && hasFrameId())
+        {
+            ATItemSPtr item = m_at_queue.front();
+            m_at_queue.pop_front();
+
+            const UInt8 id = allocFrameId();
+            item->sent = boost::posix_time::microsec_clock::universal_time();
+            m_at_inflight[id] = item;
+
+            Base::send(Frame::create(Frame::ATCommandRequest(item->command, id)),
+                boost::bind(&This::onSendAT, shared_from_this(), id, item, _1, _2));
+        }
+
+        armTimer();
+    }
+
+
+    /// @brief The AT command is written to the stream.
+    /**
+    @param[in] id The frame identifier.
+    @param[in] item The AT command sent.
+    @param[in] err The error code.
+    @param[in] frame The frame sent.
+    */
+    void onSendAT(UInt8 id, ATItemSPtr item, boost::system::error_code err, FrameSPtr frame)
+    {
+        HIVE_UNUSED(frame);
+
+        typename std::map<UInt8, ATItemSPtr>::const_iterator f = m_at_inflight.find(id);
+        if (f == m_at_inflight.end() || f->second != item)
+            return; // cancelled, the identifier might be reused
+
+        if (err) // no response will be received
+        {
+            HIVELOG_ERROR(Base::m_log, "cannot send AT command #" << int(id) << ": ["
+                << err << "] " << err.message());
+            onATFailure(id, TX_STATUS_IO_ERROR);
+        }
+    }
+
+
+    /// @brief Handle the AT command response.
+    /**
+    @param[in] id The frame identifier.
+    @param[in] response The AT command response.
+    */
+    void onATResponse(UInt8 id, Frame::ATCommandResponse const& response)
+    {
+        typename std::map<UInt8, ATItemSPtr>::iterator f = m_at_inflight.find(id);
+        if (f == m_at_inflight.end())
+        {
+            HIVELOG_DEBUG(Base::m_log, "unexpected AT command response, frame #" << int(id));
+            return;
+        }
+
+        ATItemSPtr item = f->second;
+        m_at_inflight.erase(f);
+        reportAT(item, response);
+
+        pumpAT();
+        pumpTx(); // frame identifier might be released
+        if (isIdle())
+            updateRx(); // stop RX if nobody is listening
+    }
+
+
+    /// @brief Report the AT command failure.
+    /**
+    @param[in] id The frame identifier.
+    @param[in] status The local status, one of TxStatus codes.
+    */
+    void onATFailure(UInt8 id, int status)
+    {
+        typename std::map<UInt8, ATItemSPtr>::const_iterator f = m_at_inflight.find(id);
+        if (f == m_at_inflight.end())
+            return; // already done
+
+        HIVELOG_WARN(Base::m_log, "AT command #" << int(id) << " \""
+            << f->second->command.substr(0, 2) << "\" failed with status "
+            << dump::hex(UInt8(status)));
+
+        Frame::ATCommandResponse response;
+        response.frameId = id;
+        response.command = f->second->command.substr(0, 2);
+        response.status = UInt8(status);
+        onATResponse(id, response);
+    }
+
+
+    /// @brief Report the AT command result.
+    /**
+    @param[in] item The AT command, already removed from the pipeline.
+    @param[in] response The AT command response.
+    */
+    void reportAT(ATItemSPtr item, Frame::ATCommandResponse const& response)
+    {
+        if (item->batch)
+        {
+            item->batch->responses[item->index] = response;
+            if (0 == --item->batch->pending)
+                completeAT(item->batch);
+        }
+        else if (item->callback)
+        {
+            Base::m_stream.get_io_service().post(
+                boost::bind(item->callback, response));
+        }
+    }
+
+
+    /// @brief Report the AT command batch result.
+    /**
+    @param[in] batch The completed batch.
+    */
+    void completeAT(ATBatchSPtr batch)
+    {
+        if (batch->callback)
+        {
+            Base::m_stream.get_io_service().post(
+                boost::bind(batch->callback, batch->responses));
+        }
+    }
+
+private:
+
+    /// @brief Check if there is a free frame identifier.
+    /**
+    @return `true` if the frame identifier can be allocated.
+    */
+    bool hasFrameId() const
+    {
+        return m_tx_inflight.size() + m_at_inflight.size() < 255;
+    }
+
+
+    /// @brief Allocate the frame identifier.
+    /**
+    The zero identifier is never used since XBee doesn't report status for it.
+    Identifiers of in-flight frames and AT commands are skipped.
+    Should be called only if hasFrameId() is `true`.
+
+    @return The frame identifier.
+    */
+    UInt8 allocFrameId()
+    {
+        while (0 == m_tx_next_id || m_tx_inflight.count(m_tx_next_id)
+            || m_at_inflight.count(m_tx_next_id))
+        {
+            m_tx_next_id += 1; // (!) wraps at 256
+        }
+
+        return m_tx_next_id++;
+    }
+
+private:
+
+    /// @brief Start the status timer if it's not active.
+    void armTimer()
+    {
+        if (!m_tx_timer_active && (!m_tx_inflight.empty() || !m_at_inflight.empty()))
+        {
+            m_tx_timer_active = true;
+            m_tx_timer.expires_from_now(m_tx_status_timeout/4);
+            m_tx_timer.async_wait(boost::bind(&This::onTimer,
+                shared_from_this(), boost::asio::placeholders::error));
+        }
+    }
+
+
+    /// @brief Check the in-flight frames and AT commands for the timeout.
+    /**
+    @param[in] err The error code.
+    */
+    void onTimer(boost::system::error_code err)
+    {
+        m_tx_timer_active = false;
+        if (err) return; // cancelled
+
+        const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+        std::vector<UInt8> expired;
+        typename std::map<UInt8, TxItemSPtr>::const_iterator i = m_tx_inflight.begin();
+        for (; i != m_tx_inflight.end(); ++i)
+        {
+            if (i->second->sent + m_tx_status_timeout <= now)
+                expired.push_back(i->first);
+        }
+
+        for (size_t k = 0; k < expired.size(); ++k)
+            onTransmitStatus(expired[k], TX_STATUS_TIMEOUT);
+
+        expired.clear();
+        typename std::map<UInt8, ATItemSPtr>::const_iterator j = m_at_inflight.begin();
+        for (; j != m_at_inflight.end(); ++j)
+        {
+            if (j->second->sent + m_tx_status_timeout <= now)
+                expired.push_back(j->first);
+        }
+
+        for (size_t k = 0; k < expired.size(); ++k)
+            onATFailure(expired[k], TX_STATUS_TIMEOUT);
+
+        armTimer();
+    }
+
+private:
+    typename Base::RecvFrameCallback m_rx_callback; ///< @brief The RX subscriber.
+
+    boost::asio::deadline_timer m_tx_timer; ///< @brief The transmit status timer.
+    bool m_tx_timer_active; ///< @brief The timer is active.
+
+    size_t m_tx_per_dst; ///< @brief The per-destination in-flight limit.
+    size_t m_tx_global; ///< @brief The global in-flight limit.
+    size_t m_tx_retries; ///< @brief The maximum number of retries.
+    boost::posix_time::time_duration m_tx_status_timeout; ///< @brief The transmit status timeout.
+
+    DstMap m_tx_dsts; ///< @brief The destinations.
+    UInt64 m_tx_last_dst; ///< @brief The last served destination.
+    std::map<UInt8, TxItemSPtr> m_tx_inflight; ///< @brief The in-flight requests by frame identifier.
+    UInt8 m_tx_next_id; ///< @brief The next frame identifier.
+
+    size_t m_at_window; ///< @brief The AT commands in-flight limit.
+    std::deque<ATItemSPtr> m_at_queue; ///< @brief The queued AT commands.
+    std::map<UInt8, ATItemSPtr> m_at_inflight; ///< @brief The in-flight AT commands by frame identifier.
 };
 
 } // xbee namespace
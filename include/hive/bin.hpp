@@ -7,15 +7,21 @@
 
 #include "swab.hpp"
 #include "dump.hpp"
+#include "pool.hpp"
 #include "log.hpp"
 
 #if !defined(HIVE_PCH)
 #   include <boost/shared_ptr.hpp>
+#   include <boost/function.hpp>
 #   include <boost/asio.hpp>
 #   include <istream>
 #   include <ostream>
+#   include <fstream>
 #   include <vector>
 #   include <deque>
+#   include <algorithm>
+#   include <string.h>
+#   include <stdio.h>
 #endif // HIVE_PCH
 
 
@@ -25,33 +31,22 @@ namespace hive
     namespace bin
     {
 
-/// @brief The binary output stream.
+/// @brief The binary output stream API.
 /**
-Writes binary formatted data to an external output stream.
+Provides all `put*()` methods on top of the derived class
+which should implement raw `write(buf, len)` method.
+
+@see OStream BufferOStream
 */
-// TODO: check errors!
-class OStream
+template<typename DerivedT>
+class OStreamBase
 {
-public:
+protected:
 
-    /// @brief The main constructor.
-    /**
-    @param[in] stream The external stream.
-    */
-    explicit OStream(hive::OStream &stream)
-        : m_stream(stream)
+    /// @brief The default constructor.
+    OStreamBase()
     {}
 
-
-    /// @brief Get the external stream.
-    /**
-    @return The external stream reference.
-    */
-    hive::OStream& getStream()
-    {
-        return m_stream;
-    }
-
 #if 1
 /// @name Fixed-size integers (host byte order)
 /// @{
@@ -236,6 +231,53 @@ public:
 /// @}
 #endif // fixed-size integers (big-endian)
 
+#if 1
+/// @name Arrays of fixed-size integers
+/// @{
+public:
+
+    /// @brief Write array of integers (host byte order).
+    /**
+    @param[in] vals The values to write.
+    @param[in] n The number of values.
+    */
+    template<typename IntX>
+    void putArray(const IntX *vals, size_t n)
+    {
+        derived().write(vals, n*sizeof(IntX));
+    }
+
+
+    /// @brief Write array of integers (little-endian).
+    /**
+    The values are converted by blocks using misc::h2le_array().
+
+    @param[in] vals The values to write.
+    @param[in] n The number of values.
+    */
+    template<typename IntX>
+    void putArrayLE(const IntX *vals, size_t n)
+    {
+        putArrayX<1234>(vals, n);
+    }
+
+
+    /// @brief Write array of integers (big-endian).
+    /**
+    The values are converted by blocks using misc::h2be_array().
+
+    @param[in] vals The values to write.
+    @param[in] n The number of values.
+    */
+    template<typename IntX>
+    void putArrayBE(const IntX *vals, size_t n)
+    {
+        putArrayX<4321>(vals, n);
+    }
+
+/// @}
+#endif // arrays of fixed-size integers
+
 #if 1
 /// @name Variable-size integers
 /// @{
@@ -283,6 +325,64 @@ public:
 /// @}
 #endif // variable-size integers
 
+#if 1
+/// @name Arrays of variable-size integers
+/// @{
+public:
+
+    /// @brief Write array of unsigned 32-bits integers in variable size format.
+    /**
+    The output is the same as putUInt32V() called for each element,
+    but values are encoded into a local block first
+    and the block is written at once.
+
+    @param[in] vals The values to write.
+    @param[in] n The number of values.
+    */
+    void putUInt32VArray(const UInt32 *vals, size_t n)
+    {
+        putIntXVArray<UInt32>(vals, n, false);
+    }
+
+
+    /// @brief Write array of unsigned 64-bits integers in variable size format.
+    /**
+    @param[in] vals The values to write.
+    @param[in] n The number of values.
+    @see putUInt32VArray()
+    */
+    void putUInt64VArray(const UInt64 *vals, size_t n)
+    {
+        putIntXVArray<UInt64>(vals, n, false);
+    }
+
+
+    /// @brief Write array of signed 32-bits integers in variable size format (*zig-zag* mode).
+    /**
+    @param[in] vals The values to write.
+    @param[in] n The number of values.
+    @see putUInt32VArray()
+    */
+    void putInt32VZArray(const Int32 *vals, size_t n)
+    {
+        putIntXVArray<UInt32>(vals, n, true);
+    }
+
+
+    /// @brief Write array of signed 64-bits integers in variable size format (*zig-zag* mode).
+    /**
+    @param[in] vals The values to write.
+    @param[in] n The number of values.
+    @see putUInt32VArray()
+    */
+    void putInt64VZArray(const Int64 *vals, size_t n)
+    {
+        putIntXVArray<UInt64>(vals, n, true);
+    }
+
+/// @}
+#endif // arrays of variable-size integers
+
 /// @name String and custom data buffer
 /// @{
 public:
@@ -296,7 +396,7 @@ public:
     void putString(String const& val)
     {
         putUInt32V(UInt32(val.size()));
-        m_stream.write(val.data(), val.size());
+        derived().write(val.data(), val.size());
     }
 
 
@@ -307,7 +407,7 @@ public:
     */
     void putBuffer(const void *buf, size_t len)
     {
-        m_stream.write(static_cast<const char*>(buf), len);
+        derived().write(buf, len);
     }
 /// @}
 
@@ -331,7 +431,35 @@ private:
         buf.val = val;
 
         //static_assert(sizeof(val) == sizeof(buf))
-        m_stream.write(buf.raw, sizeof(Val2Raw));
+        derived().write(buf.raw, sizeof(Val2Raw));
+    }
+
+
+    /// @brief Write array of custom integers.
+    /**
+    @param[in] vals The values to write.
+    @param[in] n The number of values.
+    */
+    template<int ORDER, typename IntX>
+    void putArrayX(const IntX *vals, size_t n)
+    {
+        if (ORDER == HIVE_BYTE_ORDER) // no conversion
+        {
+            putArray(vals, n);
+            return;
+        }
+
+        const size_t BLOCK = 512/sizeof(IntX); // values per block
+        IntX buf[BLOCK];
+
+        while (0 < n)
+        {
+            const size_t m = (n < BLOCK) ? n : BLOCK; // minimum
+            misc::EndianT<ORDER>::h2e_array(buf, vals, m);
+            derived().write(buf, m*sizeof(IntX));
+            vals += m;
+            n -= m;
+        }
     }
 
 
@@ -342,41 +470,103 @@ private:
     template<typename UIntX>
     void putIntXV(UIntX val)
     {
-        // go through all bytes, LSB-first
-        for (size_t b = 0; b < sizeof(UIntX); ++b)
+        UInt8 buf[(sizeof(UIntX)*8 + 6)/7];
+        derived().write(buf, encodeIntXV(buf, val) - buf);
+    }
+
+
+    /// @brief Write array of custom integers in variable size format.
+    /**
+    @param[in] vals The values to write.
+    @param[in] n The number of values.
+    @param[in] zigzag The *zig-zag* mode flag for signed integers.
+    */
+    template<typename UIntX, typename IntX>
+    void putIntXVArray(const IntX *vals, size_t n, bool zigzag)
+    {
+        const size_t BLOCK = 64; // values per block
+        UInt8 buf[BLOCK * ((sizeof(UIntX)*8 + 6)/7)];
+
+        while (0 < n)
         {
-            // data (7 bits)
-            const int d = int(val)&0x7F;
-            val >>= 7;
+            const size_t m = (n < BLOCK) ? n : BLOCK; // minimum
+            UInt8 *p = buf;
 
-            // 'continue' flag
-            const int f = (0 != val);
+            for (size_t i = 0; i < m; ++i)
+            {
+                const IntX val = vals[i];
+                p = encodeIntXV(p, zigzag
+                    ? UIntX((UIntX(val)<<1) ^ UIntX(val >> (sizeof(IntX)*8 - 1)))
+                    : UIntX(val));
+            }
 
-            m_stream.put((f<<7) | d);
-            if (!f)
-                break;
+            derived().write(buf, p - buf);
+            vals += m;
+            n -= m;
         }
     }
 
-private:
-    hive::OStream &m_stream; ///< @brief The external output stream.
+
+    /// @brief Encode custom integer in variable size format.
+    /**
+    Values up to 2 bytes are encoded without loop.
+
+    @param[out] p The output buffer, should have enough space.
+    @param[in] val The value to encode.
+    @return The end of encoded data.
+    */
+    template<typename UIntX>
+    static UInt8* encodeIntXV(UInt8 *p, UIntX val)
+    {
+        if (val < 0x80)         // 1 byte
+        {
+            p[0] = UInt8(val);
+            return p + 1;
+        }
+        else if (val < 0x4000)  // 2 bytes
+        {
+            p[0] = UInt8(val | 0x80);
+            p[1] = UInt8(val >> 7);
+            return p + 2;
+        }
+
+        // go through all bytes, LSB-first
+        while (0x80 <= val)
+        {
+            *p++ = UInt8(val | 0x80); // data (7 bits) + 'continue' flag
+            val >>= 7;
+        }
+        *p++ = UInt8(val);
+        return p;
+    }
+
+    /// @brief Get the derived stream.
+    /**
+    @return The derived stream reference.
+    */
+    DerivedT& derived()
+    {
+        return static_cast<DerivedT&>(*this);
+    }
 };
 
 
-/// @brief The binary input stream.
+/// @brief The binary output stream.
 /**
-Reads binary formatted data from an external input stream.
+Writes binary formatted data to an external output stream.
 */
-// TODO: check errors!!!
-class IStream
+// TODO: check errors!
+class OStream:
+    public OStreamBase<OStream>
 {
+    friend class OStreamBase<OStream>;
 public:
 
     /// @brief The main constructor.
     /**
     @param[in] stream The external stream.
     */
-    explicit IStream(hive::IStream &stream)
+    explicit OStream(hive::OStream &stream)
         : m_stream(stream)
     {}
 
@@ -385,11 +575,116 @@ public:
     /**
     @return The external stream reference.
     */
-    hive::IStream& getStream()
+    hive::OStream& getStream()
     {
         return m_stream;
     }
 
+private:
+
+    /// @brief Write raw data.
+    /**
+    @param[in] buf The data to write.
+    @param[in] len The data length in bytes.
+    */
+    void write(const void *buf, size_t len)
+    {
+        m_stream.write(static_cast<const char*>(buf), len);
+    }
+
+private:
+    hive::OStream &m_stream; ///< @brief The external output stream.
+};
+
+
+/// @brief The binary output stream to memory buffer.
+/**
+Appends binary formatted data directly to an external byte container,
+no `std::ostream` is involved. The container grows as needed, so
+its capacity may be reused between messages.
+
+The container should have `insert()` method.
+For example hive::String or std::vector<UInt8>.
+*/
+template<typename BufferT>
+class BufferOStream:
+    public OStreamBase< BufferOStream<BufferT> >
+{
+    friend class OStreamBase< BufferOStream<BufferT> >;
+public:
+
+    /// @brief The main constructor.
+    /**
+    All data are appended to the existing container content.
+
+    @param[in] buffer The external buffer.
+    */
+    explicit BufferOStream(BufferT &buffer)
+        : m_buffer(buffer)
+    {}
+
+
+    /// @brief Get the external buffer.
+    /**
+    @return The external buffer reference.
+    */
+    BufferT& getBuffer()
+    {
+        return m_buffer;
+    }
+
+
+    /// @brief Get the number of bytes in the buffer.
+    /**
+    @return The buffer size in bytes.
+    */
+    size_t size() const
+    {
+        return m_buffer.size();
+    }
+
+private:
+
+    /// @brief Write raw data.
+    /**
+    @param[in] buf The data to write.
+    @param[in] len The data length in bytes.
+    */
+    void write(const void *buf, size_t len)
+    {
+        const UInt8 *data = static_cast<const UInt8*>(buf);
+        if (len <= 2) // short varints, bytes
+        {
+            for (size_t i = 0; i < len; ++i)
+                m_buffer.push_back(data[i]);
+        }
+        else
+            m_buffer.insert(m_buffer.end(), data, data + len);
+    }
+
+private:
+    BufferT &m_buffer; ///< @brief The external buffer.
+};
+
+
+/// @brief The binary input stream API.
+/**
+Provides all `get*()` methods on top of the derived class
+which should implement raw `read(buf, len)` and `get()` methods,
+`getReadLimit()` to report the number of bytes known to be available
+and `setFail()` to mark the stream as failed.
+
+@see IStream SpanIStream
+*/
+template<typename DerivedT>
+class IStreamBase
+{
+protected:
+
+    /// @brief The default constructor.
+    IStreamBase()
+    {}
+
 #if 1
 /// @name Fixed-size integers (host byte order)
 /// @{
@@ -575,6 +870,56 @@ public:
 /// @}
 #endif // fixed-size integers (big-endian)
 
+#if 1
+/// @name Arrays of fixed-size integers
+/// @{
+public:
+
+    /// @brief Read array of integers (host byte order).
+    /**
+    @param[out] vals The values to read.
+    @param[in] n The number of values.
+    */
+    template<typename IntX>
+    void getArray(IntX *vals, size_t n)
+    {
+        derived().read(vals, n*sizeof(IntX));
+    }
+
+
+    /// @brief Read array of integers (little-endian).
+    /**
+    The values are read at once and converted in-place
+    using misc::le2h_array().
+
+    @param[out] vals The values to read.
+    @param[in] n The number of values.
+    */
+    template<typename IntX>
+    void getArrayLE(IntX *vals, size_t n)
+    {
+        getArray(vals, n);
+        misc::le2h_array(vals, vals, n);
+    }
+
+
+    /// @brief Read array of integers (big-endian).
+    /**
+    The values are read at once and converted in-place
+    using misc::be2h_array().
+
+    @param[out] vals The values to read.
+    @param[in] n The number of values.
+    */
+    template<typename IntX>
+    void getArrayBE(IntX *vals, size_t n)
+    {
+        getArray(vals, n);
+        misc::be2h_array(vals, vals, n);
+    }
+/// @}
+#endif // arrays of fixed-size integers
+
 #if 1
 /// @name Variable-size integers
 /// @{
@@ -623,51 +968,136 @@ public:
 /// @}
 #endif // variable-size integers
 
-/// @name String and custom data buffer
+#if 1
+/// @name Arrays of variable-size integers
 /// @{
 public:
 
-    /// @brief Read the custom string.
+    /// @brief Read array of unsigned 32-bits integers in variable size format.
     /**
-    @return The read value.
+    @param[out] vals The values to read.
+    @param[in] n The number of values.
     */
-    String getString()
+    void getUInt32VArray(UInt32 *vals, size_t n)
     {
-        size_t len = size_t(getUInt32V());
-        String res; res.reserve(len);
+        for (size_t i = 0; i < n; ++i)
+            vals[i] = getUInt32V();
+    }
 
-        char buf[64]; // "read" buffer
-        while (0 < len)
-        {
-            const size_t n = (len < sizeof(buf))
-                ? len : sizeof(buf); // minimum
 
-            m_stream.read(buf, n);
-            res.append(buf, buf+n);
+    /// @brief Read array of unsigned 64-bits integers in variable size format.
+    /**
+    @param[out] vals The values to read.
+    @param[in] n The number of values.
+    */
+    void getUInt64VArray(UInt64 *vals, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+            vals[i] = getUInt64V();
+    }
 
-            len -= n;
-        }
 
-        return res;
+    /// @brief Read array of signed 32-bits integers in variable size format (*zig-zag* mode).
+    /**
+    @param[out] vals The values to read.
+    @param[in] n The number of values.
+    */
+    void getInt32VZArray(Int32 *vals, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+            vals[i] = getInt32VZ();
     }
 
 
-    /// @brief Read custom data buffer.
+    /// @brief Read array of signed 64-bits integers in variable size format (*zig-zag* mode).
     /**
-    @param[in] buf The buffer read to.
-    @param[in] len The buffer length in bytes.
+    @param[out] vals The values to read.
+    @param[in] n The number of values.
     */
-    void getBuffer(void *buf, size_t len)
+    void getInt64VZArray(Int64 *vals, size_t n)
     {
-        m_stream.read(static_cast<char*>(buf), len);
+        for (size_t i = 0; i < n; ++i)
+            vals[i] = getInt64VZ();
     }
 /// @}
+#endif // arrays of variable-size integers
 
-private:
+/// @name String and custom data buffer
+/// @{
+public:
 
-    /// @brief Read custom integer.
+    /// @brief Read the custom string.
     /**
-    @return The read value.
+    @return The read value or empty string if the declared length is rejected.
+    @see getString(String&, size_t)
+    */
+    String getString()
+    {
+        String res;
+        getString(res);
+        return res;
+    }
+
+
+    /// @brief Read the custom string to the existing string.
+    /**
+    The string data is read in one pass directly to the @a str,
+    so its capacity may be reused across calls.
+
+    @param[out] str The string to read to.
+    @param[in] maxLen The maximum allowed length in bytes.
+    @return `false` if the declared length is rejected.
+    @see getBuffer(String&, size_t, size_t)
+    */
+    bool getString(String &str, size_t maxLen = size_t(-1))
+    {
+        return getBuffer(str, size_t(getUInt32V()), maxLen);
+    }
+
+
+    /// @brief Read custom data buffer of known length to the string.
+    /**
+    The declared length is checked before any allocation. If it's greater
+    than @a maxLen or than the number of bytes the stream is known to have,
+    the @a str is cleared, the stream error flag is set and no data is read.
+
+    @param[out] str The string to read to.
+    @param[in] len The declared data length in bytes.
+    @param[in] maxLen The maximum allowed length in bytes.
+    @return `false` if the declared length is rejected.
+    */
+    bool getBuffer(String &str, size_t len, size_t maxLen = size_t(-1))
+    {
+        if (maxLen < len || derived().getReadLimit() < len)
+        {
+            str.clear();
+            derived().setFail();
+            return false;
+        }
+
+        str.resize(len);
+        if (0 < len)
+            derived().read(&str[0], len);
+        return true;
+    }
+
+
+    /// @brief Read custom data buffer.
+    /**
+    @param[in] buf The buffer read to.
+    @param[in] len The buffer length in bytes.
+    */
+    void getBuffer(void *buf, size_t len)
+    {
+        derived().read(buf, len);
+    }
+/// @}
+
+protected:
+
+    /// @brief Read custom integer.
+    /**
+    @return The read value.
     */
     template<typename IntX>
     IntX getIntX()
@@ -683,13 +1113,15 @@ private:
 
         // static_assert(sizeof(val) == sizeof(buf))
         buf.val = 0; // default value
-        m_stream.read(buf.raw, sizeof(Val2Raw));
+        derived().read(buf.raw, sizeof(Val2Raw));
         return buf.val;
     }
 
 
     /// @brief Read custom integer in variable size format.
     /**
+    The truncated value is read as zero.
+
     @return The read value.
     */
     template<typename UIntX>
@@ -698,10 +1130,12 @@ private:
         UIntX val = 0;
 
         // go through all bytes, LSB-first
-        for (size_t i = 0; i < sizeof(UIntX); ++i)
+        for (size_t i = 0; i < (sizeof(UIntX)*8 + 6)/7; ++i)
         {
             // 'continue' flag and data (7 bits)
-            int f_d = m_stream.get();
+            const int f_d = derived().get();
+            if (f_d == EOF)
+                return 0; // not enough data
 
             // data (7 bits)
             val |= UIntX(f_d&0x7F) << (i*7);
@@ -714,11 +1148,356 @@ private:
         return val;
     }
 
+    /// @brief Get the derived stream.
+    /**
+    @return The derived stream reference.
+    */
+    DerivedT& derived()
+    {
+        return static_cast<DerivedT&>(*this);
+    }
+};
+
+
+/// @brief The binary input stream.
+/**
+Reads binary formatted data from an external input stream.
+*/
+// TODO: check errors!!!
+class IStream:
+    public IStreamBase<IStream>
+{
+    friend class IStreamBase<IStream>;
+public:
+
+    /// @brief The main constructor.
+    /**
+    @param[in] stream The external stream.
+    */
+    explicit IStream(hive::IStream &stream)
+        : m_stream(stream)
+    {}
+
+
+    /// @brief Get the external stream.
+    /**
+    @return The external stream reference.
+    */
+    hive::IStream& getStream()
+    {
+        return m_stream;
+    }
+
+private:
+
+    /// @brief Read raw data.
+    /**
+    @param[out] buf The buffer to read to.
+    @param[in] len The buffer length in bytes.
+    */
+    void read(void *buf, size_t len)
+    {
+        m_stream.read(static_cast<char*>(buf), len);
+    }
+
+
+    /// @brief Read one raw byte.
+    /**
+    @return The byte read or `EOF`.
+    */
+    int get()
+    {
+        return m_stream.get();
+    }
+
+
+    /// @brief Get the number of bytes known to be available.
+    /**
+    The length of generic std stream is unknown.
+
+    @return The maximum possible value.
+    */
+    size_t getReadLimit() const
+    {
+        return size_t(-1);
+    }
+
+
+    /// @brief Mark the external stream as failed.
+    void setFail()
+    {
+        m_stream.setstate(std::ios::failbit);
+    }
+
 private:
     hive::IStream &m_stream; ///< @brief The external input stream.
 };
 
 
+/// @brief The binary input stream from memory.
+/**
+Reads binary formatted data directly from the `(ptr, len)` memory block,
+no `std::istream` is involved. The memory block should be valid
+while the stream is used.
+
+All reads are bounds checked. If there is not enough data
+the error flag is set, the stream is moved to the end and
+all subsequent integers are read as zeros. The truncated
+integer, including variable size one, is also read as zero.
+*/
+class SpanIStream:
+    public IStreamBase<SpanIStream>
+{
+    friend class IStreamBase<SpanIStream>;
+public:
+
+    /// @brief The main constructor.
+    /**
+    @param[in] data The begin of memory block.
+    @param[in] len The memory block length in bytes.
+    */
+    SpanIStream(const void *data, size_t len)
+        : m_first(static_cast<const UInt8*>(data))
+        , m_last(m_first + len)
+        , m_pos(m_first)
+        , m_fail(false)
+    {}
+
+public:
+
+    /// @brief Check the error flag.
+    /**
+    @return `true` if any read was out of bounds.
+    */
+    bool fail() const
+    {
+        return m_fail;
+    }
+
+
+    /// @brief Get the current read position.
+    /**
+    @return The number of bytes read so far.
+    */
+    size_t getOffset() const
+    {
+        return m_pos - m_first;
+    }
+
+
+    /// @brief Get the number of bytes left.
+    /**
+    @return The number of bytes available to read.
+    */
+    size_t getRemaining() const
+    {
+        return m_last - m_pos;
+    }
+
+
+    /// @brief Skip the data.
+    /**
+    @param[in] len The number of bytes to skip.
+    @return `false` if there is not enough data.
+    */
+    bool skip(size_t len)
+    {
+        if (getRemaining() < len)
+        {
+            setFail();
+            return false;
+        }
+
+        m_pos += len;
+        return true;
+    }
+
+public:
+
+    /// @copydoc IStreamBase::getUInt32VArray()
+    void getUInt32VArray(UInt32 *vals, size_t n)
+    {
+        getIntXVArray(vals, n);
+    }
+
+
+    /// @copydoc IStreamBase::getUInt64VArray()
+    void getUInt64VArray(UInt64 *vals, size_t n)
+    {
+        getIntXVArray(vals, n);
+    }
+
+
+    /// @copydoc IStreamBase::getInt32VZArray()
+    void getInt32VZArray(Int32 *vals, size_t n)
+    {
+        UInt32 *uvals = reinterpret_cast<UInt32*>(vals);
+        getIntXVArray(uvals, n);
+        for (size_t i = 0; i < n; ++i)
+            vals[i] = (uvals[i]>>1) ^ -Int32(uvals[i]&1);
+    }
+
+
+    /// @copydoc IStreamBase::getInt64VZArray()
+    void getInt64VZArray(Int64 *vals, size_t n)
+    {
+        UInt64 *uvals = reinterpret_cast<UInt64*>(vals);
+        getIntXVArray(uvals, n);
+        for (size_t i = 0; i < n; ++i)
+            vals[i] = (uvals[i]>>1) ^ -Int64(uvals[i]&1);
+    }
+
+private:
+
+    /// @brief Read array of custom integers in variable size format.
+    /**
+    While there are at least 8 bytes left the values are decoded
+    directly from memory without bounds checks: 1 and 2 bytes values
+    are handled first, longer values are decoded from one 64-bits load.
+    The tail of memory block and values longer than getIntXV() accepts
+    (overlong or malformed input) are decoded by the checked scalar code,
+    so both decoders always consume the same number of bytes.
+
+    @param[out] vals The values to read.
+    @param[in] n The number of values.
+    */
+    template<typename UIntX>
+    void getIntXVArray(UIntX *vals, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            const UInt8 *p = m_pos;
+            if (sizeof(UInt64) <= size_t(m_last - p))
+            {
+                if (p[0] < 0x80)        // 1 byte
+                {
+                    vals[i] = p[0];
+                    m_pos = p + 1;
+                    continue;
+                }
+                else if (p[1] < 0x80)   // 2 bytes
+                {
+                    vals[i] = UIntX(p[0]&0x7F) | (UIntX(p[1])<<7);
+                    m_pos = p + 2;
+                    continue;
+                }
+                else                    // up to 8 bytes
+                {
+                    UInt64 val = 0;
+                    const size_t len = decodeWide(p, val);
+                    if (0 < len && len <= (sizeof(UIntX)*8 + 6)/7)
+                    {
+                        vals[i] = UIntX(val);
+                        m_pos = p + len;
+                        continue;
+                    }
+                }
+            }
+
+            // near the end or too long
+            vals[i] = getIntXV<UIntX>();
+        }
+    }
+
+
+    /// @brief Decode integer in variable size format from 8 bytes.
+    /**
+    @param[in] p The data, at least 8 bytes available.
+    @param[out] val The decoded value.
+    @return The number of bytes decoded or zero if value is longer than 8 bytes.
+    */
+    static size_t decodeWide(const UInt8 *p, UInt64 &val)
+    {
+        const UInt64 HI = (UInt64(0x80808080)<<32) | 0x80808080;
+
+        UInt64 w = 0;
+        memcpy(&w, p, sizeof(w));
+        w = misc::le2h(w);
+
+        const UInt64 stop = ~w & HI; // bytes without 'continue' flag
+        if (!stop)
+            return 0;
+
+        // keep bytes up to the first 'stop' byte
+        w &= (stop ^ (stop-1)) & ~HI;
+
+        // compact 7-bits groups
+        UInt64 res = 0;
+        for (size_t g = 0; g < sizeof(UInt64); ++g)
+            res |= (w >> g) & (UInt64(0x7F) << (7*g));
+        val = res;
+
+#if defined(__GNUC__)
+        return (__builtin_ctzll(stop)>>3) + 1;
+#else
+        size_t len = 1;
+        while (!(stop & (UInt64(0x80) << (8*(len-1)))))
+            ++len;
+        return len;
+#endif
+    }
+
+private:
+
+    /// @brief Read raw data.
+    /**
+    The buffer is filled with zeros if there is not enough data.
+
+    @param[out] buf The buffer to read to.
+    @param[in] len The buffer length in bytes.
+    */
+    void read(void *buf, size_t len)
+    {
+        const UInt8 *pos = m_pos;
+        if (0 < len)
+        {
+            if (skip(len))
+                memcpy(buf, pos, len);
+            else
+                memset(buf, 0, len);
+        }
+    }
+
+
+    /// @brief Read one raw byte.
+    /**
+    @return The byte read or `EOF`.
+    */
+    int get()
+    {
+        if (m_pos != m_last)
+            return *m_pos++;
+
+        m_fail = true;
+        return EOF;
+    }
+
+
+    /// @brief Get the number of bytes known to be available.
+    /**
+    @return The number of bytes left.
+    */
+    size_t getReadLimit() const
+    {
+        return getRemaining();
+    }
+
+
+    /// @brief Set the error flag and move to the end.
+    void setFail()
+    {
+        m_pos = m_last;
+        m_fail = true;
+    }
+
+private:
+    const UInt8 *m_first; ///< @brief The begin of memory block.
+    const UInt8 *m_last;  ///< @brief The end of memory block.
+    const UInt8 *m_pos;   ///< @brief The current read position.
+    bool m_fail;          ///< @brief The error flag.
+};
+
+
 /// @brief The binary frame content.
 /**
 This is auxiliary base class for all binary frame formats.
@@ -992,71 +1771,527 @@ public:
 
 public:
 
-    /// @brief Get the frame intent.
+    /// @brief Get the frame intent.
+    /**
+    @return The frame intent or `-1` if it's unknown.
+    */
+    int getIntent() const
+    {
+        if (HEADER_LEN+0+FOOTER_LEN <= m_content.size())
+        {
+            size_t offset = SIGNATURE_LEN+LENGTH_LEN;
+
+            const int id_lsb = m_content[offset++];
+            const int id_msb = m_content[offset++];
+
+            return (id_msb<<8) | id_lsb;
+        }
+
+        return -1; // unknown
+    }
+
+protected:
+
+    /// @brief Calculate the checksum byte.
+    /**
+    @param[in] first The begin of frame data payload.
+    @param[in] last The end of frame data payload.
+    @return The checksum byte.
+    */
+    template<typename In>
+    static UInt8 checksum(In first, In last)
+    {
+        int cs = 0;
+        for (; first != last; ++first)
+            cs += UInt8(*first);
+        return UInt8(0xFF - (cs&0xFF));
+    }
+
+
+    /// @brief Initialize frame content from payload data.
+    /**
+    @param[in] intent The payload intent.
+    @param[in] payload The frame payload data.
+    */
+    template<typename PayloadT>
+    void init(int intent, PayloadT const& payload)
+    {
+        const size_t len = payload.size();
+        assert(len < 255 && "frame data payload too big");
+
+        m_content.reserve(HEADER_LEN+len+FOOTER_LEN);
+
+        // header (signature+length+intent)
+        m_content.push_back(SIGNATURE);         // signature
+        m_content.push_back(len&0xFF);          // length
+        m_content.push_back((intent)&0xFF);     // intent, LSB
+        m_content.push_back((intent>>8)&0xFF);  // intent, MSB
+
+        // insert payload
+        m_content.insert(m_content.end(),
+            payload.begin(), payload.end());
+
+        // checksum
+        m_content.push_back(checksum(
+            m_content.begin(),
+            m_content.end()));
+    }
+};
+
+
+/// @brief The RX/TX capture.
+/**
+Records timestamped RX/TX chunks of a transceiver stream
+to the compact binary format:
+- header: `"HCAP"` signature and the format version (one byte)
+- records: direction (one byte), time delta since the previous
+  record in microseconds (variable size), data length (variable size)
+  and the data itself.
+
+The captured records may be fed back through a transceiver
+using ReplayStream.
+
+@see Transceiver::setCapture()
+*/
+class Capture:
+    private NonCopyable
+{
+    /// @brief The type alias.
+    typedef Capture This;
+
+public:
+
+    /// @brief The chunk direction.
+    enum Direction
+    {
+        DIR_RX = 1, ///< @brief The received data.
+        DIR_TX = 2  ///< @brief The sent data.
+    };
+
+    /// @brief The format version.
+    enum { VERSION = 1 };
+
+
+    /// @brief The captured chunk.
+    class Record
+    {
+    public:
+        int direction; ///< @brief The chunk direction.
+        UInt64 time;   ///< @brief The time since the first record, microseconds.
+        String data;   ///< @brief The chunk data.
+    };
+
+protected:
+
+    /// @brief The main constructor.
+    /**
+    @param[in] os The output stream.
+    @param[in] file The owned file stream. May be NULL.
+    */
+    Capture(hive::OStream &os, boost::shared_ptr<hive::OStream> file)
+        : m_file(file)
+        , m_os(os)
+    {
+        m_os.write("HCAP", 4);
+        m_os.put(char(VERSION));
+    }
+
+public:
+
+    /// @brief The shared pointer type.
+    typedef boost::shared_ptr<This> SharedPtr;
+
+
+    /// @brief The factory method.
+    /**
+    @param[in] os The external output stream.
+        Should be valid while capture is used.
+    @return The new capture instance.
+    */
+    static SharedPtr create(hive::OStream &os)
+    {
+        return SharedPtr(new This(os, boost::shared_ptr<hive::OStream>()));
+    }
+
+
+    /// @brief The factory method (file).
+    /**
+    @param[in] fileName The capture file name.
+    @return The new capture instance.
+    @throw std::runtime_error if file cannot be created.
+    */
+    static SharedPtr create(String const& fileName)
+    {
+        boost::shared_ptr<hive::OStream> file(new std::ofstream(
+            fileName.c_str(), std::ios::binary|std::ios::trunc));
+        if (!*file)
+            throw std::runtime_error("cannot create capture file");
+        return SharedPtr(new This(*file, file));
+    }
+
+public:
+
+    /// @brief Record the chunk.
+    /**
+    @param[in] direction The chunk direction.
+    @param[in] data The chunk data.
+    @param[in] len The chunk length in bytes.
+    */
+    void write(Direction direction, const void *data, size_t len)
+    {
+        const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+        if (m_last.is_not_a_date_time())
+            m_last = now;
+        const boost::posix_time::time_duration delta = now - m_last;
+        m_last = now;
+
+        bin::OStream bs(m_os);
+        bs.putUInt8(direction);
+        bs.putUInt64V(delta.is_negative() ? 0 : delta.total_microseconds());
+        bs.putUInt32V(UInt32(len));
+        bs.putBuffer(data, len);
+    }
+
+
+    /// @brief Flush the output stream.
+    void flush()
+    {
+        m_os.flush();
+    }
+
+public:
+
+    /// @brief Load all records.
+    /**
+    @param[in] is The input stream.
+    @return The records with absolute time.
+    @throw std::runtime_error on invalid or truncated data.
+    */
+    static std::vector<Record> load(hive::IStream &is)
+    {
+        char hdr[5] = { 0 };
+        is.read(hdr, sizeof(hdr));
+        if (!is || 0 != memcmp(hdr, "HCAP", 4) || VERSION != hdr[4])
+            throw std::runtime_error("invalid capture header");
+
+        std::vector<Record> records;
+        bin::IStream bs(is);
+        UInt64 time = 0;
+        while (is.peek() != EOF)
+        {
+            Record rec;
+            rec.direction = bs.getUInt8();
+            time += bs.getUInt64V();
+            rec.time = time;
+
+            const UInt32 len = bs.getUInt32V();
+            if (!bs.getBuffer(rec.data, len, MAX_RECORD_LENGTH) || !is)
+                throw std::runtime_error("truncated capture data");
+            records.push_back(rec);
+        }
+
+        return records;
+    }
+
+
+    /// @brief Load all records from file.
+    /**
+    @param[in] fileName The capture file name.
+    @return The records with absolute time.
+    @throw std::runtime_error on invalid or truncated data.
+    */
+    static std::vector<Record> load(String const& fileName)
+    {
+        std::ifstream file(fileName.c_str(), std::ios::binary);
+        if (!file)
+            throw std::runtime_error("cannot open capture file");
+        return load(file);
+    }
+
+private:
+
+    /// @brief The maximum record length, 16MB.
+    enum { MAX_RECORD_LENGTH = 16*1024*1024 };
+
+private:
+    boost::shared_ptr<hive::OStream> m_file; ///< @brief The owned file stream.
+    hive::OStream &m_os; ///< @brief The output stream.
+    boost::posix_time::ptime m_last; ///< @brief The time of the last record.
+};
+
+
+/// @brief The replay stream.
+/**
+Implements the asynchronous stream interface used by Transceiver:
+RX records of the capture are delivered at the original time
+(optionally accelerated by the speed factor), all written data
+is accepted and counted. The end of capture is reported as `eof`.
+The stalled TX mode (see setTxStalled()) never completes writes
+until cancel(), so the TX timeout of Transceiver can be tested.
+
+This stream is used for deterministic benchmarks of frame parsing:
+~~~{.cpp}
+bin::ReplayStream stream(ios, bin::Capture::load("gw.cap"), 0.0);
+typedef bin::Transceiver<bin::ReplayStream, gateway::Frame> Trx;
+Trx::SharedPtr trx = Trx::create("replay", stream);
+~~~
+
+@see Capture
+*/
+class ReplayStream:
+    private NonCopyable
+{
+    /// @brief The type alias.
+    typedef ReplayStream This;
+
+public:
+    typedef boost::asio::io_service IOService; ///< @brief The IO service type.
+    typedef boost::system::error_code ErrorCode; ///< @brief The error code type.
+
+public:
+
+    /// @brief The main constructor.
+    /**
+    @param[in] ios The IO service.
+    @param[in] records The captured records.
+    @param[in] speed The speed factor: `1.0` is original speed,
+        `2.0` is two times faster, `0.0` is no delays at all.
+    */
+    ReplayStream(IOService &ios, std::vector<Capture::Record> const& records, double speed = 1.0)
+        : m_ios(ios)
+        , m_timer(ios)
+        , m_records(records)
+        , m_speed(speed)
+        , m_next(0)
+        , m_offset(0)
+        , m_txBytes(0)
+        , m_txStalled(false)
+    {}
+
+public:
+
+    /// @brief Get the IO service.
+    /**
+    @return The IO service reference.
+    */
+    IOService& get_io_service()
+    {
+        return m_ios;
+    }
+
+#if BOOST_VERSION >= 106600
+    /// @brief The executor type.
+    typedef boost::asio::io_context::executor_type executor_type;
+
+    /// @brief Get the executor.
+    /**
+    @return The IO service executor.
+    */
+    executor_type get_executor()
+    {
+        return m_ios.get_executor();
+    }
+#endif // BOOST_VERSION
+
+public:
+
+    /// @brief Check the end of capture.
+    /**
+    @return `true` if all RX records are delivered.
+    */
+    bool isEnd()
+    {
+        skipTx();
+        return m_next == m_records.size();
+    }
+
+
+    /// @brief Get the number of written bytes.
+    /**
+    @return The total number of bytes written to the stream.
+    */
+    size_t getTxBytes() const
+    {
+        return m_txBytes;
+    }
+
+
+    /// @brief Enable/disable the stalled TX mode.
+    /**
+    In stalled mode write operations are not completed
+    until cancelled, like a device with blocked flow control.
+
+    @param[in] stalled The stalled TX flag.
+    */
+    void setTxStalled(bool stalled)
+    {
+        m_txStalled = stalled;
+    }
+
+
+    /// @brief Cancel any asynchronous operations.
+    /**
+    The stalled write operation is reported as `operation_aborted`.
+    */
+    void cancel()
+    {
+        m_timer.cancel();
+
+        if (m_txHandler)
+        {
+            m_ios.post(boost::bind<void>(m_txHandler,
+                ErrorCode(boost::asio::error::operation_aborted), 0));
+            m_txHandler.clear();
+        }
+    }
+
+
+    /// @brief Close the stream.
+    /**
+    Cancels all asynchronous operations, the rest of capture is ignored.
+    */
+    void close()
+    {
+        cancel();
+        m_next = m_records.size();
+        m_offset = 0;
+    }
+
+public:
+
+    /// @brief Start asynchronous "read some" operation.
     /**
-    @return The frame intent or `-1` if it's unknown.
+    Waits for the next RX record time if there is no partially
+    delivered record.
+
+    @param[in] bufs The buffers to read to.
+    @param[in] handler The callback functor.
     */
-    int getIntent() const
+    template<typename MutableBufferSequence, typename ReadHandler>
+    void async_read_some(MutableBufferSequence const& bufs, ReadHandler handler)
     {
-        if (HEADER_LEN+0+FOOTER_LEN <= m_content.size())
+        if (isEnd())
         {
-            size_t offset = SIGNATURE_LEN+LENGTH_LEN;
+            m_ios.post(boost::bind<void>(handler,
+                ErrorCode(boost::asio::error::eof), 0));
+            return;
+        }
 
-            const int id_lsb = m_content[offset++];
-            const int id_msb = m_content[offset++];
+        const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+        if (m_start.is_not_a_date_time())
+            m_start = now - toDuration(m_records[m_next].time);
 
-            return (id_msb<<8) | id_lsb;
+        if (0 == m_offset && 0.0 < m_speed)
+        {
+            const boost::posix_time::ptime deadline = m_start + toDuration(m_records[m_next].time);
+            if (now < deadline)
+            {
+                m_timer.expires_at(deadline);
+                m_timer.async_wait(boost::bind(&This::onReadTimer<MutableBufferSequence, ReadHandler>,
+                    this, bufs, handler, boost::asio::placeholders::error));
+                return;
+            }
         }
 
-        return -1; // unknown
+        m_ios.post(boost::bind<void>(handler, ErrorCode(), copy(bufs)));
     }
 
-protected:
 
-    /// @brief Calculate the checksum byte.
+    /// @brief Start asynchronous "write some" operation.
     /**
-    @param[in] first The begin of frame data payload.
-    @param[in] last The end of frame data payload.
-    @return The checksum byte.
+    All data is accepted immediately unless TX is stalled.
+
+    @param[in] bufs The buffers to write.
+    @param[in] handler The callback functor.
     */
-    template<typename In>
-    static UInt8 checksum(In first, In last)
+    template<typename ConstBufferSequence, typename WriteHandler>
+    void async_write_some(ConstBufferSequence const& bufs, WriteHandler handler)
     {
-        int cs = 0;
-        for (; first != last; ++first)
-            cs += UInt8(*first);
-        return UInt8(0xFF - (cs&0xFF));
+        if (m_txStalled)
+        {
+            assert(!m_txHandler && "write operation already in progress");
+            m_txHandler = handler; // wait for cancel
+            return;
+        }
+
+        const size_t len = boost::asio::buffer_size(bufs);
+        m_txBytes += len;
+        m_ios.post(boost::bind<void>(handler, ErrorCode(), len));
     }
 
+private:
 
-    /// @brief Initialize frame content from payload data.
+    /// @brief The RX record time reached.
     /**
-    @param[in] intent The payload intent.
-    @param[in] payload The frame payload data.
+    @param[in] bufs The buffers to read to.
+    @param[in] handler The callback functor.
+    @param[in] err The error code.
     */
-    template<typename PayloadT>
-    void init(int intent, PayloadT const& payload)
+    template<typename MutableBufferSequence, typename ReadHandler>
+    void onReadTimer(MutableBufferSequence bufs, ReadHandler handler, ErrorCode err)
     {
-        const size_t len = payload.size();
-        assert(len < 255 && "frame data payload too big");
+        if (!err && !isEnd())
+            handler(err, copy(bufs));
+        else
+            handler(err ? err : ErrorCode(boost::asio::error::eof), 0);
+    }
 
-        m_content.reserve(HEADER_LEN+len+FOOTER_LEN);
 
-        // header (signature+length+intent)
-        m_content.push_back(SIGNATURE);         // signature
-        m_content.push_back(len&0xFF);          // length
-        m_content.push_back((intent)&0xFF);     // intent, LSB
-        m_content.push_back((intent>>8)&0xFF);  // intent, MSB
+    /// @brief Copy the current RX record data.
+    /**
+    @param[in] bufs The buffers to copy to.
+    @return The number of bytes copied.
+    */
+    template<typename MutableBufferSequence>
+    size_t copy(MutableBufferSequence const& bufs)
+    {
+        String const& data = m_records[m_next].data;
+        const size_t n = boost::asio::buffer_copy(bufs,
+            boost::asio::buffer(data.data() + m_offset,
+                data.size() - m_offset));
 
-        // insert payload
-        m_content.insert(m_content.end(),
-            payload.begin(), payload.end());
+        m_offset += n;
+        if (m_offset == data.size())
+        {
+            m_offset = 0;
+            m_next += 1;
+        }
 
-        // checksum
-        m_content.push_back(checksum(
-            m_content.begin(),
-            m_content.end()));
+        return n;
+    }
+
+
+    /// @brief Skip the TX records.
+    void skipTx()
+    {
+        while (m_next < m_records.size() && 0 == m_offset
+            && Capture::DIR_RX != m_records[m_next].direction)
+                m_next += 1;
+    }
+
+
+    /// @brief Convert the capture time to duration.
+    /**
+    @param[in] time The capture time, microseconds.
+    @return The replay duration.
+    */
+    boost::posix_time::time_duration toDuration(UInt64 time) const
+    {
+        const double t = (0.0 < m_speed) ? (time/m_speed) : 0.0;
+        return boost::posix_time::microseconds(Int64(t));
     }
+
+private:
+    IOService &m_ios; ///< @brief The IO service.
+    boost::asio::deadline_timer m_timer; ///< @brief The RX timer.
+    std::vector<Capture::Record> m_records; ///< @brief The captured records.
+    double m_speed; ///< @brief The speed factor.
+    size_t m_next; ///< @brief The next record index.
+    size_t m_offset; ///< @brief The offset in the next record.
+    size_t m_txBytes; ///< @brief The total number of bytes written.
+    boost::posix_time::ptime m_start; ///< @brief The replay start time.
+    bool m_txStalled; ///< @brief The stalled TX flag.
+    boost::function2<void, ErrorCode, size_t> m_txHandler; ///< @brief The stalled write handler.
 };
 
 
@@ -1064,8 +2299,23 @@ protected:
 /**
 Uses external stream object which may be serial port, tcp socket,
 or something else supported by boost.asio.
+
+The optional timeouts are driven by one timer per transceiver:
+- the RX frame timeout limits the time of partially received frame,
+- the RX gap timeout limits the pause between chunks of one frame,
+- the TX timeout limits one write operation.
+
+When the RX timeout expires the partially received data is dropped,
+so the parser resynchronizes on the next bytes. When the TX timeout
+expires the stream operations are cancelled, the active TX task
+is reported with `timed_out` error and the RX is restarted.
+
+By default each read operation completes as soon as any data is
+available and reads into the free space of RX buffer. The batch
+read mode (see setRxReadSize()) reads up to the given number of bytes
+at once, so all data accumulated in the stream is drained by one
+operation and all complete frames are parsed before the next read.
 */
-// TODO: add the RX/TX timeouts?
 template<typename StreamT, typename FrameT>
 class Transceiver:
     public boost::enable_shared_from_this< Transceiver<StreamT, FrameT> >
@@ -1081,10 +2331,20 @@ protected:
     @param[in] stream The external stream object.
     */
     explicit Transceiver(String const& loggerName, StreamT &stream)
-        : m_rx_in_progress(false)
+        : m_rx_pool(BufferPool::getDefault())
+        , m_rx_in_progress(false)
+        , m_rx_restart(false)
+        , m_rx_min_read(1)
+        , m_rx_max_read(0)
+        , m_rx_reads(0)
+        , m_rx_timeouts(0)
+        , m_rx_dropped(0)
         , m_tx_in_progress(false)
+        , m_tx_timed_out(false)
+        , m_tx_timeouts(0)
         , m_stream(stream)
         , m_log(loggerName)
+        , m_timer(m_stream.get_io_service())
     {}
 
 public:
@@ -1137,6 +2397,134 @@ public:
         return m_stream;
     }
 
+
+    /// @brief Set the RX/TX capture.
+    /**
+    All received and sent chunks are recorded to the capture.
+    To stop capture just pass the NULL pointer to this method.
+
+    @param[in] capture The capture.
+    */
+    void setCapture(Capture::SharedPtr capture)
+    {
+        m_capture = capture;
+    }
+
+
+    /// @brief Get the RX/TX capture.
+    /**
+    @return The capture. May be NULL.
+    */
+    Capture::SharedPtr getCapture() const
+    {
+        return m_capture;
+    }
+
+/// @name Timeouts
+/// @{
+public:
+
+    /// @brief Set the RX frame timeout.
+    /**
+    @param[in] timeout_ms The maximum time of partially received frame,
+        in milliseconds. Zero to disable.
+    */
+    void setRxFrameTimeout(long timeout_ms)
+    {
+        m_rx_frame_timeout = boost::posix_time::milliseconds(timeout_ms);
+        updateTimer();
+    }
+
+
+    /// @brief Set the RX inter-chunk gap timeout.
+    /**
+    @param[in] timeout_ms The maximum pause inside one frame,
+        in milliseconds. Zero to disable.
+    */
+    void setRxGapTimeout(long timeout_ms)
+    {
+        m_rx_gap_timeout = boost::posix_time::milliseconds(timeout_ms);
+        updateTimer();
+    }
+
+
+    /// @brief Set the TX timeout.
+    /**
+    @param[in] timeout_ms The maximum time of one write operation,
+        in milliseconds. Zero to disable.
+    */
+    void setTxTimeout(long timeout_ms)
+    {
+        m_tx_timeout = boost::posix_time::milliseconds(timeout_ms);
+        updateTimer();
+    }
+
+
+    /// @brief Get the number of RX timeouts.
+    /**
+    @return The number of dropped partial frames.
+    */
+    size_t getRxTimeoutCount() const
+    {
+        return m_rx_timeouts;
+    }
+
+
+    /// @brief Get the number of dropped RX bytes.
+    /**
+    @return The total number of bytes dropped by RX timeouts.
+    */
+    size_t getRxDroppedBytes() const
+    {
+        return m_rx_dropped;
+    }
+
+
+    /// @brief Get the number of TX timeouts.
+    /**
+    @return The number of cancelled write operations.
+    */
+    size_t getTxTimeoutCount() const
+    {
+        return m_tx_timeouts;
+    }
+/// @}
+
+/// @name Read mode
+/// @{
+public:
+
+    /// @brief Set the batch read mode.
+    /**
+    Each read operation prepares @a maxRead bytes in the RX buffer
+    and completes once at least @a minRead bytes are received.
+    The @a minRead greater than one is useful for streams of fixed
+    size frames only, since the last frame may be delayed otherwise.
+
+    Takes effect on the next read operation.
+
+    @param[in] minRead The minimum number of bytes per read operation.
+    @param[in] maxRead The maximum number of bytes per read operation.
+        Zero to disable batch read mode.
+    */
+    void setRxReadSize(size_t minRead, size_t maxRead)
+    {
+        m_rx_max_read = maxRead;
+        m_rx_min_read = std::max(size_t(1),
+            maxRead ? std::min(minRead, maxRead) : 1);
+    }
+
+
+    /// @brief Get the number of completed read operations.
+    /**
+    @return The total number of read operations completed successfully.
+    */
+    size_t getRxReadCount() const
+    {
+        return m_rx_reads;
+    }
+/// @}
+
 public:
 
     /// @brief Start listening for the RX frames.
@@ -1154,6 +2542,9 @@ public:
         m_rx_callback = callback;
         if (m_rx_callback)
             asyncReadSome();
+        else if (!m_rx_in_progress)
+            releaseRxBuffer();
+        // else the buffer is released when the active read finished
     }
 
 
@@ -1176,6 +2567,32 @@ public:
             startNextTxTask();
     }
 
+
+    /// @brief Drop the pending TX frames.
+    /**
+    The frames waiting in the TX queue are not written, their callbacks
+    are called with `operation_aborted` error. The active write operation
+    (if any) is not affected.
+
+    Should be called when the stream is reset, otherwise the old frames
+    are written to the reopened stream by the next send() call.
+
+    @return The number of dropped frames.
+    */
+    size_t dropTxQueue()
+    {
+        HIVELOG_TRACE_BLOCK(m_log, "dropTxQueue()");
+
+        std::deque<SendTaskSPtr> tasks;
+        tasks.swap(m_tx_tasks);
+        if (!tasks.empty())
+            HIVELOG_DEBUG(m_log, "drop " << tasks.size() << " pending TX frames");
+
+        for (size_t i = 0; i < tasks.size(); ++i)
+            done(boost::asio::error::operation_aborted, tasks[i]);
+        return tasks.size();
+    }
+
 public:
 
     /// @brief Dump the buffer to string in HEX format.
@@ -1223,19 +2640,48 @@ private:
         if (!m_rx_in_progress)
         {
             m_rx_in_progress = true;
+            if (!m_rx_buf) // borrow from the pool
+                m_rx_buf = m_rx_pool->acquire();
 
-            HIVELOG_DEBUG_STR(m_log, "start async read some");
-            boost::asio::async_read(m_stream, m_rx_buf,
-                boost::asio::transfer_at_least(1),
-                boost::bind(&This::onReadSome, this->shared_from_this(),
-                    boost::asio::placeholders::error,
-                    boost::asio::placeholders::bytes_transferred));
+            if (0 < m_rx_max_read) // batch mode
+            {
+                HIVELOG_DEBUG(m_log, "start async read ["
+                    << m_rx_min_read << ".." << m_rx_max_read << "] bytes");
+                boost::asio::async_read(m_stream, m_rx_buf->prepare(m_rx_max_read),
+                    boost::asio::transfer_at_least(m_rx_min_read),
+                    boost::bind(&This::onReadBatch, this->shared_from_this(),
+                        boost::asio::placeholders::error,
+                        boost::asio::placeholders::bytes_transferred));
+            }
+            else
+            {
+                HIVELOG_DEBUG_STR(m_log, "start async read some");
+                boost::asio::async_read(m_stream, *m_rx_buf,
+                    boost::asio::transfer_at_least(1),
+                    boost::bind(&This::onReadSome, this->shared_from_this(),
+                        boost::asio::placeholders::error,
+                        boost::asio::placeholders::bytes_transferred));
+            }
         }
         else
             HIVELOG_DEBUG_STR(m_log, "async read in progress, do nothing");
     }
 
 
+    /// @brief The batch read operation completed.
+    /**
+    Commits the received data to the RX buffer.
+
+    @param[in] err The error code.
+    @param[in] len The number of bytes transfered.
+    */
+    void onReadBatch(boost::system::error_code err, size_t len)
+    {
+        m_rx_buf->commit(len);
+        onReadSome(err, len);
+    }
+
+
     /// @brief The read operation completed.
     /**
     @param[in] err The error code.
@@ -1251,17 +2697,37 @@ private:
 
         if (!err)
         {
+            m_rx_reads += 1;
             HIVELOG_DEBUG(m_log, "read " << len
                 << " bytes, RX buffer: ["
-                << hexdump(m_rx_buf) << "]");
+                << hexdump(*m_rx_buf) << "]");
+
+            const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+            if (const size_t old = m_rx_buf->size() - len) // partial frame
+            {
+                if (isRxExpired(now))
+                    dropRxData(old, "RX gap/frame timeout");
+            }
+            if (m_rx_buf->size() == len) // new frame
+                m_rx_frame_start = now;
+            m_rx_last = now;
 
-            while (0 < m_rx_buf.size()) // try to parse frames
+            if (m_capture) // record just received chunk
+            {
+                const boost::asio::streambuf::const_buffers_type data = m_rx_buf->data();
+                const String chunk(boost::asio::buffers_begin(data) + (m_rx_buf->size() - len),
+                    boost::asio::buffers_end(data));
+                m_capture->write(Capture::DIR_RX, chunk.data(), chunk.size());
+            }
+
+            while (0 < m_rx_buf->size()) // try to parse frames
             {
                 typename Frame::ParseResult result = Frame::RESULT_SUCCESS;
-                if (FrameSPtr frame = Frame::parseFrame(m_rx_buf, &result))
+                if (FrameSPtr frame = Frame::parseFrame(*m_rx_buf, &result))
                 {
                     HIVELOG_DEBUG(m_log, "new frame parsed: ["
                         << hexdump(frame) << "]");
+                    m_rx_frame_start = now; // the rest is a new frame
                     done(err, frame);
                     // continue;
                 }
@@ -1280,10 +2746,21 @@ private:
                 }
             }
 
-            asyncReadSome(); // continue RX
+            if (m_rx_callback)
+                asyncReadSome(); // continue RX, the buffer is kept
+            else
+                releaseRxBuffer(); // RX is stopped
+            updateTimer();
+        }
+        else if (err == boost::asio::error::operation_aborted && m_rx_restart)
+        {
+            HIVELOG_DEBUG_STR(m_log, "read operation cancelled by TX timeout, restart");
+            m_rx_restart = false;
+            asyncReadSome();
         }
         else
         {
+            releaseRxBuffer();
             if (err == boost::asio::error::operation_aborted)
                 HIVELOG_DEBUG_STR(m_log, "read operation cancelled");
             else
@@ -1295,6 +2772,156 @@ private:
     }
 
 
+    /// @brief Return the empty RX buffer to the pool.
+    /**
+    Called when RX is stopped (by recv() or by error). The buffer is
+    kept between reads of active RX to avoid pool round trip per chunk.
+    The buffer with incomplete frame is kept.
+    */
+    void releaseRxBuffer()
+    {
+        if (m_rx_buf && 0 == m_rx_buf->size())
+            m_rx_buf.reset();
+    }
+
+private:
+
+    /// @brief Get the RX deadline.
+    /**
+    @return The deadline of partially received frame
+        or `not_a_date_time` if there is no such frame.
+    */
+    boost::posix_time::ptime getRxDeadline() const
+    {
+        boost::posix_time::ptime deadline;
+        if (m_rx_buf && 0 < m_rx_buf->size())
+        {
+            if (0 < m_rx_frame_timeout.ticks())
+                deadline = m_rx_frame_start + m_rx_frame_timeout;
+            if (0 < m_rx_gap_timeout.ticks())
+                deadline = earliest(deadline, m_rx_last + m_rx_gap_timeout);
+        }
+
+        return deadline;
+    }
+
+
+    /// @brief Get the TX deadline.
+    /**
+    @return The deadline of active write operation
+        or `not_a_date_time` if there is no such operation.
+    */
+    boost::posix_time::ptime getTxDeadline() const
+    {
+        if (m_tx_in_progress && 0 < m_tx_timeout.ticks())
+            return m_tx_start + m_tx_timeout;
+        return boost::posix_time::ptime();
+    }
+
+
+    /// @brief Get the earliest time.
+    /**
+    @param[in] a The first time.
+    @param[in] b The second time.
+    @return The earliest valid time or `not_a_date_time`.
+    */
+    static boost::posix_time::ptime earliest(boost::posix_time::ptime a, boost::posix_time::ptime b)
+    {
+        if (a.is_not_a_date_time())
+            return b;
+        if (b.is_not_a_date_time())
+            return a;
+        return (b < a) ? b : a;
+    }
+
+
+    /// @brief Check the RX deadline.
+    /**
+    @param[in] now The current time.
+    @return `true` if partially received frame is expired.
+    */
+    bool isRxExpired(boost::posix_time::ptime now) const
+    {
+        const boost::posix_time::ptime deadline = getRxDeadline();
+        return !deadline.is_not_a_date_time() && deadline <= now;
+    }
+
+
+    /// @brief Drop the partially received data.
+    /**
+    @param[in] len The number of bytes to drop.
+    @param[in] reason The reason to log.
+    */
+    void dropRxData(size_t len, const char *reason)
+    {
+        HIVELOG_WARN(m_log, reason << ", " << len
+            << " RX bytes dropped: [" << dump::hex(
+                boost::asio::buffers_begin(m_rx_buf->data()),
+                boost::asio::buffers_begin(m_rx_buf->data()) + len) << "]");
+
+        m_rx_buf->consume(len);
+        m_rx_timeouts += 1;
+        m_rx_dropped += len;
+    }
+
+
+    /// @brief Update the timer.
+    /**
+    The timer is armed for the earliest RX/TX deadline.
+    If the timer is already armed for earlier time it's not changed,
+    the deadlines are checked again once it expires.
+    */
+    void updateTimer()
+    {
+        const boost::posix_time::ptime deadline = earliest(getRxDeadline(), getTxDeadline());
+        if (deadline.is_not_a_date_time())
+        {
+            if (!m_timer_deadline.is_not_a_date_time())
+            {
+                m_timer_deadline = boost::posix_time::ptime();
+                m_timer.cancel();
+            }
+        }
+        else if (m_timer_deadline.is_not_a_date_time() || deadline < m_timer_deadline)
+        {
+            m_timer_deadline = deadline;
+            m_timer.expires_at(deadline);
+            m_timer.async_wait(boost::bind(&This::onTimer,
+                this->shared_from_this(), boost::asio::placeholders::error));
+        }
+    }
+
+
+    /// @brief The timer expired.
+    /**
+    @param[in] err The error code.
+    */
+    void onTimer(boost::system::error_code err)
+    {
+        if (err) // cancelled or re-armed
+            return;
+
+        HIVELOG_TRACE_BLOCK(m_log, "onTimer()");
+        m_timer_deadline = boost::posix_time::ptime();
+        const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+
+        if (isRxExpired(now))
+            dropRxData(m_rx_buf->size(), "RX timeout");
+
+        const boost::posix_time::ptime tx_deadline = getTxDeadline();
+        if (!tx_deadline.is_not_a_date_time() && tx_deadline <= now && !m_tx_timed_out)
+        {
+            HIVELOG_WARN_STR(m_log, "TX timeout, cancel stream operations");
+            m_tx_timeouts += 1;
+            m_tx_timed_out = true;
+            m_rx_restart = m_rx_in_progress;
+            m_stream.cancel();
+        }
+
+        updateTimer();
+    }
+
+
     /// @brief Report new RX frame to the subscriber.
     /**
     @param[in] err The error code.
@@ -1393,6 +3020,9 @@ private:
             << task->frame->size() << " bytes");
 
         m_tx_in_progress = true;
+        m_tx_start = boost::posix_time::microsec_clock::universal_time();
+        updateTimer();
+
         boost::asio::async_write(m_stream,
             boost::asio::buffer(task->frame->getContent()),
             boost::bind(&This::onWriteAll, this->shared_from_this(),
@@ -1413,10 +3043,19 @@ private:
         HIVELOG_TRACE(m_log, "arguments: err="
             << err << ", len=" << len);
         m_tx_in_progress = false;
+        if (m_tx_timed_out)
+        {
+            m_tx_timed_out = false;
+            if (err == boost::asio::error::operation_aborted)
+                err = boost::asio::error::timed_out;
+        }
+        updateTimer();
 
         if (!err)
         {
             HIVELOG_DEBUG(m_log, len << " bytes have been written");
+            if (m_capture && 0 < len)
+                m_capture->write(Capture::DIR_TX, &task->frame->getContent()[0], len);
         }
         else
         {
@@ -1457,12 +3096,36 @@ private:
     /// @brief The RX callback.
     RecvFrameCallback m_rx_callback;
 
+    /// @brief The RX/TX capture. May be NULL.
+    Capture::SharedPtr m_capture;
+
+    /// @brief The RX buffer pool.
+    BufferPool::SharedPtr m_rx_pool;
+
     /// @brief The RX buffer.
-    boost::asio::streambuf m_rx_buf;
+    /**
+    Borrowed from the pool while RX is active
+    or there is incomplete frame data.
+    */
+    BufferPool::StreamBufPtr m_rx_buf;
 
     /// @brief The RX operation "in progress" flag.
     bool m_rx_in_progress;
 
+    /// @brief The RX should be restarted after cancel.
+    bool m_rx_restart;
+
+    size_t m_rx_min_read; ///< @brief The minimum read size in batch mode.
+    size_t m_rx_max_read; ///< @brief The maximum read size, zero for default mode.
+    size_t m_rx_reads; ///< @brief The number of completed read operations.
+
+    boost::posix_time::time_duration m_rx_frame_timeout; ///< @brief The RX frame timeout.
+    boost::posix_time::time_duration m_rx_gap_timeout; ///< @brief The RX gap timeout.
+    boost::posix_time::ptime m_rx_frame_start; ///< @brief The start time of partial frame.
+    boost::posix_time::ptime m_rx_last; ///< @brief The time of the last RX chunk.
+    size_t m_rx_timeouts; ///< @brief The number of RX timeouts.
+    size_t m_rx_dropped; ///< @brief The number of dropped RX bytes.
+
 private:
 
     /// @brief The list of pending TX tasks.
@@ -1471,9 +3134,20 @@ private:
     /// @brief The active TX task.
     bool m_tx_in_progress;
 
+    /// @brief The active TX task is cancelled by timeout.
+    bool m_tx_timed_out;
+
+    boost::posix_time::time_duration m_tx_timeout; ///< @brief The TX timeout.
+    boost::posix_time::ptime m_tx_start; ///< @brief The start time of active TX task.
+    size_t m_tx_timeouts; ///< @brief The number of TX timeouts.
+
 protected:
     StreamT &m_stream; ///< @brief The external stream.
     hive::log::Logger m_log; ///< @brief The logger instance.
+
+private:
+    boost::asio::deadline_timer m_timer; ///< @brief The RX/TX timeouts timer.
+    boost::posix_time::ptime m_timer_deadline; ///< @brief The timer deadline or `not_a_date_time`.
 };
 
     } // bin namespace
@@ -1494,7 +3168,28 @@ Binary streams
 Binary formats. hive::bin::OStream and hive::bin::IStream should
 be used with std::stringstream or boost::asio::streambuf.
 
-Variable size format for unsigned integers.
+hive::bin::BufferOStream and hive::bin::SpanIStream provide the same
+`put*()` and `get*()` methods but work on memory directly: the writer
+appends to a growable byte container and the reader is bounds checked
+over the `(ptr, len)` memory block with the `fail()` flag instead of
+the iostream state. These are preferred by frame codecs.
+
+~~~{.cpp}
+String buf;
+bin::BufferOStream<String> os(buf);
+os.putUInt16LE(0x1234);
+os.putString("hello");
+
+bin::SpanIStream is(buf.data(), buf.size());
+const UInt16 a = is.getUInt16LE();
+const String b = is.getString();
+if (is.fail())
+    ; // not enough data
+~~~
+
+Variable size format for unsigned integers. The arrays of such integers
+could be written and read at once by `put*VArray()` and `get*VArray()`
+methods, which are much faster for the memory streams.
 
 Zig-Zag format for signed integers.
 
@@ -13,6 +13,25 @@
 #   include <string>
 #endif // HIVE_PCH
 
+// HIVE_SSSE3 (see below)
+#if defined(HIVE_DISABLE_SSSE3)
+    // generic code only
+#elif defined(__SSSE3__) || defined(__AVX__) // enabled by compiler flags
+#   define HIVE_SSSE3 1
+#   define HIVE_SSSE3_TARGET
+#   define HIVE_SSSE3_SUPPORTED() true
+#elif (defined(__x86_64__) || defined(__i386__)) \
+    && (defined(__clang__) || 4 < __GNUC__ || (4 == __GNUC__ && 9 <= __GNUC_MINOR__))
+#   define HIVE_SSSE3 1 // runtime dispatch
+#   define HIVE_SSSE3_TARGET __attribute__((target("ssse3")))
+#   define HIVE_SSSE3_SUPPORTED() hive::misc::impl::cpu_has_ssse3()
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#   include <intrin.h>
+#   define HIVE_SSSE3 1 // runtime dispatch
+#   define HIVE_SSSE3_TARGET
+#   define HIVE_SSSE3_SUPPORTED() hive::misc::impl::cpu_has_ssse3()
+#endif // SSSE3
+
 
 /// @brief The main namespace.
 /**
@@ -119,6 +138,67 @@ just to prevent "unreferenced formal parameter" warnings.
 #define HIVE_UNUSED(x)
 #endif // defined(HIVE_DOXY_MODE)
 
+
+// HIVE_SSSE3
+#if defined(HIVE_SSSE3)
+    namespace misc
+    {
+        /// @brief The implementation specific stuff.
+        namespace impl
+        {
+
+/// @brief Check the CPU for SSSE3 instructions.
+/**
+The result is detected once and cached.
+
+@return `true` if SSSE3 is supported.
+*/
+inline bool cpu_has_ssse3()
+{
+#if defined(__SSSE3__) || defined(__AVX__)
+    return true;
+#elif defined(_MSC_VER)
+    struct CPU
+    {
+        static bool ssse3()
+        {
+            int info[4];
+            __cpuid(info, 1);
+            return 0 != (info[2] & (1<<9)); // ECX
+        }
+    };
+    static const bool supported = CPU::ssse3();
+    return supported;
+#else
+    static const bool supported = (__builtin_cpu_init(), 0 != __builtin_cpu_supports("ssse3"));
+    return supported;
+#endif
+}
+
+        } // impl namespace
+    } // misc namespace
+#endif // HIVE_SSSE3
+#if defined(HIVE_DOXY_MODE)
+
+/// @hideinitializer @brief The SSSE3 fast paths are compiled.
+/**
+The SSSE3 code is enabled by compiler flags (`-mssse3`, `-mavx`, etc.)
+or compiled for runtime dispatch: GCC 4.9+ and Clang on x86 use
+`__attribute__((target("ssse3")))`, MSVC on x86 uses intrinsics directly.
+In the latter case the CPU is checked once by #HIVE_SSSE3_SUPPORTED(),
+so the default build uses SSSE3 on the CPUs that have it.
+
+Define `HIVE_DISABLE_SSSE3` to use the generic code only.
+*/
+#define HIVE_SSSE3
+
+/// @hideinitializer @brief The function attribute to compile SSSE3 code.
+#define HIVE_SSSE3_TARGET
+
+/// @hideinitializer @brief Check if the SSSE3 code can be used.
+#define HIVE_SSSE3_SUPPORTED()
+#endif // defined(HIVE_DOXY_MODE)
+
 } // hive namespace
 
 #endif // __HIVE_DEFS_HPP_
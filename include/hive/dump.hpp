@@ -88,6 +88,58 @@ String hex(std::vector<T,A> const& data)
 }
 
 
+/// @brief Dump a contiguous binary buffer to an output stream in *HEX* format.
+/**
+The buffer is converted by blocks and each block is written at once.
+
+@param[in,out] os The output stream.
+@param[in] data The binary data.
+@param[in] len The binary data length in bytes.
+@return The output stream.
+*/
+inline OStream& hex(OStream &os, UInt8 const* data, size_t len)
+{
+    const size_t BLOCK = 256;
+    char buf[2*BLOCK];
+
+    while (0 < len)
+    {
+        const size_t n = (len < BLOCK) ? len : BLOCK;
+        misc::impl::base16_encode_buf(data, n, buf);
+        os.write(buf, 2*n);
+        data += n;
+        len -= n;
+    }
+
+    return os;
+}
+
+
+/// @brief Dump a binary vector to an output stream in *HEX* format.
+/**
+@param[in,out] os The output stream.
+@param[in] data The binary data.
+@return The output stream.
+*/
+template<typename A> inline
+OStream& hex(OStream &os, std::vector<UInt8,A> const& data)
+{
+    return data.empty() ? os : hex(os, &data[0], data.size());
+}
+
+
+/// @brief Dump a binary vector to a string in *HEX* format.
+/**
+@param[in] data The binary data.
+@return The dump in *HEX* format.
+*/
+template<typename A> inline
+String hex(std::vector<UInt8,A> const& data)
+{
+    return misc::base16_encode(data);
+}
+
+
 /// @brief Dump a binary string to an output stream in *HEX* format.
 /**
 @param[in,out] os The output stream.
@@ -96,7 +148,7 @@ String hex(std::vector<T,A> const& data)
 */
 inline OStream& hex(OStream &os, String const& data)
 {
-    return hex(os, data.begin(), data.end());
+    return hex(os, reinterpret_cast<UInt8 const*>(data.data()), data.size());
 }
 
 
@@ -107,7 +159,7 @@ inline OStream& hex(OStream &os, String const& data)
 */
 inline String hex(String const& data)
 {
-    return hex(data.begin(), data.end());
+    return misc::base16_encode(data);
 }
 
 /// @}
@@ -352,6 +404,9 @@ There are two kind of dump functions:
   - hive::dump::ascii() functions are used to dump in *ASCII* format.
 
 In *HEX* format all binary bytes are replaced with two hexadecimal digit (lower case).
+Byte strings and `std::vector<UInt8>` are converted as contiguous buffers
+(by 16-bytes blocks using SSSE3 if supported by CPU, see #HIVE_SSSE3), other containers
+are converted byte by byte.
 
 *ASCII* format uses characters in range [32..127). Any other characters
 are replaced with `bad` placeholder which is '.' by default.
@@ -11,6 +11,7 @@ Some implementation parts is based on urdl library by Christopher M. Kohlhoff.
 
 #include "defs.hpp"
 #include "misc.hpp"
+#include "pool.hpp"
 #include "log.hpp"
 
 #if !defined(HIVE_PCH)
@@ -1194,7 +1195,8 @@ enum Internal
 /// @brief Informational (1xx) codes.
 enum Informational
 {
-    CONTINUE = 100 ///< @hideinitializer @brief 100
+    CONTINUE            = 100, ///< @hideinitializer @brief 100
+    SWITCHING_PROTOCOLS = 101  ///< @hideinitializer @brief 101
 };
 
 
@@ -1223,7 +1225,8 @@ enum ClientError
     BAD_REQUEST  = 400, ///< @hideinitializer @brief 400
     UNAUTHORIZED = 401, ///< @hideinitializer @brief 401
     FORBIDDEN    = 403, ///< @hideinitializer @brief 403
-    NOT_FOUND    = 404  ///< @hideinitializer @brief 404
+    NOT_FOUND    = 404, ///< @hideinitializer @brief 404
+    METHOD_NOT_ALLOWED = 405 ///< @hideinitializer @brief 405
 };
 
 
@@ -1401,7 +1404,9 @@ inline OStream& operator<<(OStream &os, Response const& res)
 /**
 This class represents one connection to the server.
 
-Contains buffer for send/recv operations.
+Contains buffer for send/recv operations. The buffer is borrowed from
+the default buffer pool on first use and may be returned while
+the connection is idle.
 
 - Simple for HTTP connections
 - Secure for HTTPS connections
@@ -1416,7 +1421,7 @@ public:
     typedef boost::system::error_code ErrorCode; ///< @brief The error code type.
     typedef boost::asio::ip::tcp::resolver Resolver; ///< @brief The resolver type.
     typedef boost::asio::ip::tcp::endpoint Endpoint; ///< @brief The endpoint type.
-    typedef boost::asio::streambuf StreamBuf; ///< @brief The stream buffer type.
+    typedef BufferPool::StreamBuf StreamBuf; ///< @brief The stream buffer type.
     typedef boost::asio::mutable_buffers_1 MutableBuffers; ///< @brief The mutable buffers.
     typedef boost::asio::const_buffers_1 ConstBuffers; ///< @brief The constant buffers.
 
@@ -1449,11 +1454,26 @@ public:
 
     /// @brief Get the stream buffer.
     /**
+    The buffer is borrowed from the pool if there is no buffer yet.
+
     @return The stream buffer.
     */
     StreamBuf& getBuffer()
     {
-        return m_buffer;
+        if (!m_buffer)
+            m_buffer = BufferPool::getDefault()->acquire();
+        return *m_buffer;
+    }
+
+
+    /// @brief Return the empty stream buffer to the pool.
+    /**
+    Does nothing if the buffer contains any data.
+    */
+    void releaseBuffer()
+    {
+        if (m_buffer && 0 == m_buffer->size())
+            m_buffer.reset();
     }
 
 
@@ -1550,7 +1570,7 @@ private:
     /**
     This buffer may be used for read/write operations.
     */
-    StreamBuf m_buffer;
+    BufferPool::StreamBufPtr m_buffer;
 
 
     /// @brief The unique identifier.
@@ -2212,6 +2232,7 @@ private:
         if (!task->m_cancelled && isKeepAlive(task))        // if task is cancelled, its connection is closed
         if (ConnectionPtr pconn = task->takeConnection())
         {
+            pconn->releaseBuffer(); // idle
             m_connCache.push_back(pconn);
             HIVELOG_DEBUG(m_log, "Task" << task->getUniqueID()
                 << " - keep-alive Connection" << pconn->getUniqueID()
@@ -429,6 +429,22 @@ public:
         std::swap(m_obj, other.m_obj);
     }
 
+
+    /// @brief Swap the **STRING** value content.
+    /**
+    The value becomes a **STRING** (previous content is dropped)
+    and its string is exchanged with @a str. Useful to move
+    the externally prepared string without copying.
+
+    @param[in,out] str The string to swap with.
+    */
+    void swapString(String &str)
+    {
+        if (m_type != TYPE_STRING)
+            Value(TYPE_STRING).swap(*this);
+        m_str.swap(str);
+    }
+
 #if defined(HIVE_HAS_RVALUE_REFS)
 
     /// @brief The move-constructor.
@@ -2108,6 +2124,200 @@ public:
         return false;
     }
 
+public: // member by member parsing
+
+    /// @brief Parse the beginning of an object or an array.
+    /**
+    Big values can be parsed member by member without building
+    the whole JSON value:
+
+    ~~~{.cpp}
+    Parser::parseBegin(is, '{');
+    String name;
+    for (bool first = true; Parser::parseNextMember(is, first, name); )
+        Parser::parse(is, jval[name]);
+    ~~~
+
+    @param[in,out] is The input stream.
+    @param[in] open The opening character: `{` or `[`.
+    @throw error::SyntaxError if there is no such character.
+    */
+    static void parseBegin(IStream &is, Traits::char_type open)
+    {
+        skipCommentsAndWS(is);
+        const Traits::int_type meta = is.peek();
+        if (Traits::eq_int_type(meta, Traits::eof())
+            || !Traits::eq(Traits::to_char_type(meta), open))
+        {
+            throw error::SyntaxError(Traits::eq(open, '{')
+                ? "no object" : "no array");
+        }
+
+        is.ignore(1); // ignore '{' or '['
+    }
+
+
+    /// @brief Parse the next object member name.
+    /**
+    The member value should be parsed by the caller.
+
+    @param[in,out] is The input stream.
+    @param[in,out] first The first member flag, should be `true` initially.
+    @param[out] name The member name.
+    @return `false` if end of object.
+    @throw error::SyntaxError in case of parsing error.
+    */
+    static bool parseNextMember(IStream &is, bool &first, String &name)
+    {
+        if (!parseNext(is, first, '}', "no member separator"))
+            return false;
+
+        if (!parseString(is, name))
+            throw error::SyntaxError("no member name");
+
+        skipCommentsAndWS(is);
+        if (Traits::eq(Traits::to_char_type(is.peek()), ':'))
+            is.ignore(1);
+        else
+            throw error::SyntaxError("no member value separator");
+
+        return true;
+    }
+
+
+    /// @brief Parse the next array element.
+    /**
+    The element value should be parsed by the caller.
+
+    @param[in,out] is The input stream.
+    @param[in,out] first The first element flag, should be `true` initially.
+    @return `false` if end of array.
+    @throw error::SyntaxError in case of parsing error.
+    */
+    static bool parseNextElement(IStream &is, bool &first)
+    {
+        return parseNext(is, first, ']', "no element separator");
+    }
+
+
+    /// @brief Parse the JSON value as raw text.
+    /**
+    The value is copied as is, no JSON value is created.
+    Only brackets and strings are checked, the value should be
+    parsed later to check the full syntax.
+
+    @param[in,out] is The input stream.
+    @param[out] raw The raw text of the value.
+    @return The input stream.
+    @throw error::SyntaxError in case of parsing error.
+    */
+    static IStream& parseRaw(IStream &is, String &raw)
+    {
+        raw.clear();
+        skipCommentsAndWS(is);
+
+        size_t depth = 0;
+        while (is)
+        {
+            const Traits::int_type meta = is.peek();
+            if (Traits::eq_int_type(meta, Traits::eof()))
+                break; // end of stream
+
+            const Traits::char_type cx = Traits::to_char_type(meta);
+            if (Traits::eq(cx, '\"') || (HIVE_JSON_SINGLE_QUOTED_STRING && Traits::eq(cx, '\'')))
+            {
+                raw.push_back(Traits::to_char_type(is.get()));
+                for (bool escape = false; ; )
+                {
+                    const Traits::int_type m = is.get();
+                    if (Traits::eq_int_type(m, Traits::eof()))
+                        throw error::SyntaxError("cannot parse string");
+
+                    const Traits::char_type ch = Traits::to_char_type(m);
+                    raw.push_back(ch);
+                    if (escape)
+                        escape = false;
+                    else if (Traits::eq(ch, '\\'))
+                        escape = true;
+                    else if (Traits::eq(ch, cx))
+                        break; // end of string
+                }
+
+                if (0 == depth)
+                    break; // end of string value
+            }
+            else if (Traits::eq(cx, '{') || Traits::eq(cx, '['))
+            {
+                raw.push_back(Traits::to_char_type(is.get()));
+                depth += 1;
+            }
+            else if (Traits::eq(cx, '}') || Traits::eq(cx, ']'))
+            {
+                if (0 == depth)
+                    break; // end of the enclosing object or array
+                raw.push_back(Traits::to_char_type(is.get()));
+                if (0 == (depth -= 1))
+                    break; // end of object or array
+            }
+            else if (0 == depth && (Traits::eq(cx, ',') || Traits::eq(cx, ' ')
+                || Traits::eq(cx, '\t') || Traits::eq(cx, '\r') || Traits::eq(cx, '\n')))
+            {
+                break; // end of primitive value
+            }
+            else
+                raw.push_back(Traits::to_char_type(is.get()));
+        }
+
+        if (0 != depth)
+            throw error::SyntaxError("unexpected end of value");
+        if (raw.empty())
+            throw error::SyntaxError("no valid JSON value");
+
+        return is;
+    }
+
+private:
+
+    /// @brief Parse the member or element separator.
+    /**
+    @param[in,out] is The input stream.
+    @param[in,out] first The first member or element flag.
+    @param[in] close The closing character: `}` or `]`.
+    @param[in] hint The error message if there is no separator.
+    @return `false` if end of object or array.
+    @throw error::SyntaxError in case of parsing error.
+    */
+    static bool parseNext(IStream &is, bool &first, Traits::char_type close, const char *hint)
+    {
+        skipCommentsAndWS(is);
+        Traits::int_type meta = is.peek();
+        if (Traits::eq_int_type(meta, Traits::eof()))
+            throw error::SyntaxError("unexpected end of value");
+
+        if (Traits::eq(Traits::to_char_type(meta), close))
+        {
+            is.ignore(1); // ignore '}' or ']'
+            return false; // end of object or array
+        }
+
+        if (!first) // check separator
+        {
+            if (Traits::eq(Traits::to_char_type(meta), ','))
+            {
+                is.ignore(1); // ingore ','
+                skipCommentsAndWS(is);
+            }
+            else
+                throw error::SyntaxError(hint);
+        }
+        else
+            first = false;
+
+        return true;
+    }
+
+public:
+
 
     /// @brief Parse quoted or simple string from an input stream.
     /**
@@ -8,10 +8,24 @@
 #include "defs.hpp"
 
 #if !defined(HIVE_PCH)
+#   include <boost/date_time/posix_time/posix_time_types.hpp>
 #   include <sstream>
 #   include <vector>
 #endif // HIVE_PCH
 
+#if defined(WIN32) || defined(_WIN32) // win
+#   include <process.h>
+#   define HIVE_MISC_GETPID() _getpid()
+#else // posix
+#   include <unistd.h>
+#   define HIVE_MISC_GETPID() getpid()
+#endif // WIN32
+
+// SIMD codecs for contiguous buffers
+#if defined(HIVE_SSSE3)
+#   include <tmmintrin.h>
+#endif // HIVE_SSSE3
+
 namespace hive
 {
     namespace misc
@@ -240,6 +254,296 @@ inline String url_decode(String const& str)
 /// @}
 
 
+        /// @brief The implementation specific stuff.
+        namespace impl
+        {
+
+/// @brief Get the base64 decoding table.
+/**
+@return The table of 256 items: 6-bits value or -1 for invalid characters.
+*/
+inline Int8 const* base64_dtable()
+{
+    static const Int8 TABLE[] =
+    {
+        -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,
+        -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,
+        -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,62,  -1,-1,-1,63,
+        52,53,54,55,  56,57,58,59,  60,61,-1,-1,  -1,-1,-1,-1,
+        -1, 0, 1, 2,   3, 4, 5, 6,   7, 8, 9,10,  11,12,13,14,
+        15,16,17,18,  19,20,21,22,  23,24,25,-1,  -1,-1,-1,-1,
+        -1,26,27,28,  29,30,31,32,  33,34,35,36,  37,38,39,40,
+        41,42,43,44,  45,46,47,48,  49,50,51,-1,  -1,-1,-1,-1,
+        -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,
+        -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,
+        -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,
+        -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,
+        -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,
+        -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,
+        -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,
+        -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1
+    };
+
+    return TABLE;
+}
+
+
+#if defined(HIVE_SSSE3)
+/// @brief Encode base16 by 16-bytes blocks using SSSE3 nibble lookup.
+/**
+@param[in] in The input buffer.
+@param[in] len The input buffer length in bytes.
+@param[out] out The output buffer, at least `2*len` characters.
+@return The number of input bytes processed, multiple of 16.
+*/
+HIVE_SSSE3_TARGET
+inline size_t base16_encode_ssse3(UInt8 const* in, size_t len, char* out)
+{
+    UInt8 const* const start = in;
+    const __m128i lut = _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7',
+                                      '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+    const __m128i mask = _mm_set1_epi8(0x0F);
+    for (; 16 <= len; len -= 16, in += 16, out += 32)
+    {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<__m128i const*>(in));
+        const __m128i hi = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(x, 4), mask));
+        const __m128i lo = _mm_shuffle_epi8(lut, _mm_and_si128(x, mask));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out +  0), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+
+    return in - start;
+}
+#endif // HIVE_SSSE3
+
+
+/// @brief Encode the contiguous binary buffer to base16.
+/**
+Uses SSSE3 nibble lookup by 16-bytes blocks if supported.
+
+@param[in] in The input buffer.
+@param[in] len The input buffer length in bytes.
+@param[out] out The output buffer, at least `2*len` characters.
+@return The end of output buffer.
+*/
+inline char* base16_encode_buf(UInt8 const* in, size_t len, char* out)
+{
+    const char DIGITS[] = "0123456789abcdef";
+
+#if defined(HIVE_SSSE3)
+    if (HIVE_SSSE3_SUPPORTED())
+    {
+        const size_t n = base16_encode_ssse3(in, len, out);
+        in += n;
+        len -= n;
+        out += 2*n;
+    }
+#endif // HIVE_SSSE3
+
+    for (; 0 < len; --len)
+    {
+        const unsigned int x = *in++;
+        *out++ = DIGITS[(x>>4)&0x0F]; // high nibble
+        *out++ = DIGITS[x&0x0F];      // low nibble
+    }
+
+    return out;
+}
+
+
+#if defined(HIVE_SSSE3)
+/// @brief Encode base64 by 12-bytes blocks using SSSE3.
+/**
+@param[in] in The input buffer.
+@param[in] len The input buffer length in bytes.
+@param[out] out The output buffer, at least `4*(len/3)` characters.
+@return The number of input bytes processed, multiple of 12.
+*/
+HIVE_SSSE3_TARGET
+inline size_t base64_encode_ssse3(UInt8 const* in, size_t len, char* out)
+{
+    UInt8 const* const start = in;
+
+    // each block loads 16 bytes but uses only the first 12
+    const __m128i split = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    const __m128i shift = _mm_setr_epi8('a'-26, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52,
+        '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '+'-62, '/'-63, 'A', 0, 0);
+    for (; 16 <= len; len -= 12, in += 12, out += 16)
+    {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<__m128i const*>(in));
+        x = _mm_shuffle_epi8(x, split); // [b1 b0 b2 b1] for each 3 bytes
+
+        // unpack 6-bits indices
+        const __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(x,
+            _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040));
+        const __m128i t1 = _mm_mullo_epi16(_mm_and_si128(x,
+            _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010));
+        const __m128i idx = _mm_or_si128(t0, t1);
+
+        // map each range to its ASCII offset
+        __m128i r = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+        const __m128i lt26 = _mm_cmpgt_epi8(_mm_set1_epi8(26), idx);
+        r = _mm_or_si128(r, _mm_and_si128(lt26, _mm_set1_epi8(13)));
+        r = _mm_add_epi8(_mm_shuffle_epi8(shift, r), idx);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), r);
+    }
+
+    return in - start;
+}
+#endif // HIVE_SSSE3
+
+
+/// @brief Encode the contiguous binary buffer to base64.
+/**
+Encodes complete 3-bytes groups only, the tail (and padding)
+should be processed by the generic base64_encode().
+Uses SSSE3 by 12-bytes blocks if supported.
+
+@param[in] in The input buffer.
+@param[in] len The input buffer length in bytes.
+@param[out] out The output buffer, at least `4*(len/3)` characters.
+@return The number of input bytes processed, multiple of 3.
+*/
+inline size_t base64_encode_buf(UInt8 const* in, size_t len, char* out)
+{
+    const char TABLE[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    UInt8 const* const start = in;
+
+#if defined(HIVE_SSSE3)
+    if (HIVE_SSSE3_SUPPORTED())
+    {
+        const size_t n = base64_encode_ssse3(in, len, out);
+        in += n;
+        len -= n;
+        out += 4*(n/3);
+    }
+#endif // HIVE_SSSE3
+
+    for (; 3 <= len; len -= 3, in += 3, out += 4)
+    {
+        const UInt32 x = (UInt32(in[0])<<16)
+                       | (UInt32(in[1])<<8)
+                       |  UInt32(in[2]);
+
+        out[0] = TABLE[(x>>18)&0x3F];
+        out[1] = TABLE[(x>>12)&0x3F];
+        out[2] = TABLE[(x>>6)&0x3F];
+        out[3] = TABLE[x&0x3F];
+    }
+
+    return in - start;
+}
+
+
+#if defined(HIVE_SSSE3)
+/// @brief Decode base64 by 16-characters blocks using SSSE3.
+/**
+Stops on the first block with padding or invalid characters.
+
+@param[in] in The input buffer.
+@param[in] len The input buffer length in characters.
+@param[out] out The output buffer, at least `3*(len/4)` bytes.
+@return The number of input characters processed, multiple of 16.
+*/
+HIVE_SSSE3_TARGET
+inline size_t base64_decode_ssse3(char const* in, size_t len, UInt8* out)
+{
+    char const* const start = in;
+
+    // valid characters: bit (1<<hi_nibble) in mask[lo_nibble]
+    const __m128i mask_lut = _mm_setr_epi8(
+        char(0xA8), char(0xF8), char(0xF8), char(0xF8),
+        char(0xF8), char(0xF8), char(0xF8), char(0xF8),
+        char(0xF8), char(0xF8), char(0xF0), char(0x54),
+        char(0x50), char(0x50), char(0x50), char(0x54));
+    const __m128i bit_lut = _mm_setr_epi8(0x01, 0x02, 0x04, 0x08,
+        0x10, 0x20, 0x40, char(0x80), 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i shift_lut = _mm_setr_epi8(0, 0, 19, 4, -65, -65, -71, -71,
+        0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8,
+        14, 13, 12, -1, -1, -1, -1);
+
+    // each block stores 16 bytes but produces only 12,
+    // so keep at least 8 characters (6 bytes) for the scalar tail
+    for (; 24 <= len; len -= 16, in += 16, out += 12)
+    {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<__m128i const*>(in));
+        const __m128i hi = _mm_and_si128(_mm_srli_epi32(x, 4), _mm_set1_epi8(0x0F));
+        const __m128i lo = _mm_and_si128(x, _mm_set1_epi8(0x0F));
+
+        const __m128i m = _mm_and_si128(_mm_shuffle_epi8(mask_lut, lo),
+            _mm_shuffle_epi8(bit_lut, hi));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(m, _mm_setzero_si128())))
+            break; // padding or invalid data
+
+        // '/' shares high nibble with '+'
+        const __m128i is_slash = _mm_cmpeq_epi8(x, _mm_set1_epi8('/'));
+        const __m128i sh = _mm_or_si128(
+            _mm_andnot_si128(is_slash, _mm_shuffle_epi8(shift_lut, hi)),
+            _mm_and_si128(is_slash, _mm_set1_epi8(16)));
+        const __m128i v = _mm_add_epi8(x, sh);
+
+        // [00aaaaaa][00bbbbbb][00cccccc][00dddddd] => [xxxxxxxx][yyyyyyyy][zzzzzzzz]
+        const __m128i ab = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+        const __m128i abcd = _mm_madd_epi16(ab, _mm_set1_epi32(0x00011000));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+            _mm_shuffle_epi8(abcd, pack));
+    }
+
+    return in - start;
+}
+#endif // HIVE_SSSE3
+
+
+/// @brief Decode the contiguous base64 buffer.
+/**
+Decodes complete 4-characters groups without padding and stops
+on the first group with padding or invalid characters,
+the rest should be processed by the generic base64_decode().
+Uses SSSE3 by 16-characters blocks if supported.
+
+@param[in] in The input buffer.
+@param[in] len The input buffer length in characters.
+@param[out] out The output buffer, at least `3*(len/4)` bytes.
+@return The number of input characters processed, multiple of 4.
+*/
+inline size_t base64_decode_buf(char const* in, size_t len, UInt8* out)
+{
+    Int8 const* TABLE = base64_dtable();
+    char const* const start = in;
+
+#if defined(HIVE_SSSE3)
+    if (HIVE_SSSE3_SUPPORTED())
+    {
+        const size_t n = base64_decode_ssse3(in, len, out);
+        in += n;
+        len -= n;
+        out += 3*(n/4);
+    }
+#endif // HIVE_SSSE3
+
+    for (; 4 <= len; len -= 4, in += 4, out += 3)
+    {
+        const int a = TABLE[UInt8(in[0])];
+        const int b = TABLE[UInt8(in[1])];
+        const int c = TABLE[UInt8(in[2])];
+        const int d = TABLE[UInt8(in[3])];
+        if ((a|b|c|d) < 0)
+            break; // padding or invalid data
+
+        const UInt32 x = (a<<18) | (b<<12) | (c<<6) | d;
+        out[0] = UInt8(x>>16);
+        out[1] = UInt8(x>>8);
+        out[2] = UInt8(x);
+    }
+
+    return in - start;
+}
+
+        } // impl namespace
+
+
 /// @name Base16 encoding
 /// @{
 
@@ -328,6 +632,23 @@ String base16_encode(std::vector<T,A> const& data)
 }
 
 
+/// @brief Encode the binary vector.
+/**
+Uses the contiguous buffer fast path.
+
+@param[in] data The input data.
+@return The base16 data.
+*/
+template<typename A> inline
+String base16_encode(std::vector<UInt8,A> const& data)
+{
+    String buf(data.size()*2, '\0');
+    if (!data.empty())
+        impl::base16_encode_buf(&data[0], data.size(), &buf[0]);
+    return buf;
+}
+
+
 /// @brief Encode the custom binary string.
 /**
 @param[in] data The input data.
@@ -335,7 +656,13 @@ String base16_encode(std::vector<T,A> const& data)
 */
 inline String base16_encode(String const& data)
 {
-    return base16_encode(data.begin(), data.end());
+    String buf(data.size()*2, '\0');
+    if (!data.empty())
+    {
+        impl::base16_encode_buf(reinterpret_cast<UInt8 const*>(data.data()),
+            data.size(), &buf[0]);
+    }
+    return buf;
 }
 
 
@@ -425,26 +752,7 @@ The output buffer should be 4/3 times less than input buffer.
 template<typename In, typename Out>
 Out base64_decode(In first, In last, Out out)
 {
-    const Int8 TABLE[] =
-    {
-        -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,
-        -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,
-        -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,62,  -1,-1,-1,63,
-        52,53,54,55,  56,57,58,59,  60,61,-1,-1,  -1,-1,-1,-1,
-        -1, 0, 1, 2,   3, 4, 5, 6,   7, 8, 9,10,  11,12,13,14,
-        15,16,17,18,  19,20,21,22,  23,24,25,-1,  -1,-1,-1,-1,
-        -1,26,27,28,  29,30,31,32,  33,34,35,36,  37,38,39,40,
-        41,42,43,44,  45,46,47,48,  49,50,51, 1,  -1,-1,-1,-1,
-        -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,
-        -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,
-        -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,
-        -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,
-        -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,
-        -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,
-        -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,
-        -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1,  -1,-1,-1,-1
-    };
-
+    Int8 const* TABLE = impl::base64_dtable();
 
     // [aaaaaa][bbbbbb][cccccc][dddddd] => [xxxxxxxx][yyyyyyyy][zzzzzzzz]
     // [aaaaaa][bbbbbb][cccc00][=]      => [xxxxxxxx][yyyyyyyy]
@@ -526,6 +834,43 @@ String base64_encode(std::vector<T,A> const& data)
 }
 
 
+/// @brief Encode the contiguous binary buffer.
+/**
+Complete 3-bytes groups are processed by the fast path,
+the tail is processed by the generic base64_encode().
+
+@param[in] data The input data.
+@param[in] len The input data length in bytes.
+@return The base64 data.
+*/
+inline String base64_encode(UInt8 const* data, size_t len)
+{
+    const size_t olen = ((len+2)/3)*4; // ceil(4/3*len)
+
+    String buf(olen, '\0');
+    if (0 < len)
+    {
+        const size_t n = impl::base64_encode_buf(data, len, &buf[0]);
+        buf.erase(base64_encode(data + n, data + len,
+            buf.begin() + (n/3)*4), buf.end());
+    }
+    return buf;
+}
+
+
+/// @brief Encode the binary vector.
+/**
+@param[in] data The input data.
+@return The base64 data.
+*/
+template<typename A> inline
+String base64_encode(std::vector<UInt8,A> const& data)
+{
+    return data.empty() ? String()
+        : base64_encode(&data[0], data.size());
+}
+
+
 /// @brief Encode the custom binary string.
 /**
 @param[in] data The input data.
@@ -533,7 +878,7 @@ String base64_encode(std::vector<T,A> const& data)
 */
 inline String base64_encode(String const& data)
 {
-    return base64_encode(data.begin(), data.end());
+    return base64_encode(reinterpret_cast<UInt8 const*>(data.data()), data.size());
 }
 
 
@@ -549,11 +894,46 @@ inline std::vector<UInt8> base64_decode(String const& data)
     const size_t olen = ((ilen+3)/4)*3; // ceil(3/4*len)
 
     std::vector<UInt8> buf(olen);
-    buf.erase(base64_decode(data.begin(),
-        data.end(), buf.begin()), buf.end());
+    if (0 < ilen)
+    {
+        // padding and invalid data are processed by the generic version
+        const size_t n = impl::base64_decode_buf(data.data(), ilen, &buf[0]);
+        buf.erase(base64_decode(data.begin() + n, data.end(),
+            buf.begin() + (n/4)*3), buf.end());
+    }
     return buf;
 }
 
+/// @}
+
+
+/// @name Random
+/// @{
+
+/// @brief Get the random generator seed.
+/**
+Combines the current time, the process identifier and the custom salt,
+so different processes and different objects started at the same
+time get different random sequences.
+
+@param[in] salt The custom salt, usually the object address.
+@return The seed value.
+*/
+inline UInt32 random_seed(const void *salt)
+{
+    using namespace boost::posix_time;
+    const ptime epoch(boost::gregorian::date(1970, 1, 1));
+    const UInt64 t = UInt64((microsec_clock::universal_time() - epoch).total_microseconds());
+    const UInt64 a = UInt64(reinterpret_cast<size_t>(salt));
+    const UInt64 p = UInt64(HIVE_MISC_GETPID());
+
+    UInt64 x = t ^ (a << 16) ^ (p << 40) ^ (p << 8);
+    x ^= x >> 33; // mix bits (MurmurHash3 finalizer)
+    x *= UInt64(0xff51afd7ed558ccdULL);
+    x ^= x >> 33;
+    return UInt32(x) ^ UInt32(x >> 32);
+}
+
 /// @}
 
     } // misc namespace
@@ -15,8 +15,14 @@ Defines #HIVE_PCH macro if precompiled headers are enabled.
 #include <boost/smart_ptr.hpp>
 #include <boost/function.hpp>
 #include <boost/cstdint.hpp>
+#include <boost/crc.hpp>
 #include <boost/thread.hpp>
 #include <boost/asio.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+#include <boost/random/uniform_real_distribution.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 #include <boost/bind.hpp>
 
 // STL
@@ -31,6 +37,7 @@ Defines #HIVE_PCH macro if precompiled headers are enabled.
 #include <vector>
 #include <string>
 #include <limits>
+#include <cstdlib>
 #include <deque>
 #include <queue>
 #include <list>
@@ -0,0 +1,426 @@
+/** @file
+@brief The stream buffer pool.
+@author Sergey Polichnoy <sergey.polichnoy@dataart.com>
+@see @ref page_hive_pool
+*/
+#ifndef __HIVE_POOL_HPP_
+#define __HIVE_POOL_HPP_
+
+#include "defs.hpp"
+
+#if !defined(HIVE_PCH)
+#   include <boost/enable_shared_from_this.hpp>
+#   include <boost/shared_ptr.hpp>
+#   include <boost/weak_ptr.hpp>
+#   include <boost/thread.hpp>
+#   include <boost/asio.hpp>
+#   include <boost/bind.hpp>
+#   include <streambuf>
+#   include <vector>
+#endif // HIVE_PCH
+
+#include <boost/version.hpp>
+
+
+namespace hive
+{
+
+/// @brief The pool of stream buffers.
+/**
+Shares `boost::asio::streambuf` objects between components which
+need a buffer only from time to time: transceivers, HTTP connections, etc.
+
+The acquired buffer is returned to the pool automatically once
+the last shared pointer is released. Idle buffers are grouped by
+capacity classes (512 bytes, 4KB, 32KB and 256KB). Buffers grown
+beyond the largest class or exceeding the idle memory limit
+are destroyed, so memory is given back after a load burst.
+
+The pool is thread-safe.
+
+@see @ref page_hive_pool
+*/
+class BufferPool:
+    public boost::enable_shared_from_this<BufferPool>,
+    private NonCopyable
+{
+    /// @brief The type alias.
+    typedef BufferPool This;
+
+public:
+
+    /// @brief The stream buffer type.
+    typedef boost::asio::streambuf StreamBuf;
+
+    /// @brief The stream buffer shared pointer type.
+    typedef boost::shared_ptr<StreamBuf> StreamBufPtr;
+
+    /// @brief The capacity classes.
+    enum
+    {
+        MIN_CLASS_SIZE = 512, ///< @brief The smallest capacity class.
+        NUM_CLASSES = 4       ///< @brief The number of capacity classes, x8 each.
+    };
+
+protected:
+
+    /// @brief The main constructor.
+    /**
+    @param[in] maxIdleBytes The maximum total capacity of idle buffers.
+    */
+    explicit BufferPool(size_t maxIdleBytes)
+        : m_maxIdleBytes(maxIdleBytes)
+        , m_idleBytes(0)
+        , m_inUseBytes(0)
+        , m_inUseCount(0)
+        , m_acquired(0)
+        , m_hits(0)
+        , m_dropped(0)
+    {}
+
+public:
+
+    /// @brief The destructor.
+    /**
+    Destroys all idle buffers.
+    */
+    ~BufferPool()
+    {
+        for (int k = 0; k < NUM_CLASSES; ++k)
+        {
+            for (size_t i = 0; i < m_idle[k].size(); ++i)
+                delete m_idle[k][i];
+        }
+    }
+
+public:
+
+    /// @brief The shared pointer type.
+    typedef boost::shared_ptr<This> SharedPtr;
+
+
+    /// @brief The factory method.
+    /**
+    @param[in] maxIdleBytes The maximum total capacity of idle buffers.
+    @return The new buffer pool.
+    */
+    static SharedPtr create(size_t maxIdleBytes = 1024*1024)
+    {
+        return SharedPtr(new This(maxIdleBytes));
+    }
+
+
+    /// @brief Get the default buffer pool.
+    /**
+    This pool is used by transceivers and HTTP connections.
+
+    @return The process-wide buffer pool.
+    */
+    static SharedPtr getDefault()
+    {
+        static SharedPtr pool = create();
+        return pool;
+    }
+
+public:
+
+    /// @brief Acquire a buffer.
+    /**
+    The idle buffer of the smallest class which is able to hold
+    @a sizeHint bytes is preferred. If there is no such buffer
+    the biggest smaller one is used. If pool is empty
+    the new buffer is created.
+
+    The buffer is empty and returned to the pool automatically.
+
+    @param[in] sizeHint The expected data size in bytes.
+    @return The stream buffer.
+    */
+    StreamBufPtr acquire(size_t sizeHint = 0)
+    {
+        StreamBuf *sb = 0;
+        size_t cap = 0;
+
+        { // take from the pool
+            boost::lock_guard<boost::mutex> guard(m_mutex);
+            const int hint = getClass(sizeHint);
+            const int first = (0 <= hint) ? hint : (NUM_CLASSES-1);
+            for (int k = first; !sb && k < NUM_CLASSES; ++k)
+                sb = take(k, cap);
+            for (int k = first-1; !sb && 0 <= k; --k)
+                sb = take(k, cap);
+
+            m_acquired += 1;
+            m_hits += sb ? 1 : 0;
+            m_inUseCount += 1;
+            m_inUseBytes += cap;
+        }
+
+        if (!sb)
+            sb = new StreamBuf();
+
+        return StreamBufPtr(sb, boost::bind(&This::recycle,
+            boost::weak_ptr<This>(shared_from_this()), _1, cap));
+    }
+
+
+    /// @brief Destroy all idle buffers.
+    void trim()
+    {
+        boost::lock_guard<boost::mutex> guard(m_mutex);
+        for (int k = 0; k < NUM_CLASSES; ++k)
+        {
+            for (size_t i = 0; i < m_idle[k].size(); ++i)
+                delete m_idle[k][i];
+            m_dropped += m_idle[k].size();
+            m_idle[k].clear();
+        }
+        m_idleBytes = 0;
+    }
+
+/// @name Counters
+/// @{
+public:
+
+    /// @brief Get the number of buffers in use.
+    /**
+    @return The number of acquired and not yet returned buffers.
+    */
+    size_t getInUseCount() const
+    {
+        boost::lock_guard<boost::mutex> guard(m_mutex);
+        return m_inUseCount;
+    }
+
+
+    /// @brief Get the bytes in use.
+    /**
+    The buffer capacity is known at the moment of acquisition,
+    so buffers growing while in use are counted by the initial capacity.
+
+    @return The total capacity of buffers in use.
+    */
+    size_t getInUseBytes() const
+    {
+        boost::lock_guard<boost::mutex> guard(m_mutex);
+        return m_inUseBytes;
+    }
+
+
+    /// @brief Get the idle bytes.
+    /**
+    @return The total capacity of idle buffers kept by the pool.
+    */
+    size_t getIdleBytes() const
+    {
+        boost::lock_guard<boost::mutex> guard(m_mutex);
+        return m_idleBytes;
+    }
+
+
+    /// @brief Get the number of acquisitions.
+    /**
+    @return The total number of acquire() calls.
+    */
+    size_t getAcquiredCount() const
+    {
+        boost::lock_guard<boost::mutex> guard(m_mutex);
+        return m_acquired;
+    }
+
+
+    /// @brief Get the number of dropped buffers.
+    /**
+    @return The total number of destroyed buffers returned to the pool.
+    */
+    size_t getDroppedCount() const
+    {
+        boost::lock_guard<boost::mutex> guard(m_mutex);
+        return m_dropped;
+    }
+
+
+    /// @brief Get the pool hit rate.
+    /**
+    @return The part of acquisitions served by idle buffers, in range [0..1].
+    */
+    double getHitRate() const
+    {
+        boost::lock_guard<boost::mutex> guard(m_mutex);
+        return m_acquired ? double(m_hits)/m_acquired : 0.0;
+    }
+/// @}
+
+public:
+
+    /// @brief Get the stream buffer capacity.
+    /**
+    Uses `capacity()` if provided by boost (1.66+). Otherwise
+    the end of the last prepared area is used which may be
+    less than the real capacity.
+
+    @param[in] sb The stream buffer.
+    @return The capacity in bytes.
+    */
+    static size_t capacity(StreamBuf const& sb)
+    {
+#if BOOST_VERSION >= 106600
+        return sb.capacity();
+#else
+        return Access::reserved(const_cast<StreamBuf&>(sb));
+#endif // BOOST_VERSION
+    }
+
+private:
+
+    /// @brief Get the capacity class.
+    /**
+    @param[in] cap The capacity in bytes.
+    @return The capacity class index or -1 if it's too big.
+    */
+    static int getClass(size_t cap)
+    {
+        size_t limit = MIN_CLASS_SIZE;
+        for (int k = 0; k < NUM_CLASSES; ++k, limit *= 8)
+        {
+            if (cap <= limit)
+                return k;
+        }
+
+        return -1; // too big
+    }
+
+
+    /// @brief Take an idle buffer of the capacity class.
+    /**
+    Should be called under the lock.
+
+    @param[in] k The capacity class index.
+    @param[out] cap The buffer capacity.
+    @return The idle buffer or NULL.
+    */
+    StreamBuf* take(int k, size_t &cap)
+    {
+        if (m_idle[k].empty())
+            return 0;
+
+        StreamBuf *sb = m_idle[k].back();
+        m_idle[k].pop_back();
+
+        cap = capacity(*sb);
+        m_idleBytes -= cap;
+        return sb;
+    }
+
+
+    /// @brief Put the buffer back to the pool.
+    /**
+    @param[in] sb The buffer to put.
+    @param[in] acquiredCap The buffer capacity at acquisition.
+    */
+    void put(StreamBuf *sb, size_t acquiredCap)
+    {
+        sb->consume(sb->size());
+        const size_t cap = capacity(*sb);
+        const int k = getClass(cap);
+
+        {
+            boost::lock_guard<boost::mutex> guard(m_mutex);
+            m_inUseCount -= 1;
+            m_inUseBytes -= acquiredCap;
+
+            if (0 <= k && m_idleBytes + cap <= m_maxIdleBytes)
+            {
+                m_idle[k].push_back(sb);
+                m_idleBytes += cap;
+                return;
+            }
+
+            m_dropped += 1;
+        }
+
+        delete sb;
+    }
+
+
+    /// @brief Return the buffer to the pool.
+    /**
+    This is the custom deleter of acquired buffers.
+    If the pool is already destroyed the buffer is just deleted.
+
+    @param[in] wpool The pool.
+    @param[in] sb The buffer to return.
+    @param[in] acquiredCap The buffer capacity at acquisition.
+    */
+    static void recycle(boost::weak_ptr<This> wpool, StreamBuf *sb, size_t acquiredCap)
+    {
+        if (SharedPtr pool = wpool.lock())
+            pool->put(sb, acquiredCap);
+        else
+            delete sb;
+    }
+
+private:
+
+    /// @brief Access to the protected std::streambuf members.
+    struct Access:
+        public std::streambuf
+    {
+        /// @brief Get the size of the last reserved area.
+        /**
+        @param[in] sb The stream buffer.
+        @return The distance from the data begin to the end of put area.
+        */
+        static size_t reserved(std::streambuf &sb)
+        {
+            char* (std::streambuf::*eback_)() const = &Access::eback;
+            char* (std::streambuf::*epptr_)() const = &Access::epptr;
+            return size_t((sb.*epptr_)() - (sb.*eback_)());
+        }
+    };
+
+private:
+    std::vector<StreamBuf*> m_idle[NUM_CLASSES]; ///< @brief The idle buffers by capacity classes.
+    size_t m_maxIdleBytes; ///< @brief The idle memory limit.
+    size_t m_idleBytes;    ///< @brief The total capacity of idle buffers.
+    size_t m_inUseBytes;   ///< @brief The total capacity of buffers in use.
+    size_t m_inUseCount;   ///< @brief The number of buffers in use.
+    size_t m_acquired;     ///< @brief The number of acquisitions.
+    size_t m_hits;         ///< @brief The number of acquisitions served by idle buffers.
+    size_t m_dropped;      ///< @brief The number of destroyed buffers.
+    mutable boost::mutex m_mutex; ///< @brief The mutex to protect the pool.
+};
+
+} // hive namespace
+
+#endif // __HIVE_POOL_HPP_
+
+
+///////////////////////////////////////////////////////////////////////////////
+/** @page page_hive_pool Buffer pool
+
+The hive::BufferPool class shares `boost::asio::streambuf` objects
+between components which need a buffer only from time to time.
+Without the pool each transceiver or connection owns its own buffer
+which may grow during the load burst and never shrinks.
+
+~~~{.cpp}
+BufferPool::SharedPtr pool = BufferPool::getDefault();
+
+BufferPool::StreamBufPtr buf = pool->acquire();
+boost::asio::async_read(stream, *buf, ...);
+
+// ... once buffer is empty and not needed
+buf.reset(); // returned to the pool
+~~~
+
+The idle buffers are grouped by capacity classes. The buffer whose
+capacity exceeds the largest class is destroyed on return.
+The total capacity of idle buffers is limited as well.
+
+The following counters are available:
+- hive::BufferPool::getInUseCount() and hive::BufferPool::getInUseBytes()
+- hive::BufferPool::getIdleBytes()
+- hive::BufferPool::getHitRate()
+- hive::BufferPool::getAcquiredCount() and hive::BufferPool::getDroppedCount()
+*/
@@ -48,6 +48,15 @@ Defined as:
 #else                                 // nix
 #   include <endian.h>
 #endif // WIN32
+#include <string.h>
+
+// SIMD byte shuffles for arrays
+#if defined(HIVE_SSSE3)
+#   include <tmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#   include <arm_neon.h>
+#   define HIVE_SWAB_NEON 1
+#endif // SIMD
 
 
 namespace hive
@@ -142,6 +151,25 @@ inline Int64 swab(Int64 x)
     return swab_64(x);
 }
 
+
+/// @brief Reverse byte order (8-bits).
+/**
+Does nothing, used by generic code.
+
+@param[in] x The 8-bits integer.
+@return The same integer.
+*/
+inline UInt8 swab(UInt8 x)
+{
+    return x;
+}
+
+/// @copydoc swab(UInt8)
+inline Int8 swab(Int8 x)
+{
+    return x;
+}
+
 /// @}
 
     } // swab functions
@@ -523,6 +551,197 @@ inline Int64 le2h(Int64 x)
     } // little-endian
 
 
+    // arrays
+    namespace misc
+    {
+        /// @brief The implementation specific stuff.
+        namespace impl
+        {
+
+#if defined(HIVE_SSSE3)
+/// @brief Reverse byte order of 16-bytes blocks using SSSE3.
+/**
+@param[out] dst The output array.
+@param[in] src The input array.
+@param[in] n The number of elements.
+@return The number of elements processed.
+*/
+template<typename T> HIVE_SSSE3_TARGET
+inline size_t swab_ssse3(T *dst, const T *src, size_t n)
+{
+    const __m128i mask = (2 == sizeof(T))
+        ? _mm_setr_epi8(1,0, 3,2, 5,4, 7,6, 9,8, 11,10, 13,12, 15,14)
+        : (4 == sizeof(T))
+        ? _mm_setr_epi8(3,2,1,0, 7,6,5,4, 11,10,9,8, 15,14,13,12)
+        : _mm_setr_epi8(7,6,5,4,3,2,1,0, 15,14,13,12,11,10,9,8);
+
+    const size_t K = 16/sizeof(T); // elements per block
+    size_t i = 0;
+    for (; i+K <= n; i += K)
+    {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src+i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst+i), _mm_shuffle_epi8(x, mask));
+    }
+    return i;
+}
+
+
+/// @brief Reverse byte order of 16-bytes blocks if SSSE3 is supported.
+/**
+@param[out] dst The output array.
+@param[in] src The input array.
+@param[in] n The number of elements.
+@return The number of elements processed.
+*/
+template<typename T>
+inline size_t swab_simd(T *dst, const T *src, size_t n)
+{
+    return HIVE_SSSE3_SUPPORTED() ? swab_ssse3(dst, src, n) : 0;
+}
+#elif defined(HIVE_SWAB_NEON)
+/// @brief Reverse byte order of 16-bytes blocks using NEON.
+/**
+@param[out] dst The output array.
+@param[in] src The input array.
+@param[in] n The number of elements.
+@return The number of elements processed.
+*/
+template<typename T>
+inline size_t swab_simd(T *dst, const T *src, size_t n)
+{
+    const size_t K = 16/sizeof(T); // elements per block
+    size_t i = 0;
+    for (; i+K <= n; i += K)
+    {
+        const uint8x16_t x = vld1q_u8(reinterpret_cast<const uint8_t*>(src+i));
+        const uint8x16_t y = (2 == sizeof(T)) ? vrev16q_u8(x)
+            : (4 == sizeof(T)) ? vrev32q_u8(x) : vrev64q_u8(x);
+        vst1q_u8(reinterpret_cast<uint8_t*>(dst+i), y);
+    }
+    return i;
+}
+#endif // SIMD
+
+        } // impl
+
+/// @name Arrays byte order
+/// @{
+
+/// @brief Reverse byte order of integer array.
+/**
+Uses SSSE3 (if supported by CPU, see #HIVE_SSSE3) or NEON byte shuffles.
+The arrays may be the same for in-place conversion,
+but should not overlap otherwise.
+
+@param[out] dst The output array.
+@param[in] src The input array.
+@param[in] n The number of elements.
+*/
+template<typename T>
+inline void swab_array(T *dst, const T *src, size_t n)
+{
+    size_t i = 0;
+    if (1 == sizeof(T))
+    {
+        if (dst != src)
+            memcpy(dst, src, n);
+        return;
+    }
+
+#if defined(HIVE_SSSE3) || defined(HIVE_SWAB_NEON)
+    i = impl::swab_simd(dst, src, n);
+#endif // SIMD
+
+    for (; i < n; ++i)
+        dst[i] = swab(src[i]);
+}
+
+
+/// @brief Copy array if it's not the same.
+/**
+@param[out] dst The output array.
+@param[in] src The input array.
+@param[in] n The number of elements.
+*/
+template<typename T>
+inline void copy_array(T *dst, const T *src, size_t n)
+{
+    if (dst != src && 0 < n)
+        memcpy(dst, src, n*sizeof(T));
+}
+
+
+/// @brief Convert host to little-endian (array).
+/**
+Just copies on little-endian platforms.
+
+@param[out] dst The output array in little-endian format.
+@param[in] src The input array in host format.
+@param[in] n The number of elements.
+*/
+template<typename T>
+inline void h2le_array(T *dst, const T *src, size_t n)
+{
+#if defined(HIVE_BIG_ENDIAN)    // big-endian
+    swab_array(dst, src, n);
+#else                           // little-endian
+    copy_array(dst, src, n);
+#endif
+}
+
+
+/// @brief Convert little-endian to host (array).
+/**
+Just copies on little-endian platforms.
+
+@param[out] dst The output array in host format.
+@param[in] src The input array in little-endian format.
+@param[in] n The number of elements.
+*/
+template<typename T>
+inline void le2h_array(T *dst, const T *src, size_t n)
+{
+    h2le_array(dst, src, n); // the same
+}
+
+
+/// @brief Convert host to big-endian (array).
+/**
+Just copies on big-endian platforms.
+
+@param[out] dst The output array in big-endian format.
+@param[in] src The input array in host format.
+@param[in] n The number of elements.
+*/
+template<typename T>
+inline void h2be_array(T *dst, const T *src, size_t n)
+{
+#if defined(HIVE_LITTLE_ENDIAN) // little-endian
+    swab_array(dst, src, n);
+#else                           // big-endian
+    copy_array(dst, src, n);
+#endif
+}
+
+
+/// @brief Convert big-endian to host (array).
+/**
+Just copies on big-endian platforms.
+
+@param[out] dst The output array in host format.
+@param[in] src The input array in big-endian format.
+@param[in] n The number of elements.
+*/
+template<typename T>
+inline void be2h_array(T *dst, const T *src, size_t n)
+{
+    h2be_array(dst, src, n); // the same
+}
+
+/// @}
+    } // arrays
+
+
     // converters
     namespace misc
     {
@@ -635,6 +854,22 @@ public:
     {
         return le2h_64(x);
     }
+
+public:
+
+    /// @copydoc h2le_array()
+    template<typename T>
+    static inline void h2e_array(T *dst, const T *src, size_t n)
+    {
+        h2le_array(dst, src, n);
+    }
+
+    /// @copydoc le2h_array()
+    template<typename T>
+    static inline void e2h_array(T *dst, const T *src, size_t n)
+    {
+        le2h_array(dst, src, n);
+    }
 };
 
 
@@ -727,6 +962,22 @@ public:
     {
         return be2h_64(x);
     }
+
+public:
+
+    /// @copydoc h2be_array()
+    template<typename T>
+    static inline void h2e_array(T *dst, const T *src, size_t n)
+    {
+        h2be_array(dst, src, n);
+    }
+
+    /// @copydoc be2h_array()
+    template<typename T>
+    static inline void e2h_array(T *dst, const T *src, size_t n)
+    {
+        be2h_array(dst, src, n);
+    }
 };
 
 
@@ -814,6 +1065,20 @@ to the host byte order and visa versa:
 Both signed and unsigned integers may be converted.
 
 
+Arrays
+------
+
+The following functions convert whole arrays of integers:
+- hive::misc::swab_array()
+- hive::misc::le2h_array(), hive::misc::h2le_array()
+- hive::misc::be2h_array(), hive::misc::h2be_array()
+
+The byte order is changed by 16-bytes blocks using SSSE3 or NEON
+shuffles if the compiler targets such instruction set (for example
+`-mssse3` or `-mfpu=neon`), the scalar code is used otherwise.
+If no change is needed the data are just copied.
+
+
 Byte order converters
 ---------------------
 
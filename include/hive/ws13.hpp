@@ -219,12 +219,12 @@ public:
     static SharedPtr create(PayloadT const& payload, bool masking,
         UInt32 mask = 0, bool FIN = true, int flags = 0)
     {
-        OStringStream oss;
-        bin::OStream bs(oss);
+        OctetString data;
+        bin::BufferOStream<OctetString> bs(data);
         payload.format(bs);
 
         SharedPtr pthis(new Frame());
-        pthis->init(oss.str(), PayloadT::OPCODE,
+        pthis->init(data, PayloadT::OPCODE,
             masking, mask, FIN, flags);
         return pthis;
     }
@@ -243,9 +243,7 @@ public:
     {
         if (2 <= m_content.size())
         {
-            OctetString frame(m_content.begin(), m_content.end());
-            IStringStream iss(frame);
-            bin::IStream bs(iss);
+            bin::SpanIStream bs(&m_content[0], m_content.size());
 
             const int f_ctl = bs.getUInt8();
             const int f_len = bs.getUInt8();
@@ -265,19 +263,21 @@ public:
             if (masking)
             {
                 const UInt32 mask = bs.getUInt32BE();
-                const size_t offset = (size_t)iss.tellg();
+                if (bs.getRemaining() < len)
+                    return false; // truncated frame
+
+                // unmask a copy of the payload
+                const Iterator data = m_content.begin() + bs.getOffset();
+                OctetString frame(data, data + len);
                 for (size_t i = 0; i < len; ++i)
                 {
                     const size_t k = (3 - (i%4));
                     const UInt8 M = mask >> (k*8);
-                    frame[offset+i] ^= M;
+                    frame[i] ^= M;
                 }
 
-                // re-init input stream
-                IStringStream iss(frame);
-                bin::IStream bs(iss);
-                iss.seekg(offset);
-                return payload.parse(bs);
+                bin::SpanIStream ps(frame.data(), frame.size());
+                return payload.parse(ps);
             }
             else
                 return payload.parse(bs);
@@ -461,12 +461,12 @@ protected:
     void init(OctetString const& payload, int opcode,
         bool masking, UInt32 mask, bool FIN, int flags)
     {
-        boost::asio::streambuf sbuf;
-        OStream os(&sbuf);
-        bin::OStream bs(os);
-
         const size_t len = payload.size();
 
+        m_content.clear();
+        m_content.reserve(2 + 8 + 4 + len); // max header + payload
+        bin::BufferOStream<Content> bs(m_content);
+
         // frame control field
         bs.putUInt8(((FIN?1:0)<<7) | ((flags&0x07)<<4) | (opcode&0x0F));
 
@@ -491,11 +491,13 @@ protected:
             bs.putUInt32BE(mask);
 
             // mask the payload
+            const size_t offset = m_content.size();
+            bs.putBuffer(payload.data(), payload.size());
             for (size_t i = 0; i < len; ++i)
             {
                 const size_t k = (3 - (i%4));
                 const UInt8 M = mask >> (k*8);
-                bs.putUInt8(payload[i] ^ M);
+                m_content[offset+i] ^= M;
             }
         }
         else
@@ -503,10 +505,6 @@ protected:
             // do not mask the payload, just copy
             bs.putBuffer(payload.data(), payload.size());
         }
-
-        boost::asio::streambuf::const_buffers_type buf = sbuf.data();
-        m_content.assign(boost::asio::buffers_begin(buf),
-            boost::asio::buffers_end(buf));
     }
 };
 
@@ -533,7 +531,8 @@ public:
     /**
     @param[in,out] bs The output binary stream.
     */
-    void format(bin::OStream &bs) const
+    template<typename OStreamT>
+    void format(OStreamT &bs) const
     {
         HIVE_UNUSED(bs);
     }
@@ -544,7 +543,8 @@ public:
     @param[in,out] bs The input binary stream.
     @return `true` if successfully parsed.
     */
-    bool parse(bin::IStream &bs)
+    template<typename IStreamT>
+    bool parse(IStreamT &bs)
     {
         HIVE_UNUSED(bs);
         return true;
@@ -565,6 +565,22 @@ protected:
         oss << bs.getStream().rdbuf();
         return oss.str();
     }
+
+
+    /// @brief Get all remaining data.
+    /**
+    This method reads the data till the end of memory block.
+
+    @param[in,out] bs The input binary stream.
+    @return The parsed data.
+    */
+    static OctetString getAll(bin::SpanIStream &bs)
+    {
+        OctetString data(bs.getRemaining(), '\0');
+        if (!data.empty())
+            bs.getBuffer(&data[0], data.size());
+        return data;
+    }
 };
 
 
@@ -600,7 +616,8 @@ public:
 public:
 
     /// @copydoc Frame::Payload::format()
-    void format(bin::OStream &bs) const
+    template<typename OStreamT>
+    void format(OStreamT &bs) const
     {
         bs.putBuffer(data.data(),
             data.size());
@@ -608,7 +625,8 @@ public:
 
 
     /// @copydoc Frame::Payload::parse()
-    bool parse(bin::IStream &bs)
+    template<typename IStreamT>
+    bool parse(IStreamT &bs)
     {
         data = getAll(bs);
         return true;
@@ -647,7 +665,8 @@ public:
 public:
 
     /// @copydoc Frame::Payload::format()
-    void format(bin::OStream &bs) const
+    template<typename OStreamT>
+    void format(OStreamT &bs) const
     {
         bs.putBuffer(text.data(),
             text.size());
@@ -655,7 +674,8 @@ public:
 
 
     /// @copydoc Frame::Payload::parse()
-    bool parse(bin::IStream &bs)
+    template<typename IStreamT>
+    bool parse(IStreamT &bs)
     {
         text = getAll(bs);
         return true;
@@ -694,7 +714,8 @@ public:
 public:
 
     /// @copydoc Frame::Payload::format()
-    void format(bin::OStream &bs) const
+    template<typename OStreamT>
+    void format(OStreamT &bs) const
     {
         bs.putBuffer(data.data(),
             data.size());
@@ -702,7 +723,8 @@ public:
 
 
     /// @copydoc Frame::Payload::parse()
-    bool parse(bin::IStream &bs)
+    template<typename IStreamT>
+    bool parse(IStreamT &bs)
     {
         data = getAll(bs);
         return true;
@@ -781,7 +803,8 @@ public:
 public:
 
     /// @copydoc Frame::Payload::format()
-    void format(bin::OStream &bs) const
+    template<typename OStreamT>
+    void format(OStreamT &bs) const
     {
         bs.putUInt16BE(statusCode);
         bs.putBuffer(reason.data(),
@@ -790,7 +813,8 @@ public:
 
 
     /// @copydoc Frame::Payload::parse()
-    bool parse(bin::IStream &bs)
+    template<typename IStreamT>
+    bool parse(IStreamT &bs)
     {
         statusCode = bs.getUInt16BE(); // optional
         reason = getAll(bs); // up to end
@@ -830,7 +854,8 @@ public:
 public:
 
     /// @copydoc Frame::Payload::format()
-    void format(bin::OStream &bs) const
+    template<typename OStreamT>
+    void format(OStreamT &bs) const
     {
         bs.putBuffer(data.data(),
             data.size());
@@ -838,7 +863,8 @@ public:
 
 
     /// @copydoc Frame::Payload::parse()
-    bool parse(bin::IStream &bs)
+    template<typename IStreamT>
+    bool parse(IStreamT &bs)
     {
         data = getAll(bs); // up to end
         return true;
@@ -878,7 +904,8 @@ public:
 public:
 
     /// @copydoc Frame::Payload::format()
-    void format(bin::OStream &bs) const
+    template<typename OStreamT>
+    void format(OStreamT &bs) const
     {
         bs.putBuffer(data.data(),
             data.size());
@@ -886,7 +913,8 @@ public:
 
 
     /// @copydoc Frame::Payload::parse()
-    bool parse(bin::IStream &bs)
+    template<typename IStreamT>
+    bool parse(IStreamT &bs)
     {
         data = getAll(bs); // up to end
         return true;
@@ -913,15 +941,16 @@ inline OctetString sha1(OctetString const& data)
     unsigned int hash[N];
     h.get_digest(hash);
 
-    OStringStream oss;
-    bin::OStream bs(oss);
+    OctetString res;
+    res.reserve(N*sizeof(hash[0]));
+    bin::BufferOStream<OctetString> bs(res);
     for (size_t i = 0; i < N; ++i)
     {
         //oss << dump::hex(hash[i]);
         bs.putUInt32BE(hash[i]);
     }
 
-    return oss.str();
+    return res;
 }
 
         } // implementation
@@ -9,10 +9,17 @@
 #include <examples/simple_dev.hpp>
 #include <examples/simple_gw.hpp>
 #include <examples/zigbee_gw.hpp>
+#include <examples/test_server.hpp>
 
 #include "test-defs.hpp"
 #include "test-swab.hpp"
+#include "test-bin.hpp"
 #include "test-dump.hpp"
+#include "test-pool.hpp"
+#include "test-serial.hpp"
+#include "test-zigbee.hpp"
+#include "test-xbee.hpp"
+#include "test-devicehive.hpp"
 #include "test-json.hpp"
 #include "test-http.hpp"
 #include "test-ws13.hpp"
@@ -58,10 +65,23 @@ int main(int argc, const char *argv[])
         if (0) simple_dev::main(argc, argv);
         if (1) simple_gw::main(argc, argv);
         if (0) zigbee_gw::main(argc, argv);
+        if (0) test_server::main(argc, argv);
 
         if (0) test_defs0();
         if (0) test_swab0();
+        if (0) test_bin0();
+        if (0) test_bin1();
         if (0) test_dump0();
+        if (0) test_dump1();
+        if (0) test_pool0();
+        if (0) test_serial0();
+        if (0) test_zigbee0();
+        if (0) test_xbee0();
+        if (0) test_xbee1();
+        if (0) test_xbee2();
+        if (0) test_devicehive0();
+        if (0) test_devicehive1();
+        if (0) test_devicehive2();
         if (0) test_json0();
         if (0) test_json1(1<argc ? argv[1] : "../json");
         if (0) test_http0();
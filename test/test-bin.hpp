@@ -0,0 +1,612 @@
+/** @file
+@brief The binary streams unit test.
+@author Sergey Polichnoy <sergey.polichnoy@dataart.com>
+*/
+#include <hive/bin.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <stdexcept>
+#include <iostream>
+#include <limits>
+#include <ctime>
+#include <assert.h>
+
+namespace
+{
+    using namespace hive;
+
+// assert macro, throws exception
+#define MY_ASSERT(cond, msg) \
+    if (cond) {} else throw std::runtime_error(msg)
+
+
+// write the test record
+template<typename OStreamT>
+void put_bin_record(OStreamT &bs, UInt32 i)
+{
+    bs.putUInt8(UInt8(i));
+    bs.putInt16LE(Int16(-Int32(i)));
+    bs.putUInt32BE(i*7919);
+    bs.putUInt64LE(UInt64(i) << 33);
+    bs.putUInt32V(i);
+    bs.putInt64VZ(-Int64(i));
+    bs.putString("test");
+}
+
+
+// read and check the test record
+template<typename IStreamT>
+void check_bin_record(IStreamT &bs, UInt32 i)
+{
+    MY_ASSERT(bs.getUInt8() == UInt8(i), "bad UInt8");
+    MY_ASSERT(bs.getInt16LE() == Int16(-Int32(i)), "bad Int16LE");
+    MY_ASSERT(bs.getUInt32BE() == i*7919, "bad UInt32BE");
+    MY_ASSERT(bs.getUInt64LE() == (UInt64(i) << 33), "bad UInt64LE");
+    MY_ASSERT(bs.getUInt32V() == i, "bad UInt32V");
+    MY_ASSERT(bs.getInt64VZ() == -Int64(i), "bad Int64VZ");
+    MY_ASSERT(bs.getString() == "test", "bad String");
+}
+
+
+// generate test values: mostly small with some edge cases
+template<typename T>
+std::vector<T> gen_bin_values(size_t n)
+{
+    std::vector<T> vals(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        T val = T(rand());
+        switch (i%8)
+        {
+            case 0: case 1: case 2: val &= 0x3F; break;     // 1 byte
+            case 3: case 4: val &= 0x1FFF; break;           // 2 bytes
+            case 5: val = T(UInt64(val) << (rand()%(sizeof(T)*8))); break; // any
+            case 6: val = std::numeric_limits<T>::max() - T(i%3); break;
+            case 7: val = std::numeric_limits<T>::min() + T(i%3); break;
+        }
+        vals[i] = val;
+    }
+    return vals;
+}
+
+
+// check the varint arrays
+template<typename T>
+void check_bin_varray(void (bin::OStream::*put)(T),
+    void (bin::BufferOStream<String>::*put_array)(const T*, size_t),
+    void (bin::IStream::*get_array)(T*, size_t),
+    void (bin::SpanIStream::*sget_array)(T*, size_t))
+{
+    const size_t N = 10000;
+    const std::vector<T> vals = gen_bin_values<T>(N);
+
+    // array and scalar writes should be the same
+    String buf;
+    bin::BufferOStream<String> bs(buf);
+    (bs.*put_array)(&vals[0], N);
+
+    OStringStream oss;
+    bin::OStream os(oss);
+    for (size_t i = 0; i < N; ++i)
+        (os.*put)(vals[i]);
+    MY_ASSERT(oss.str() == buf, "array and scalar varints differ");
+
+    // read back using std stream and memory stream
+    std::vector<T> res1(N), res2(N);
+    IStringStream iss(buf);
+    bin::IStream is(iss);
+    (is.*get_array)(&res1[0], N);
+
+    bin::SpanIStream ss(buf.data(), buf.size());
+    (ss.*sget_array)(&res2[0], N);
+
+    MY_ASSERT(res1 == vals, "bad varint array (std stream)");
+    MY_ASSERT(res2 == vals, "bad varint array (memory stream)");
+    MY_ASSERT(!ss.fail() && ss.getRemaining() == 0, "SpanIStream should be at the end");
+
+    // truncated
+    bin::SpanIStream ts(buf.data(), buf.size()-1);
+    res2.push_back(vals[0]); // one more value past the end
+    (ts.*sget_array)(&res2[0], N+1);
+    MY_ASSERT(ts.fail(), "should fail on truncated varint array");
+    MY_ASSERT(res2[N-1] == 0 && res2[N] == 0, "truncated varints should be zeros");
+}
+
+
+// check the fixed-size integer arrays
+template<typename T>
+void check_bin_array(void (bin::OStream::*putLE)(T), void (bin::OStream::*putBE)(T))
+{
+    const size_t N = 1000;
+    const std::vector<T> vals = gen_bin_values<T>(N);
+
+    // array and scalar writes should be the same
+    String buf;
+    bin::BufferOStream<String> bs(buf);
+    bs.putArrayLE(&vals[0], N);
+    bs.putArrayBE(&vals[0], N);
+
+    OStringStream oss;
+    bin::OStream os(oss);
+    for (size_t i = 0; i < N; ++i)
+        (os.*putLE)(vals[i]);
+    for (size_t i = 0; i < N; ++i)
+        (os.*putBE)(vals[i]);
+    MY_ASSERT(oss.str() == buf, "array and scalar integers differ");
+
+    // read back
+    std::vector<T> res1(N), res2(N);
+    bin::SpanIStream is(buf.data(), buf.size());
+    is.getArrayLE(&res1[0], N);
+    is.getArrayBE(&res2[0], N);
+    MY_ASSERT(res1 == vals && res2 == vals, "bad integer array");
+    MY_ASSERT(!is.fail() && is.getRemaining() == 0, "SpanIStream should be at the end");
+}
+
+
+// generate capture of simple frames split into random chunks
+std::vector<bin::Capture::Record> gen_bin_capture(size_t n_frames)
+{
+    String all;
+    for (size_t i = 0; i < n_frames; ++i)
+    {
+        const String payload(i%32, char(i));
+        bin::SimpleFrame::SharedPtr frame = bin::SimpleFrame::create(int(i&0xFFFF), payload);
+        all.append(frame->getContent().begin(), frame->getContent().end());
+    }
+
+    OStringStream oss;
+    bin::Capture::SharedPtr cap = bin::Capture::create(oss);
+    for (size_t pos = 0; pos < all.size(); )
+    {
+        const size_t n = std::min(size_t(1 + rand()%64), all.size()-pos);
+        cap->write(bin::Capture::DIR_RX, all.data() + pos, n);
+        if (0 == rand()%8)
+            cap->write(bin::Capture::DIR_TX, "tx", 2);
+        pos += n;
+    }
+
+    IStringStream iss(oss.str());
+    return bin::Capture::load(iss);
+}
+
+
+// count replayed frames
+void on_bin_replay_frame(size_t *count, boost::system::error_code err, bin::SimpleFrame::SharedPtr frame)
+{
+    if (!err && frame)
+        *count += 1;
+}
+
+
+// replay the capture through transceiver
+size_t replay_bin_capture(std::vector<bin::Capture::Record> const& records,
+    double speed, long gap_ms = 0, size_t *rx_timeouts = 0)
+{
+    typedef bin::Transceiver<bin::ReplayStream, bin::SimpleFrame> ReplayTrx;
+
+    boost::asio::io_service ios;
+    bin::ReplayStream stream(ios, records, speed);
+    ReplayTrx::SharedPtr trx = ReplayTrx::create("/test/replay", stream);
+    trx->setRxGapTimeout(gap_ms);
+
+    size_t count = 0;
+    trx->recv(boost::bind(on_bin_replay_frame, &count, _1, _2));
+    ios.run();
+
+    MY_ASSERT(stream.isEnd(), "capture is not replayed");
+    if (rx_timeouts)
+        *rx_timeouts = trx->getRxTimeoutCount();
+    return count;
+}
+
+
+// save the TX result
+void on_bin_sent(boost::system::error_code *res, boost::system::error_code err, bin::SimpleFrame::SharedPtr)
+{
+    *res = err;
+}
+
+
+// send the frame to the stalled stream, the RX frame should be received after TX timeout,
+// the queued frame is dropped and never written
+void check_bin_tx_timeout()
+{
+    typedef bin::Transceiver<bin::ReplayStream, bin::SimpleFrame> ReplayTrx;
+
+    const std::vector<UInt8> content = bin::SimpleFrame::create(1, String("payload"))->getContent();
+    std::vector<bin::Capture::Record> recs(1);
+    recs[0].direction = bin::Capture::DIR_RX;
+    recs[0].time = 100*1000; // 100ms, after TX timeout
+    recs[0].data.assign(content.begin(), content.end());
+
+    boost::asio::io_service ios;
+    bin::ReplayStream stream(ios, recs, 1.0);
+    stream.setTxStalled(true);
+    ReplayTrx::SharedPtr trx = ReplayTrx::create("/test/stalled", stream);
+    trx->setTxTimeout(30);
+
+    size_t count = 0;
+    boost::system::error_code tx_err;
+    boost::system::error_code queued_err;
+    trx->recv(boost::bind(on_bin_replay_frame, &count, _1, _2));
+    trx->send(bin::SimpleFrame::create(2, String("stalled")),
+        boost::bind(on_bin_sent, &tx_err, _1, _2));
+    trx->send(bin::SimpleFrame::create(3, String("queued")),
+        boost::bind(on_bin_sent, &queued_err, _1, _2));
+    MY_ASSERT(1 == trx->dropTxQueue(), "queued TX frame should be dropped");
+    ios.run();
+
+    MY_ASSERT(tx_err == boost::asio::error::timed_out, "stalled TX should be timed out");
+    MY_ASSERT(queued_err == boost::asio::error::operation_aborted, "dropped TX should be aborted");
+    MY_ASSERT(1 == trx->getTxTimeoutCount(), "bad TX timeout count");
+    MY_ASSERT(1 == count && stream.isEnd(), "RX should be restarted after TX timeout");
+    MY_ASSERT(0 == stream.getTxBytes(), "stalled TX should not be written");
+}
+
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+
+typedef boost::asio::local::stream_protocol::socket BinBenchSocket;
+
+
+// write the same burst of frames several times
+struct BinBenchProducer
+{
+    BinBenchSocket &socket;
+    String burst;
+    size_t left;
+
+    void start()
+    {
+        boost::asio::async_write(socket, boost::asio::buffer(burst),
+            boost::bind(&BinBenchProducer::onWrite, this, _1, _2));
+    }
+
+    void onWrite(boost::system::error_code err, size_t)
+    {
+        if (!err && 0 < --left)
+            start();
+    }
+};
+
+
+// count received frames, close the socket once all are received
+void on_bin_bench_frame(size_t *count, size_t total, BinBenchSocket *socket,
+    boost::system::error_code err, bin::SimpleFrame::SharedPtr frame)
+{
+    if (!err && frame && ++(*count) == total)
+        socket->close();
+}
+
+
+// receive frames from socketpair through transceiver
+void bench_bin_socketpair(size_t minRead, size_t maxRead)
+{
+    typedef bin::Transceiver<BinBenchSocket, bin::SimpleFrame> BenchTrx;
+    const size_t BURST = 256;
+    const size_t BURSTS = 2000;
+    const size_t N = BURST*BURSTS;
+
+    String burst;
+    for (size_t i = 0; i < BURST; ++i)
+    {
+        bin::SimpleFrame::SharedPtr frame = bin::SimpleFrame::create(int(i), String(16, char(i)));
+        burst.append(frame->getContent().begin(), frame->getContent().end());
+    }
+
+    boost::asio::io_service ios;
+    BinBenchSocket tx(ios), rx(ios);
+    boost::asio::local::connect_pair(tx, rx);
+
+    BenchTrx::SharedPtr trx = BenchTrx::create("/test/bench", rx);
+    trx->setRxReadSize(minRead, maxRead);
+
+    size_t count = 0;
+    trx->recv(boost::bind(on_bin_bench_frame, &count, N, &rx, _1, _2));
+    BinBenchProducer producer = { tx, burst, BURSTS };
+    producer.start();
+
+    const boost::posix_time::ptime t0 = boost::posix_time::microsec_clock::universal_time();
+    const std::clock_t c0 = std::clock();
+    ios.run();
+    const std::clock_t c1 = std::clock();
+    const boost::posix_time::ptime t1 = boost::posix_time::microsec_clock::universal_time();
+    MY_ASSERT(N == count, "not all frames are received");
+
+    const Int64 us = (t1-t0).total_microseconds();
+    const double cpu_ns = double(c1-c0)*1e9/CLOCKS_PER_SEC/N;
+    std::cout << "socketpair [" << minRead << ".." << maxRead << "]: "
+        << (us ? Int64(N)*1000000/us : 0) << " frames/sec, "
+        << cpu_ns << "ns CPU/frame, "
+        << double(N)/trx->getRxReadCount() << " frames/read\n";
+}
+
+#endif // BOOST_ASIO_HAS_LOCAL_SOCKETS
+
+
+// test application entry point
+/*
+Checks the memory streams are compatible with the std streams.
+*/
+void test_bin0()
+{
+    const UInt32 N = 1000;
+
+    // write the same records to both streams
+    OStringStream oss;
+    bin::OStream os(oss);
+    String buf;
+    bin::BufferOStream<String> bos(buf);
+    for (UInt32 i = 0; i < N; ++i)
+    {
+        put_bin_record(os, i);
+        put_bin_record(bos, i);
+    }
+    MY_ASSERT(oss.str() == buf, "BufferOStream differs from OStream");
+
+    // read back from memory
+    bin::SpanIStream is(buf.data(), buf.size());
+    for (UInt32 i = 0; i < N; ++i)
+        check_bin_record(is, i);
+    MY_ASSERT(!is.fail() && is.getRemaining() == 0, "SpanIStream should be at the end");
+
+    { // vector<UInt8> as a buffer
+        std::vector<UInt8> vbuf;
+        bin::BufferOStream< std::vector<UInt8> > vos(vbuf);
+        for (UInt32 i = 0; i < N; ++i)
+            put_bin_record(vos, i);
+        MY_ASSERT(String(vbuf.begin(), vbuf.end()) == buf,
+            "vector buffer differs from string buffer");
+    }
+
+    { // out of bounds
+        const UInt8 data[] = { 0x01, 0x02, 0x03 };
+        bin::SpanIStream bs(data, sizeof(data));
+        MY_ASSERT(bs.getUInt16BE() == 0x0102 && !bs.fail(), "bad UInt16BE");
+        MY_ASSERT(bs.getUInt32LE() == 0 && bs.fail(), "should fail on UInt32");
+        MY_ASSERT(bs.getRemaining() == 0 && bs.getOffset() == sizeof(data), "should be at the end");
+        MY_ASSERT(bs.getUInt8() == 0 && bs.fail(), "should fail on UInt8");
+    }
+
+    { // truncated varint and string
+        const UInt8 data[] = { 0x80, 0x80 };
+        bin::SpanIStream bs(data, sizeof(data));
+        MY_ASSERT(bs.getUInt32V() == 0 && bs.fail(), "should fail on truncated varint");
+        MY_ASSERT(bs.getUInt64V() == 0 && bs.fail(), "varint past the end should be zero");
+
+        const UInt8 data2[] = { 0x05, 'a', 'b' };
+        bin::SpanIStream bs2(data2, sizeof(data2));
+        bs2.getString();
+        MY_ASSERT(bs2.fail(), "should fail on truncated string");
+
+        // huge declared length is rejected before allocation
+        const UInt8 data3[] = { 0xFF, 0xFF, 0xFF, 0xFF, 0x0F, 'a' };
+        bin::SpanIStream bs3(data3, sizeof(data3));
+        String str("garbage");
+        MY_ASSERT(!bs3.getString(str) && str.empty() && bs3.fail(),
+            "should reject huge string length");
+    }
+
+    { // length limits and capacity reuse
+        OStringStream oss;
+        bin::OStream os(oss);
+        os.putString("hello");
+        os.putString("world!");
+        os.putString("");
+        const String buf = oss.str();
+
+        bin::SpanIStream bs(buf.data(), buf.size());
+        String str;
+        MY_ASSERT(bs.getString(str, 5) && str == "hello", "bad limited String");
+        const size_t cap = str.capacity();
+        MY_ASSERT(bs.getString(str) && str == "world!", "bad String");
+        MY_ASSERT(bs.getString(str) && str.empty(), "bad empty String");
+        MY_ASSERT(cap <= str.capacity(), "String capacity should be reused");
+        MY_ASSERT(!bs.fail() && 0 == bs.getRemaining(), "bad String stream");
+
+        IStringStream iss(buf);
+        bin::IStream is(iss);
+        MY_ASSERT(is.getString(str, 5) && str == "hello", "bad limited String");
+        MY_ASSERT(!is.getString(str, 5) && str.empty(), "should reject long String");
+        MY_ASSERT(iss.fail(), "std stream should be failed");
+    }
+
+    check_bin_array<UInt16>(&bin::OStream::putUInt16LE, &bin::OStream::putUInt16BE);
+    check_bin_array<Int16>(&bin::OStream::putInt16LE, &bin::OStream::putInt16BE);
+    check_bin_array<UInt32>(&bin::OStream::putUInt32LE, &bin::OStream::putUInt32BE);
+    check_bin_array<Int32>(&bin::OStream::putInt32LE, &bin::OStream::putInt32BE);
+    check_bin_array<UInt64>(&bin::OStream::putUInt64LE, &bin::OStream::putUInt64BE);
+    check_bin_array<Int64>(&bin::OStream::putInt64LE, &bin::OStream::putInt64BE);
+
+    check_bin_varray<UInt32>(&bin::OStream::putUInt32V,
+        &bin::BufferOStream<String>::putUInt32VArray,
+        &bin::IStream::getUInt32VArray,
+        &bin::SpanIStream::getUInt32VArray);
+    check_bin_varray<UInt64>(&bin::OStream::putUInt64V,
+        &bin::BufferOStream<String>::putUInt64VArray,
+        &bin::IStream::getUInt64VArray,
+        &bin::SpanIStream::getUInt64VArray);
+    check_bin_varray<Int32>(&bin::OStream::putInt32VZ,
+        &bin::BufferOStream<String>::putInt32VZArray,
+        &bin::IStream::getInt32VZArray,
+        &bin::SpanIStream::getInt32VZArray);
+    check_bin_varray<Int64>(&bin::OStream::putInt64VZ,
+        &bin::BufferOStream<String>::putInt64VZArray,
+        &bin::IStream::getInt64VZArray,
+        &bin::SpanIStream::getInt64VZArray);
+
+    { // overlong 32-bits varints (more than 5 bytes), bulk and scalar decoders should agree
+        const String buf = String(9, '\xFF') + String(6, '\x81') + String(1, '\x01') + String(8, '\x05');
+        const size_t N = 8;
+
+        std::vector<UInt32> res1(N), res2(N);
+        IStringStream iss(buf);
+        bin::IStream is(iss);
+        is.getUInt32VArray(&res1[0], N);
+
+        bin::SpanIStream ss(buf.data(), buf.size());
+        ss.getUInt32VArray(&res2[0], N);
+
+        MY_ASSERT(res1 == res2, "bulk and scalar overlong varints differ");
+        MY_ASSERT(!ss.fail() && ss.getRemaining() == size_t(iss.rdbuf()->in_avail()),
+            "bulk and scalar overlong varints consumed different sizes");
+    }
+
+    { // capture and replay
+        const std::vector<bin::Capture::Record> records = gen_bin_capture(100);
+        MY_ASSERT(100 == replay_bin_capture(records, 0.0), "bad replayed frames");
+        MY_ASSERT(100 == replay_bin_capture(records, 1000.0), "bad accelerated replay");
+
+        // half of frame, the pause and the whole frame
+        const std::vector<UInt8> content = bin::SimpleFrame::create(1, String("payload"))->getContent();
+        std::vector<bin::Capture::Record> recs(2);
+        recs[0].direction = bin::Capture::DIR_RX;
+        recs[0].time = 0;
+        recs[0].data.assign(content.begin(), content.begin() + content.size()/2);
+        recs[1].direction = bin::Capture::DIR_RX;
+        recs[1].time = 100*1000; // 100ms
+        recs[1].data.assign(content.begin(), content.end());
+        size_t timeouts = 0;
+        MY_ASSERT(1 == replay_bin_capture(recs, 1.0, 30, &timeouts), "bad frame after resync");
+        MY_ASSERT(1 == timeouts, "partial frame should be dropped by gap timeout");
+
+        check_bin_tx_timeout();
+
+        IStringStream iss("HCAP\x01" "\x01\x00\x05" "ab"); // truncated record
+        bool failed = false;
+        try { bin::Capture::load(iss); }
+        catch (std::runtime_error const&) { failed = true; }
+        MY_ASSERT(failed, "should fail on truncated capture");
+    }
+}
+
+
+// test application entry point
+/*
+Compares the std streams and the memory streams performance.
+*/
+void test_bin1()
+{
+    using namespace boost::posix_time;
+
+    const UInt32 N = 1000000;
+    String ref;
+
+    { // std streams
+        const ptime t0 = microsec_clock::universal_time();
+        OStringStream oss;
+        bin::OStream os(oss);
+        for (UInt32 i = 0; i < N; ++i)
+            put_bin_record(os, i);
+        ref = oss.str();
+
+        const ptime t1 = microsec_clock::universal_time();
+        IStringStream iss(ref);
+        bin::IStream is(iss);
+        for (UInt32 i = 0; i < N; ++i)
+            check_bin_record(is, i);
+
+        const ptime t2 = microsec_clock::universal_time();
+        std::cout << "std streams: write " << (t1-t0).total_milliseconds()
+            << "ms, read " << (t2-t1).total_milliseconds() << "ms\n";
+    }
+
+    { // memory streams
+        const ptime t0 = microsec_clock::universal_time();
+        String buf;
+        bin::BufferOStream<String> os(buf);
+        for (UInt32 i = 0; i < N; ++i)
+            put_bin_record(os, i);
+
+        const ptime t1 = microsec_clock::universal_time();
+        bin::SpanIStream is(buf.data(), buf.size());
+        for (UInt32 i = 0; i < N; ++i)
+            check_bin_record(is, i);
+
+        const ptime t2 = microsec_clock::universal_time();
+        std::cout << "memory streams: write " << (t1-t0).total_milliseconds()
+            << "ms, read " << (t2-t1).total_milliseconds() << "ms\n";
+        MY_ASSERT(buf == ref, "memory streams differ from std streams");
+    }
+
+    { // varint arrays
+        const size_t M = 1000000;
+        std::vector<UInt32> vals = gen_bin_values<UInt32>(M);
+        for (size_t i = 0; i < M; ++i)
+            vals[i] &= (i%8 < 6) ? 0x3FFF : 0xFFFFFFFF; // mostly small
+        std::vector<UInt32> res(M);
+
+        const ptime t0 = microsec_clock::universal_time();
+        String buf;
+        bin::BufferOStream<String> os(buf);
+        for (size_t i = 0; i < M; ++i)
+            os.putUInt32V(vals[i]);
+
+        const ptime t1 = microsec_clock::universal_time();
+        bin::SpanIStream is(buf.data(), buf.size());
+        for (size_t i = 0; i < M; ++i)
+            res[i] = is.getUInt32V();
+
+        const ptime t2 = microsec_clock::universal_time();
+        buf.clear();
+        os.putUInt32VArray(&vals[0], M);
+
+        const ptime t3 = microsec_clock::universal_time();
+        bin::SpanIStream is2(buf.data(), buf.size());
+        is2.getUInt32VArray(&res[0], M);
+
+        const ptime t4 = microsec_clock::universal_time();
+        std::cout << "varint scalar: write " << (t1-t0).total_milliseconds()
+            << "ms, read " << (t2-t1).total_milliseconds() << "ms\n";
+        std::cout << "varint array: write " << (t3-t2).total_milliseconds()
+            << "ms, read " << (t4-t3).total_milliseconds() << "ms\n";
+        MY_ASSERT(res == vals, "bad varint array");
+    }
+
+    { // big-endian integer arrays
+        const size_t M = 1000000;
+        const std::vector<UInt32> vals = gen_bin_values<UInt32>(M);
+        std::vector<UInt32> res(M);
+        String buf;
+        bin::BufferOStream<String> os(buf);
+        os.putArrayBE(&vals[0], M);
+
+        const ptime t0 = microsec_clock::universal_time();
+        bin::SpanIStream is(buf.data(), buf.size());
+        for (size_t i = 0; i < M; ++i)
+            res[i] = is.getUInt32BE();
+
+        const ptime t1 = microsec_clock::universal_time();
+        bin::SpanIStream is2(buf.data(), buf.size());
+        is2.getArrayBE(&res[0], M);
+
+        const ptime t2 = microsec_clock::universal_time();
+        std::cout << "UInt32BE read: scalar " << (t1-t0).total_microseconds()
+            << "us, array " << (t2-t1).total_microseconds() << "us\n";
+        MY_ASSERT(res == vals, "bad integer array");
+    }
+
+    { // replay frames through transceiver
+        const size_t N = 100000;
+        const std::vector<bin::Capture::Record> records = gen_bin_capture(N);
+
+        const ptime t0 = microsec_clock::universal_time();
+        MY_ASSERT(N == replay_bin_capture(records, 0.0), "bad replayed frames");
+
+        const ptime t1 = microsec_clock::universal_time();
+        const Int64 us = (t1-t0).total_microseconds();
+        std::cout << "replay: " << N << " frames in " << us/1000 << "ms, "
+            << (us ? Int64(N)*1000000/us : 0) << " frames/sec\n";
+    }
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+    // socketpair producer, default and batch read modes
+    bench_bin_socketpair(1, 0);
+    bench_bin_socketpair(1, 4*1024);
+    bench_bin_socketpair(1, 64*1024);
+#endif // BOOST_ASIO_HAS_LOCAL_SOCKETS
+}
+
+#undef MY_ASSERT
+
+} // local namespace
@@ -0,0 +1,469 @@
+/** @file
+@brief The DeviceHive services test.
+@author Sergey Polichnoy <sergey.polichnoy@dataart.com>
+*/
+#include <DeviceHive/restful.hpp>
+#include <DeviceHive/websocket.hpp>
+#include <examples/test_server.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <stdexcept>
+#include <iostream>
+#include <set>
+
+namespace
+{
+    using namespace hive;
+
+// assert macro, throws exception
+#define MY_ASSERT(cond, msg) \
+    if (cond) {} else throw std::runtime_error(msg)
+
+
+// websocket throughput: notifications over one connection
+class WebsocketThroughputTest:
+    public devicehive::IDeviceServiceEvents,
+    public boost::enable_shared_from_this<WebsocketThroughputTest>
+{
+public:
+    WebsocketThroughputTest(size_t count, size_t window, size_t timeout_ms)
+        : m_count(count)
+        , m_window(window)
+        , m_timeout_ms(timeout_ms)
+        , m_sent(0)
+        , m_done(0)
+        , m_errors(0)
+    {}
+
+    void run(size_t latencyMin_ms, size_t latencyMax_ms)
+    {
+        m_server = test_server::Server::create(m_ios);
+        m_server->setLatency(latencyMin_ms, latencyMax_ms);
+
+        m_service = devicehive::WebsocketService::create(
+            http::Client::create(m_ios), m_server->getWebsocketUrl(),
+            shared_from_this(), "bench");
+        m_service->setTimeout(60000); // connect and registration should succeed
+        m_service->asyncConnect();
+
+        m_ios.run();
+    }
+
+private: // IDeviceServiceEvents
+    virtual void onConnected(ErrorCode err)
+    {
+        MY_ASSERT(!err, "cannot connect to test server");
+
+        m_device = devicehive::Device::create("ws-bench-device", "bench", "bench-key");
+        m_service->asyncRegisterDevice(m_device);
+    }
+
+    virtual void onRegisterDevice(ErrorCode err, devicehive::DevicePtr)
+    {
+        MY_ASSERT(!err, "cannot register device");
+
+        // actions keep own deadlines, so the timeout
+        // is applied to the notifications only
+        m_service->setTimeout(m_timeout_ms);
+        m_started = boost::posix_time::microsec_clock::universal_time();
+        while (m_sent < m_count && m_sent - m_done < m_window)
+            sendNext();
+    }
+
+    virtual void onInsertNotification(ErrorCode err, devicehive::DevicePtr, devicehive::NotificationPtr)
+    {
+        m_done += 1;
+        if (err)
+            m_errors += 1;
+
+        if (m_sent < m_count)
+            sendNext();
+        else if (m_done == m_count)
+            finish();
+    }
+
+private:
+    void sendNext()
+    {
+        json::Value params;
+        params["seq"] = m_sent++;
+        m_service->asyncInsertNotification(m_device,
+            devicehive::Notification::create("bench", params));
+    }
+
+    void finish()
+    {
+        using namespace boost::posix_time;
+        const time_duration elapsed = microsec_clock::universal_time() - m_started;
+        const double sec = std::max(elapsed.total_microseconds(), Int64(1)) * 1.0e-6;
+
+        std::cout << "window:" << m_window
+            << " notifications:" << m_count
+            << " errors:" << m_errors
+            << " timed out:" << m_service->getTimedOutActionCount()
+            << " time:" << elapsed.total_milliseconds() << "ms"
+            << " rate:" << size_t(m_count/sec) << "/sec\n";
+        std::cout << "server " << m_server->formatStats() << "\n";
+        MY_ASSERT(m_server->getStats().notificationsInserted >= m_count - m_errors,
+            "lost notifications");
+
+        m_service->cancelAll();
+        m_server->stop();
+        m_ios.stop();
+    }
+
+private:
+    boost::asio::io_service m_ios;
+    test_server::Server::SharedPtr m_server;
+    devicehive::WebsocketService::SharedPtr m_service;
+    devicehive::DevicePtr m_device;
+
+    size_t m_count;
+    size_t m_window;
+    size_t m_timeout_ms;
+    size_t m_sent;
+    size_t m_done;
+    size_t m_errors;
+    boost::posix_time::ptime m_started;
+};
+
+
+// test application entry point
+/*
+Measures the websocket action throughput against the local test server:
+notifications are sent with different number of actions in flight.
+The last run uses server latency close to the notification timeout,
+so some notifications are finished by timeout. The connection and
+the device registration use the long timeout.
+*/
+void test_devicehive0()
+{
+    hive::log::Logger::root().setLevel(hive::log::LEVEL_WARN);
+
+    const size_t N = 10000;
+    const size_t windows[] = { 1, 16, 256, N };
+    for (size_t i = 0; i < sizeof(windows)/sizeof(windows[0]); ++i)
+    {
+        boost::shared_ptr<WebsocketThroughputTest> t(
+            new WebsocketThroughputTest(N, windows[i], 60000));
+        t->run(0, 0);
+    }
+
+    std::cout << "with latency 50..150ms and 100ms timeout:\n";
+    boost::shared_ptr<WebsocketThroughputTest> t(
+        new WebsocketThroughputTest(1000, 64, 100));
+    t->run(50, 150);
+}
+
+
+// RESTful service integration: registrations, notifications and commands with injected faults
+class RestfulIntegrationTest:
+    public devicehive::IDeviceServiceEvents,
+    public boost::enable_shared_from_this<RestfulIntegrationTest>
+{
+public:
+    RestfulIntegrationTest(size_t devices, size_t notifications)
+        : m_deviceCount(devices)
+        , m_notificationCount(notifications)
+        , m_timer(m_ios)
+        , m_notificationsDone(0)
+        , m_retries(0)
+    {}
+
+    void run(size_t latencyMax_ms, double failureRate, double dropRate)
+    {
+        m_server = test_server::Server::create(m_ios);
+        m_server->setLatency(0, latencyMax_ms);
+        m_server->setFailureRate(failureRate);
+        m_server->setDropRate(dropRate);
+
+        m_service = devicehive::RestfulService::create(
+            http::Client::create(m_ios), m_server->getBaseUrl(),
+            shared_from_this(), "integration");
+        m_service->setAutoReconnect(true);
+        m_service->setTimeout(5000);
+        m_service->setPollWaitTimeout(2); // less than HTTP timeout
+        m_service->asyncConnect();
+
+        m_timer.expires_from_now(boost::posix_time::seconds(120));
+        m_timer.async_wait(boost::bind(&RestfulIntegrationTest::onDeadline,
+            shared_from_this(), boost::asio::placeholders::error));
+
+        m_started = boost::posix_time::microsec_clock::universal_time();
+        m_ios.run();
+    }
+
+private: // IDeviceServiceEvents
+    virtual void onConnected(ErrorCode err)
+    {
+        MY_ASSERT(!err, "cannot connect to test server");
+
+        m_service->asyncGetServerInfo();
+    }
+
+    virtual void onServerInfo(ErrorCode err, devicehive::ServerInfo info)
+    {
+        if (err)
+        {
+            m_retries += 1;
+            m_service->asyncGetServerInfo();
+            return;
+        }
+
+        // commands are polled since this timestamp,
+        // so the commands inserted before the first poll are not lost
+        m_serverTimestamp = info.timestamp;
+
+        std::vector<devicehive::DevicePtr> devices;
+        for (size_t i = 0; i < m_deviceCount; ++i)
+        {
+            OStringStream oss;
+            oss << "it-device-" << i;
+            devices.push_back(devicehive::Device::create(oss.str(), "integration", "it-key"));
+        }
+
+        m_service->asyncRegisterDevices(devices);
+    }
+
+    virtual void onRegisterDevice(ErrorCode err, devicehive::DevicePtr device)
+    {
+        if (err)
+        {
+            m_retries += 1;
+            m_service->asyncRegisterDevice(device);
+            return;
+        }
+
+        m_service->asyncSubscribeForCommands(device, m_serverTimestamp);
+        m_pendingCommands.insert(m_server->insertCommand(device->id, "ping"));
+
+        for (size_t i = 0; i < m_notificationCount; ++i)
+        {
+            json::Value params;
+            params["seq"] = i;
+            m_service->asyncInsertNotification(device,
+                devicehive::Notification::create("integration", params));
+        }
+    }
+
+    virtual void onInsertCommand(ErrorCode err, devicehive::DevicePtr device, devicehive::CommandPtr command)
+    {
+        if (err == boost::asio::error::operation_aborted)
+            return; // cancelled
+        MY_ASSERT(!err, "poll errors should be restored");
+
+        command->status = "Done";
+        m_service->asyncUpdateCommand(device, command);
+    }
+
+    virtual void onUpdateCommand(ErrorCode err, devicehive::DevicePtr device, devicehive::CommandPtr command)
+    {
+        if (err)
+        {
+            m_retries += 1;
+            m_service->asyncUpdateCommand(device, command);
+            return;
+        }
+
+        m_pendingCommands.erase(command->id);
+        checkDone();
+    }
+
+    virtual void onInsertNotification(ErrorCode err, devicehive::DevicePtr device, devicehive::NotificationPtr notification)
+    {
+        if (err)
+        {
+            m_retries += 1;
+            m_service->asyncInsertNotification(device, notification);
+            return;
+        }
+
+        m_notificationsDone += 1;
+        checkDone();
+    }
+
+private:
+    void checkDone()
+    {
+        if (m_notificationsDone < m_deviceCount*m_notificationCount || !m_pendingCommands.empty())
+            return;
+
+        using namespace boost::posix_time;
+        const time_duration elapsed = microsec_clock::universal_time() - m_started;
+        std::cout << "devices:" << m_deviceCount
+            << " notifications:" << m_notificationsDone
+            << " retries:" << m_retries
+            << " time:" << elapsed.total_milliseconds() << "ms\n";
+        std::cout << "server " << m_server->formatStats() << "\n";
+
+        const test_server::Server::Stats &stats = m_server->getStats();
+        MY_ASSERT(stats.notificationsInserted >= m_notificationsDone, "lost notifications");
+        MY_ASSERT(stats.commandsUpdated >= m_deviceCount, "lost command updates");
+
+        m_timer.cancel();
+        m_service->cancelAll();
+        m_server->stop();
+        m_ios.stop();
+    }
+
+    void onDeadline(ErrorCode err)
+    {
+        if (err)
+            return; // cancelled
+
+        std::cout << "server " << m_server->formatStats() << "\n";
+        MY_ASSERT(false, "integration test timed out");
+    }
+
+private:
+    boost::asio::io_service m_ios;
+    test_server::Server::SharedPtr m_server;
+    devicehive::RestfulService::SharedPtr m_service;
+
+    size_t m_deviceCount;
+    size_t m_notificationCount;
+    String m_serverTimestamp;
+    boost::asio::deadline_timer m_timer;
+    std::set<UInt64> m_pendingCommands;
+    size_t m_notificationsDone;
+    size_t m_retries;
+    boost::posix_time::ptime m_started;
+};
+
+
+// test application entry point
+/*
+Runs the RESTful service against the local test server:
+devices are registered in bulk, then notifications are sent
+and commands are polled and updated. Failed requests are retried
+by the test, failed polls are restored by the service.
+The first run is fault-free, the second one injects failures,
+connection drops and latency.
+*/
+void test_devicehive2()
+{
+    hive::log::Logger::root().setLevel(hive::log::LEVEL_WARN);
+
+    { // no faults
+        boost::shared_ptr<RestfulIntegrationTest> t(
+            new RestfulIntegrationTest(50, 20));
+        t->run(0, 0.0, 0.0);
+    }
+
+    std::cout << "with latency 0..20ms, 5% failures and 1% drops:\n";
+    boost::shared_ptr<RestfulIntegrationTest> t(
+        new RestfulIntegrationTest(50, 20));
+    t->run(20, 0.05, 0.01);
+}
+
+
+// generate the "poll commands" response
+String gen_poll_response(size_t count, size_t paramsSize)
+{
+    json::Value jres;
+    for (size_t i = 0; i < count; ++i)
+    {
+        json::Value params;
+        for (size_t k = 0; k < paramsSize; ++k)
+        {
+            OStringStream oss;
+            oss << "param" << k;
+            params[oss.str()] = "value of " + oss.str();
+        }
+
+        json::Value jcmd;
+        jcmd["id"] = i+1;
+        jcmd["timestamp"] = "2013-01-01T00:00:00.000000";
+        jcmd["command"] = "bench";
+        jcmd["parameters"] = params;
+        jcmd["lifetime"] = 0;
+        jcmd["flags"] = 0;
+        jres.append(jcmd);
+    }
+
+    return json::toStr(jres);
+}
+
+
+// test application entry point
+/*
+Compares "poll commands" response parsing: Serializer::fromJson()
+versus Serializer::moveFromJson() versus Serializer::parseLazy().
+The lazy parsing is measured with and without parameters access.
+*/
+void test_devicehive1()
+{
+    using namespace boost::posix_time;
+    using devicehive::Command;
+    using devicehive::CommandPtr;
+    using devicehive::Serializer;
+
+    const size_t N = 100;
+    const String content = gen_poll_response(100, 50);
+    size_t total[4] = { 0, 0, 0, 0 };
+
+    const ptime t0 = microsec_clock::universal_time();
+    for (size_t i = 0; i < N; ++i)
+    {
+        const json::Value jres = json::fromStr(content);
+        for (size_t k = 0; k < jres.size(); ++k)
+        {
+            CommandPtr command = Command::create();
+            Serializer::fromJson(jres[k], command);
+            total[0] += command->getParams().size();
+        }
+    }
+
+    const ptime t1 = microsec_clock::universal_time();
+    for (size_t i = 0; i < N; ++i)
+    {
+        json::Value jres = json::fromStr(content);
+        for (size_t k = 0; k < jres.size(); ++k)
+        {
+            CommandPtr command = Command::create();
+            Serializer::moveFromJson(jres[k], command);
+            total[1] += command->getParams().size();
+        }
+    }
+
+    const ptime t2 = microsec_clock::universal_time();
+    for (size_t i = 0; i < N; ++i)
+    {
+        IStringStream iss(content);
+        json::Parser::parseBegin(iss, '[');
+        for (bool first = true; json::Parser::parseNextElement(iss, first); )
+        {
+            CommandPtr command = Command::create();
+            Serializer::parseLazy(iss, command);
+            total[2] += !command->name.empty();
+        }
+    }
+
+    const ptime t3 = microsec_clock::universal_time();
+    for (size_t i = 0; i < N; ++i)
+    {
+        IStringStream iss(content);
+        json::Parser::parseBegin(iss, '[');
+        for (bool first = true; json::Parser::parseNextElement(iss, first); )
+        {
+            CommandPtr command = Command::create();
+            Serializer::parseLazy(iss, command);
+            total[3] += command->getParams().size();
+        }
+    }
+
+    const ptime t4 = microsec_clock::universal_time();
+    std::cout << "poll response of " << content.size() << " bytes:"
+        << " fromJson " << (t1-t0).total_milliseconds()
+        << "ms, moveFromJson " << (t2-t1).total_milliseconds()
+        << "ms, parseLazy " << (t3-t2).total_milliseconds()
+        << "ms, parseLazy+getParams " << (t4-t3).total_milliseconds() << "ms\n";
+    MY_ASSERT(total[0] == N*100*50, "invalid fromJson parameters");
+    MY_ASSERT(total[1] == total[0], "invalid moveFromJson parameters");
+    MY_ASSERT(total[2] == N*100, "invalid parseLazy commands");
+    MY_ASSERT(total[3] == total[0], "invalid parseLazy parameters");
+}
+
+#undef MY_ASSERT
+
+} // local namespace
@@ -3,6 +3,7 @@
 @author Sergey Polichnoy <sergey.polichnoy@dataart.com>
 */
 #include <hive/dump.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 #include <stdexcept>
 #include <iostream>
 #include <assert.h>
@@ -42,6 +43,54 @@ void check_dump_hex()
 }
 
 
+// generate random binary data
+std::vector<UInt8> gen_dump_data(size_t len)
+{
+    std::vector<UInt8> data(len);
+    for (size_t i = 0; i < len; ++i)
+        data[i] = UInt8(rand());
+    return data;
+}
+
+
+// check contiguous fast paths against generic iterator versions
+void check_dump_codecs()
+{
+    for (size_t len = 0; len < 200; ++len)
+    {
+        const std::vector<UInt8> data = gen_dump_data(len);
+        const String sdata(data.begin(), data.end());
+
+        // HEX
+        const String h = dump::hex(data.begin(), data.end());
+        MY_ASSERT(dump::hex(data) == h, "invalid dump::hex(vector)");
+        MY_ASSERT(dump::hex(sdata) == h, "invalid dump::hex(string)");
+        MY_ASSERT(misc::base16_encode(data) == h, "invalid base16_encode(vector)");
+        OStringStream oss;
+        dump::hex(oss, data);
+        MY_ASSERT(oss.str() == h, "invalid dump::hex(stream)");
+
+        // base64
+        const String a = misc::base64_encode(data.begin(), data.end());
+        MY_ASSERT(misc::base64_encode(data) == a, "invalid base64_encode(vector)");
+        MY_ASSERT(misc::base64_encode(sdata) == a, "invalid base64_encode(string)");
+        MY_ASSERT(misc::base64_decode(a) == data, "invalid base64_decode()");
+
+        // base64 with one corrupted character
+        if (!a.empty())
+        {
+            String b = a;
+            const size_t pos = rand()%b.size();
+            b[pos] = "!{@\xFF\x00"[rand()%5];
+            bool failed = false;
+            try { misc::base64_decode(b); }
+            catch (std::runtime_error const&) { failed = true; }
+            MY_ASSERT(failed, "base64_decode() should fail on invalid data");
+        }
+    }
+}
+
+
 // test application entry point
 /*
 Checks for auxiliary dump tools.
@@ -66,10 +115,68 @@ void test_dump0()
     check_dump_hex<UInt16>(); check_dump_hex<Int16>();
     check_dump_hex<UInt32>(); check_dump_hex<Int32>();
     check_dump_hex<UInt64>(); check_dump_hex<Int64>();
+    check_dump_codecs();
 
     std::cout << "done\n\n";
 }
 
+
+// test application entry point
+/*
+Benchmark for HEX and base64 codecs.
+*/
+void test_dump1()
+{
+    using namespace boost::posix_time;
+
+    const size_t N = 1000;
+    const std::vector<UInt8> data = gen_dump_data(64*1024);
+
+    { // HEX
+        const ptime t0 = microsec_clock::universal_time();
+        size_t total = 0;
+        for (size_t i = 0; i < N; ++i)
+            total += dump::hex(data.begin(), data.end()).size();
+
+        const ptime t1 = microsec_clock::universal_time();
+        for (size_t i = 0; i < N; ++i)
+            total -= dump::hex(data).size();
+
+        const ptime t2 = microsec_clock::universal_time();
+        std::cout << "HEX: generic " << (t1-t0).total_milliseconds()
+            << "ms, buffer " << (t2-t1).total_milliseconds() << "ms\n";
+        MY_ASSERT(0 == total, "invalid HEX size");
+    }
+
+    { // base64
+        const String ref = misc::base64_encode(data.begin(), data.end());
+        std::vector<UInt8> res(data.size());
+
+        const ptime t0 = microsec_clock::universal_time();
+        for (size_t i = 0; i < N; ++i)
+            misc::base64_encode(data.begin(), data.end());
+
+        const ptime t1 = microsec_clock::universal_time();
+        for (size_t i = 0; i < N; ++i)
+            misc::base64_encode(data);
+
+        const ptime t2 = microsec_clock::universal_time();
+        for (size_t i = 0; i < N; ++i)
+            res.erase(misc::base64_decode(ref.begin(), ref.end(), res.begin()), res.end());
+
+        const ptime t3 = microsec_clock::universal_time();
+        for (size_t i = 0; i < N; ++i)
+            res = misc::base64_decode(ref);
+
+        const ptime t4 = microsec_clock::universal_time();
+        std::cout << "base64 encode: generic " << (t1-t0).total_milliseconds()
+            << "ms, buffer " << (t2-t1).total_milliseconds() << "ms\n";
+        std::cout << "base64 decode: generic " << (t3-t2).total_milliseconds()
+            << "ms, buffer " << (t4-t3).total_milliseconds() << "ms\n";
+        MY_ASSERT(res == data, "invalid base64 decode");
+    }
+}
+
 #undef MY_ASSERT
 
 } // local namespace
@@ -180,6 +180,43 @@ void test_json0()
         v10 = getStringJVal();
     }
 
+    { // check member by member parsing
+        IStringStream iss(" [ {\"id\":1, \"parameters\": {\"a\":[1,\"]}\\\"\"],\"b\":null} }, {\"id\":2,\"parameters\":123} ] ");
+        std::vector<String> raw;
+
+        json::Parser::parseBegin(iss, '[');
+        for (bool first = true; json::Parser::parseNextElement(iss, first); )
+        {
+            json::Parser::parseBegin(iss, '{');
+            String name;
+            for (bool firstMember = true; json::Parser::parseNextMember(iss, firstMember, name); )
+            {
+                if (name == "parameters")
+                {
+                    raw.push_back(String());
+                    json::Parser::parseRaw(iss, raw.back());
+                }
+                else
+                {
+                    json::Value jval;
+                    json::Parser::parse(iss, jval);
+                    MY_ASSERT(jval.asInt() == int(raw.size()+1), "bad member value");
+                }
+            }
+        }
+
+        MY_ASSERT(raw.size() == 2, "bad number of elements");
+        MY_ASSERT(raw[0] == "{\"a\":[1,\"]}\\\"\"],\"b\":null}", "bad raw object");
+        MY_ASSERT(json::fromStr(raw[0])["a"][1].asString() == "]}\"", "bad raw object content");
+        MY_ASSERT(raw[1] == "123", "bad raw integer");
+
+        try { IStringStream bad("[1 2]"); bool first = true;
+            json::Parser::parseBegin(bad, '['); json::Parser::parseNextElement(bad, first);
+            json::Value jval; json::Parser::parse(bad, jval);
+            MY_ASSERT(!json::Parser::parseNextElement(bad, first) && false, "cannot parse \"[1 2]\"");
+        } catch (json::error::SyntaxError const&) {}
+    }
+
     std::cout << "\n\n";
 }
 
@@ -0,0 +1,80 @@
+/** @file
+@brief The buffer pool unit test.
+@author Sergey Polichnoy <sergey.polichnoy@dataart.com>
+*/
+#include <hive/pool.hpp>
+#include <stdexcept>
+#include <iostream>
+
+namespace
+{
+    using namespace hive;
+
+// assert macro, throws exception
+#define MY_ASSERT(cond, msg) \
+    if (cond) {} else throw std::runtime_error(msg)
+
+
+// fill the buffer with some data
+void fill_pool_buffer(BufferPool::StreamBuf &sb, size_t len)
+{
+    OStream os(&sb);
+    os << String(len, 'x');
+}
+
+
+// test application entry point
+/*
+Checks for buffer pool.
+*/
+void test_pool0()
+{
+    std::cout << "check for buffer pool... ";
+
+    BufferPool::SharedPtr pool = BufferPool::create(64*1024);
+
+    { // reuse
+        BufferPool::StreamBufPtr a = pool->acquire();
+        fill_pool_buffer(*a, 1000);
+        MY_ASSERT(1 == pool->getInUseCount(), "invalid in-use count");
+    }
+    MY_ASSERT(0 == pool->getInUseCount(), "buffer is not returned");
+    MY_ASSERT(0 < pool->getIdleBytes(), "buffer is not kept");
+
+    {
+        BufferPool::StreamBufPtr a = pool->acquire();
+        MY_ASSERT(0 == a->size(), "returned buffer is not empty");
+        MY_ASSERT(0 < pool->getInUseBytes(), "invalid in-use bytes");
+        MY_ASSERT(0.5 == pool->getHitRate(), "invalid hit rate");
+    }
+
+    { // huge buffers are dropped
+        BufferPool::StreamBufPtr a = pool->acquire();
+        fill_pool_buffer(*a, 1024*1024);
+    }
+    MY_ASSERT(0 == pool->getIdleBytes(), "huge buffer is kept");
+    MY_ASSERT(1 == pool->getDroppedCount(), "invalid dropped count");
+
+    { // idle memory limit
+        std::vector<BufferPool::StreamBufPtr> bufs;
+        for (size_t i = 0; i < 10; ++i)
+        {
+            bufs.push_back(pool->acquire());
+            fill_pool_buffer(*bufs.back(), 16*1024);
+        }
+    }
+    MY_ASSERT(pool->getIdleBytes() <= 64*1024, "idle memory limit exceeded");
+    MY_ASSERT(0 == pool->getInUseCount(), "buffers are not returned");
+
+    { // buffer outlives the pool
+        BufferPool::StreamBufPtr a = pool->acquire();
+        pool.reset();
+        fill_pool_buffer(*a, 100);
+    }
+
+    std::cout << "done\n\n";
+}
+
+#undef MY_ASSERT
+
+} // local namespace
@@ -0,0 +1,198 @@
+/** @file
+@brief The serial stream device benchmark.
+@author Sergey Polichnoy <sergey.polichnoy@dataart.com>
+*/
+#include <DeviceHive/gateway.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <iostream>
+#include <vector>
+
+#if !defined(WIN32) && !defined(_WIN32)
+#   include <stdlib.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif // WIN32
+
+namespace
+{
+    using namespace hive;
+
+// assert macro, throws exception
+#define MY_ASSERT(cond, msg) \
+    if (cond) {} else throw std::runtime_error(msg)
+
+#if !defined(WIN32) && !defined(_WIN32)
+
+/// @brief The frame round-trip benchmark over a pseudo-terminal pair.
+/**
+The serial device is opened on the slave side, the master side echoes
+everything back. Each frame is sent once the previous echo is received.
+*/
+class SerialEchoBench
+{
+public:
+    typedef gateway::StreamDevice::Serial Serial;
+    typedef boost::posix_time::ptime Time;
+
+    SerialEchoBench(boost::asio::io_service &ios, int master, String const& slaveName, bool lowLatency)
+        : m_serial(Serial::create(ios, slaveName, 115200))
+        , m_master(ios, master)
+        , m_frame(16, 'x')
+        , m_rx_len(0)
+        , m_frames(0)
+    {
+        m_serial->setLowLatency(lowLatency);
+    }
+
+    void start(size_t frames)
+    {
+        m_frames = frames;
+        m_rtt.reserve(frames);
+        m_serial->async_open(boost::bind(&SerialEchoBench::onOpen, this, _1));
+        asyncEcho();
+    }
+
+    void stop()
+    {
+        m_serial->close();
+        m_master.close();
+    }
+
+    Serial::Settings const& getSettings() const
+    {
+        return m_serial->getSettings();
+    }
+
+    std::vector<long>& getRoundTrips()
+    {
+        return m_rtt;
+    }
+
+private:
+
+    void onOpen(boost::system::error_code err)
+    {
+        MY_ASSERT(!err, "cannot open pty slave");
+        sendFrame();
+    }
+
+    void sendFrame()
+    {
+        m_rx_len = 0;
+        m_start = boost::posix_time::microsec_clock::universal_time();
+        m_serial->async_write_some(boost::asio::buffer(m_frame),
+            boost::bind(&SerialEchoBench::onSent, this, _1, _2));
+        m_serial->async_read_some(boost::asio::buffer(m_rx_buf),
+            boost::bind(&SerialEchoBench::onRecv, this, _1, _2));
+    }
+
+    void onSent(boost::system::error_code err, size_t len)
+    {
+        MY_ASSERT(!err && len == m_frame.size(), "cannot write frame");
+    }
+
+    void onRecv(boost::system::error_code err, size_t len)
+    {
+        if (err) return; // closed
+        m_rx_len += len;
+        if (m_rx_len < m_frame.size())
+        {
+            m_serial->async_read_some(boost::asio::buffer(m_rx_buf),
+                boost::bind(&SerialEchoBench::onRecv, this, _1, _2));
+            return;
+        }
+
+        const Time now = boost::posix_time::microsec_clock::universal_time();
+        m_rtt.push_back(long((now - m_start).total_microseconds()));
+        if (m_rtt.size() < m_frames)
+            sendFrame();
+        else
+            stop();
+    }
+
+    void asyncEcho()
+    {
+        m_master.async_read_some(boost::asio::buffer(m_echo_buf),
+            boost::bind(&SerialEchoBench::onEcho, this, _1, _2));
+    }
+
+    void onEcho(boost::system::error_code err, size_t len)
+    {
+        if (err) return; // closed
+        boost::asio::write(m_master, boost::asio::buffer(m_echo_buf, len), err);
+        if (!err) asyncEcho();
+    }
+
+private:
+    Serial::SharedPtr m_serial;
+    boost::asio::posix::stream_descriptor m_master;
+    const String m_frame;
+    char m_rx_buf[256];
+    char m_echo_buf[256];
+    size_t m_rx_len;
+    size_t m_frames;
+    Time m_start;
+    std::vector<long> m_rtt;
+};
+
+
+// run the round-trip benchmark
+void bench_serial_echo(bool lowLatency, size_t frames)
+{
+    const int master = ::posix_openpt(O_RDWR|O_NOCTTY);
+    MY_ASSERT(0 <= master, "cannot open pty master");
+    MY_ASSERT(0 == ::grantpt(master) && 0 == ::unlockpt(master), "cannot unlock pty");
+    const String slaveName = ::ptsname(master);
+
+    boost::asio::io_service ios;
+    SerialEchoBench bench(ios, master, slaveName, lowLatency);
+    bench.start(frames);
+    ios.run();
+
+    std::vector<long> &rtt = bench.getRoundTrips();
+    MY_ASSERT(rtt.size() == frames, "not all frames are received");
+    std::sort(rtt.begin(), rtt.end());
+
+    double total = 0.0;
+    for (size_t i = 0; i < rtt.size(); ++i)
+        total += rtt[i];
+
+    std::cout << (lowLatency ? "low-latency" : "default") << " mode ["
+        << bench.getSettings().toString() << "]:\n\t"
+        << frames << " frames, round-trip avg: " << (total/frames) << "us"
+        << ", p50: " << rtt[frames/2] << "us"
+        << ", p99: " << rtt[frames*99/100] << "us\n";
+}
+
+#endif // WIN32
+
+
+// test application entry point
+/*
+Serial port round-trip benchmark.
+
+A pseudo-terminal has no latency timer and doesn't support
+`ASYNC_LOW_LATENCY`, so both modes are expected to be the same here.
+The benchmark checks the low-latency mode doesn't break anything,
+the gain should be measured on a real USB-serial adapter.
+*/
+void test_serial0()
+{
+    std::cout << "serial port round-trip benchmark...\n";
+
+#if !defined(WIN32) && !defined(_WIN32)
+    const size_t FRAMES = 10000;
+    bench_serial_echo(false, FRAMES);
+    bench_serial_echo(true, FRAMES);
+    std::cout << "NOTE: pseudo-terminal has no latency timer, so it cannot show"
+        " any difference between modes, use a real USB-serial adapter\n";
+#else
+    std::cout << "pseudo-terminals are not supported\n";
+#endif // WIN32
+}
+
+#undef MY_ASSERT
+
+} // local namespace
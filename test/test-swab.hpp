@@ -5,6 +5,7 @@
 #include <hive/swab.hpp>
 #include <stdexcept>
 #include <iostream>
+#include <vector>
 #include <assert.h>
 
 namespace
@@ -53,6 +54,44 @@ void check_swab()
     }
 }
 
+template<typename T>
+void check_swab_array()
+{
+    // check for all sizes around SIMD block
+    for (size_t n = 0; n < 100; ++n)
+    {
+        std::vector<T> src(n+1), dst(n+1, T(0));
+        for (size_t i = 0; i < n+1; ++i)
+            src[i] = T(UInt64(rand()) * UInt64(rand()) * 2654435761u);
+        const T guard = dst[n];
+
+        misc::swab_array(&dst[0], &src[0], n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            MY_ASSERT(dst[i] == misc::swab(src[i]), "invalid swab_array");
+        }
+        MY_ASSERT(dst[n] == guard, "swab_array out of range");
+
+        misc::h2le_array(&dst[0], &src[0], n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            MY_ASSERT(dst[i] == misc::h2le(src[i]), "invalid h2le_array");
+        }
+
+        misc::h2be_array(&dst[0], &src[0], n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            MY_ASSERT(dst[i] == misc::h2be(src[i]), "invalid h2be_array");
+        }
+
+        // in-place
+        std::vector<T> tmp(src);
+        misc::be2h_array(&tmp[0], &tmp[0], n);
+        misc::h2be_array(&tmp[0], &tmp[0], n);
+        MY_ASSERT(tmp == src, "be2h_array and h2be_array should be consistent");
+    }
+}
+
 // test application entry point
 /*
 Checks for swab functions.
@@ -65,6 +104,10 @@ void test_swab0()
     check_swab<UInt32>(); check_swab<Int32>();
     check_swab<UInt64>(); check_swab<Int64>();
 
+    check_swab_array<UInt16>(); check_swab_array<Int16>();
+    check_swab_array<UInt32>(); check_swab_array<Int32>();
+    check_swab_array<UInt64>(); check_swab_array<Int64>();
+
     std::cout << "done\n";
 }
 
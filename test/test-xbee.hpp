@@ -0,0 +1,565 @@
+/** @file
+@brief The XBee API mode 2, AT command pipeline, payload views and transmit scheduler test.
+@author Sergey Polichnoy <sergey.polichnoy@dataart.com>
+*/
+#include <DeviceHive/xbee.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <stdexcept>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+    using namespace hive;
+
+// assert macro, throws exception
+#define MY_ASSERT(cond, msg) \
+    if (cond) {} else throw std::runtime_error(msg)
+
+
+// escape the whole frame, the reference implementation
+String xbee_escape_frame(String const& frame)
+{
+    String res;
+    for (size_t i = 0; i < frame.size(); ++i)
+    {
+        const UInt8 b = UInt8(frame[i]);
+        if (0 != i && (b == 0x7E || b == 0x7D || b == 0x11 || b == 0x13))
+        {
+            res.push_back(char(0x7D));
+            res.push_back(char(b ^ 0x20));
+        }
+        else
+            res.push_back(char(b));
+    }
+
+    return res;
+}
+
+
+// AT command with special bytes in parameters
+String xbee_test_command(size_t i)
+{
+    String cmd = "NI";
+    cmd.push_back(char(0x7E));
+    cmd.push_back(char(0x11));
+    cmd.push_back(char(i));
+    return cmd;
+}
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+
+/// @brief The fake XBee module.
+/**
+Answers each AT command, the parameters are echoed back with a few
+special bytes appended. All responses to the received data are
+sent after the link latency.
+
+Each transmit request is delivered if the network address is unknown
+(with the address discovery) or valid. The network address of a node
+is the low byte of MAC address plus the address base.
+*/
+class FakeXBeeModule
+{
+public:
+    typedef boost::asio::local::stream_protocol::socket Socket;
+
+    FakeXBeeModule(boost::asio::io_service &ios, bool escaped, long latency_us)
+        : m_socket(ios)
+        , m_timer(ios)
+        , m_escaped(escaped)
+        , m_latency(boost::posix_time::microseconds(latency_us))
+        , m_rx_escape(false)
+        , m_writing(false)
+        , m_timer_active(false)
+        , m_addr16_base(0x1000)
+    {}
+
+    Socket& socket()
+    {
+        return m_socket;
+    }
+
+    // all nodes rejoin the network
+    void setAddressBase(UInt16 base)
+    {
+        m_addr16_base = base;
+    }
+
+    void start()
+    {
+        m_socket.async_read_some(boost::asio::buffer(m_rx_buf),
+            boost::bind(&FakeXBeeModule::onRead, this, _1, _2));
+    }
+
+private:
+
+    void onRead(boost::system::error_code err, size_t len)
+    {
+        if (err) return; // closed
+
+        UInt8 *data = reinterpret_cast<UInt8*>(m_rx_buf);
+        if (m_escaped)
+            len = xbee::EscapedStream<Socket>::unescape(data, len, data, m_rx_escape);
+        m_rx_data.sputn(m_rx_buf, len);
+
+        while (xbee::Frame::SharedPtr frame = xbee::Frame::parseFrame(m_rx_data, 0))
+        {
+            xbee::Frame::SharedPtr f = (frame->getIntent() == xbee::Frame::ZB_TRANSMIT_REQUEST)
+                ? transmit(frame) : command(frame);
+            const String content(f->getContent().begin(), f->getContent().end());
+            m_pending += m_escaped ? xbee_escape_frame(content) : content;
+        }
+
+        if (!m_pending.empty() && !m_timer_active)
+        {
+            m_timer_active = true;
+            m_timer.expires_from_now(m_latency);
+            m_timer.async_wait(boost::bind(&FakeXBeeModule::onTimer, this, _1));
+        }
+
+        start();
+    }
+
+    xbee::Frame::SharedPtr command(xbee::Frame::SharedPtr frame)
+    {
+        xbee::Frame::ATCommandRequest req;
+        MY_ASSERT(frame->getPayload(req), "bad AT command request");
+
+        xbee::Frame::ATCommandResponse res;
+        res.frameId = req.frameId;
+        res.command = req.command.substr(0, 2);
+        res.status = xbee::Frame::ATCommandResponse::STATUS_OK;
+        res.result = req.command.substr(2) + "\x7D\x13";
+        return xbee::Frame::create(res);
+    }
+
+    xbee::Frame::SharedPtr transmit(xbee::Frame::SharedPtr frame)
+    {
+        xbee::Frame::ZBTransmitRequest req;
+        MY_ASSERT(frame->getPayload(req), "bad transmit request");
+
+        const UInt16 addr16 = UInt16(m_addr16_base + (req.dstAddr64&0xFF));
+        xbee::Frame::ZBTransmitStatus res;
+        res.frameId = req.frameId;
+        if (req.dstAddr16 == xbee::Frame::ZBTransmitRequest::UNKNOWN_ADDRESS16)
+        {
+            res.dstAddr16 = addr16;
+            res.deliveryStatus = xbee::Frame::ZBTransmitStatus::DELIVERY_SUCCESS;
+            res.discoveryStatus = xbee::Frame::ZBTransmitStatus::DISCOVERY_ADDRESS;
+        }
+        else if (req.dstAddr16 == addr16)
+        {
+            res.dstAddr16 = addr16;
+            res.deliveryStatus = xbee::Frame::ZBTransmitStatus::DELIVERY_SUCCESS;
+        }
+        else
+        {
+            res.dstAddr16 = xbee::Frame::ZBTransmitRequest::UNKNOWN_ADDRESS16;
+            res.deliveryStatus = xbee::Frame::ZBTransmitStatus::DELIVERY_ADDRESS_NOT_FOUND;
+        }
+
+        return xbee::Frame::create(res);
+    }
+
+    void onTimer(boost::system::error_code err)
+    {
+        m_timer_active = false;
+        if (err) return; // cancelled
+
+        m_ready += m_pending;
+        m_pending.clear();
+        flush();
+    }
+
+    void flush()
+    {
+        if (!m_writing && !m_ready.empty())
+        {
+            m_writing = true;
+            m_tx_data.swap(m_ready);
+            m_ready.clear();
+            boost::asio::async_write(m_socket, boost::asio::buffer(m_tx_data),
+                boost::bind(&FakeXBeeModule::onWrite, this, _1));
+        }
+    }
+
+    void onWrite(boost::system::error_code err)
+    {
+        m_writing = false;
+        if (!err) flush();
+    }
+
+private:
+    Socket m_socket;
+    boost::asio::deadline_timer m_timer;
+    bool m_escaped;
+    boost::posix_time::time_duration m_latency;
+
+    char m_rx_buf[256];
+    bool m_rx_escape;
+    boost::asio::streambuf m_rx_data;
+
+    String m_pending; // waiting for latency
+    String m_ready;   // waiting for write
+    String m_tx_data; // being written
+    bool m_writing;
+    bool m_timer_active;
+    UInt16 m_addr16_base;
+};
+
+
+/// @brief The AT command pipeline benchmark.
+class XBeePipelineBench
+{
+public:
+    typedef boost::asio::local::stream_protocol::socket Socket;
+    typedef xbee::EscapedStream<Socket> Stream;
+    typedef xbee::API<Stream> API;
+
+    XBeePipelineBench(boost::asio::io_service &ios, bool escaped, size_t window)
+        : m_ios(ios)
+        , m_module(ios, escaped, 1000)
+        , m_socket(ios)
+        , m_stream(m_socket, escaped)
+        , m_expected(0)
+        , m_delivered(0)
+    {
+        boost::asio::local::connect_pair(m_socket, m_module.socket());
+        m_api = API::create(m_stream);
+        m_api->setATWindow(window);
+        m_module.start();
+    }
+
+    void sequential(size_t N)
+    {
+        m_expected = N;
+        for (size_t i = 0; i < N; ++i)
+        {
+            m_api->queryAT(xbee_test_command(i),
+                boost::bind(&XBeePipelineBench::onResponse, this, _1));
+        }
+    }
+
+    void batch(size_t N)
+    {
+        m_expected = N;
+        std::vector<String> commands;
+        for (size_t i = 0; i < N; ++i)
+            commands.push_back(xbee_test_command(i));
+        m_api->queryATBatch(commands,
+            boost::bind(&XBeePipelineBench::onBatch, this, _1));
+    }
+
+    // send N unicast frames with unknown network address
+    void transmit(std::vector<UInt64> const& nodes, size_t N)
+    {
+        m_expected += N*nodes.size();
+        for (size_t i = 0; i < N; ++i)
+            for (size_t k = 0; k < nodes.size(); ++k)
+        {
+            m_api->transmit(xbee::Frame::ZBTransmitRequest("data", 0, nodes[k]),
+                boost::bind(&XBeePipelineBench::onTransmitted, this, _1));
+        }
+    }
+
+    std::vector<xbee::Frame::ATCommandResponse> const& getResponses() const
+    {
+        return m_responses;
+    }
+
+    FakeXBeeModule& getModule()
+    {
+        return m_module;
+    }
+
+    API::SharedPtr getAPI() const
+    {
+        return m_api;
+    }
+
+private:
+
+    void onResponse(xbee::Frame::ATCommandResponse const& res)
+    {
+        m_responses.push_back(res);
+        if (m_responses.size() == m_expected)
+            m_ios.stop();
+    }
+
+    void onBatch(std::vector<xbee::Frame::ATCommandResponse> const& res)
+    {
+        m_responses = res;
+        m_ios.stop();
+    }
+
+    void onTransmitted(int status)
+    {
+        MY_ASSERT(status == xbee::Frame::ZBTransmitStatus::DELIVERY_SUCCESS, "frame is not delivered");
+        if (++m_delivered == m_expected)
+            m_ios.stop();
+    }
+
+private:
+    boost::asio::io_service &m_ios;
+    FakeXBeeModule m_module;
+    Socket m_socket;
+    Stream m_stream;
+    API::SharedPtr m_api;
+    size_t m_expected;
+    size_t m_delivered;
+    std::vector<xbee::Frame::ATCommandResponse> m_responses;
+};
+
+
+// run the AT command benchmark
+void bench_xbee_at(bool escaped, size_t window, bool batch, size_t N)
+{
+    using namespace boost::posix_time;
+
+    boost::asio::io_service ios;
+    XBeePipelineBench bench(ios, escaped, window);
+
+    const ptime t0 = microsec_clock::universal_time();
+    if (batch)
+        bench.batch(N);
+    else
+        bench.sequential(N);
+    ios.run();
+    const ptime t1 = microsec_clock::universal_time();
+
+    std::vector<xbee::Frame::ATCommandResponse> const& res = bench.getResponses();
+    MY_ASSERT(res.size() == N, "not all responses are received");
+    for (size_t i = 0; i < N; ++i)
+    {
+        MY_ASSERT(res[i].status == xbee::Frame::ATCommandResponse::STATUS_OK, "bad response status");
+        MY_ASSERT(res[i].command == "NI", "bad response command");
+        MY_ASSERT(res[i].result == xbee_test_command(i).substr(2) + "\x7D\x13", "bad response data");
+    }
+
+    std::cout << (escaped ? "API mode 2" : "API mode 1") << ", window " << window
+        << (batch ? ", batch: " : ": ") << N << " AT commands in "
+        << (t1-t0).total_milliseconds() << "ms\n";
+}
+
+#endif // BOOST_ASIO_HAS_LOCAL_SOCKETS
+
+
+// test application entry point
+/*
+Checks API mode 2 unescaping and compares sequential and pipelined AT commands.
+*/
+void test_xbee0()
+{
+    typedef xbee::EscapedStream<boost::asio::ip::tcp::socket> Stream;
+
+    { // unescape split by chunks
+        const String frame = "\x7E\x00\x05\x08\x01\x7E\x7D\x11\x13";
+        const String escaped = xbee_escape_frame(frame);
+        for (size_t k = 1; k <= escaped.size(); ++k)
+        {
+            String res;
+            bool pending = false;
+            for (size_t i = 0; i < escaped.size(); i += k)
+            {
+                std::vector<UInt8> chunk(escaped.begin() + i,
+                    escaped.begin() + std::min(escaped.size(), i+k));
+                const size_t n = Stream::unescape(&chunk[0], chunk.size(), &chunk[0], pending);
+                res.append(chunk.begin(), chunk.begin() + n);
+            }
+
+            MY_ASSERT(res == frame && !pending, "bad unescaped data");
+        }
+    }
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+    const size_t N = 200;
+    bench_xbee_at(true, 1, false, N);
+    bench_xbee_at(true, 8, false, N);
+    bench_xbee_at(true, 8, true, N);
+    bench_xbee_at(false, 8, true, N);
+#else
+    std::cout << "local sockets are not supported\n";
+#endif // BOOST_ASIO_HAS_LOCAL_SOCKETS
+}
+
+
+// test application entry point
+/*
+Checks payload views and compares them with payload parsing.
+*/
+void test_xbee1()
+{
+    using namespace boost::posix_time;
+
+    xbee::Frame::ZBReceivePacket packet;
+    packet.srcAddr64 = 0x0013A20040A1B2C3ULL;
+    packet.srcAddr16 = 0x1234;
+    packet.options = 0x01;
+    packet.data.assign(64, 'x');
+    const xbee::Frame::SharedPtr frame = xbee::Frame::create(packet);
+
+    { // consistency
+        xbee::Frame::ZBReceivePacketView view;
+        MY_ASSERT(frame->getView(view), "cannot get receive packet view");
+        MY_ASSERT(view.getSrcAddr64() == packet.srcAddr64
+            && view.getSrcAddr16() == packet.srcAddr16
+            && view.getOptions() == packet.options, "bad receive packet fields");
+        MY_ASSERT(String(view.getData(), view.getData() + view.getDataSize()) == packet.data,
+            "bad receive packet data");
+
+        xbee::Frame::ZBTransmitStatusView status;
+        MY_ASSERT(!frame->getView(status) && !status.isValid(), "frame type is not checked");
+
+        xbee::Frame::ZBTransmitStatus ts;
+        ts.frameId = 7;
+        ts.dstAddr16 = 0xABCD;
+        ts.retryCount = 2;
+        ts.deliveryStatus = 0x21;
+        ts.discoveryStatus = 0x01;
+        const xbee::Frame::SharedPtr tsFrame = xbee::Frame::create(ts); // (!) should be alive while view is used
+        MY_ASSERT(tsFrame->getView(status), "cannot get transmit status view");
+        MY_ASSERT(status.getFrameId() == 7 && status.getDstAddr16() == 0xABCD
+            && status.getRetryCount() == 2 && status.getDeliveryStatus() == 0x21
+            && status.getDiscoveryStatus() == 0x01, "bad transmit status fields");
+
+        xbee::Frame::ATCommandResponse at;
+        at.frameId = 3;
+        at.command = "MY";
+        at.status = 0;
+        at.result = "\x12\x34";
+        xbee::Frame::ATCommandResponseView atv;
+        const xbee::Frame::SharedPtr atFrame = xbee::Frame::create(at);
+        MY_ASSERT(atFrame->getView(atv), "cannot get AT response view");
+        MY_ASSERT(atv.getFrameId() == 3 && String(atv.getCommand(), 2) == "MY"
+            && atv.getStatus() == 0 && atv.getResultSize() == 2
+            && atv.getResult()[1] == 0x34, "bad AT response fields");
+
+        // truncated payload
+        const UInt8 truncated[] = { xbee::Frame::ZB_RECEIVE_PACKET, 0x00, 0x13 };
+        MY_ASSERT(!view.assign(truncated, sizeof(truncated)) && !view.isValid(),
+            "truncated payload is accepted");
+    }
+
+    { // decoding benchmark
+        // rotating set of frames, so the decoding is not loop-invariant
+        const size_t K = 16;
+        const size_t N = 1000000;
+        std::vector<xbee::Frame::SharedPtr> frames(K);
+        UInt64 expected = 0;
+        for (size_t k = 0; k < K; ++k)
+        {
+            xbee::Frame::ZBReceivePacket p = packet;
+            p.srcAddr16 = UInt16(0x1234 + k);
+            p.data.assign(32 + 4*k, char('a' + k));
+            frames[k] = xbee::Frame::create(p);
+            expected += p.srcAddr16 + p.data.size();
+        }
+        expected *= 2*(N/K);
+
+        UInt64 sum = 0;
+
+        const ptime t0 = microsec_clock::universal_time();
+        for (size_t i = 0; i < N; ++i)
+        {
+            xbee::Frame::ZBReceivePacket payload;
+            if (frames[i%K]->getPayload(payload))
+                sum += payload.srcAddr16 + payload.data.size();
+        }
+
+        const ptime t1 = microsec_clock::universal_time();
+        for (size_t i = 0; i < N; ++i)
+        {
+            xbee::Frame::ZBReceivePacketView view;
+            if (frames[i%K]->getView(view))
+                sum += view.getSrcAddr16() + view.getDataSize();
+        }
+
+        const ptime t2 = microsec_clock::universal_time();
+        MY_ASSERT(N%K == 0 && sum == expected, "bad decoding");
+
+        std::cout << N << " receive packets: payload "
+            << (t1-t0).total_milliseconds() << "ms, view "
+            << (t2-t1).total_milliseconds() << "ms\n";
+    }
+}
+
+
+
+// count the cancelled frames
+void on_xbee_aborted(size_t *count, int status)
+{
+    MY_ASSERT(status == XBeePipelineBench::API::TX_STATUS_ABORTED, "frame is not cancelled");
+    *count += 1;
+}
+
+
+// test application entry point
+/*
+Checks the network address caching by transmit scheduler
+and the cancellation of pending frames.
+*/
+void test_xbee2()
+{
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+    typedef XBeePipelineBench::API API;
+    const size_t N = 10;
+
+    std::vector<UInt64> nodes;
+    nodes.push_back(0x0013A200000000A1ULL);
+    nodes.push_back(0x0013A200000000B2ULL);
+
+    boost::asio::io_service ios;
+    XBeePipelineBench bench(ios, false, 8);
+    bench.getAPI()->setTxWindow(1, 4);
+
+    // the first frame discovers the address
+    bench.transmit(nodes, N);
+    ios.run();
+    for (size_t k = 0; k < nodes.size(); ++k)
+    {
+        const API::TxStats stats = bench.getAPI()->getTxStats(nodes[k]);
+        MY_ASSERT(stats.delivered == N && stats.discoveries == 1, "address is not cached");
+        MY_ASSERT(stats.address16 == 0x1000 + (nodes[k]&0xFF), "bad cached address");
+    }
+
+    // nodes rejoin, the cached address is stale
+    bench.getModule().setAddressBase(0x2000);
+    ios.reset();
+    bench.transmit(nodes, N);
+    ios.run();
+    for (size_t k = 0; k < nodes.size(); ++k)
+    {
+        const API::TxStats stats = bench.getAPI()->getTxStats(nodes[k]);
+        MY_ASSERT(stats.delivered == 2*N && stats.failed == 0, "frame is not delivered");
+        MY_ASSERT(stats.discoveries == 2 && stats.retries == 1, "stale address is not rediscovered");
+        MY_ASSERT(stats.address16 == 0x2000 + (nodes[k]&0xFF), "bad cached address");
+    }
+
+    // in-flight and queued frames are cancelled
+    size_t aborted = 0;
+    for (size_t i = 0; i < 2; ++i)
+        for (size_t k = 0; k < nodes.size(); ++k)
+    {
+        bench.getAPI()->transmit(xbee::Frame::ZBTransmitRequest("data", 0, nodes[k]),
+            boost::bind(on_xbee_aborted, &aborted, _1));
+    }
+    MY_ASSERT(0 < bench.getAPI()->getTxInFlight() && 0 < bench.getAPI()->getTxQueued(),
+        "frames should be in flight and queued");
+    bench.getAPI()->cancelTx();
+    MY_ASSERT(0 == bench.getAPI()->getTxInFlight() && 0 == bench.getAPI()->getTxQueued(),
+        "frames are not cancelled");
+    ios.reset();
+    ios.poll();
+    MY_ASSERT(2*nodes.size() == aborted, "cancelled frames are not reported");
+
+    std::cout << 2*N*nodes.size() << " frames to " << nodes.size()
+        << " nodes, " << 2*nodes.size() << " address discoveries\n";
+#else
+    std::cout << "local sockets are not supported\n";
+#endif // BOOST_ASIO_HAS_LOCAL_SOCKETS
+}
+
+#undef MY_ASSERT
+
+} // local namespace
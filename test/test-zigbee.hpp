@@ -0,0 +1,140 @@
+/** @file
+@brief The ZigBee gateway nodes index test.
+@author Sergey Polichnoy <sergey.polichnoy@dataart.com>
+*/
+#include <examples/zigbee_gw.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <stdexcept>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+    using namespace hive;
+
+// assert macro, throws exception
+#define MY_ASSERT(cond, msg) \
+    if (cond) {} else throw std::runtime_error(msg)
+
+
+// the simple ZigBee node
+struct ZigbeeTestNode
+{
+    UInt64 address64;
+    UInt16 address16;
+    devicehive::DevicePtr device;
+
+    ZigbeeTestNode()
+        : address64(0)
+        , address16(0xFFFE)
+    {}
+};
+
+typedef zigbee_gw::NodeIndex<ZigbeeTestNode> ZigbeeTestIndex;
+
+
+// find node by device, the old linear scan
+ZigbeeTestIndex::NodePtr find_zigbee_node_scan(ZigbeeTestIndex const& index, devicehive::DevicePtr device)
+{
+    for (ZigbeeTestIndex::Iterator i = index.begin(); i != index.end(); ++i)
+    {
+        if (i->second->device == device)
+            return i->second;
+    }
+
+    return ZigbeeTestIndex::NodePtr();
+}
+
+
+// test application entry point
+/*
+Checks the nodes index and compares lookup with linear scan.
+*/
+void test_zigbee0()
+{
+    using namespace boost::posix_time;
+
+    const size_t N = 1000;
+    const size_t LOOKUPS = 100000;
+
+    ZigbeeTestIndex index;
+    std::vector<devicehive::DevicePtr> devices;
+    for (size_t i = 0; i < N; ++i)
+    {
+        ZigbeeTestIndex::NodePtr node = index.get(0x0013A20000000000ULL + i);
+        index.setAddress16(node, UInt16(i));
+
+        OStringStream id;
+        id << "device-" << i;
+        devicehive::DevicePtr device = devicehive::Device::create(id.str(), "", "");
+        index.setDevice(node, device);
+        devices.push_back(device);
+    }
+    MY_ASSERT(index.size() == N, "bad number of nodes");
+
+    { // consistency
+        ZigbeeTestIndex::NodePtr node = index.find(devices[10]);
+        MY_ASSERT(node && node->address64 == 0x0013A20000000000ULL + 10, "bad lookup by device");
+        MY_ASSERT(index.find(String("device-10")) == node, "bad lookup by identifier");
+        MY_ASSERT(index.find16(10) == node, "bad lookup by network address");
+
+        // node rejoins with the address of another node
+        index.setAddress16(node, 20);
+        MY_ASSERT(index.find16(20) == node && !index.find16(10), "network address is not updated");
+        MY_ASSERT(index.find(0x0013A20000000000ULL + 20)->address16 == ZigbeeTestIndex::UNKNOWN_ADDRESS16,
+            "reused network address is not reset");
+
+        // node leaves the network
+        ZigbeeTestIndex::NodePtr other = index.find(0x0013A20000000000ULL + 30);
+        index.resetAddress16(other);
+        MY_ASSERT(!index.find16(30) && other->address16 == ZigbeeTestIndex::UNKNOWN_ADDRESS16,
+            "network address is not reset");
+        index.setAddress16(other, 30);
+        MY_ASSERT(index.find16(30) == other, "network address is not restored");
+
+        // device is re-created
+        devicehive::DevicePtr device = devicehive::Device::create("device-10", "", "");
+        index.setDevice(node, device);
+        MY_ASSERT(index.find(device) == node && !index.find(devices[10]), "device is not updated");
+        devices[10] = device;
+
+        // two nodes share the device identifier
+        ZigbeeTestIndex::NodePtr first = index.find(devices[40]);
+        ZigbeeTestIndex::NodePtr second = index.find(devices[50]);
+        index.setDevice(first, devicehive::Device::create("device-50", "", ""));
+        MY_ASSERT(index.find(String("device-50")) == first, "shared identifier is not updated");
+        index.setDevice(second, devices[50]);
+        MY_ASSERT(index.find(String("device-50")) == second, "shared identifier is not restored");
+        index.setDevice(first, devices[40]);
+        MY_ASSERT(index.find(String("device-50")) == second && index.find(devices[50]) == second,
+            "other node's device is removed");
+        MY_ASSERT(index.find(String("device-40")) == first, "device identifier is not updated");
+    }
+
+    { // lookup benchmark
+        size_t found = 0;
+        const ptime t0 = microsec_clock::universal_time();
+        for (size_t i = 0; i < LOOKUPS; ++i)
+            found += find_zigbee_node_scan(index, devices[(i*7919)%N]) ? 1 : 0;
+
+        const ptime t1 = microsec_clock::universal_time();
+        for (size_t i = 0; i < LOOKUPS; ++i)
+            found += index.find(devices[(i*7919)%N]) ? 1 : 0;
+
+        const ptime t2 = microsec_clock::universal_time();
+        for (size_t i = 0; i < LOOKUPS; ++i)
+            found += index.find(devices[(i*7919)%N]->id) ? 1 : 0;
+
+        const ptime t3 = microsec_clock::universal_time();
+        MY_ASSERT(found == 3*LOOKUPS, "not all nodes are found");
+
+        std::cout << N << " nodes, " << LOOKUPS << " lookups: scan "
+            << (t1-t0).total_milliseconds() << "ms, by device "
+            << (t2-t1).total_milliseconds() << "ms, by identifier "
+            << (t3-t2).total_milliseconds() << "ms\n";
+    }
+}
+
+#undef MY_ASSERT
+
+} // local namespace